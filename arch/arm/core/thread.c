@@ -138,6 +138,17 @@ void _new_thread(char *pStackMem, unsigned stackSize,
 	/* static threads overwrite it afterwards with real value */
 	tcs->init_data = NULL;
 	tcs->fn_abort = NULL;
+#ifdef CONFIG_THREAD_STATS
+	tcs->stats.cycles = 0;
+	tcs->stats.switches = 0;
+	tcs->stats.stack_size = stackSize;
+#endif
+#ifdef CONFIG_SCHED_DEADLINE
+	tcs->deadline.active = 0;
+	tcs->deadline.stats.jobs = 0;
+	tcs->deadline.stats.misses = 0;
+	tcs->deadline.stats.max_lateness = 0;
+#endif
 #else
 	tcs->link = NULL;
 	tcs->flags = priority == -1 ? TASK | PREEMPTIBLE : FIBER;
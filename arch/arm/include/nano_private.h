@@ -214,6 +214,12 @@ struct tcs {
 	void *init_data;
 	void (*fn_abort)(void);
 #endif
+#ifdef CONFIG_THREAD_STATS
+	struct k_thread_stats stats;
+#endif
+#ifdef CONFIG_SCHED_DEADLINE
+	struct _thread_deadline deadline;
+#endif
 #ifdef CONFIG_FLOAT
 	/*
 	 * No cooperative floating point register set structure exists for
@@ -146,6 +146,9 @@ static int show_help(int argc, char *argv[])
 
 	printk("Available commands:\n");
 	printk("help\n");
+#ifdef CONFIG_THREAD_STATS
+	printk("kernel\n");
+#endif
 
 	for (i = 0; commands[i].cmd_name; i++) {
 		printk("%s\n", commands[i].cmd_name);
@@ -154,6 +157,20 @@ static int show_help(int argc, char *argv[])
 	return 0;
 }
 
+#ifdef CONFIG_THREAD_STATS
+static int kernel_cmd(int argc, char *argv[])
+{
+	if (argc < 2 || strcmp(argv[1], "threads")) {
+		printk("kernel threads\n");
+		return 0;
+	}
+
+	k_thread_stats_show();
+
+	return 0;
+}
+#endif
+
 static shell_cmd_function_t get_cb(const char *string)
 {
 	int i;
@@ -166,6 +183,12 @@ static shell_cmd_function_t get_cb(const char *string)
 		return show_help;
 	}
 
+#ifdef CONFIG_THREAD_STATS
+	if (!strcmp(string, "kernel")) {
+		return kernel_cmd;
+	}
+#endif
+
 	for (i = 0; commands[i].cmd_name; i++) {
 		if (!strcmp(string, commands[i].cmd_name)) {
 			return commands[i].cb;
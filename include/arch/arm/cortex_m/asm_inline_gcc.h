@@ -99,6 +99,13 @@ static ALWAYS_INLINE unsigned int find_lsb_set(uint32_t op)
 	return bit;
 }
 
+#ifdef CONFIG_INT_LATENCY_BENCHMARK
+void _int_latency_start(void);
+void _int_latency_stop(void);
+#else
+#define _int_latency_start()  do { } while (0)
+#define _int_latency_stop()   do { } while (0)
+#endif
 
 /**
  *
@@ -149,6 +156,8 @@ static ALWAYS_INLINE unsigned int _arch_irq_lock(void)
 		: "i"(_EXC_IRQ_DEFAULT_PRIO)
 		: "r1");
 
+	_int_latency_start();
+
 	return key;
 }
 
@@ -170,6 +179,10 @@ static ALWAYS_INLINE unsigned int _arch_irq_lock(void)
 
 static ALWAYS_INLINE void _arch_irq_unlock(unsigned int key)
 {
+	if (key == 0) {
+		_int_latency_stop();
+	}
+
 	__asm__ volatile("msr BASEPRI, %0;\n\t" :  : "r"(key));
 }
 
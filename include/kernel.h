@@ -77,6 +77,14 @@ typedef sys_dlist_t _wait_q_t;
 #define _DEBUG_TRACING_KERNEL_OBJECTS_NEXT_PTR(type)
 #endif
 
+#ifdef CONFIG_POLL
+#define _POLL_EVENT_OBJ_INIT .poll_event = NULL,
+#define _POLL_EVENT struct k_poll_event *poll_event
+#else
+#define _POLL_EVENT_OBJ_INIT
+#define _POLL_EVENT
+#endif
+
 #define k_thread tcs
 struct tcs;
 struct k_mutex;
@@ -91,6 +99,7 @@ struct k_stack;
 struct k_mem_map;
 struct k_mem_pool;
 struct k_timer;
+struct k_poll_event;
 
 typedef struct k_thread *k_tid_t;
 
@@ -114,6 +123,33 @@ extern k_tid_t k_thread_spawn(char *stack, unsigned stack_size,
 			      void *p1, void *p2, void *p3,
 			      int32_t prio, uint32_t options, int32_t delay);
 
+#ifdef CONFIG_THREAD_STACK_POOL
+/**
+ * @brief Spawn a thread on a stack from the thread stack pool
+ *
+ * Like k_thread_spawn(), except that the stack is taken from the pool of
+ * CONFIG_THREAD_STACK_POOL_STACKS stacks, and goes back to it once the thread
+ * has exited or been aborted, or has been canceled before starting.
+ *
+ * @param stack_size Stack size the thread needs, in bytes.
+ * @param entry Thread entry function.
+ * @param p1 1st entry point parameter.
+ * @param p2 2nd entry point parameter.
+ * @param p3 3rd entry point parameter.
+ * @param prio Thread priority.
+ * @param options Thread options.
+ * @param delay Scheduling delay (in milliseconds), or K_NO_WAIT (for no delay).
+ *
+ * @return ID of the new thread, or NULL if the pool has no stack left or the
+ * pool stacks are smaller than @a stack_size.
+ */
+extern k_tid_t k_thread_spawn_dynamic(unsigned stack_size,
+				      void (*entry)(void *, void *, void *),
+				      void *p1, void *p2, void *p3,
+				      int32_t prio, uint32_t options,
+				      int32_t delay);
+#endif
+
 extern void k_sleep(int32_t duration);
 extern void k_busy_wait(uint32_t usec_to_wait);
 extern void k_yield(void);
@@ -265,6 +301,101 @@ extern int k_am_in_isr(void);
 extern void k_thread_custom_data_set(void *value);
 extern void *k_thread_custom_data_get(void);
 
+#ifdef CONFIG_THREAD_STATS
+/**
+ * @brief Thread runtime statistics.
+ */
+struct k_thread_stats {
+	/** cycles spent running, including ISRs that preempted the thread */
+	uint64_t cycles;
+	/** number of times the thread was switched in */
+	uint32_t switches;
+	/** size of the thread's stack area, including its thread structure */
+	uint32_t stack_size;
+};
+
+/**
+ * @brief Get the runtime statistics of a thread.
+ *
+ * @param thread Thread to examine.
+ * @param stats Destination for the statistics. The cycles of the current
+ * thread include the time since it was last switched in.
+ *
+ * @return N/A
+ */
+extern void k_thread_stats_get(k_tid_t thread, struct k_thread_stats *stats);
+
+/**
+ * @brief Get the number of stack bytes a thread has never used.
+ *
+ * Scans the thread's stack area for the pattern written by
+ * CONFIG_INIT_STACKS, so the cost is proportional to the stack size.
+ *
+ * @param thread Thread to examine.
+ *
+ * @return Stack headroom, in bytes.
+ */
+extern size_t k_thread_stack_unused_get(k_tid_t thread);
+
+/**
+ * @brief Print the CPU usage, number of switches and stack headroom of
+ * each thread.
+ *
+ * @return N/A
+ */
+extern void k_thread_stats_show(void);
+#endif /* CONFIG_THREAD_STATS */
+
+#ifdef CONFIG_SCHED_DEADLINE
+/**
+ * @brief Deadline statistics of a thread.
+ */
+struct k_thread_deadline_stats {
+	/** number of jobs completed */
+	uint32_t jobs;
+	/** number of jobs completed after their deadline */
+	uint32_t misses;
+	/** largest lateness of a job, in hardware cycles */
+	uint32_t max_lateness;
+};
+
+struct _thread_deadline {
+	uint32_t abs;	/* hardware cycle counter value */
+	int active;
+	struct k_thread_deadline_stats stats;
+};
+
+/**
+ * @brief Set the deadline of a thread's current job.
+ *
+ * Among ready threads of the same priority, the ones with a deadline run
+ * first, earliest deadline first, and preempt the ones without a deadline
+ * or with a later one. Threads of different priorities are still scheduled
+ * by priority only.
+ *
+ * Setting a deadline completes the previous job of the thread, if it had
+ * one, and accounts for it in the thread's deadline statistics.
+ *
+ * @param thread Thread whose deadline is set.
+ * @param deadline Deadline (in milliseconds) from now, or K_FOREVER to
+ * complete the current job without starting a new one.
+ *
+ * @return N/A
+ */
+extern void k_thread_deadline_set(k_tid_t thread, int32_t deadline);
+
+/**
+ * @brief Get the deadline statistics of a thread.
+ *
+ * @param thread Thread to examine.
+ * @param stats Destination for the statistics.
+ *
+ * @return N/A
+ */
+extern void k_thread_deadline_stats_get(k_tid_t thread,
+					struct k_thread_deadline_stats *stats);
+#endif /* CONFIG_SCHED_DEADLINE */
+
 /**
  *  kernel timing
  */
@@ -494,8 +625,10 @@ extern uint32_t k_cycle_get_32(void);
 /* fifos */
 
 struct k_fifo {
+	atomic_t incoming;
 	_wait_q_t wait_q;
 	sys_slist_t data_q;
+	_POLL_EVENT;
 
 	_DEBUG_TRACING_KERNEL_OBJECTS_NEXT_PTR(k_fifo);
 };
@@ -508,8 +641,10 @@ extern void *k_fifo_get(struct k_fifo *fifo, int32_t timeout);
 
 #define K_FIFO_INITIALIZER(obj) \
 	{ \
+	.incoming = ATOMIC_INIT(0), \
 	.wait_q = SYS_DLIST_STATIC_INIT(&obj.wait_q), \
 	.data_q = SYS_SLIST_STATIC_INIT(&obj.data_q), \
+	_POLL_EVENT_OBJ_INIT \
 	_DEBUG_TRACING_KERNEL_OBJECTS_INIT \
 	}
 
@@ -520,7 +655,7 @@ extern void *k_fifo_get(struct k_fifo *fifo, int32_t timeout);
 
 struct k_lifo {
 	_wait_q_t wait_q;
-	void *list;
+	atomic_t list;
 
 	_DEBUG_TRACING_KERNEL_OBJECTS_NEXT_PTR(k_lifo);
 };
@@ -532,7 +667,7 @@ extern void *k_lifo_get(struct k_lifo *lifo, int32_t timeout);
 #define K_LIFO_INITIALIZER(obj) \
 	{ \
 	.wait_q = SYS_DLIST_STATIC_INIT(&obj.wait_q), \
-	.list = NULL, \
+	.list = ATOMIC_INIT(0), \
 	_DEBUG_TRACING_KERNEL_OBJECTS_INIT \
 	}
 
@@ -579,15 +714,41 @@ struct k_work;
 
 typedef void (*k_work_handler_t)(struct k_work *);
 
+#ifdef CONFIG_WORKQUEUE_STATS
+/**
+ * @brief Workqueue latency statistics.
+ *
+ * Histograms are indexed by the position of the most significant bit set in
+ * the measured duration (in hardware cycles): bucket n counts durations in
+ * the [2^(n-1), 2^n) range, bucket 0 counts zero-length durations, and the
+ * last bucket also accumulates all longer durations.
+ */
+struct k_work_q_stats {
+	/* number of work items executed */
+	uint32_t items;
+	/* enqueue-to-start latency histogram */
+	uint32_t wait_hist[CONFIG_WORKQUEUE_STATS_BUCKETS];
+	/* handler run-time histogram */
+	uint32_t run_hist[CONFIG_WORKQUEUE_STATS_BUCKETS];
+	/* worst enqueue-to-start latency (in cycles) */
+	uint32_t max_wait;
+	/* worst handler run-time (in cycles) */
+	uint32_t max_run;
+};
+#endif
+
 /**
- * A workqueue is a fiber that executes @ref k_work items that are
- * queued to it.  This is useful for drivers which need to schedule
+ * A workqueue is a pool of one or more fibers that execute @ref k_work items
+ * that are queued to it.  This is useful for drivers which need to schedule
  * execution of code which might sleep from ISR context.  The actual
- * fiber identifier is not stored in the structure in order to save
+ * fiber identifiers are not stored in the structure in order to save
  * space.
  */
 struct k_work_q {
 	struct k_fifo fifo;
+#ifdef CONFIG_WORKQUEUE_STATS
+	struct k_work_q_stats stats;
+#endif
 };
 
 /**
@@ -604,6 +765,9 @@ struct k_work {
 	void *_reserved;		/* Used by k_fifo implementation. */
 	k_work_handler_t handler;
 	atomic_t flags[1];
+#ifdef CONFIG_WORKQUEUE_STATS
+	uint32_t _submit_cycles;	/* Used for latency statistics. */
+#endif
 };
 
 /**
@@ -644,6 +808,9 @@ static inline void k_work_submit_to_queue(struct k_work_q *work_q,
 					  struct k_work *work)
 {
 	if (!atomic_test_and_set_bit(work->flags, K_WORK_STATE_PENDING)) {
+#ifdef CONFIG_WORKQUEUE_STATS
+		work->_submit_cycles = k_cycle_get_32();
+#endif
 		k_fifo_put(&work_q->fifo, work);
 	}
 }
@@ -663,6 +830,43 @@ static inline int k_work_pending(struct k_work *work)
 extern void k_work_q_start(struct k_work_q *work_q,
 				 const struct k_thread_config *config);
 
+/**
+ * @brief Start a new workqueue served by a pool of threads.
+ *
+ * All threads of the pool pull work items from the same queue, so that one
+ * slow handler does not delay the execution of the other pending items.
+ * Each thread executes up to CONFIG_WORKQUEUE_BATCH_SIZE items back-to-back
+ * before yielding the CPU.
+ *
+ * Since the pending state of a work item is cleared before its handler is
+ * invoked, a work item resubmitted while its handler runs can be executed
+ * concurrently by another thread of the pool: such handlers must provide
+ * their own mutual exclusion if needed.
+ *
+ * This routine can be called from either fiber or task context.
+ *
+ * @param work_q Workqueue to start
+ * @param config Array of @a num_threads thread configurations, one per
+ *               thread of the pool
+ * @param num_threads Number of threads in the pool
+ *
+ * @return N/A
+ */
+extern void k_work_q_pool_start(struct k_work_q *work_q,
+				const struct k_thread_config *config,
+				int num_threads);
+
+#ifdef CONFIG_WORKQUEUE_STATS
+/**
+ * @brief Reset the latency statistics of a workqueue.
+ *
+ * @param work_q Workqueue whose statistics are reset
+ *
+ * @return N/A
+ */
+extern void k_work_q_stats_reset(struct k_work_q *work_q);
+#endif
+
 #if defined(CONFIG_SYS_CLOCK_EXISTS)
 
  /*
@@ -764,6 +968,7 @@ static inline int k_delayed_work_submit(struct k_delayed_work *work,
 /* mutexes */
 
 struct k_mutex {
+	atomic_t state;
 	_wait_q_t wait_q;
 	struct k_thread *owner;
 	uint32_t lock_count;
@@ -785,6 +990,7 @@ struct k_mutex {
 
 #define K_MUTEX_INITIALIZER(obj) \
 	{ \
+	.state = ATOMIC_INIT(0), \
 	.wait_q = SYS_DLIST_STATIC_INIT(&obj.wait_q), \
 	.owner = NULL, \
 	.lock_count = 0, \
@@ -804,8 +1010,9 @@ extern void k_mutex_unlock(struct k_mutex *mutex);
 
 struct k_sem {
 	_wait_q_t wait_q;
-	unsigned int count;
+	atomic_t count;
 	unsigned int limit;
+	_POLL_EVENT;
 
 	_DEBUG_TRACING_KERNEL_OBJECTS_NEXT_PTR(k_sem);
 };
@@ -879,7 +1086,7 @@ extern void k_sem_give(struct k_sem *sem);
  */
 static inline void k_sem_reset(struct k_sem *sem)
 {
-	sem->count = 0;
+	atomic_clear(&sem->count);
 }
 
 /**
@@ -894,7 +1101,7 @@ static inline void k_sem_reset(struct k_sem *sem)
  */
 static inline unsigned int k_sem_count_get(struct k_sem *sem)
 {
-	return sem->count;
+	return (unsigned int)sem->count;
 }
 
 #ifdef CONFIG_SEMAPHORE_GROUPS
@@ -953,6 +1160,7 @@ extern void k_sem_group_reset(struct k_sem *sem_array[]);
 	.wait_q = SYS_DLIST_STATIC_INIT(&obj.wait_q), \
 	.count = initial_count, \
 	.limit = count_limit, \
+	_POLL_EVENT_OBJ_INIT \
 	_DEBUG_TRACING_KERNEL_OBJECTS_INIT \
 	}
 
@@ -975,6 +1183,129 @@ extern void k_sem_group_reset(struct k_sem *sem_array[]);
 	struct k_sem name = \
 		K_SEM_INITIALIZER(name, initial_count, count_limit)
 
+/* reader-writer locks */
+
+struct k_rwlock {
+	atomic_t state;
+	_wait_q_t readers;
+	_wait_q_t writers;
+	struct k_thread *writer;
+	int writer_orig_prio;
+
+	_DEBUG_TRACING_KERNEL_OBJECTS_NEXT_PTR(k_rwlock);
+};
+
+#define K_RWLOCK_INITIALIZER(obj) \
+	{ \
+	.state = ATOMIC_INIT(0), \
+	.readers = SYS_DLIST_STATIC_INIT(&obj.readers), \
+	.writers = SYS_DLIST_STATIC_INIT(&obj.writers), \
+	.writer = NULL, \
+	.writer_orig_prio = K_LOWEST_THREAD_PRIO, \
+	_DEBUG_TRACING_KERNEL_OBJECTS_INIT \
+	}
+
+/**
+ * @def K_RWLOCK_DEFINE
+ *
+ * @brief Statically define and initialize a global reader-writer lock.
+ *
+ * Create a global reader-writer lock named @name. It is initialized as if
+ * k_rwlock_init() was called on it. If the lock is to be accessed outside the
+ * module where it is defined, it can be declared via
+ *
+ *    extern struct k_rwlock @name;
+ *
+ * @param name Name of the reader-writer lock variable.
+ */
+#define K_RWLOCK_DEFINE(name) \
+	struct k_rwlock name = K_RWLOCK_INITIALIZER(name)
+
+/**
+ * @brief Initialize a reader-writer lock object.
+ *
+ * A reader-writer lock is held either by any number of readers, or by a
+ * single writer. Writers are preferred: once a writer waits for the lock,
+ * new readers wait behind it. The writer holding the lock inherits the
+ * priority of the highest priority thread waiting for the lock.
+ *
+ * Cannot be called from ISR.
+ *
+ * @param rwlock Pointer to a reader-writer lock object.
+ *
+ * @return N/A
+ */
+extern void k_rwlock_init(struct k_rwlock *rwlock);
+
+/**
+ * @brief Take a reader-writer lock for reading, possibly pending.
+ *
+ * The lock is taken right away if no writer holds it or waits for it.
+ * Unlike a mutex, the lock cannot be taken again recursively if a writer
+ * waits for it.
+ *
+ * Cannot be called from ISR.
+ *
+ * @param rwlock Pointer to a reader-writer lock object.
+ * @param timeout Number of milliseconds to wait if the lock is unavailable,
+ *                or one of the special values K_NO_WAIT and K_FOREVER.
+ *
+ * @retval 0 When the lock is taken.
+ * @retval -EAGAIN When timeout expires.
+ * @retval -EBUSY When unavailable and the timeout is K_NO_WAIT.
+ *
+ * @sa K_NO_WAIT, K_FOREVER
+ */
+extern int k_rwlock_read_lock(struct k_rwlock *rwlock, int32_t timeout);
+
+/**
+ * @brief Release a reader-writer lock taken for reading.
+ *
+ * The last reader to release the lock hands it to the first waiting writer.
+ *
+ * Cannot be called from ISR.
+ *
+ * @param rwlock Pointer to a reader-writer lock object.
+ *
+ * @return N/A
+ */
+extern void k_rwlock_read_unlock(struct k_rwlock *rwlock);
+
+/**
+ * @brief Take a reader-writer lock for writing, possibly pending.
+ *
+ * The lock is taken right away if nobody holds it. The lock cannot be taken
+ * recursively.
+ *
+ * Cannot be called from ISR.
+ *
+ * @param rwlock Pointer to a reader-writer lock object.
+ * @param timeout Number of milliseconds to wait if the lock is unavailable,
+ *                or one of the special values K_NO_WAIT and K_FOREVER.
+ *
+ * @retval 0 When the lock is taken.
+ * @retval -EAGAIN When timeout expires.
+ * @retval -EBUSY When unavailable and the timeout is K_NO_WAIT.
+ *
+ * @sa K_NO_WAIT, K_FOREVER
+ */
+extern int k_rwlock_write_lock(struct k_rwlock *rwlock, int32_t timeout);
+
+/**
+ * @brief Release a reader-writer lock taken for writing.
+ *
+ * The lock is handed to the first waiting writer if there is one, otherwise
+ * to all the waiting readers. The priority of the calling thread is restored
+ * to the one it had when it took the lock.
+ *
+ * Cannot be called from ISR.
+ *
+ * @param rwlock Pointer to a reader-writer lock object.
+ *
+ * @return N/A
+ */
+extern void k_rwlock_write_unlock(struct k_rwlock *rwlock);
+
 /* events */
 
 #define K_EVT_DEFAULT NULL
@@ -1018,28 +1349,36 @@ extern void k_event_send(struct k_event *event);
 /* message queues */
 
 struct k_msgq {
-	_wait_q_t wait_q;
+	struct {
+		_wait_q_t readers; /* Reader wait queue */
+		_wait_q_t writers; /* Writer wait queue */
+	} wait_q;
 	uint32_t msg_size;
 	uint32_t max_msgs;
 	char *buffer_start;
 	char *buffer_end;
 	char *read_ptr;
 	char *write_ptr;
+	char *claim_ptr;
 	uint32_t used_msgs;
+	_POLL_EVENT;
 
 	_DEBUG_TRACING_KERNEL_OBJECTS_NEXT_PTR(k_msgq);
 };
 
 #define K_MSGQ_INITIALIZER(obj, q_buffer, q_msg_size, q_max_msgs) \
 	{ \
-	.wait_q = SYS_DLIST_STATIC_INIT(&obj.wait_q), \
+	.wait_q.readers = SYS_DLIST_STATIC_INIT(&obj.wait_q.readers), \
+	.wait_q.writers = SYS_DLIST_STATIC_INIT(&obj.wait_q.writers), \
 	.max_msgs = q_max_msgs, \
 	.msg_size = q_msg_size, \
 	.buffer_start = q_buffer, \
 	.buffer_end = q_buffer + (q_max_msgs * q_msg_size), \
 	.read_ptr = q_buffer, \
 	.write_ptr = q_buffer, \
+	.claim_ptr = NULL, \
 	.used_msgs = 0, \
+	_POLL_EVENT_OBJ_INIT \
 	_DEBUG_TRACING_KERNEL_OBJECTS_INIT \
 	}
 
@@ -1098,6 +1437,23 @@ extern void k_msgq_init(struct k_msgq *q, char *buffer,
  */
 extern int k_msgq_put(struct k_msgq *q, void *data, int32_t timeout);
 
+/**
+ * @brief Add several messages to a message queue.
+ *
+ * This routine adds up to @a num_msgs messages, stored back to back at
+ * @a data, with interrupts locked only once. Messages are handed to waiting
+ * threads first, as k_msgq_put() does. The routine never waits for space,
+ * so it can be called from an ISR.
+ *
+ * @param q Pointer to the message queue object.
+ * @param data Pointer to the first message.
+ * @param num_msgs Number of messages to add.
+ *
+ * @return Number of messages added, which is less than @a num_msgs when
+ *         the message queue became full.
+ */
+extern int k_msgq_put_n(struct k_msgq *q, void *data, uint32_t num_msgs);
+
 /**
  * @brief Obtain a message from a message queue.
  *
@@ -1116,11 +1472,86 @@ extern int k_msgq_put(struct k_msgq *q, void *data, int32_t timeout);
  */
 extern int k_msgq_get(struct k_msgq *q, void *data, int32_t timeout);
 
+/**
+ * @brief Obtain several messages from a message queue.
+ *
+ * This routine fetches up to @a max_msgs of the oldest messages into the
+ * buffer at @a data, with interrupts locked only once. The routine never
+ * waits; a thread that must wait for data can use k_msgq_get() for the
+ * first message.
+ *
+ * @param q Pointer to the message queue object.
+ * @param data Pointer to room for @a max_msgs messages.
+ * @param max_msgs Maximum number of messages to obtain.
+ *
+ * @return Number of messages obtained.
+ */
+extern int k_msgq_get_n(struct k_msgq *q, void *data, uint32_t max_msgs);
+
+/**
+ * @brief Claim room for a message in a message queue.
+ *
+ * This routine reserves the next slot of the message queue's buffer and
+ * returns it, so that the caller can build the message in place instead of
+ * copying it in. The message becomes visible to readers, in the order of the
+ * claim, when k_msgq_commit() is called. Messages added after the claim are
+ * read after the claimed one.
+ *
+ * Only one message can be claimed at a time. While it is claimed, readers,
+ * and threads polling the message queue, wait for it to be committed even
+ * if messages were added after it.
+ *
+ * @param q Pointer to the message queue object.
+ *
+ * @return Pointer to the claimed slot, or NULL if the message queue is full
+ *         or another message is claimed.
+ */
+extern void *k_msgq_claim(struct k_msgq *q);
+
+/**
+ * @brief Commit a claimed message.
+ *
+ * This routine makes the message built in the slot returned by
+ * k_msgq_claim() available to readers, waking up the threads waiting to
+ * read.
+ *
+ * @param q Pointer to the message queue object.
+ *
+ * @return 0 if successful, -EINVAL if no message was claimed.
+ */
+extern int k_msgq_commit(struct k_msgq *q);
+
+/**
+ * @brief Read the oldest message of a message queue in place.
+ *
+ * This routine returns a pointer to the oldest message without removing it,
+ * so that a single reader can process it without copying it out. The message
+ * stays in the queue until k_msgq_release() is called.
+ *
+ * @param q Pointer to the message queue object.
+ *
+ * @return Pointer to the oldest message, or NULL if there is none.
+ */
+extern void *k_msgq_peek(struct k_msgq *q);
+
+/**
+ * @brief Remove the oldest message of a message queue.
+ *
+ * This routine discards the message returned by k_msgq_peek() and lets
+ * a thread waiting to write add its message.
+ *
+ * @param q Pointer to the message queue object.
+ *
+ * @return N/A
+ */
+extern void k_msgq_release(struct k_msgq *q);
+
 /**
  * @brief Purge contents of a message queue.
  *
  * Discards all messages currently in the message queue, and cancels
- * any "add message" operations initiated by waiting threads.
+ * any "add message" operations initiated by waiting threads. A claimed
+ * message is kept and can still be committed.
  *
  * @param q Pointer to the message queue object.
  *
@@ -1341,6 +1772,8 @@ struct k_pipe {
 		_wait_q_t      writers; /* Writer wait queue */
 	} wait_q;
 
+	_POLL_EVENT;
+
 	_DEBUG_TRACING_KERNEL_OBJECTS_NEXT_PTR(k_pipe);
 };
 
@@ -1353,6 +1786,7 @@ struct k_pipe {
 	.write_index = 0,                                             \
 	.wait_q.writers = SYS_DLIST_STATIC_INIT(&obj.wait_q.writers), \
 	.wait_q.readers = SYS_DLIST_STATIC_INIT(&obj.wait_q.readers), \
+	_POLL_EVENT_OBJ_INIT                                          \
 	_DEBUG_TRACING_KERNEL_OBJECTS_INIT                            \
 	}
 
@@ -1443,6 +1877,147 @@ extern void k_pipe_block_put(struct k_pipe *pipe, struct k_mem_block *block,
 			     size_t size, struct k_sem *sem);
 #endif
 
+#ifdef CONFIG_POLL
+/**
+ *  polling
+ */
+
+/* types of objects that can be polled */
+enum _poll_types_bits {
+	_POLL_TYPE_IGNORE,
+	_POLL_TYPE_SEM_AVAILABLE,
+	_POLL_TYPE_FIFO_DATA_AVAILABLE,
+	_POLL_TYPE_MSGQ_DATA_AVAILABLE,
+	_POLL_TYPE_PIPE_DATA_AVAILABLE,
+
+	_POLL_NUM_TYPES
+};
+
+#define K_POLL_TYPE_IGNORE              _POLL_TYPE_IGNORE
+#define K_POLL_TYPE_SEM_AVAILABLE       _POLL_TYPE_SEM_AVAILABLE
+#define K_POLL_TYPE_FIFO_DATA_AVAILABLE _POLL_TYPE_FIFO_DATA_AVAILABLE
+#define K_POLL_TYPE_MSGQ_DATA_AVAILABLE _POLL_TYPE_MSGQ_DATA_AVAILABLE
+#define K_POLL_TYPE_PIPE_DATA_AVAILABLE _POLL_TYPE_PIPE_DATA_AVAILABLE
+
+/* states of a polling event */
+enum _poll_states_bits {
+	_POLL_STATE_NOT_READY,
+	_POLL_STATE_EADDRINUSE,
+	_POLL_STATE_SEM_AVAILABLE,
+	_POLL_STATE_FIFO_DATA_AVAILABLE,
+	_POLL_STATE_MSGQ_DATA_AVAILABLE,
+	_POLL_STATE_PIPE_DATA_AVAILABLE,
+
+	_POLL_NUM_STATES
+};
+
+#define K_POLL_STATE_NOT_READY           _POLL_STATE_NOT_READY
+#define K_POLL_STATE_EADDRINUSE          _POLL_STATE_EADDRINUSE
+#define K_POLL_STATE_SEM_AVAILABLE       _POLL_STATE_SEM_AVAILABLE
+#define K_POLL_STATE_FIFO_DATA_AVAILABLE _POLL_STATE_FIFO_DATA_AVAILABLE
+#define K_POLL_STATE_MSGQ_DATA_AVAILABLE _POLL_STATE_MSGQ_DATA_AVAILABLE
+#define K_POLL_STATE_PIPE_DATA_AVAILABLE _POLL_STATE_PIPE_DATA_AVAILABLE
+
+/* polling modes */
+enum k_poll_modes {
+	/* polling thread does not take ownership of objects when available */
+	K_POLL_MODE_NOTIFY_ONLY = 0,
+
+	K_POLL_NUM_MODES
+};
+
+/* private - used by k_poll() to track the state of the polling thread */
+struct _poller {
+	volatile int is_polling;
+	struct k_thread *thread;
+};
+
+/**
+ * @brief Poll event descriptor
+ *
+ * Describes one kernel object to poll and the condition to wait for on it.
+ * Initialize with k_poll_event_init() or K_POLL_EVENT_INITIALIZER().
+ */
+struct k_poll_event {
+	/* private - set by k_poll() while the event is registered */
+	struct _poller *poller;
+
+	/* event type (K_POLL_TYPE_xxx) */
+	uint32_t type:4;
+
+	/* event state (K_POLL_STATE_xxx), set by the kernel */
+	uint32_t state:4;
+
+	/* polling mode (K_POLL_MODE_xxx) */
+	uint32_t mode:1;
+
+	/* unused bits in 32-bit word */
+	uint32_t unused:23;
+
+	/* object to poll */
+	union {
+		void *obj;
+		struct k_sem *sem;
+		struct k_fifo *fifo;
+		struct k_msgq *msgq;
+		struct k_pipe *pipe;
+	};
+};
+
+#define K_POLL_EVENT_INITIALIZER(event_type, event_mode, event_obj) \
+	{ \
+	.poller = NULL, \
+	.type = event_type, \
+	.state = K_POLL_STATE_NOT_READY, \
+	.mode = event_mode, \
+	.unused = 0, \
+	{ .obj = event_obj }, \
+	}
+
+/**
+ * @brief Initialize a poll event descriptor.
+ *
+ * @param event Event descriptor to initialize.
+ * @param type One of the K_POLL_TYPE_xxx types.
+ * @param mode Polling mode; only K_POLL_MODE_NOTIFY_ONLY is supported.
+ * @param obj Kernel object to poll; its type must match @a type.
+ *
+ * @return N/A
+ */
+extern void k_poll_event_init(struct k_poll_event *event, uint32_t type,
+			      int mode, void *obj);
+
+/**
+ * @brief Wait for one or more kernel objects to become available.
+ *
+ * The calling thread waits until at least one of the objects described by
+ * the @a events array is available, or until @a timeout expires. Upon
+ * return, the state field of each event is set to K_POLL_STATE_NOT_READY
+ * or to the condition that is fulfilled on its object.
+ *
+ * In K_POLL_MODE_NOTIFY_ONLY mode, the polling thread is only notified that
+ * an object is available: it must then obtain it with the regular API (e.g.
+ * k_sem_take() with K_NO_WAIT), and be prepared for the object to have been
+ * taken by another thread in the meantime.
+ *
+ * Only one thread can poll a given object at a time. Threads pending on an
+ * object with its regular API are served before a polling thread.
+ *
+ * @param events Array of event descriptors.
+ * @param num_events Number of descriptors in @a events.
+ * @param timeout Number of milliseconds to wait, or one of the special
+ *                values K_NO_WAIT and K_FOREVER.
+ *
+ * @retval 0 At least one object is available.
+ * @retval -EAGAIN No object became available before the timeout expired.
+ * @retval -EADDRINUSE An object is already polled by another thread; the
+ *                     state of its event is set to K_POLL_STATE_EADDRINUSE.
+ */
+extern int k_poll(struct k_poll_event *events, int num_events,
+		  int32_t timeout);
+
+#endif /* CONFIG_POLL */
+
 /**
  *  memory management
  */
@@ -1771,7 +2346,9 @@ extern void k_mem_pool_defrag(struct k_mem_pool *pool);
  * @brief Allocate memory from heap pool
  *
  * This routine provides traditional malloc semantics; internally it uses
- * the memory pool APIs on a dedicated HEAP pool
+ * the memory pool APIs on a dedicated HEAP pool. With
+ * CONFIG_HEAP_SLAB_CACHES, small requests are served from fixed-size block
+ * caches first.
  *
  * @param size Size of memory requested by the caller (in bytes)
  *
@@ -1788,6 +2365,40 @@ extern void *k_malloc(uint32_t size);
  */
 extern void k_free(void *ptr);
 
+#ifdef CONFIG_HEAP_SLAB_CACHES
+/**
+ * @brief Usage statistics of a k_malloc() slab cache.
+ */
+struct k_malloc_slab_stats {
+	/** size of the blocks of the cache */
+	int block_size;
+	/** number of blocks in the cache */
+	int num_blocks;
+	/** number of blocks currently allocated */
+	int num_used;
+	/** highest number of blocks allocated at the same time */
+	int max_used;
+	/** number of requests served by the cache */
+	uint32_t num_allocs;
+	/** number of requests passed on to the heap pool, the cache being empty */
+	uint32_t num_fallbacks;
+};
+
+/**
+ * @brief Get the usage statistics of a k_malloc() slab cache.
+ *
+ * The caches are numbered from 0, in increasing block size order.
+ *
+ * @param cache Index of the cache.
+ * @param stats Destination for the statistics.
+ *
+ * @retval 0 On success.
+ * @retval -EINVAL If there is no cache with this index.
+ */
+extern int k_malloc_slab_stats_get(int cache,
+				   struct k_malloc_slab_stats *stats);
+#endif /* CONFIG_HEAP_SLAB_CACHES */
+
 /*
  * legacy.h must be before arch/cpu.h to allow the ioapic/loapic drivers to
  * hook into the device subsystem, which itself uses nanokernel semaphores,
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2016 Wind River Systems, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file
+ * @brief Interrupt latency benchmark
+ *
+ * Tracks how long interrupts are kept locked, which irq_lock() call sites
+ * keep them locked the longest, and the entry latency of each interrupt
+ * line.
+ */
+
+#ifndef __INT_LATENCY_H__
+#define __INT_LATENCY_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef CONFIG_INT_LATENCY_BENCHMARK
+
+/**
+ * @brief Start tracking interrupt latency.
+ *
+ * Measures the overhead of the benchmark itself, then starts tracking.
+ *
+ * @return N/A
+ */
+extern void int_latency_init(void);
+
+/**
+ * @brief Print the interrupt latency metrics and start a new sampling
+ * interval.
+ *
+ * @return N/A
+ */
+extern void int_latency_show(void);
+
+/**
+ * @brief Shell command handler for the interrupt latency benchmark.
+ *
+ * Accepts "show" (the default), which calls int_latency_show(), and
+ * "reset", which discards the metrics gathered so far. Add
+ * INT_LATENCY_SHELL_CMD to the commands passed to shell_init().
+ *
+ * @param argc Number of parameters passed.
+ * @param argv Array of option strings.
+ *
+ * @return 0 on success, -EINVAL on an unknown sub-command.
+ */
+extern int int_latency_shell_cmd(int argc, char *argv[]);
+
+#define INT_LATENCY_SHELL_CMD \
+	{ "int_latency", int_latency_shell_cmd, "[show|reset]" }
+
+#endif /* CONFIG_INT_LATENCY_BENCHMARK */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __INT_LATENCY_H__ */
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2016 Wind River Systems, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file
+ * @brief Kernel binary tracing.
+ *
+ * The kernel records fixed-size binary trace records, stamped with the
+ * hardware cycle counter, into a ring buffer. The records are drained by
+ * the application, or by the trace dump thread which emits them on the
+ * console for scripts/trace_decode.py to turn into a timeline.
+ *
+ * When CONFIG_KERNEL_TRACING is disabled, all the trace points compile to
+ * nothing.
+ */
+
+#ifndef __KERNEL_TRACE_H__
+#define __KERNEL_TRACE_H__
+
+/**
+ * @brief Kernel Tracing
+ * @defgroup kernel_trace Kernel Tracing
+ * @{
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Trace event identifiers. These values are part of the record format
+ * understood by scripts/trace_decode.py: do not renumber them.
+ */
+#define K_TRACE_CONTEXT_SWITCH      0x01 /* data: incoming thread */
+#define K_TRACE_ISR_ENTER           0x02 /* data: interrupt key */
+#define K_TRACE_ISR_EXIT            0x03 /* data: 0 */
+#define K_TRACE_IDLE_ENTER          0x04 /* data: 0 */
+#define K_TRACE_SEM_GIVE            0x10 /* data: semaphore */
+#define K_TRACE_SEM_TAKE            0x11 /* data: semaphore */
+#define K_TRACE_SEM_TAKE_BLOCK      0x12 /* data: semaphore */
+#define K_TRACE_MUTEX_LOCK          0x20 /* data: mutex */
+#define K_TRACE_MUTEX_LOCK_BLOCK    0x21 /* data: mutex */
+#define K_TRACE_MUTEX_UNLOCK        0x22 /* data: mutex */
+#define K_TRACE_FIFO_PUT            0x30 /* data: fifo */
+#define K_TRACE_FIFO_GET            0x31 /* data: fifo */
+#define K_TRACE_FIFO_GET_BLOCK      0x32 /* data: fifo */
+#define K_TRACE_WORK_START          0x40 /* data: work item */
+#define K_TRACE_WORK_END            0x41 /* data: work item */
+#define K_TRACE_USER                0x80 /* first application event ID */
+
+#ifndef _ASMLANGUAGE
+
+#include <stdint.h>
+
+/**
+ * @brief Trace record.
+ *
+ * All records have the same size so that they can be written with a single
+ * index update and decoded without framing information.
+ */
+struct k_trace_record {
+	/** hardware cycle counter when the event occurred */
+	uint32_t timestamp;
+	/** event identifier (K_TRACE_xxx) */
+	uint16_t event_id;
+	/** non-zero if the event was recorded in interrupt context */
+	uint16_t in_isr;
+	/** thread running when the event occurred */
+	uint32_t thread;
+	/** event-specific data */
+	uint32_t data;
+};
+
+#ifdef CONFIG_KERNEL_TRACING
+
+extern void _sys_k_trace_event(uint16_t event_id, uint32_t data);
+
+#define _SYS_K_TRACE(event_id, data) \
+	_sys_k_trace_event(event_id, (uint32_t)(data))
+
+/**
+ * @brief Record an application-defined trace event.
+ *
+ * @param event_id Event identifier, K_TRACE_USER or above.
+ * @param data Event-specific data.
+ *
+ * @return N/A
+ */
+static inline void sys_k_trace_user_event(uint16_t event_id, uint32_t data)
+{
+	_sys_k_trace_event(event_id, data);
+}
+
+/**
+ * @brief Retrieve trace records.
+ *
+ * Copies the oldest trace records into @a records and removes them from the
+ * trace buffer.
+ *
+ * @param records Destination array.
+ * @param max_records Number of records @a records can hold.
+ *
+ * @return Number of records copied.
+ */
+extern int sys_k_trace_get(struct k_trace_record *records, int max_records);
+
+/**
+ * @brief Get the number of trace records dropped because the trace buffer
+ * was full.
+ *
+ * @return Number of dropped records since boot.
+ */
+extern uint32_t sys_k_trace_dropped_get(void);
+
+/**
+ * @brief Start or stop recording trace events.
+ *
+ * Recording starts at boot.
+ *
+ * @param enable Non-zero to record events, zero to discard them.
+ *
+ * @return N/A
+ */
+extern void sys_k_trace_enable(int enable);
+
+#else
+
+#define _SYS_K_TRACE(event_id, data) do { } while ((0))
+
+#endif /* CONFIG_KERNEL_TRACING */
+
+#endif /* _ASMLANGUAGE */
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* __KERNEL_TRACE_H__ */
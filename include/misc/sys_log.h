@@ -45,6 +45,67 @@ extern "C" {
  * @defgroup system_log System Log
  * @{
  */
+
+#if defined(CONFIG_SYS_LOG_DEFERRED)
+#include <stddef.h>
+#include <stdint.h>
+#include <toolchain.h>
+#include <atomic.h>
+
+/** Maximum number of arguments of a deferred log message */
+#define SYS_LOG_DEFERRED_MAX_ARGS 8
+
+/**
+ * @brief Log domain of a compile unit
+ *
+ * Each compile unit logging with deferred logging enabled has its own,
+ * registered when it logs its first message.
+ */
+struct sys_log_domain {
+	const char *name;
+	int level;
+	int newline;
+	atomic_t registered;
+	struct sys_log_domain *next;
+};
+
+extern void _sys_log_put(struct sys_log_domain *domain, int level,
+			 const char *func, int nargs, const char *fmt, ...);
+
+/**
+ * @brief Set the runtime log level of a domain
+ *
+ * Messages above the level are dropped when they are logged. The level
+ * cannot be raised above the compile time level of the domain, since the
+ * logging calls of higher levels are compiled out.
+ *
+ * @param name Domain name, as given by SYS_LOG_DOMAIN.
+ * @param level New log level, SYS_LOG_LEVEL_OFF to silence the domain.
+ *
+ * @return 0 on success, -ENOENT if the domain has not logged anything yet.
+ */
+extern int sys_log_level_set(const char *name, int level);
+
+/**
+ * @brief Format and output one deferred log message
+ *
+ * Called by the logging thread. Applications that do not use the logging
+ * thread call it from a low priority context, e.g. their background task.
+ *
+ * @return 1 if a message was output, 0 if there was none ready.
+ */
+extern int sys_log_process(void);
+
+/**
+ * @brief Get the number of log messages dropped so far
+ *
+ * Messages are dropped when logged while the log buffer is full.
+ *
+ * @return Number of messages dropped.
+ */
+extern uint32_t sys_log_dropped_get(void);
+#endif /* CONFIG_SYS_LOG_DEFERRED */
+
 #if defined(CONFIG_SYS_LOG) && (SYS_LOG_LEVEL > SYS_LOG_LEVEL_OFF)
 
 #define IS_SYS_LOG_ACTIVE 1
@@ -102,6 +163,68 @@ extern "C" {
 #define SYS_LOG_NL ""
 #endif
 
+#if defined(CONFIG_SYS_LOG_DEFERRED)
+
+static struct sys_log_domain _sys_log_domain __unused = {
+	.name = SYS_LOG_DOMAIN,
+	.level = SYS_LOG_LEVEL,
+	.newline = (SYS_LOG_NL[0] != '\0'),
+	.registered = ATOMIC_INIT(0),
+	.next = NULL,
+};
+
+/*
+ * Number of arguments after the format. It is counted up to 16, so that
+ * more than SYS_LOG_DEFERRED_MAX_ARGS can be rejected at build time.
+ */
+#define _SYS_LOG_NARGS(...)						\
+	_SYS_LOG_NARGS_(__VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9,	\
+			8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define _SYS_LOG_NARGS_(fmt, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10,	\
+			_11, _12, _13, _14, _15, _16, N, ...) N
+
+/*
+ * Fails to build unless the count is a constant of at most
+ * SYS_LOG_DEFERRED_MAX_ARGS: past 16 arguments, the count is one of them.
+ */
+#define _SYS_LOG_NARGS_CHECK(nargs)					\
+	((void)sizeof(struct {						\
+		unsigned int too_many_log_args :			\
+			((nargs) <= SYS_LOG_DEFERRED_MAX_ARGS) ? 1 : -1; \
+	}))
+
+/*
+ * Only the format string pointer and the arguments are stored; the message
+ * is formatted later by the logging thread. String arguments must therefore
+ * still be valid then, e.g. string literals. Each argument is stored as 32
+ * bits, so 64-bit arguments such as long long or double are garbled.
+ */
+#define LOG_DEFERRED(log_lv, ...)					\
+	do {								\
+		_SYS_LOG_NARGS_CHECK(_SYS_LOG_NARGS(__VA_ARGS__));	\
+		if ((log_lv) <= _sys_log_domain.level) {		\
+			_sys_log_put(&_sys_log_domain, log_lv, __func__, \
+				     _SYS_LOG_NARGS(__VA_ARGS__),	\
+				     __VA_ARGS__);			\
+		}							\
+	} while (0)
+
+#define SYS_LOG_ERR(...) LOG_DEFERRED(SYS_LOG_LEVEL_ERROR, __VA_ARGS__)
+
+#if (SYS_LOG_LEVEL >= SYS_LOG_LEVEL_WARNING)
+#define SYS_LOG_WRN(...) LOG_DEFERRED(SYS_LOG_LEVEL_WARNING, __VA_ARGS__)
+#endif
+
+#if (SYS_LOG_LEVEL >= SYS_LOG_LEVEL_INFO)
+#define SYS_LOG_INF(...) LOG_DEFERRED(SYS_LOG_LEVEL_INFO, __VA_ARGS__)
+#endif
+
+#if (SYS_LOG_LEVEL == SYS_LOG_LEVEL_DEBUG)
+#define SYS_LOG_DBG(...) LOG_DEFERRED(SYS_LOG_LEVEL_DEBUG, __VA_ARGS__)
+#endif
+
+#else
+
 /* [domain] [level] function: */
 #define LOG_LAYOUT "[%s]%s %s: %s"
 #define LOG_BACKEND_CALL(log_lv, log_color, log_format, color_off, ...)	\
@@ -130,6 +253,8 @@ extern "C" {
 #define SYS_LOG_DBG(...) LOG_NO_COLOR(SYS_LOG_TAG_DBG, ##__VA_ARGS__)
 #endif
 
+#endif /* CONFIG_SYS_LOG_DEFERRED */
+
 #else
 /**
  * @def IS_SYS_LOG_ACTIVE
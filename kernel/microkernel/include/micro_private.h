@@ -83,6 +83,7 @@ extern void _k_timeout_cancel(struct k_args *A);
 extern void _k_timer_list_update(int ticks);
 
 extern void _k_do_event_signal(kevent_t event);
+extern void _k_do_event_signal_repeat(kevent_t event, int count);
 
 extern void _k_state_bit_set(struct k_task *, uint32_t);
 extern void _k_state_bit_reset(struct k_task *, uint32_t);
@@ -186,6 +186,35 @@ void _k_do_event_signal(kevent_t event)
 #endif
 }
 
+/**
+ *
+ * @brief Signal an event several times in a row
+ *
+ * Once the event is pending and has neither a handler nor a waiting task,
+ * further signals would only mark it pending again, so they are skipped.
+ *
+ * @param event Event to signal.
+ * @param count Number of times the event has been signaled.
+ *
+ * @return N/A
+ */
+void _k_do_event_signal_repeat(kevent_t event, int count)
+{
+	struct _k_event_struct *E = (struct _k_event_struct *)event;
+
+	while (count-- > 0) {
+		_k_do_event_signal(event);
+
+		if ((E->func == NULL) && (E->waiter == NULL) &&
+		    (E->status != 0)) {
+#ifdef CONFIG_OBJECT_MONITOR
+			E->count += count;
+#endif
+			break;
+		}
+	}
+}
+
 /**
  *
  * @brief Perform signal an event request
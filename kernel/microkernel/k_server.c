@@ -72,66 +72,151 @@ static struct k_task *next_task_select(void)
 
 /**
  *
- * @brief The microkernel thread entry point
+ * @brief Take a batch of commands off the command stack
  *
- * This function implements the microkernel fiber.  It waits for command
- * packets to arrive on its command stack. It executes all commands on the
- * stack and then sets up the next task that is ready to run. Next it
- * goes to wait on further inputs on the command stack.
+ * Pops up to @a max commands with interrupts locked only once. The commands
+ * are stored in the order they are popped, i.e. the most recently pushed
+ * command first, as if they were popped one at a time.
  *
- * @return Does not return.
+ * @param batch Where to store the commands.
+ * @param max Maximum number of commands to pop.
+ *
+ * @return number of commands popped
  */
-FUNC_NORETURN void _k_server(int unused1, int unused2)
+static int commands_get(struct k_args **batch, int max)
 {
-	struct k_args *pArgs;
-	struct k_task *pNextTask;
+	struct nano_stack *stack = &_k_command_stack;
+	unsigned int imask;
+	int n = 0;
 
-	ARG_UNUSED(unused1);
-	ARG_UNUSED(unused2);
+	imask = irq_lock();
 
-	/* indicate that failure of this fiber may be fatal to the entire system
-	 */
+	while ((n < max) && (stack->next > stack->base)) {
+		stack->next--;
+		batch[n++] = (struct k_args *)*(stack->next);
+	}
 
-	_thread_essential_set();
+	irq_unlock(imask);
 
-	while (1) { /* forever */
-		(void) nano_fiber_stack_pop(&_k_command_stack, (uint32_t *)&pArgs,
-				TICKS_UNLIMITED); /* will schedule */
-		do {
-			int cmd_type = (int)pArgs & KERNEL_CMD_TYPE_MASK;
+	return n;
+}
+
+/**
+ *
+ * @brief Count the copies of a command at the start of a batch
+ *
+ * Event signals and semaphore gives are encoded in the command word itself,
+ * so identical words target the same object and can be processed together.
+ *
+ * @return number of consecutive commands identical to the first one
+ */
+static int command_repeats(struct k_args **batch, int n)
+{
+	int count = 1;
+
+	while ((count < n) && (batch[count] == batch[0])) {
+		count++;
+	}
+
+	return count;
+}
 
-			if (cmd_type == KERNEL_CMD_PACKET_TYPE) {
+/**
+ *
+ * @brief Execute the commands at the start of a batch
+ *
+ * Runs of semaphore gives to the same semaphore are folded into a single
+ * semaphore update, and runs of signals to the same event are cut short once
+ * further signals can no longer make a difference.
+ *
+ * @return number of commands executed
+ */
+static int commands_execute(struct k_args **batch, int n)
+{
+	struct k_args *pArgs = batch[0];
+	int cmd_type = (int)pArgs & KERNEL_CMD_TYPE_MASK;
+	int count = 1;
 
-				/* process command packet */
+	if (cmd_type == KERNEL_CMD_PACKET_TYPE) {
+
+		/* process command packet */
 
 #ifdef CONFIG_TASK_MONITOR
-				if (_k_monitor_mask & MON_KSERV) {
-					_k_task_monitor_args(pArgs);
-				}
+		if (_k_monitor_mask & MON_KSERV) {
+			_k_task_monitor_args(pArgs);
+		}
 #endif
-				(*pArgs->Comm)(pArgs);
-			} else if (cmd_type == KERNEL_CMD_EVENT_TYPE) {
+		(*pArgs->Comm)(pArgs);
+	} else if (cmd_type == KERNEL_CMD_EVENT_TYPE) {
 
-				/* give event */
+		/* give event */
+
+		kevent_t event = (int)pArgs & ~KERNEL_CMD_TYPE_MASK;
+
+		count = command_repeats(batch, n);
 
 #ifdef CONFIG_TASK_MONITOR
-				if (_k_monitor_mask & MON_EVENT) {
-					_k_task_monitor_args(pArgs);
-				}
-#endif
-				kevent_t event = (int)pArgs & ~KERNEL_CMD_TYPE_MASK;
+		if (_k_monitor_mask & MON_EVENT) {
+			int i;
 
-				_k_do_event_signal(event);
-			} else { /* cmd_type == KERNEL_CMD_SEMAPHORE_TYPE */
+			for (i = 0; i < count; i++) {
+				_k_task_monitor_args(pArgs);
+			}
+		}
+#endif
+		_k_do_event_signal_repeat(event, count);
+	} else { /* cmd_type == KERNEL_CMD_SEMAPHORE_TYPE */
 
-				/* give semaphore */
+		/* give semaphore */
 
 #ifdef CONFIG_TASK_MONITOR
-				/* task monitoring for giving semaphore not implemented */
+		/* task monitoring for giving semaphore not implemented */
 #endif
-				ksem_t sem = (int)pArgs & ~KERNEL_CMD_TYPE_MASK;
+		ksem_t sem = (int)pArgs & ~KERNEL_CMD_TYPE_MASK;
+
+		count = command_repeats(batch, n);
+
+		_k_sem_struct_value_update(count, (struct _k_sem_struct *)sem);
+	}
 
-				_k_sem_struct_value_update(1, (struct _k_sem_struct *)sem);
+	return count;
+}
+
+/**
+ *
+ * @brief The microkernel thread entry point
+ *
+ * This function implements the microkernel fiber.  It waits for command
+ * packets to arrive on its command stack. It executes all commands on the
+ * stack, a batch at a time, and then sets up the next task that is ready to
+ * run. Next it goes to wait on further inputs on the command stack.
+ *
+ * @return Does not return.
+ */
+FUNC_NORETURN void _k_server(int unused1, int unused2)
+{
+	struct k_args *batch[CONFIG_COMMAND_BATCH_SIZE];
+	struct k_task *pNextTask;
+	int n;
+	int i;
+
+	ARG_UNUSED(unused1);
+	ARG_UNUSED(unused2);
+
+	/* indicate that failure of this fiber may be fatal to the entire system
+	 */
+
+	_thread_essential_set();
+
+	while (1) { /* forever */
+		(void) nano_fiber_stack_pop(&_k_command_stack,
+				(uint32_t *)batch,
+				TICKS_UNLIMITED); /* will schedule */
+		n = 1 + commands_get(&batch[1],
+					 CONFIG_COMMAND_BATCH_SIZE - 1);
+		do {
+			for (i = 0; i < n; ) {
+				i += commands_execute(&batch[i], n - i);
 			}
 
 			/*
@@ -142,8 +227,8 @@ FUNC_NORETURN void _k_server(int unused1, int unused2)
 			if (_nanokernel.fiber) {
 				fiber_yield();
 			}
-		} while (nano_fiber_stack_pop(&_k_command_stack, (uint32_t *)&pArgs,
-					TICKS_NONE));
+		} while ((n = commands_get(batch,
+					     CONFIG_COMMAND_BATCH_SIZE)) != 0);
 
 		pNextTask = next_task_select();
 
@@ -29,11 +29,151 @@
 #include <wait_q.h>
 #include <ksched.h>
 #include <misc/slist.h>
+#include <misc/kernel_trace.h>
+
+/*
+ * Producers push their items onto fifo->incoming, a stack updated with
+ * compare-and-swap, without locking interrupts or looking at the wait
+ * queue. The consumer moves the stacked items, in reverse order, to the end
+ * of data_q before looking at it.
+ *
+ * Before a thread pends on the fifo or a poller waits for it, FIFO_WAITERS
+ * is set in fifo->incoming, which is then empty. The producers then take the
+ * locked path, which hands the items directly to the waiters, until none is
+ * left.
+ */
+#define FIFO_WAITERS 0x1
+
+/**
+ * @brief Push a list of items onto the incoming stack
+ *
+ * @return true if pushed; false if the locked path must be taken
+ */
+static bool fifo_try_push(struct k_fifo *fifo, void *head, void *tail)
+{
+	atomic_val_t top;
+
+	do {
+		top = atomic_get(&fifo->incoming);
+		if (top & FIFO_WAITERS) {
+			return false;
+		}
+		*(void **)tail = (void *)top;
+	} while (!atomic_cas(&fifo->incoming, top, (atomic_val_t)head));
+
+	return true;
+}
+
+/**
+ * @brief Reverse a list of items
+ *
+ * @return The new head of the list, i.e. its former tail
+ */
+static void *list_reverse(void *head, void *tail)
+{
+	void *prev = NULL, *next;
+
+	while (head != tail) {
+		next = *(void **)head;
+		*(void **)head = prev;
+		prev = head;
+		head = next;
+	}
+	*(void **)tail = prev;
+
+	return tail;
+}
+
+/**
+ * @brief Move the items pushed by producers to data_q
+ *
+ * Must be called with interrupts locked.
+ */
+static void fifo_drain(struct k_fifo *fifo)
+{
+	atomic_val_t top = atomic_get(&fifo->incoming);
+	void *head, *tail;
+
+	if (top == 0 || (top & FIFO_WAITERS)) {
+		return;
+	}
+
+	tail = (void *)atomic_clear(&fifo->incoming);
+	for (head = tail; *(void **)head; head = *(void **)head) {
+		;
+	}
+
+	/* the stack holds the newest item on top */
+	sys_slist_append_list(&fifo->data_q, list_reverse(tail, head), tail);
+}
+
+/**
+ * @brief Make producers take the locked path, the fifo being empty
+ *
+ * Must be called with interrupts locked.
+ *
+ * @return true if done; false if items were pushed in the meantime
+ */
+static bool fifo_set_waiters(struct k_fifo *fifo)
+{
+	atomic_val_t top;
+
+	do {
+		top = atomic_get(&fifo->incoming);
+		if (top & FIFO_WAITERS) {
+			return true;
+		}
+		if (top != 0) {
+			return false;
+		}
+	} while (!atomic_cas(&fifo->incoming, 0, FIFO_WAITERS));
+
+	return true;
+}
+
+/**
+ * @brief Let producers push again once nobody waits for the fifo
+ *
+ * Must be called with interrupts locked.
+ */
+static void fifo_update_waiters(struct k_fifo *fifo)
+{
+	if (sys_dlist_is_empty(&fifo->wait_q)
+#ifdef CONFIG_POLL
+	    && !fifo->poll_event
+#endif
+	    ) {
+		atomic_clear(&fifo->incoming);
+	}
+}
+
+#ifdef CONFIG_POLL
+int _k_fifo_poll_ready(struct k_fifo *fifo)
+{
+	fifo_drain(fifo);
+
+	if (!sys_slist_is_empty(&fifo->data_q)) {
+		return 1;
+	}
+
+	/* the poller is about to register, unless we raced a producer */
+	if (!fifo_set_waiters(fifo)) {
+		fifo_drain(fifo);
+		return 1;
+	}
+
+	return 0;
+}
+#endif
 
 void k_fifo_init(struct k_fifo *fifo)
 {
+	atomic_set(&fifo->incoming, 0);
 	sys_slist_init(&fifo->data_q);
 	sys_dlist_init(&fifo->wait_q);
+#ifdef CONFIG_POLL
+	fifo->poll_event = NULL;
+#endif
 
 	SYS_TRACING_OBJ_INIT(k_fifo, fifo);
 }
@@ -50,18 +190,38 @@ void k_fifo_put(struct k_fifo *fifo, void *data)
 	struct k_thread *first_pending_thread;
 	unsigned int key;
 
+	_SYS_K_TRACE(K_TRACE_FIFO_PUT, fifo);
+
+	if (likely(fifo_try_push(fifo, data, data))) {
+		return;
+	}
+
 	key = irq_lock();
 
 	first_pending_thread = _unpend_first_thread(&fifo->wait_q);
 
 	if (first_pending_thread) {
 		prepare_thread_to_run(first_pending_thread, data);
+		fifo_update_waiters(fifo);
 		if (!_is_in_isr() && _must_switch_threads()) {
 			(void)_Swap(key);
 			return;
 		}
 	} else {
+		/* the incoming stack is empty while FIFO_WAITERS is set */
 		sys_slist_append(&fifo->data_q, data);
+#ifdef CONFIG_POLL
+		int must_swap = _handle_obj_poll_event(&fifo->poll_event,
+					K_POLL_STATE_FIFO_DATA_AVAILABLE);
+
+		fifo_update_waiters(fifo);
+		if (must_swap) {
+			(void)_Swap(key);
+			return;
+		}
+#else
+		fifo_update_waiters(fifo);
+#endif
 	}
 
 	irq_unlock(key);
@@ -74,6 +234,17 @@ void k_fifo_put_list(struct k_fifo *fifo, void *head, void *tail)
 	struct k_thread *first_thread, *thread;
 	unsigned int key;
 
+	_SYS_K_TRACE(K_TRACE_FIFO_PUT, fifo);
+
+	if (!(atomic_get(&fifo->incoming) & FIFO_WAITERS)) {
+		void *reversed = list_reverse(head, tail);
+
+		if (likely(fifo_try_push(fifo, reversed, head))) {
+			return;
+		}
+		list_reverse(reversed, head);
+	}
+
 	key = irq_lock();
 
 	first_thread = _peek_first_pending_thread(&fifo->wait_q);
@@ -84,8 +255,18 @@ void k_fifo_put_list(struct k_fifo *fifo, void *head, void *tail)
 
 	if (head) {
 		sys_slist_append_list(&fifo->data_q, head, tail);
+#ifdef CONFIG_POLL
+		if (_handle_obj_poll_event(&fifo->poll_event,
+					   K_POLL_STATE_FIFO_DATA_AVAILABLE)) {
+			fifo_update_waiters(fifo);
+			(void)_Swap(key);
+			return;
+		}
+#endif
 	}
 
+	fifo_update_waiters(fifo);
+
 	if (first_thread) {
 		if (!_is_in_isr() && _must_switch_threads()) {
 			(void)_Swap(key);
@@ -116,10 +297,10 @@ void *k_fifo_get(struct k_fifo *fifo, int32_t timeout)
 
 	key = irq_lock();
 
+	fifo_drain(fifo);
+
 	if (likely(!sys_slist_is_empty(&fifo->data_q))) {
-		data = sys_slist_get_not_empty(&fifo->data_q);
-		irq_unlock(key);
-		return data;
+		goto got_data;
 	}
 
 	if (timeout == K_NO_WAIT) {
@@ -127,7 +308,20 @@ void *k_fifo_get(struct k_fifo *fifo, int32_t timeout)
 		return NULL;
 	}
 
+	if (!fifo_set_waiters(fifo)) {
+		fifo_drain(fifo);
+		goto got_data;
+	}
+
+	_SYS_K_TRACE(K_TRACE_FIFO_GET_BLOCK, fifo);
+
 	_pend_current_thread(&fifo->wait_q, timeout);
 
 	return _Swap(key) ? NULL : _current->swap_data;
+
+got_data:
+	data = sys_slist_get_not_empty(&fifo->data_q);
+	irq_unlock(key);
+	_SYS_K_TRACE(K_TRACE_FIFO_GET, fifo);
+	return data;
 }
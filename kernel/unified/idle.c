@@ -20,6 +20,7 @@
 #include <sections.h>
 #include <drivers/system_timer.h>
 #include <wait_q.h>
+#include <misc/kernel_trace.h>
 
 #if defined(CONFIG_TICKLESS_IDLE)
 /*
@@ -132,6 +133,7 @@ void idle(void *unused1, void *unused2, void *unused3)
 	ARG_UNUSED(unused3);
 
 	for (;;) {
+		_SYS_K_TRACE(K_TRACE_IDLE_ENTER, 0);
 		_sys_power_save_idle(_get_next_timeout_expiry());
 
 		k_yield();
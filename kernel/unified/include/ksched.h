@@ -37,6 +37,36 @@ extern struct k_thread *_get_next_ready_thread(void);
 extern int __must_switch_threads(void);
 extern int32_t _ms_to_ticks(int32_t ms);
 
+/*
+ * Number of messages a consumer may take from a message queue, i.e. those
+ * ahead of a claimed message. Must be called with interrupts locked.
+ */
+static inline uint32_t _msgq_readable(struct k_msgq *q)
+{
+	int offset;
+
+	if (!q->claim_ptr) {
+		return q->used_msgs;
+	}
+
+	offset = q->claim_ptr - q->read_ptr;
+	if (offset < 0) {
+		offset += q->buffer_end - q->buffer_start;
+	}
+
+	return offset / q->msg_size;
+}
+
+#ifdef CONFIG_POLL
+extern int _handle_obj_poll_event(struct k_poll_event **obj_poll_event,
+				  uint32_t state);
+extern int _k_fifo_poll_ready(struct k_fifo *fifo);
+#endif
+
+#ifdef CONFIG_THREAD_STATS
+extern uint32_t _thread_stats_current_cycles(void);
+#endif
+
 /*
  * The _is_prio_higher family: I created this because higher priorities are
  * lower numerically and I always found somewhat confusing seeing, e.g.:
@@ -71,6 +101,26 @@ static inline int _is_higher_prio_than_current(struct k_thread *thread)
 	return _is_t1_higher_prio_than_t2(thread, _nanokernel.current);
 }
 
+#ifdef CONFIG_SCHED_DEADLINE
+/*
+ * Is t1's deadline earlier than t2's ? Threads without a deadline come after
+ * the ones with one. Deadlines wrap around with the cycle counter.
+ */
+static inline int _is_t1_deadline_earlier_than_t2(struct k_thread *t1,
+						   struct k_thread *t2)
+{
+	if (!t1->deadline.active) {
+		return 0;
+	}
+
+	if (!t2->deadline.active) {
+		return 1;
+	}
+
+	return (int32_t)(t1->deadline.abs - t2->deadline.abs) < 0;
+}
+#endif
+
 /* is thread currenlty cooperative ? */
 static inline int _is_coop(struct k_thread *thread)
 {
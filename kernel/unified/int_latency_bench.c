@@ -20,12 +20,40 @@
 #include "sections.h"
 #include <stdint.h>	    /* uint32_t */
 #include <limits.h>	    /* ULONG_MAX */
+#include <string.h>	    /* memset, strcmp */
 #include <misc/printk.h> /* printk */
 #include <sys_clock.h>
 #include <drivers/system_timer.h>
+#include <arch/cpu.h>
+#include <errno.h>
+#include <misc/int_latency.h>
+#include <kernel_event_logger_arch.h>
 
 #define NB_CACHE_WARMING_DRY_RUN 7
 
+/*
+ * Latencies are accumulated in log2 histograms: bucket N counts the
+ * latencies in [2^(N-1), 2^N) cycles, the last bucket everything above.
+ */
+#define HIST_BUCKETS 24
+
+/* interrupt nesting levels whose entry latency is measured */
+#define ISR_NEST_MAX 8
+
+struct int_latency_offender {
+	/* longest time interrupts were locked from this call site */
+	uint32_t latency;
+	/* return address of the irq_lock() that started the locked section */
+	void *caller;
+};
+
+struct int_latency_irq {
+	int key;
+	uint32_t count;
+	uint32_t max;
+	uint32_t hist[HIST_BUCKETS];
+};
+
 /*
  * Timestamp corresponding to when interrupt were turned off.
  * A value of zero indicated interrupt are not currently locked.
@@ -50,6 +78,90 @@ static uint32_t int_latency_bench_ready;
 /* min amount of time it takes from HW interrupt generation to 'C' handler */
 uint32_t _hw_irq_to_c_handler_latency = ULONG_MAX;
 
+/* distribution of the time spent with interrupts locked */
+static uint32_t int_locked_hist[HIST_BUCKETS];
+
+/* call site of the irq_lock() that started the current locked section */
+static void *int_locked_caller;
+
+/* call sites that kept interrupts locked the longest */
+static struct int_latency_offender
+	offenders[CONFIG_INT_LATENCY_WORST_OFFENDERS];
+static uint32_t offenders_min;
+
+/* per interrupt line entry latency, from the interrupt stub to the ISR */
+static struct int_latency_irq irq_lines[CONFIG_INT_LATENCY_IRQ_LINES];
+
+/*
+ * Entry timestamps of the interrupts between the interrupt stub and their
+ * ISR, one per nesting level: on ARM the stub runs with interrupts
+ * unlocked, so a higher priority interrupt can preempt it.
+ */
+static volatile uint32_t isr_entry_timestamp[ISR_NEST_MAX];
+static volatile uint32_t isr_entry_depth;
+
+static inline int hist_bucket(uint32_t delta)
+{
+	int bucket = find_msb_set(delta);
+
+	return bucket < HIST_BUCKETS ? bucket : HIST_BUCKETS - 1;
+}
+
+static void offender_record(uint32_t delta, void *caller)
+{
+	int i;
+	int min = 0;
+
+	/* only call sites already tracked can beat the smallest entry */
+	if (delta <= offenders_min) {
+		return;
+	}
+
+	for (i = 0; i < CONFIG_INT_LATENCY_WORST_OFFENDERS; i++) {
+		if (offenders[i].caller == caller) {
+			if (delta > offenders[i].latency) {
+				offenders[i].latency = delta;
+			}
+			min = -1;
+			break;
+		}
+		if (offenders[i].latency < offenders[min].latency) {
+			min = i;
+		}
+	}
+
+	if (min >= 0) {
+		offenders[min].latency = delta;
+		offenders[min].caller = caller;
+	}
+
+	offenders_min = offenders[0].latency;
+	for (i = 1; i < CONFIG_INT_LATENCY_WORST_OFFENDERS; i++) {
+		if (offenders[i].latency < offenders_min) {
+			offenders_min = offenders[i].latency;
+		}
+	}
+}
+
+static void stats_reset(void)
+{
+	int i;
+
+	int_locked_latency_min = ULONG_MAX;
+	int_locked_latency_max = 0;
+
+	memset(int_locked_hist, 0, sizeof(int_locked_hist));
+	memset(offenders, 0, sizeof(offenders));
+	offenders_min = 0;
+
+	for (i = 0; i < CONFIG_INT_LATENCY_IRQ_LINES; i++) {
+		irq_lines[i].key = -1;
+		irq_lines[i].count = 0;
+		irq_lines[i].max = 0;
+		memset(irq_lines[i].hist, 0, sizeof(irq_lines[i].hist));
+	}
+}
+
 /**
  *
  * @brief Start tracking time spent with interrupts locked
@@ -65,6 +177,7 @@ void _int_latency_start(void)
 	/* when interrupts are not already locked, take time stamp */
 	if (!int_locked_timestamp && int_latency_bench_ready) {
 		int_locked_timestamp = sys_cycle_get_32();
+		int_locked_caller = __builtin_return_address(0);
 		int_lock_unlock_nest = 0;
 	}
 	int_lock_unlock_nest++;
@@ -116,12 +229,108 @@ void _int_latency_stop(void)
 		if (delta < int_locked_latency_min)
 			int_locked_latency_min = delta;
 
+		int_locked_hist[hist_bucket(delta)]++;
+		offender_record(delta, int_locked_caller);
+
 		/* interrupts are now enabled, get ready for next interrupt lock
 		 */
 		int_locked_timestamp = 0;
 	}
 }
 
+/**
+ *
+ * @brief Mark the entry in the interrupt stub
+ *
+ * Called by the architecture interrupt stub as early as possible. On x86
+ * interrupts are still locked, on ARM they are not, so the stub can be
+ * preempted by a nested interrupt until _int_latency_isr_handler() is
+ * called.
+ *
+ * @return N/A
+ *
+ */
+void _int_latency_isr_enter(void)
+{
+	uint32_t now = sys_cycle_get_32();
+	uint32_t depth = isr_entry_depth;
+
+	/*
+	 * Take the level before filling it: a nested interrupt then uses the
+	 * next one, and gives it back before this one resumes.
+	 */
+	isr_entry_depth = depth + 1;
+
+	if (depth < ISR_NEST_MAX) {
+		isr_entry_timestamp[depth] = now;
+	}
+}
+
+/**
+ *
+ * @brief Account for the entry latency of the current interrupt
+ *
+ * Called by the architecture interrupt stub right before the ISR is
+ * invoked.
+ *
+ * @return N/A
+ *
+ */
+void _int_latency_isr_handler(void)
+{
+	uint32_t now = sys_cycle_get_32();
+	uint32_t depth = isr_entry_depth;
+	uint32_t delta;
+	int key;
+	struct int_latency_irq *line = NULL;
+	int i;
+
+	if (!depth) {
+		/* not entered through _int_latency_isr_enter() */
+		return;
+	}
+
+	depth--;
+	if (depth >= ISR_NEST_MAX) {
+		/* nested too deep to be measured */
+		isr_entry_depth = depth;
+		return;
+	}
+
+	/* read the level before giving it back */
+	delta = now - isr_entry_timestamp[depth];
+	isr_entry_depth = depth;
+
+	if (!int_latency_bench_ready) {
+		return;
+	}
+
+	key = _sys_current_irq_key_get();
+
+	for (i = 0; i < CONFIG_INT_LATENCY_IRQ_LINES; i++) {
+		if (irq_lines[i].key == key) {
+			line = &irq_lines[i];
+			break;
+		}
+		if (irq_lines[i].key == -1) {
+			line = &irq_lines[i];
+			line->key = key;
+			break;
+		}
+	}
+
+	if (!line) {
+		/* table full: the line is not tracked */
+		return;
+	}
+
+	line->count++;
+	if (delta > line->max) {
+		line->max = delta;
+	}
+	line->hist[hist_bucket(delta)]++;
+}
+
 /**
  *
  * @brief Initialize interrupt latency benchmark
@@ -134,6 +343,8 @@ void int_latency_init(void)
 	uint32_t timeToReadTime;
 	uint32_t cacheWarming = NB_CACHE_WARMING_DRY_RUN;
 
+	stats_reset();
+
 	int_latency_bench_ready = 1;
 
 	/*
@@ -166,13 +377,92 @@ void int_latency_init(void)
 		stop_delay = sys_cycle_get_32() - stop_delay - timeToReadTime;
 
 		/* re-initialize globals to default values */
-		int_locked_latency_min = ULONG_MAX;
-		int_locked_latency_max = 0;
+		stats_reset();
 
 		cacheWarming--;
 	}
 }
 
+static void show_hist(const uint32_t *hist)
+{
+	int i;
+
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		if (!hist[i]) {
+			continue;
+		}
+
+		if (i == 0) {
+			printk("    0 tcs: %u\n", hist[i]);
+		} else if (i == HIST_BUCKETS - 1) {
+			printk("    %u+ tcs: %u\n", 1 << (i - 1), hist[i]);
+		} else {
+			printk("    %u-%u tcs: %u\n", 1 << (i - 1),
+			       (1 << i) - 1, hist[i]);
+		}
+	}
+}
+
+static void show_locked_hist(void)
+{
+	printk(" Interrupt locked time distribution:\n");
+	show_hist(int_locked_hist);
+}
+
+static void show_offenders(void)
+{
+	struct int_latency_offender sorted[CONFIG_INT_LATENCY_WORST_OFFENDERS];
+	struct int_latency_offender tmp;
+	int i, j;
+
+	memcpy(sorted, offenders, sizeof(sorted));
+
+	/* insertion sort, longest first */
+	for (i = 1; i < CONFIG_INT_LATENCY_WORST_OFFENDERS; i++) {
+		tmp = sorted[i];
+		for (j = i; j > 0 && sorted[j - 1].latency < tmp.latency; j--) {
+			sorted[j] = sorted[j - 1];
+		}
+		sorted[j] = tmp;
+	}
+
+	printk(" Longest interrupt locked sections (irq_lock() call site):\n");
+	for (i = 0; i < CONFIG_INT_LATENCY_WORST_OFFENDERS; i++) {
+		if (!sorted[i].caller) {
+			break;
+		}
+		printk("    0x%x: %d tcs = %d nsec\n",
+		       (uint32_t)sorted[i].caller, sorted[i].latency,
+		       SYS_CLOCK_HW_CYCLES_TO_NS(sorted[i].latency));
+	}
+}
+
+static void show_irq_lines(void)
+{
+	int i;
+
+	for (i = 0; i < CONFIG_INT_LATENCY_IRQ_LINES; i++) {
+		struct int_latency_irq *line = &irq_lines[i];
+
+		if (line->key == -1) {
+			break;
+		}
+
+		/*
+		 * The worst case latency of a line adds the longest time the
+		 * interrupt could have been held off by a locked section.
+		 */
+		printk(" IRQ key %d: %u interrupts, max entry latency: "
+		       "%d tcs = %d nsec, worst case: %d tcs = %d nsec\n",
+		       line->key, line->count, line->max,
+		       SYS_CLOCK_HW_CYCLES_TO_NS(line->max),
+		       line->max + int_locked_latency_max,
+		       SYS_CLOCK_HW_CYCLES_TO_NS(line->max +
+						 int_locked_latency_max));
+		show_hist(line->hist);
+	}
+}
+
 /**
  *
  * @brief Dumps interrupt latency values
@@ -222,14 +512,32 @@ void int_latency_show(void)
 		       SYS_CLOCK_HW_CYCLES_TO_NS(nesting_delay),
 		       stop_delay,
 		       SYS_CLOCK_HW_CYCLES_TO_NS(stop_delay));
+
+		show_locked_hist();
+		show_offenders();
 	} else {
 		printk("interrupts were not locked and unlocked yet\n");
 	}
+
+	show_irq_lines();
+
 	/*
 	 * Lets start with new values so that one extra long path executed
 	 * with interrupt disabled hide smaller paths with interrupt
 	 * disabled.
 	 */
-	int_locked_latency_min = ULONG_MAX;
-	int_locked_latency_max = 0;
+	stats_reset();
+}
+
+int int_latency_shell_cmd(int argc, char *argv[])
+{
+	if (argc < 2 || !strcmp(argv[1], "show")) {
+		int_latency_show();
+	} else if (!strcmp(argv[1], "reset")) {
+		stats_reset();
+	} else {
+		return -EINVAL;
+	}
+
+	return 0;
 }
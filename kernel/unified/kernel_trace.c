@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2016 Wind River Systems, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file
+ * @brief Kernel binary tracing.
+ *
+ * Trace records are stored in a ring buffer of fixed-size entries. When the
+ * buffer is full, new records are dropped (and counted) rather than
+ * overwriting old ones, so that a drained trace is always contiguous.
+ */
+
+#include <kernel.h>
+#include <nano_private.h>
+#include <ksched.h>
+#include <misc/kernel_trace.h>
+#include <misc/printk.h>
+#include <kernel_event_logger_arch.h>
+
+#define TRACE_BUF_SIZE CONFIG_KERNEL_TRACING_BUFFER_SIZE
+
+static struct k_trace_record trace_buf[TRACE_BUF_SIZE];
+
+/* free-running indexes: the ring holds (head - tail) records */
+static uint32_t trace_head;
+static uint32_t trace_tail;
+static uint32_t trace_dropped;
+static int trace_enabled = 1;
+
+/* must be called with interrupts locked */
+static inline void trace_put(uint16_t event_id, uint32_t thread,
+			     uint32_t data)
+{
+	struct k_trace_record *rec;
+
+	if (!trace_enabled) {
+		return;
+	}
+
+	if (trace_head - trace_tail == TRACE_BUF_SIZE) {
+		trace_dropped++;
+		return;
+	}
+
+	rec = &trace_buf[trace_head % TRACE_BUF_SIZE];
+
+	rec->timestamp = k_cycle_get_32();
+	rec->event_id = event_id;
+	rec->in_isr = _is_in_isr();
+	rec->thread = thread;
+	rec->data = data;
+
+	trace_head++;
+}
+
+void _sys_k_trace_event(uint16_t event_id, uint32_t data)
+{
+	unsigned int key = irq_lock();
+
+	trace_put(event_id, (uint32_t)_current, data);
+
+	irq_unlock(key);
+}
+
+/* called from the context switch code */
+void _sys_k_trace_context_switch(void)
+{
+	unsigned int key = irq_lock();
+
+	trace_put(K_TRACE_CONTEXT_SWITCH, (uint32_t)_current,
+		  (uint32_t)_get_next_ready_thread());
+
+	irq_unlock(key);
+}
+
+/* called from the interrupt entry code */
+void _sys_k_trace_isr_enter(void)
+{
+	unsigned int key = irq_lock();
+
+	trace_put(K_TRACE_ISR_ENTER, (uint32_t)_current,
+		  _sys_current_irq_key_get());
+
+	irq_unlock(key);
+}
+
+/* called from the interrupt exit code */
+void _sys_k_trace_isr_exit(void)
+{
+	unsigned int key = irq_lock();
+
+	trace_put(K_TRACE_ISR_EXIT, (uint32_t)_current, 0);
+
+	irq_unlock(key);
+}
+
+int sys_k_trace_get(struct k_trace_record *records, int max_records)
+{
+	int count = 0;
+	unsigned int key;
+
+	while (count < max_records) {
+		key = irq_lock();
+
+		if (trace_head == trace_tail) {
+			irq_unlock(key);
+			break;
+		}
+
+		records[count++] = trace_buf[trace_tail % TRACE_BUF_SIZE];
+		trace_tail++;
+
+		irq_unlock(key);
+	}
+
+	return count;
+}
+
+uint32_t sys_k_trace_dropped_get(void)
+{
+	return trace_dropped;
+}
+
+void sys_k_trace_enable(int enable)
+{
+	trace_enabled = enable;
+}
+
+#ifdef CONFIG_KERNEL_TRACING_DUMP
+
+#define TRACE_DUMP_BATCH 8
+
+/*
+ * Emit records on the console, one per line, in the format parsed by
+ * scripts/trace_decode.py.
+ */
+static void trace_dump_main(void *p1, void *p2, void *p3)
+{
+	struct k_trace_record recs[TRACE_DUMP_BATCH];
+	uint32_t dropped = 0;
+
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	printk("KTRACE-HZ %u\n", (uint32_t)sys_clock_hw_cycles_per_sec);
+
+	while (1) {
+		int count = sys_k_trace_get(recs, TRACE_DUMP_BATCH);
+
+		for (int i = 0; i < count; i++) {
+			printk("KTRACE %08x %04x %04x %08x %08x\n",
+			       recs[i].timestamp, recs[i].event_id,
+			       recs[i].in_isr, recs[i].thread, recs[i].data);
+		}
+
+		if (sys_k_trace_dropped_get() != dropped) {
+			dropped = sys_k_trace_dropped_get();
+			printk("KTRACE-DROPPED %u\n", dropped);
+		}
+
+		if (count < TRACE_DUMP_BATCH) {
+			k_sleep(CONFIG_KERNEL_TRACING_DUMP_PERIOD);
+		}
+	}
+}
+
+K_THREAD_DEFINE(_k_trace_dump, CONFIG_KERNEL_TRACING_DUMP_STACK_SIZE,
+		trace_dump_main, NULL, NULL, NULL,
+		NULL, K_LOWEST_APPLICATION_THREAD_PRIO, 0);
+
+#endif /* CONFIG_KERNEL_TRACING_DUMP */
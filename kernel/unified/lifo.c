@@ -27,9 +27,18 @@
 #include <wait_q.h>
 #include <ksched.h>
 
+/*
+ * The items are kept in a stack updated with compare-and-swap, so that
+ * producers push them without locking interrupts or looking at the wait
+ * queue. Before a thread pends on the lifo, LIFO_WAITERS is set in
+ * lifo->list, which is then empty. The producers then take the locked path,
+ * which hands the items directly to the waiters, until none is left.
+ */
+#define LIFO_WAITERS 0x1
+
 void k_lifo_init(struct k_lifo *lifo)
 {
-	lifo->list = (void *)0;
+	atomic_set(&lifo->list, 0);
 	sys_dlist_init(&lifo->wait_q);
 
 	SYS_TRACING_OBJ_INIT(k_lifo, lifo);
@@ -39,6 +48,18 @@ void k_lifo_put(struct k_lifo *lifo, void *data)
 {
 	struct k_thread *first_pending_thread;
 	unsigned int key;
+	atomic_val_t top;
+
+	do {
+		top = atomic_get(&lifo->list);
+		if (top & LIFO_WAITERS) {
+			break;
+		}
+		*(void **)data = (void *)top;
+		if (likely(atomic_cas(&lifo->list, top, (atomic_val_t)data))) {
+			return;
+		}
+	} while (1);
 
 	key = irq_lock();
 
@@ -51,13 +72,18 @@ void k_lifo_put(struct k_lifo *lifo, void *data)
 		_set_thread_return_value_with_data(first_pending_thread,
 						   0, data);
 
+		if (sys_dlist_is_empty(&lifo->wait_q)) {
+			atomic_clear(&lifo->list);
+		}
+
 		if (!_is_in_isr() && _must_switch_threads()) {
 			(void)_Swap(key);
 			return;
 		}
 	} else {
-		*(void **)data = lifo->list;
-		lifo->list = data;
+		/* the waiters timed out, and left the stack empty */
+		*(void **)data = NULL;
+		atomic_set(&lifo->list, (atomic_val_t)data);
 	}
 
 	irq_unlock(key);
@@ -66,21 +92,30 @@ void k_lifo_put(struct k_lifo *lifo, void *data)
 void *k_lifo_get(struct k_lifo *lifo, int32_t timeout)
 {
 	unsigned int key;
-	void *data;
+	atomic_val_t top;
 
+	/* pops are serialized by the interrupt lock: no ABA problem */
 	key = irq_lock();
 
-	if (likely(lifo->list)) {
-		data = lifo->list;
-		lifo->list = *(void **)data;
-		irq_unlock(key);
-		return data;
-	}
-
-	if (timeout == K_NO_WAIT) {
-		irq_unlock(key);
-		return NULL;
-	}
+	do {
+		top = atomic_get(&lifo->list);
+		if (top == 0 || (top & LIFO_WAITERS)) {
+			if (timeout == K_NO_WAIT) {
+				irq_unlock(key);
+				return NULL;
+			}
+			if (top & LIFO_WAITERS ||
+			    atomic_cas(&lifo->list, 0, LIFO_WAITERS)) {
+				break;
+			}
+			continue;
+		}
+		if (likely(atomic_cas(&lifo->list, top,
+				      (atomic_val_t)*(void **)top))) {
+			irq_unlock(key);
+			return (void *)top;
+		}
+	} while (1);
 
 	_pend_current_thread(&lifo->wait_q, timeout);
 
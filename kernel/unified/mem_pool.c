@@ -25,6 +25,10 @@
 #include <wait_q.h>
 #include <init.h>
 
+#ifdef CONFIG_MDEF
+#include <sysgen.h>
+#endif
+
 #define _QUAD_BLOCK_AVAILABLE 0x0F
 #define _QUAD_BLOCK_ALLOCATED 0x0
 
@@ -526,12 +530,165 @@ int k_mem_pool_alloc(struct k_mem_pool *pool, struct k_mem_block *block,
 
 #define MALLOC_ALIGN (sizeof(uint32_t))
 
+#ifdef CONFIG_HEAP_SLAB_CACHES
+
+/*
+ * Small k_malloc() requests are served from memory maps of power of two
+ * block sizes. A block is identified as coming from a cache by its address,
+ * so no bookkeeping is stored along with it.
+ */
+
+#define SLAB_MIN_SHIFT 3
+
+#define SLAB_CACHE_DEFINE(size) \
+	K_MEM_MAP_DEFINE(_k_malloc_slab_##size, size, \
+			 CONFIG_HEAP_SLAB_BLOCKS, 1 << SLAB_MIN_SHIFT)
+
+#define SLAB_CACHE(size) { .map = &_k_malloc_slab_##size }
+
+struct slab_cache {
+	struct k_mem_map *map;
+	int max_used;
+	uint32_t num_allocs;
+	uint32_t num_fallbacks;
+};
+
+SLAB_CACHE_DEFINE(8);
+#if CONFIG_HEAP_SLAB_MAX_SIZE > 8
+SLAB_CACHE_DEFINE(16);
+#endif
+#if CONFIG_HEAP_SLAB_MAX_SIZE > 16
+SLAB_CACHE_DEFINE(32);
+#endif
+#if CONFIG_HEAP_SLAB_MAX_SIZE > 32
+SLAB_CACHE_DEFINE(64);
+#endif
+#if CONFIG_HEAP_SLAB_MAX_SIZE > 64
+SLAB_CACHE_DEFINE(128);
+#endif
+#if CONFIG_HEAP_SLAB_MAX_SIZE > 128
+SLAB_CACHE_DEFINE(256);
+#endif
+#if CONFIG_HEAP_SLAB_MAX_SIZE > 256
+SLAB_CACHE_DEFINE(512);
+#endif
+
+static struct slab_cache slab_caches[] = {
+	SLAB_CACHE(8),
+#if CONFIG_HEAP_SLAB_MAX_SIZE > 8
+	SLAB_CACHE(16),
+#endif
+#if CONFIG_HEAP_SLAB_MAX_SIZE > 16
+	SLAB_CACHE(32),
+#endif
+#if CONFIG_HEAP_SLAB_MAX_SIZE > 32
+	SLAB_CACHE(64),
+#endif
+#if CONFIG_HEAP_SLAB_MAX_SIZE > 64
+	SLAB_CACHE(128),
+#endif
+#if CONFIG_HEAP_SLAB_MAX_SIZE > 128
+	SLAB_CACHE(256),
+#endif
+#if CONFIG_HEAP_SLAB_MAX_SIZE > 256
+	SLAB_CACHE(512),
+#endif
+};
+
+#define NUM_SLAB_CACHES ARRAY_SIZE(slab_caches)
+
+static void *slab_alloc(uint32_t size)
+{
+	struct slab_cache *cache;
+	unsigned int index = 0;
+	unsigned int key;
+	void *ptr;
+
+	/* index of the smallest block size that fits */
+	if (size > (1 << SLAB_MIN_SHIFT)) {
+		index = 32 - __builtin_clz(size - 1) - SLAB_MIN_SHIFT;
+	}
+
+	if (index >= NUM_SLAB_CACHES) {
+		return NULL;
+	}
+
+	cache = &slab_caches[index];
+
+	if (k_mem_map_alloc(cache->map, &ptr, K_NO_WAIT) != 0) {
+		key = irq_lock();
+		cache->num_fallbacks++;
+		irq_unlock(key);
+		return NULL;
+	}
+
+	key = irq_lock();
+	cache->num_allocs++;
+	if (cache->map->num_used > cache->max_used) {
+		cache->max_used = cache->map->num_used;
+	}
+	irq_unlock(key);
+
+	return ptr;
+}
+
+static bool slab_free(void *ptr)
+{
+	struct k_mem_map *map;
+	int i;
+
+	for (i = 0; i < NUM_SLAB_CACHES; i++) {
+		map = slab_caches[i].map;
+		if ((char *)ptr >= map->buffer &&
+		    (char *)ptr < map->buffer +
+				  map->num_blocks * map->block_size) {
+			k_mem_map_free(map, &ptr);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+int k_malloc_slab_stats_get(int cache, struct k_malloc_slab_stats *stats)
+{
+	struct slab_cache *slab;
+	unsigned int key;
+
+	if (cache < 0 || cache >= NUM_SLAB_CACHES) {
+		return -EINVAL;
+	}
+
+	slab = &slab_caches[cache];
+
+	key = irq_lock();
+	stats->block_size = slab->map->block_size;
+	stats->num_blocks = slab->map->num_blocks;
+	stats->num_used = slab->map->num_used;
+	stats->max_used = slab->max_used;
+	stats->num_allocs = slab->num_allocs;
+	stats->num_fallbacks = slab->num_fallbacks;
+	irq_unlock(key);
+
+	return 0;
+}
+
+#endif /* CONFIG_HEAP_SLAB_CACHES */
+
 void *k_malloc(uint32_t size)
 {
 	uint32_t new_size;
 	uint32_t *aligned_addr;
 	struct k_mem_block mem_block;
 
+#ifdef CONFIG_HEAP_SLAB_CACHES
+	void *ptr = slab_alloc(size);
+
+	if (ptr || heap_mem_pool == NULL) {
+		return ptr;
+	}
+#endif
+
 	__ASSERT(heap_mem_pool != NULL,
 		"Try to allocate a block in undefined heap\n");
 
@@ -583,6 +740,12 @@ void k_free(void *ptr)
 {
 	struct k_mem_block mem_block;
 
+#ifdef CONFIG_HEAP_SLAB_CACHES
+	if (slab_free(ptr)) {
+		return;
+	}
+#endif
+
 	__ASSERT(heap_mem_pool != NULL,
 		"Try to free a block in undefined heap\n");
 
@@ -29,6 +29,74 @@
 #include <wait_q.h>
 #include <misc/dlist.h>
 
+static inline void _msgq_ring_put(struct k_msgq *q, void *data)
+{
+	memcpy(q->write_ptr, data, q->msg_size);
+	q->write_ptr += q->msg_size;
+	if (q->write_ptr == q->buffer_end) {
+		q->write_ptr = q->buffer_start;
+	}
+	q->used_msgs++;
+}
+
+static inline void _msgq_ring_drop(struct k_msgq *q)
+{
+	q->read_ptr += q->msg_size;
+	if (q->read_ptr == q->buffer_end) {
+		q->read_ptr = q->buffer_start;
+	}
+	q->used_msgs--;
+}
+
+/*
+ * Gives the oldest message to the first thread waiting to read. The caller
+ * has checked that a message is readable.
+ */
+static inline struct k_thread *_msgq_handoff_read(struct k_msgq *q)
+{
+	struct k_thread *pending_thread =
+		_unpend_first_thread(&q->wait_q.readers);
+
+	if (pending_thread) {
+		memcpy(pending_thread->swap_data, q->read_ptr, q->msg_size);
+		_msgq_ring_drop(q);
+		_set_thread_return_value(pending_thread, 0);
+		_abort_thread_timeout(pending_thread);
+		_ready_thread(pending_thread);
+	}
+
+	return pending_thread;
+}
+
+/*
+ * Moves the message of the first thread waiting to write into the ring. The
+ * caller has checked that the ring has room for it.
+ */
+static inline struct k_thread *_msgq_handoff_write(struct k_msgq *q)
+{
+	struct k_thread *pending_thread =
+		_unpend_first_thread(&q->wait_q.writers);
+
+	if (pending_thread) {
+		_msgq_ring_put(q, pending_thread->swap_data);
+		_set_thread_return_value(pending_thread, 0);
+		_abort_thread_timeout(pending_thread);
+		_ready_thread(pending_thread);
+	}
+
+	return pending_thread;
+}
+
+/* unlock interrupts, switching to a readied thread where allowed */
+static inline void _msgq_reschedule(unsigned int key)
+{
+	if (!_is_in_isr() && _must_switch_threads()) {
+		_Swap(key);
+	} else {
+		irq_unlock(key);
+	}
+}
+
 void k_msgq_init(struct k_msgq *q, char *buffer,
 		 uint32_t msg_size, uint32_t max_msgs)
 {
@@ -38,8 +106,13 @@ void k_msgq_init(struct k_msgq *q, char *buffer,
 	q->buffer_end = buffer + (max_msgs * msg_size);
 	q->read_ptr = buffer;
 	q->write_ptr = buffer;
+	q->claim_ptr = NULL;
 	q->used_msgs = 0;
-	sys_dlist_init(&q->wait_q);
+	sys_dlist_init(&q->wait_q.readers);
+	sys_dlist_init(&q->wait_q.writers);
+#ifdef CONFIG_POLL
+	q->poll_event = NULL;
+#endif
 	SYS_TRACING_OBJ_INIT(msgq, q);
 }
 
@@ -51,7 +124,12 @@ int k_msgq_put(struct k_msgq *q, void *data, int32_t timeout)
 
 	if (q->used_msgs < q->max_msgs) {
 		/* message queue isn't full */
-		pending_thread = _unpend_first_thread(&q->wait_q);
+		pending_thread = NULL;
+		if (!q->claim_ptr) {
+			/* no claimed message that must be read first */
+			pending_thread =
+				_unpend_first_thread(&q->wait_q.readers);
+		}
 		if (pending_thread) {
 			/* give message to waiting thread */
 			memcpy(pending_thread->swap_data, data, q->msg_size);
@@ -65,12 +143,16 @@ int k_msgq_put(struct k_msgq *q, void *data, int32_t timeout)
 			}
 		} else {
 			/* put message in queue */
-			memcpy(q->write_ptr, data, q->msg_size);
-			q->write_ptr += q->msg_size;
-			if (q->write_ptr == q->buffer_end) {
-				q->write_ptr = q->buffer_start;
+			_msgq_ring_put(q, data);
+#ifdef CONFIG_POLL
+			/* not readable if it was put behind a claim */
+			if (_msgq_readable(q) > 0 &&
+			    _handle_obj_poll_event(&q->poll_event,
+					K_POLL_STATE_MSGQ_DATA_AVAILABLE)) {
+				_Swap(key);
+				return 0;
 			}
-			q->used_msgs++;
+#endif
 		}
 		result = 0;
 	} else if (timeout == K_NO_WAIT) {
@@ -78,7 +160,7 @@ int k_msgq_put(struct k_msgq *q, void *data, int32_t timeout)
 		result = -ENOMSG;
 	} else {
 		/* wait for put message success, failure, or timeout */
-		_pend_current_thread(&q->wait_q, timeout);
+		_pend_current_thread(&q->wait_q.writers, timeout);
 		_current->swap_data = data;
 		return _Swap(key);
 	}
@@ -88,41 +170,58 @@ int k_msgq_put(struct k_msgq *q, void *data, int32_t timeout)
 	return result;
 }
 
+int k_msgq_put_n(struct k_msgq *q, void *data, uint32_t num_msgs)
+{
+	unsigned int key = irq_lock();
+	char *msg = data;
+	uint32_t i;
+
+	for (i = 0; i < num_msgs && q->used_msgs < q->max_msgs; i++) {
+		struct k_thread *pending_thread = NULL;
+
+		if (!q->claim_ptr) {
+			pending_thread =
+				_unpend_first_thread(&q->wait_q.readers);
+		}
+		if (pending_thread) {
+			memcpy(pending_thread->swap_data, msg, q->msg_size);
+			_set_thread_return_value(pending_thread, 0);
+			_abort_thread_timeout(pending_thread);
+			_ready_thread(pending_thread);
+		} else {
+			_msgq_ring_put(q, msg);
+		}
+		msg += q->msg_size;
+	}
+
+#ifdef CONFIG_POLL
+	if (_msgq_readable(q) > 0) {
+		_handle_obj_poll_event(&q->poll_event,
+				       K_POLL_STATE_MSGQ_DATA_AVAILABLE);
+	}
+#endif
+
+	_msgq_reschedule(key);
+
+	return i;
+}
+
 int k_msgq_get(struct k_msgq *q, void *data, int32_t timeout)
 {
 	unsigned int key = irq_lock();
 	struct k_thread *pending_thread;
 	int result;
 
-	if (q->used_msgs > 0) {
+	if (_msgq_readable(q) > 0) {
 		/* take first available message from queue */
 		memcpy(data, q->read_ptr, q->msg_size);
-		q->read_ptr += q->msg_size;
-		if (q->read_ptr == q->buffer_end) {
-			q->read_ptr = q->buffer_start;
-		}
-		q->used_msgs--;
+		_msgq_ring_drop(q);
 
 		/* handle first thread waiting to write (if any) */
-		pending_thread = _unpend_first_thread(&q->wait_q);
-		if (pending_thread) {
-			/* add thread's message to queue */
-			memcpy(q->write_ptr, pending_thread->swap_data,
-			       q->msg_size);
-			q->write_ptr += q->msg_size;
-			if (q->write_ptr == q->buffer_end) {
-				q->write_ptr = q->buffer_start;
-			}
-			q->used_msgs++;
-
-			/* wake up waiting thread */
-			_set_thread_return_value(pending_thread, 0);
-			_abort_thread_timeout(pending_thread);
-			_ready_thread(pending_thread);
-			if (_must_switch_threads()) {
-				_Swap(key);
-				return 0;
-			}
+		pending_thread = _msgq_handoff_write(q);
+		if (pending_thread && _must_switch_threads()) {
+			_Swap(key);
+			return 0;
 		}
 		result = 0;
 	} else if (timeout == K_NO_WAIT) {
@@ -130,7 +229,7 @@ int k_msgq_get(struct k_msgq *q, void *data, int32_t timeout)
 		result = -ENOMSG;
 	} else {
 		/* wait for get message success or timeout */
-		_pend_current_thread(&q->wait_q, timeout);
+		_pend_current_thread(&q->wait_q.readers, timeout);
 		_current->swap_data = data;
 		return _Swap(key);
 	}
@@ -140,20 +239,144 @@ int k_msgq_get(struct k_msgq *q, void *data, int32_t timeout)
 	return result;
 }
 
+int k_msgq_get_n(struct k_msgq *q, void *data, uint32_t max_msgs)
+{
+	unsigned int key = irq_lock();
+	uint32_t num_msgs = _msgq_readable(q);
+	char *msg = data;
+	uint32_t i;
+
+	if (num_msgs > max_msgs) {
+		num_msgs = max_msgs;
+	}
+
+	for (i = 0; i < num_msgs; i++) {
+		memcpy(msg, q->read_ptr, q->msg_size);
+		_msgq_ring_drop(q);
+		msg += q->msg_size;
+	}
+
+	/* refill the space with the messages of waiting writers */
+	if (num_msgs > 0) {
+		while (q->used_msgs < q->max_msgs && _msgq_handoff_write(q)) {
+		}
+	}
+
+	_msgq_reschedule(key);
+
+	return num_msgs;
+}
+
+void *k_msgq_claim(struct k_msgq *q)
+{
+	unsigned int key = irq_lock();
+	void *slot = NULL;
+
+	if (!q->claim_ptr && q->used_msgs < q->max_msgs) {
+		slot = q->write_ptr;
+		q->claim_ptr = q->write_ptr;
+		q->write_ptr += q->msg_size;
+		if (q->write_ptr == q->buffer_end) {
+			q->write_ptr = q->buffer_start;
+		}
+		q->used_msgs++;
+	}
+
+	irq_unlock(key);
+
+	return slot;
+}
+
+int k_msgq_commit(struct k_msgq *q)
+{
+	unsigned int key = irq_lock();
+
+	if (!q->claim_ptr) {
+		/* nothing claimed */
+		irq_unlock(key);
+		return -EINVAL;
+	}
+
+	q->claim_ptr = NULL;
+
+	/*
+	 * Readers wait only if the claimed message is the oldest one, so
+	 * hand the messages to them in order. Writers wait only if the ring
+	 * is full, so their messages go after those, in the room the
+	 * readers free.
+	 */
+	for (;;) {
+		if (q->used_msgs > 0 && _msgq_handoff_read(q)) {
+			continue;
+		}
+		if (q->used_msgs < q->max_msgs && _msgq_handoff_write(q)) {
+			continue;
+		}
+		break;
+	}
+
+#ifdef CONFIG_POLL
+	if (_msgq_readable(q) > 0) {
+		_handle_obj_poll_event(&q->poll_event,
+				       K_POLL_STATE_MSGQ_DATA_AVAILABLE);
+	}
+#endif
+
+	_msgq_reschedule(key);
+
+	return 0;
+}
+
+void *k_msgq_peek(struct k_msgq *q)
+{
+	unsigned int key = irq_lock();
+	void *msg = _msgq_readable(q) > 0 ? q->read_ptr : NULL;
+
+	irq_unlock(key);
+
+	return msg;
+}
+
+void k_msgq_release(struct k_msgq *q)
+{
+	unsigned int key = irq_lock();
+
+	if (_msgq_readable(q) == 0) {
+		irq_unlock(key);
+		return;
+	}
+
+	_msgq_ring_drop(q);
+	_msgq_handoff_write(q);
+
+	_msgq_reschedule(key);
+}
+
 void k_msgq_purge(struct k_msgq *q)
 {
 	unsigned int key = irq_lock();
 	struct k_thread *pending_thread;
 
 	/* wake up any threads that are waiting to write */
-	while ((pending_thread = _unpend_first_thread(&q->wait_q)) != NULL) {
+	while ((pending_thread = _unpend_first_thread(&q->wait_q.writers))
+	       != NULL) {
 		_set_thread_return_value(pending_thread, -ENOMSG);
 		_abort_thread_timeout(pending_thread);
 		_ready_thread(pending_thread);
 	}
 
-	q->used_msgs = 0;
-	q->read_ptr = q->write_ptr;
+	if (q->claim_ptr) {
+		/* keep the claimed slot, its owner still writes to it */
+		q->used_msgs = 1;
+		q->read_ptr = q->claim_ptr;
+		q->write_ptr = q->claim_ptr + q->msg_size;
+		if (q->write_ptr == q->buffer_end) {
+			q->write_ptr = q->buffer_start;
+		}
+	} else {
+		q->used_msgs = 0;
+		q->read_ptr = q->write_ptr;
+	}
 
 	_reschedule_threads(key);
 }
@@ -43,6 +43,7 @@
 #include <wait_q.h>
 #include <misc/dlist.h>
 #include <errno.h>
+#include <misc/kernel_trace.h>
 
 #ifdef CONFIG_OBJECT_MONITOR
 #define RECORD_STATE_CHANGE(mutex) \
@@ -71,8 +72,23 @@
 #define INIT_KERNEL_TRACING(mutex) do { } while ((0))
 #endif
 
+/*
+ * The mutex state word holds the owning thread, or 0 when the mutex is free,
+ * so that an uncontended lock and unlock are a single compare-and-swap each.
+ * Threads are aligned, so bit 0 is free to flag that other threads have
+ * pended on the mutex: the owner then has to take the slow path on unlock to
+ * restore its priority and hand the mutex over.
+ *
+ * The owner, lock_count and owner_orig_prio fields are only written by the
+ * owning thread, or by the unlocking thread when it hands the mutex over.
+ */
+#define MUTEX_WAITERS 0x1
+
+#define MUTEX_OWNER(state) ((struct k_thread *)((state) & ~MUTEX_WAITERS))
+
 void k_mutex_init(struct k_mutex *mutex)
 {
+	atomic_set(&mutex->state, 0);
 	mutex->owner = NULL;
 	mutex->lock_count = 0;
 
@@ -94,42 +110,60 @@ static int new_prio_for_inheritance(int target, int limit)
 	return new_prio;
 }
 
-static void adjust_owner_prio(struct k_mutex *mutex, int new_prio)
+static void adjust_owner_prio(struct k_thread *owner, int new_prio)
 {
-	if (mutex->owner->prio != new_prio) {
+	if (owner->prio != new_prio) {
 
 		K_DEBUG("%p (ready (y/n): %c) prio changed to %d (was %d)\n",
-			mutex->owner, _is_thread_ready(mutex->owner) ?
-			'y' : 'n',
-			new_prio, mutex->owner->prio);
+			owner, _is_thread_ready(owner) ? 'y' : 'n',
+			new_prio, owner->prio);
 
-		_thread_priority_set(mutex->owner, new_prio);
+		_thread_priority_set(owner, new_prio);
 	}
 }
 
+static inline void mutex_set_owner(struct k_mutex *mutex,
+				   struct k_thread *owner, int prio)
+{
+	mutex->lock_count = 1;
+	mutex->owner_orig_prio = prio;
+	mutex->owner = owner;
+}
+
 int k_mutex_lock(struct k_mutex *mutex, int32_t timeout)
 {
+	struct k_thread *owner;
 	int new_prio, key;
+	int prio = _current->prio;
 
-	k_sched_lock();
-
-	if (likely(mutex->lock_count == 0 || mutex->owner == _current)) {
+	/* fast path: mutex is free, or already ours */
 
+	if (likely(atomic_cas(&mutex->state, 0, (atomic_val_t)_current))) {
 		RECORD_STATE_CHANGE();
+		mutex_set_owner(mutex, _current, prio);
+		_SYS_K_TRACE(K_TRACE_MUTEX_LOCK, mutex);
+		return 0;
+	}
 
-		mutex->owner_orig_prio = mutex->lock_count == 0 ?
-					_current->prio :
-					mutex->owner_orig_prio;
-
+	if (MUTEX_OWNER(atomic_get(&mutex->state)) == _current) {
+		RECORD_STATE_CHANGE();
 		mutex->lock_count++;
-		mutex->owner = _current;
+		_SYS_K_TRACE(K_TRACE_MUTEX_LOCK, mutex);
+		return 0;
+	}
 
-		K_DEBUG("%p took mutex %p, count: %d, orig prio: %d\n",
-			_current, mutex, mutex->lock_count,
-			mutex->owner_orig_prio);
+	/*
+	 * slow path: the state cannot change under us anymore once the
+	 * scheduler is locked, since only threads lock and unlock mutexes
+	 */
 
-		k_sched_unlock();
+	k_sched_lock();
 
+	if (atomic_cas(&mutex->state, 0, (atomic_val_t)_current)) {
+		RECORD_STATE_CHANGE();
+		mutex_set_owner(mutex, _current, _current->prio);
+		k_sched_unlock();
+		_SYS_K_TRACE(K_TRACE_MUTEX_LOCK, mutex);
 		return 0;
 	}
 
@@ -140,31 +174,33 @@ int k_mutex_lock(struct k_mutex *mutex, int32_t timeout)
 		return -EBUSY;
 	}
 
-#if 0
-	if (_is_prio_higher(_current->prio, mutex->owner->prio)) {
-		new_prio = _current->prio;
-	}
-	new_prio = _get_new_prio_with_ceiling(new_prio);
-#endif
-	new_prio = new_prio_for_inheritance(_current->prio, mutex->owner->prio);
+	_SYS_K_TRACE(K_TRACE_MUTEX_LOCK_BLOCK, mutex);
+
+	/*
+	 * The owner might have been preempted before publishing itself in
+	 * mutex->owner: the state word is authoritative.
+	 */
+	owner = MUTEX_OWNER(atomic_or(&mutex->state, MUTEX_WAITERS));
+
+	new_prio = new_prio_for_inheritance(_current->prio, owner->prio);
 
 	key = irq_lock();
 
 	K_DEBUG("adjusting prio up on mutex %p\n", mutex);
 
-	adjust_owner_prio(mutex, new_prio);
+	adjust_owner_prio(owner, new_prio);
 
 	_pend_current_thread(&mutex->wait_q, timeout);
 
 	int got_mutex = _Swap(key);
 
-	K_DEBUG("on mutex %p got_mutex value: %d\n", mutex, got_mutex);
-
 	K_DEBUG("%p got mutex %p (y/n): %c\n", _current, mutex,
-		got_mutex ? 'y' : 'n');
+		got_mutex ? 'n' : 'y');
 
 	if (got_mutex == 0) {
+		/* the unlocking thread made us the owner */
 		k_sched_unlock();
+		_SYS_K_TRACE(K_TRACE_MUTEX_LOCK, mutex);
 		return 0;
 	}
 
@@ -172,17 +208,29 @@ int k_mutex_lock(struct k_mutex *mutex, int32_t timeout)
 
 	K_DEBUG("%p timeout on mutex %p\n", _current, mutex);
 
-	struct k_thread *waiter =
-		(struct k_thread *)sys_dlist_peek_head(&mutex->wait_q);
+	/*
+	 * The waiters flag is left set even if the wait queue is now empty:
+	 * the owner's unlock then takes the slow path and clears it.
+	 */
+
+	key = irq_lock();
 
-	new_prio = mutex->owner_orig_prio;
-	new_prio = waiter ? new_prio_for_inheritance(waiter->prio, new_prio) :
-			    new_prio;
+	owner = MUTEX_OWNER(atomic_get(&mutex->state));
 
-	K_DEBUG("adjusting prio down on mutex %p\n", mutex);
+	if (owner && mutex->owner == owner) {
+		struct k_thread *waiter =
+			(struct k_thread *)sys_dlist_peek_head(&mutex->wait_q);
+
+		new_prio = mutex->owner_orig_prio;
+		new_prio = waiter ?
+			   new_prio_for_inheritance(waiter->prio, new_prio) :
+			   new_prio;
+
+		K_DEBUG("adjusting prio down on mutex %p\n", mutex);
+
+		adjust_owner_prio(owner, new_prio);
+	}
 
-	key = irq_lock();
-	adjust_owner_prio(mutex, new_prio);
 	irq_unlock(key);
 
 	k_sched_unlock();
@@ -196,22 +244,30 @@ void k_mutex_unlock(struct k_mutex *mutex)
 
 	__ASSERT(mutex->owner == _current, "");
 
-	k_sched_lock();
+	_SYS_K_TRACE(K_TRACE_MUTEX_UNLOCK, mutex);
 
 	RECORD_STATE_CHANGE();
 
-	mutex->lock_count--;
+	if (mutex->lock_count > 1) {
+		mutex->lock_count--;
+		K_DEBUG("mutex %p lock_count: %d\n", mutex, mutex->lock_count);
+		return;
+	}
 
-	K_DEBUG("mutex %p lock_count: %d\n", mutex, mutex->lock_count);
+	/* fast path: nobody pended on the mutex while we owned it */
 
-	if (mutex->lock_count != 0) {
-		k_sched_unlock();
+	mutex->lock_count = 0;
+	mutex->owner = NULL;
+
+	if (likely(atomic_cas(&mutex->state, (atomic_val_t)_current, 0))) {
 		return;
 	}
 
+	k_sched_lock();
+
 	key = irq_lock();
 
-	adjust_owner_prio(mutex, mutex->owner_orig_prio);
+	adjust_owner_prio(_current, mutex->owner_orig_prio);
 
 	struct k_thread *new_owner = _unpend_first_thread(&mutex->wait_q);
 
@@ -222,8 +278,6 @@ void k_mutex_unlock(struct k_mutex *mutex)
 		_abort_thread_timeout(new_owner);
 		_ready_thread(new_owner);
 
-		irq_unlock(key);
-
 		_set_thread_return_value(new_owner, 0);
 
 		/*
@@ -231,13 +285,16 @@ void k_mutex_unlock(struct k_mutex *mutex)
 		 * waiter since the wait queue is priority-based: no need to
 		 * ajust its priority
 		 */
-		mutex->owner = new_owner;
-		mutex->lock_count++;
-		mutex->owner_orig_prio = new_owner->prio;
+		mutex_set_owner(mutex, new_owner, new_owner->prio);
+
+		atomic_set(&mutex->state, (atomic_val_t)new_owner |
+			   (sys_dlist_is_empty(&mutex->wait_q) ?
+			    0 : MUTEX_WAITERS));
 	} else {
-		irq_unlock(key);
-		mutex->owner = NULL;
+		atomic_set(&mutex->state, 0);
 	}
 
+	irq_unlock(key);
+
 	k_sched_unlock();
 }
@@ -87,6 +87,9 @@ void k_pipe_init(struct k_pipe *pipe, unsigned char *buffer, size_t size)
 	pipe->write_index = 0;
 	sys_dlist_init(&pipe->wait_q.writers);
 	sys_dlist_init(&pipe->wait_q.readers);
+#ifdef CONFIG_POLL
+	pipe->poll_event = NULL;
+#endif
 	SYS_TRACING_OBJ_INIT(pipe, pipe);
 }
 
@@ -466,9 +469,22 @@ int _k_pipe_put_internal(struct k_pipe *pipe, struct k_pipe_async *async_desc,
 	 * readers. Add as much as possible to the pipe's circular buffer.
 	 */
 
-	num_bytes_written +=
-		_pipe_buffer_put(pipe, data + num_bytes_written,
-				 bytes_to_write - num_bytes_written);
+	bytes_copied = _pipe_buffer_put(pipe, data + num_bytes_written,
+					bytes_to_write - num_bytes_written);
+	num_bytes_written += bytes_copied;
+
+#ifdef CONFIG_POLL
+	/*
+	 * The scheduler is locked: a polling thread readied here runs, if
+	 * needed, when the scheduler is unlocked below.
+	 */
+	if (bytes_copied > 0) {
+		key = irq_lock();
+		(void)_handle_obj_poll_event(&pipe->poll_event,
+					     K_POLL_STATE_PIPE_DATA_AVAILABLE);
+		irq_unlock(key);
+	}
+#endif
 
 	if (num_bytes_written == bytes_to_write) {
 		*bytes_written = num_bytes_written;
@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2016 Wind River Systems, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file
+ *
+ * @brief Kernel asynchronous event polling interface.
+ *
+ * Polling for asynchronous events on a set of kernel objects, e.g.
+ * semaphores becoming available or data arriving in fifos, message queues
+ * or pipes.
+ *
+ * A polled object keeps a pointer to the (single) event registered on it.
+ * The object signals the event, and thus readies the polling thread, only
+ * when it becomes available and no thread is pending on it through its
+ * regular API.
+ */
+
+#include <kernel.h>
+#include <nano_private.h>
+#include <wait_q.h>
+#include <ksched.h>
+#include <misc/slist.h>
+#include <misc/dlist.h>
+#include <misc/__assert.h>
+
+void k_poll_event_init(struct k_poll_event *event, uint32_t type,
+		       int mode, void *obj)
+{
+	__ASSERT(mode == K_POLL_MODE_NOTIFY_ONLY,
+		 "only NOTIFY_ONLY mode is supported\n");
+	__ASSERT(type < _POLL_NUM_TYPES, "invalid type\n");
+	__ASSERT(obj, "must provide an object\n");
+
+	event->poller = NULL;
+	event->type = type;
+	event->state = K_POLL_STATE_NOT_READY;
+	event->mode = mode;
+	event->unused = 0;
+	event->obj = obj;
+}
+
+/* must be called with interrupts locked */
+static inline int is_condition_met(struct k_poll_event *event,
+				   uint32_t *state)
+{
+	switch (event->type) {
+	case K_POLL_TYPE_SEM_AVAILABLE:
+		if (k_sem_count_get(event->sem) > 0) {
+			*state = K_POLL_STATE_SEM_AVAILABLE;
+			return 1;
+		}
+		break;
+	case K_POLL_TYPE_FIFO_DATA_AVAILABLE:
+		if (_k_fifo_poll_ready(event->fifo)) {
+			*state = K_POLL_STATE_FIFO_DATA_AVAILABLE;
+			return 1;
+		}
+		break;
+	case K_POLL_TYPE_MSGQ_DATA_AVAILABLE:
+		if (_msgq_readable(event->msgq) > 0) {
+			*state = K_POLL_STATE_MSGQ_DATA_AVAILABLE;
+			return 1;
+		}
+		break;
+	case K_POLL_TYPE_PIPE_DATA_AVAILABLE:
+		if (event->pipe->bytes_used > 0) {
+			*state = K_POLL_STATE_PIPE_DATA_AVAILABLE;
+			return 1;
+		}
+		break;
+	case K_POLL_TYPE_IGNORE:
+		break;
+	default:
+		__ASSERT(0, "invalid event type (0x%x)\n", event->type);
+		break;
+	}
+
+	return 0;
+}
+
+/* find the object's pointer to its registered event */
+static inline struct k_poll_event **obj_poll_event(struct k_poll_event *event)
+{
+	switch (event->type) {
+	case K_POLL_TYPE_SEM_AVAILABLE:
+		return &event->sem->poll_event;
+	case K_POLL_TYPE_FIFO_DATA_AVAILABLE:
+		return &event->fifo->poll_event;
+	case K_POLL_TYPE_MSGQ_DATA_AVAILABLE:
+		return &event->msgq->poll_event;
+	case K_POLL_TYPE_PIPE_DATA_AVAILABLE:
+		return &event->pipe->poll_event;
+	default:
+		return NULL;
+	}
+}
+
+/* must be called with interrupts locked */
+static inline int register_event(struct k_poll_event *event,
+				 struct _poller *poller)
+{
+	struct k_poll_event **slot = obj_poll_event(event);
+
+	if (!slot) {
+		/* K_POLL_TYPE_IGNORE */
+		return 0;
+	}
+
+	if (*slot) {
+		return -EADDRINUSE;
+	}
+
+	*slot = event;
+	event->poller = poller;
+
+	return 0;
+}
+
+/* must be called with interrupts locked */
+static inline void clear_event_registration(struct k_poll_event *event)
+{
+	struct k_poll_event **slot = obj_poll_event(event);
+
+	event->poller = NULL;
+
+	if (slot && *slot == event) {
+		*slot = NULL;
+	}
+}
+
+/* must be called with interrupts locked */
+static inline void clear_event_registrations(struct k_poll_event *events,
+					     int last_registered)
+{
+	for (; last_registered >= 0; last_registered--) {
+		clear_event_registration(&events[last_registered]);
+	}
+}
+
+static inline void set_event_ready(struct k_poll_event *event, uint32_t state)
+{
+	event->poller = NULL;
+	event->state |= state;
+}
+
+int k_poll(struct k_poll_event *events, int num_events, int32_t timeout)
+{
+	int key, rc = 0;
+	int last_registered = -1;
+	struct _poller poller = { .thread = _current, .is_polling = 1, };
+
+	__ASSERT(!_is_in_isr(), "");
+	__ASSERT(events, "NULL events\n");
+	__ASSERT(num_events > 0, "zero events\n");
+
+	/* find events whose condition is already fulfilled */
+	for (int ii = 0; ii < num_events; ii++) {
+		uint32_t state;
+
+		events[ii].state = K_POLL_STATE_NOT_READY;
+
+		key = irq_lock();
+		if (is_condition_met(&events[ii], &state)) {
+			set_event_ready(&events[ii], state);
+			poller.is_polling = 0;
+		} else if (timeout != K_NO_WAIT && poller.is_polling) {
+			rc = register_event(&events[ii], &poller);
+			if (rc == 0) {
+				last_registered = ii;
+			} else {
+				events[ii].state = K_POLL_STATE_EADDRINUSE;
+			}
+		}
+		irq_unlock(key);
+
+		if (rc != 0) {
+			break;
+		}
+	}
+
+	key = irq_lock();
+
+	/*
+	 * If we're not polling anymore, it means that at least one event
+	 * condition is met, either when looping through the events here or
+	 * because one of the events registered has had its state changed, or
+	 * that one of the objects is already being polled by another thread.
+	 */
+	if (!poller.is_polling || rc != 0) {
+		clear_event_registrations(events, last_registered);
+		irq_unlock(key);
+		return rc;
+	}
+
+	poller.is_polling = 0;
+
+	if (timeout == K_NO_WAIT) {
+		irq_unlock(key);
+		return -EAGAIN;
+	}
+
+	_wait_q_t wait_q;
+
+	sys_dlist_init(&wait_q);
+
+	_pend_current_thread(&wait_q, timeout);
+
+	int swap_rc = _Swap(key);
+
+	/*
+	 * Clear all event registrations. If events happen while we're in this
+	 * loop, and we already had one that triggered, that's OK: they will
+	 * end up in the list of events that are ready; if we timed out, and
+	 * events happen while we're in this loop, that is OK as well since
+	 * we've already know the return code (-EAGAIN), and even if they are
+	 * added to the list of events that occurred, the user has to check the
+	 * return code first, which invalidates the whole list of event states.
+	 */
+	key = irq_lock();
+	clear_event_registrations(events, last_registered);
+	irq_unlock(key);
+
+	return swap_rc;
+}
+
+/* must be called with interrupts locked */
+static int _signal_poll_event(struct k_poll_event *event, uint32_t state,
+			      int *must_reschedule)
+{
+	*must_reschedule = 0;
+
+	if (!event->poller) {
+		goto ready_event;
+	}
+
+	struct k_thread *thread = event->poller->thread;
+
+	__ASSERT(event->poller->thread, "poller should have a thread\n");
+
+	event->poller->is_polling = 0;
+
+	if (!_is_thread_pending(thread)) {
+		/* the poller is still registering its events */
+		goto ready_event;
+	}
+
+	_unpend_thread(thread);
+	_abort_thread_timeout(thread);
+	_set_thread_return_value(thread, 0);
+	_ready_thread(thread);
+
+	*must_reschedule = !_is_in_isr() && _must_switch_threads();
+
+ready_event:
+	set_event_ready(event, state);
+	return 0;
+}
+
+/* returns 1 if a reschedule must take place, 0 otherwise */
+/* must be called with interrupts locked */
+int _handle_obj_poll_event(struct k_poll_event **obj_poll_event,
+			   uint32_t state)
+{
+	struct k_poll_event *poll_event = *obj_poll_event;
+	int must_reschedule;
+
+	if (!poll_event) {
+		return 0;
+	}
+
+	*obj_poll_event = NULL;
+
+	(void)_signal_poll_event(poll_event, state, &must_reschedule);
+
+	return must_reschedule;
+}
@@ -0,0 +1,363 @@
+/*
+ * Copyright (c) 2016 Wind River Systems, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file @brief reader-writer lock kernel services
+ *
+ * A reader-writer lock is held either by any number of readers or by one
+ * writer. Writers are preferred: readers wait as long as a writer holds the
+ * lock or waits for it, so that a steady flow of readers cannot starve the
+ * writers. A writer releasing the lock hands it to the next writer if there
+ * is one, otherwise to all the waiting readers.
+ *
+ * The writer holding the lock inherits the priority of the highest priority
+ * thread waiting for the lock, as with mutexes. Readers holding the lock do
+ * not inherit priorities.
+ */
+
+#include <kernel.h>
+#include <nano_private.h>
+#include <toolchain.h>
+#include <sections.h>
+#include <wait_q.h>
+#include <ksched.h>
+#include <misc/dlist.h>
+#include <errno.h>
+
+/*
+ * The state word holds the number of readers, in units of RWLOCK_READER, or
+ * RWLOCK_WRITER while a writer holds the lock. Taking and releasing the lock
+ * is a single compare-and-swap as long as nobody waits for it.
+ *
+ * RWLOCK_WAITERS is set while threads pend on the lock: the lock-free paths
+ * then all fail, and the state is only changed with interrupts locked.
+ */
+#define RWLOCK_WRITER  0x1
+#define RWLOCK_WAITERS 0x2
+#define RWLOCK_READER  0x4
+
+#define RWLOCK_HELD(state) ((state) & ~RWLOCK_WAITERS)
+
+void k_rwlock_init(struct k_rwlock *rwlock)
+{
+	atomic_set(&rwlock->state, 0);
+	sys_dlist_init(&rwlock->readers);
+	sys_dlist_init(&rwlock->writers);
+	rwlock->writer = NULL;
+	rwlock->writer_orig_prio = K_LOWEST_THREAD_PRIO;
+
+#ifdef CONFIG_DEBUG_TRACING_KERNEL_OBJECTS
+	rwlock->__next = NULL;
+#endif
+}
+
+static int new_prio_for_inheritance(int target, int limit)
+{
+	int new_prio = _is_prio_higher(target, limit) ? target : limit;
+
+	new_prio = _get_new_prio_with_ceiling(new_prio);
+
+	return new_prio;
+}
+
+static void adjust_writer_prio(struct k_thread *writer, int new_prio)
+{
+	if (writer->prio != new_prio) {
+
+		K_DEBUG("%p (ready (y/n): %c) prio changed to %d (was %d)\n",
+			writer, _is_thread_ready(writer) ? 'y' : 'n',
+			new_prio, writer->prio);
+
+		_thread_priority_set(writer, new_prio);
+	}
+}
+
+/**
+ * @brief Priority the writer should run at
+ *
+ * Its own priority, raised to the one of the first waiting writer and of
+ * the first waiting reader.
+ *
+ * Must be called with interrupts locked.
+ */
+static int writer_prio(struct k_rwlock *rwlock)
+{
+	struct k_thread *waiter;
+	int prio = rwlock->writer_orig_prio;
+
+	waiter = _peek_first_pending_thread(&rwlock->writers);
+	if (waiter) {
+		prio = new_prio_for_inheritance(waiter->prio, prio);
+	}
+
+	waiter = _peek_first_pending_thread(&rwlock->readers);
+	if (waiter) {
+		prio = new_prio_for_inheritance(waiter->prio, prio);
+	}
+
+	return prio;
+}
+
+static void wake(struct k_thread *thread)
+{
+	_abort_thread_timeout(thread);
+	_ready_thread(thread);
+	_set_thread_return_value(thread, 0);
+}
+
+/**
+ * @brief Wake up all the waiting readers, who now hold the lock
+ *
+ * Must be called with interrupts locked and RWLOCK_WAITERS set.
+ *
+ * @return The state with the readers added
+ */
+static atomic_val_t wake_readers(struct k_rwlock *rwlock, atomic_val_t state)
+{
+	struct k_thread *thread;
+
+	while ((thread = _unpend_first_thread(&rwlock->readers)) != NULL) {
+		wake(thread);
+		state += RWLOCK_READER;
+	}
+
+	return state;
+}
+
+static inline atomic_val_t waiters_flag(struct k_rwlock *rwlock)
+{
+	return sys_dlist_is_empty(&rwlock->readers) &&
+	       sys_dlist_is_empty(&rwlock->writers) ? 0 : RWLOCK_WAITERS;
+}
+
+/**
+ * @brief Hand the lock over to the next writer, else to all the readers
+ *
+ * Must be called with interrupts locked, RWLOCK_WAITERS set and the lock
+ * free.
+ */
+static void handoff(struct k_rwlock *rwlock)
+{
+	struct k_thread *thread = _unpend_first_thread(&rwlock->writers);
+	atomic_val_t state = 0;
+
+	if (thread) {
+		wake(thread);
+
+		rwlock->writer = thread;
+		rwlock->writer_orig_prio = thread->prio;
+		state = RWLOCK_WRITER;
+
+		/* readers can have a higher priority than the next writer */
+		adjust_writer_prio(thread, writer_prio(rwlock));
+	} else {
+		state = wake_readers(rwlock, state);
+	}
+
+	atomic_set(&rwlock->state, state | waiters_flag(rwlock));
+}
+
+static void reschedule(unsigned int key)
+{
+	if (_must_switch_threads()) {
+		_Swap(key);
+	} else {
+		irq_unlock(key);
+	}
+}
+
+/**
+ * @brief Clean up after the current thread timed out waiting for the lock
+ *
+ * The writer no longer inherits the priority of the current thread, and
+ * readers that waited behind the current thread, if it is the last waiting
+ * writer, get the lock.
+ */
+static void timed_out(struct k_rwlock *rwlock)
+{
+	unsigned int key = irq_lock();
+	atomic_val_t state = atomic_get(&rwlock->state);
+
+	if (rwlock->writer) {
+		adjust_writer_prio(rwlock->writer, writer_prio(rwlock));
+	}
+
+	/* waiting readers imply that RWLOCK_WAITERS is set */
+	if (!(state & RWLOCK_WRITER) &&
+	    sys_dlist_is_empty(&rwlock->writers) &&
+	    !sys_dlist_is_empty(&rwlock->readers)) {
+		state = wake_readers(rwlock, state & ~RWLOCK_WAITERS);
+		atomic_set(&rwlock->state, state);
+	}
+
+	reschedule(key);
+}
+
+/**
+ * @brief Pend the current thread on one of the wait queues of the lock
+ *
+ * Must be called with interrupts locked; unlocks them.
+ *
+ * @return 0 if the lock was handed to the current thread, -EAGAIN on timeout
+ */
+static int pend(struct k_rwlock *rwlock, _wait_q_t *wait_q, int32_t timeout,
+		unsigned int key)
+{
+	atomic_or(&rwlock->state, RWLOCK_WAITERS);
+
+	/*
+	 * A writer that was preempted before publishing itself in
+	 * rwlock->writer misses the priority boost.
+	 */
+	if (rwlock->writer) {
+		K_DEBUG("adjusting prio up on rwlock %p\n", rwlock);
+		adjust_writer_prio(rwlock->writer,
+				   new_prio_for_inheritance(_current->prio,
+							    rwlock->writer->prio));
+	}
+
+	_pend_current_thread(wait_q, timeout);
+
+	if (_Swap(key) == 0) {
+		return 0;
+	}
+
+	K_DEBUG("%p timeout on rwlock %p\n", _current, rwlock);
+
+	timed_out(rwlock);
+
+	return -EAGAIN;
+}
+
+int k_rwlock_read_lock(struct k_rwlock *rwlock, int32_t timeout)
+{
+	atomic_val_t state;
+	unsigned int key;
+
+	__ASSERT(!_is_in_isr(), "");
+
+	state = atomic_get(&rwlock->state);
+	if (likely(!(state & (RWLOCK_WRITER | RWLOCK_WAITERS))) &&
+	    atomic_cas(&rwlock->state, state, state + RWLOCK_READER)) {
+		return 0;
+	}
+
+	key = irq_lock();
+
+	state = atomic_get(&rwlock->state);
+
+	/* readers wait behind a writer that holds or waits for the lock */
+	while (!(state & RWLOCK_WRITER) &&
+	       sys_dlist_is_empty(&rwlock->writers)) {
+		if (atomic_cas(&rwlock->state, state, state + RWLOCK_READER)) {
+			irq_unlock(key);
+			return 0;
+		}
+		state = atomic_get(&rwlock->state);
+	}
+
+	if (timeout == K_NO_WAIT) {
+		irq_unlock(key);
+		return -EBUSY;
+	}
+
+	return pend(rwlock, &rwlock->readers, timeout, key);
+}
+
+void k_rwlock_read_unlock(struct k_rwlock *rwlock)
+{
+	atomic_val_t state = atomic_get(&rwlock->state);
+	unsigned int key;
+
+	__ASSERT(!(state & RWLOCK_WRITER) && RWLOCK_HELD(state) != 0,
+		 "rwlock not held for reading");
+
+	if (likely(!(state & RWLOCK_WAITERS)) &&
+	    atomic_cas(&rwlock->state, state, state - RWLOCK_READER)) {
+		return;
+	}
+
+	key = irq_lock();
+
+	state = atomic_sub(&rwlock->state, RWLOCK_READER) - RWLOCK_READER;
+
+	if (RWLOCK_HELD(state) != 0 || !(state & RWLOCK_WAITERS)) {
+		irq_unlock(key);
+		return;
+	}
+
+	/* last reader out: a writer is waiting */
+	handoff(rwlock);
+
+	reschedule(key);
+}
+
+int k_rwlock_write_lock(struct k_rwlock *rwlock, int32_t timeout)
+{
+	atomic_val_t state;
+	unsigned int key;
+	int prio = _current->prio;
+
+	__ASSERT(!_is_in_isr(), "");
+	__ASSERT(rwlock->writer != _current, "rwlock already held");
+
+	if (likely(atomic_cas(&rwlock->state, 0, RWLOCK_WRITER))) {
+		rwlock->writer_orig_prio = prio;
+		rwlock->writer = _current;
+		return 0;
+	}
+
+	key = irq_lock();
+
+	state = atomic_get(&rwlock->state);
+	if (RWLOCK_HELD(state) == 0 &&
+	    atomic_cas(&rwlock->state, state, state | RWLOCK_WRITER)) {
+		rwlock->writer_orig_prio = _current->prio;
+		rwlock->writer = _current;
+		irq_unlock(key);
+		return 0;
+	}
+
+	if (timeout == K_NO_WAIT) {
+		irq_unlock(key);
+		return -EBUSY;
+	}
+
+	return pend(rwlock, &rwlock->writers, timeout, key);
+}
+
+void k_rwlock_write_unlock(struct k_rwlock *rwlock)
+{
+	unsigned int key;
+
+	__ASSERT(rwlock->writer == _current, "rwlock not held for writing");
+
+	rwlock->writer = NULL;
+
+	if (likely(atomic_cas(&rwlock->state, RWLOCK_WRITER, 0))) {
+		return;
+	}
+
+	key = irq_lock();
+
+	K_DEBUG("adjusting prio down on rwlock %p\n", rwlock);
+
+	adjust_writer_prio(_current, rwlock->writer_orig_prio);
+
+	handoff(rwlock);
+
+	reschedule(key);
+}
@@ -38,6 +38,34 @@ static void _clear_ready_q_prio_bit(int prio)
 	*bmap &= ~_get_ready_q_prio_bit(prio);
 }
 
+#ifdef CONFIG_SCHED_DEADLINE
+/*
+ * Threads with a deadline are kept ahead of the ones without one, in
+ * deadline order, after the threads with the same deadline.
+ */
+static void _ready_q_insert(sys_dlist_t *q, struct k_thread *thread)
+{
+	sys_dnode_t *node;
+
+	if (thread->deadline.active) {
+		SYS_DLIST_FOR_EACH_NODE(q, node) {
+			struct k_thread *t =
+				CONTAINER_OF(node, struct k_thread, k_q_node);
+
+			if (_is_t1_deadline_earlier_than_t2(thread, t)) {
+				sys_dlist_insert_before(q, node,
+							&thread->k_q_node);
+				return;
+			}
+		}
+	}
+
+	sys_dlist_append(q, &thread->k_q_node);
+}
+#else
+#define _ready_q_insert(q, thread) sys_dlist_append(q, &(thread)->k_q_node)
+#endif
+
 /*
  * Add thread to the ready queue, in the slot for its priority; the thread
  * must not be on a wait queue.
@@ -54,12 +82,18 @@ void _add_thread_to_ready_q(struct k_thread *thread)
 	sys_dlist_t *q = &_nanokernel.ready_q.q[q_index];
 
 	_set_ready_q_prio_bit(thread->prio);
-	sys_dlist_append(q, &thread->k_q_node);
+	_ready_q_insert(q, thread);
 
 	struct k_thread **cache = &_nanokernel.ready_q.cache;
 
 	*cache = *cache && _is_prio_higher(thread->prio, (*cache)->prio) ?
 		 thread : *cache;
+
+#ifdef CONFIG_SCHED_DEADLINE
+	/* an earlier deadline can put the thread ahead of the cached one */
+	*cache = *cache && (*cache)->prio == thread->prio &&
+		 sys_dlist_is_head(q, &thread->k_q_node) ? thread : *cache;
+#endif
 }
 
 /*
@@ -207,6 +241,13 @@ int __must_switch_threads(void)
 	extern void _dump_ready_q(void);
 	_dump_ready_q();
 
+#ifdef CONFIG_SCHED_DEADLINE
+	if (_get_highest_ready_prio() == _current->prio) {
+		return _is_t1_deadline_earlier_than_t2(_get_next_ready_thread(),
+							_current);
+	}
+#endif
+
 	return _is_prio_higher(_get_highest_ready_prio(), _current->prio);
 }
 
@@ -233,6 +274,63 @@ void k_thread_priority_set(k_tid_t tid, int prio)
 	_reschedule_threads(key);
 }
 
+#ifdef CONFIG_SCHED_DEADLINE
+/* application API: set the deadline of a thread's current job */
+void k_thread_deadline_set(k_tid_t tid, int32_t deadline)
+{
+	__ASSERT(deadline >= 0 || deadline == K_FOREVER, "");
+
+	struct k_thread *thread = (struct k_thread *)tid;
+	int key = irq_lock();
+	uint32_t now = k_cycle_get_32();
+
+	if (thread->deadline.active) {
+		int32_t lateness = (int32_t)(now - thread->deadline.abs);
+
+		thread->deadline.stats.jobs++;
+		if (lateness > 0) {
+			thread->deadline.stats.misses++;
+			if ((uint32_t)lateness >
+			    thread->deadline.stats.max_lateness) {
+				thread->deadline.stats.max_lateness = lateness;
+			}
+		}
+	}
+
+	if (deadline == K_FOREVER) {
+		thread->deadline.active = 0;
+	} else {
+		thread->deadline.active = 1;
+		thread->deadline.abs = now +
+			(uint32_t)(((uint64_t)deadline *
+				    sys_clock_hw_cycles_per_sec) /
+				   MSEC_PER_SEC);
+	}
+
+	/* requeue the thread according to its new deadline */
+	if (_is_thread_ready(thread)) {
+		_remove_thread_from_ready_q(thread);
+		_add_thread_to_ready_q(thread);
+	}
+
+	if (_is_in_isr()) {
+		irq_unlock(key);
+	} else {
+		_reschedule_threads(key);
+	}
+}
+
+void k_thread_deadline_stats_get(k_tid_t thread,
+				 struct k_thread_deadline_stats *stats)
+{
+	unsigned int key = irq_lock();
+
+	*stats = thread->deadline.stats;
+
+	irq_unlock(key);
+}
+#endif /* CONFIG_SCHED_DEADLINE */
+
 /*
  * Interrupts must be locked when calling this function.
  *
@@ -250,7 +348,7 @@ void _move_thread_to_end_of_prio_q(struct k_thread *thread)
 	}
 
 	sys_dlist_remove(&thread->k_q_node);
-	sys_dlist_append(q, &thread->k_q_node);
+	_ready_q_insert(q, thread);
 
 	struct k_thread **cache = &_nanokernel.ready_q.cache;
 
@@ -358,3 +456,30 @@ void k_sched_time_slice_set(int32_t duration_in_ms, int prio)
 	_time_slice_prio_ceiling = prio;
 }
 #endif /* CONFIG_TIMESLICING */
+
+#ifdef CONFIG_THREAD_STATS
+/* cycle counter value when the current thread was switched in */
+static uint32_t switched_in_stamp;
+
+/* called from the context switch code */
+void _thread_stats_switch(void)
+{
+	unsigned int key = irq_lock();
+	struct k_thread *next = _get_next_ready_thread();
+	uint32_t now = k_cycle_get_32();
+
+	if (next != _current) {
+		_current->stats.cycles += now - switched_in_stamp;
+		switched_in_stamp = now;
+		next->stats.switches++;
+	}
+
+	irq_unlock(key);
+}
+
+/* must be called with interrupts locked */
+uint32_t _thread_stats_current_cycles(void)
+{
+	return k_cycle_get_32() - switched_in_stamp;
+}
+#endif /* CONFIG_THREAD_STATS */
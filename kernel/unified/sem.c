@@ -34,6 +34,7 @@
 #include <wait_q.h>
 #include <misc/dlist.h>
 #include <ksched.h>
+#include <misc/kernel_trace.h>
 
 #ifdef CONFIG_SEMAPHORE_GROUPS
 struct _sem_desc {
@@ -56,6 +57,9 @@ void k_sem_init(struct k_sem *sem, unsigned int initial_count,
 	sem->count = initial_count;
 	sem->limit = limit;
 	sys_dlist_init(&sem->wait_q);
+#ifdef CONFIG_POLL
+	sem->poll_event = NULL;
+#endif
 	SYS_TRACING_OBJ_INIT(nano_sem, sem);
 }
 
@@ -212,6 +216,57 @@ static int handle_sem_group(struct k_sem *sem, struct k_thread *thread)
 #define handle_sem_group(sem, thread) 0
 #endif
 
+/*
+ * Threads only pend on a semaphore, and pollers only wait for it, while its
+ * count is zero. As long as the count is not zero, it can thus be updated
+ * with a compare-and-swap without locking interrupts, since there is nobody
+ * to wake up. The code that updates the count with interrupts locked does
+ * not need atomic operations, since nothing can run concurrently with it on
+ * a single CPU.
+ */
+
+/**
+ * @brief Take a semaphore whose count is not zero, without locking
+ *
+ * @return true if the semaphore was taken; false if its count is zero
+ */
+static inline bool sem_try_take(struct k_sem *sem)
+{
+	atomic_val_t count;
+
+	do {
+		count = atomic_get(&sem->count);
+		if (count == 0) {
+			return false;
+		}
+	} while (!atomic_cas(&sem->count, count, count - 1));
+
+	return true;
+}
+
+/**
+ * @brief Give a semaphore whose count is not zero, without locking
+ *
+ * @return true if the semaphore was given; false if its count is zero and
+ * waiters may have to be woken up
+ */
+static inline bool sem_try_give(struct k_sem *sem)
+{
+	atomic_val_t count;
+
+	do {
+		count = atomic_get(&sem->count);
+		if (count == 0) {
+			return false;
+		}
+		if (count == (atomic_val_t)sem->limit) {
+			return true;
+		}
+	} while (!atomic_cas(&sem->count, count, count + 1));
+
+	return true;
+}
+
 /**
  * @brief Common semaphore give code
  *
@@ -228,8 +283,14 @@ static bool sem_give_common(struct k_sem *sem)
 		 * Increment the semaphore's count unless
 		 * its limit has already been reached.
 		 */
-		sem->count += (sem->count != sem->limit);
+		sem->count += (sem->count != (atomic_val_t)sem->limit);
+
+#ifdef CONFIG_POLL
+		return _handle_obj_poll_event(&sem->poll_event,
+					      K_POLL_STATE_SEM_AVAILABLE);
+#else
 		return false;
+#endif
 	}
 
 	_abort_thread_timeout(thread);
@@ -280,6 +341,12 @@ void k_sem_give(struct k_sem *sem)
 {
 	unsigned int   key;
 
+	_SYS_K_TRACE(K_TRACE_SEM_GIVE, sem);
+
+	if (sem_try_give(sem)) {
+		return;
+	}
+
 	key = irq_lock();
 
 	if (sem_give_common(sem)) {
@@ -293,11 +360,18 @@ int k_sem_take(struct k_sem *sem, int32_t timeout)
 {
 	__ASSERT(!_is_in_isr() || timeout == K_NO_WAIT, "");
 
+	if (likely(sem_try_take(sem))) {
+		_SYS_K_TRACE(K_TRACE_SEM_TAKE, sem);
+		return 0;
+	}
+
 	unsigned int key = irq_lock();
 
-	if (likely(sem->count > 0)) {
+	/* given since the check above */
+	if (sem->count > 0) {
 		sem->count--;
 		irq_unlock(key);
+		_SYS_K_TRACE(K_TRACE_SEM_TAKE, sem);
 		return 0;
 	}
 
@@ -306,6 +380,8 @@ int k_sem_take(struct k_sem *sem, int32_t timeout)
 		return -EBUSY;
 	}
 
+	_SYS_K_TRACE(K_TRACE_SEM_TAKE_BLOCK, sem);
+
 	_pend_current_thread(&sem->wait_q, timeout);
 
 	return _Swap(key);
@@ -201,6 +201,84 @@ void _thread_exit(struct k_thread *thread)
 }
 #endif /* CONFIG_THREAD_MONITOR */
 
+#ifdef CONFIG_THREAD_STATS
+void k_thread_stats_get(k_tid_t thread, struct k_thread_stats *stats)
+{
+	unsigned int key = irq_lock();
+
+	*stats = thread->stats;
+	if (thread == _current) {
+		stats->cycles += _thread_stats_current_cycles();
+	}
+
+	irq_unlock(key);
+}
+
+size_t k_thread_stack_unused_get(k_tid_t thread)
+{
+	/*
+	 * The thread structure sits at the bottom of the stack area and the
+	 * stack grows down towards it: count the bytes above the structure
+	 * that still hold the pattern written by CONFIG_INIT_STACKS.
+	 */
+	const uint8_t *start = (const uint8_t *)thread + sizeof(*thread);
+	const uint8_t *end = (const uint8_t *)thread + thread->stats.stack_size;
+	const uint8_t *p = start;
+
+	while (p < end && *p == 0xaa) {
+		p++;
+	}
+
+	return p - start;
+}
+
+static const char *thread_name(k_tid_t thread)
+{
+	if (thread == _main_thread) {
+		return "main";
+	} else if (thread == _idle_thread) {
+		return "idle";
+	}
+
+	return "";
+}
+
+void k_thread_stats_show(void)
+{
+	struct k_thread_stats stats;
+	struct k_thread *thread;
+	uint64_t total = 0;
+
+	/*
+	 * Threads exiting while the list is walked are not supported, as for
+	 * any user of the thread monitor list.
+	 */
+	for (thread = _nanokernel.threads; thread;
+	     thread = thread->next_thread) {
+		k_thread_stats_get(thread, &stats);
+		total += stats.cycles;
+	}
+
+	if (!total) {
+		total = 1;
+	}
+
+	for (thread = _nanokernel.threads; thread;
+	     thread = thread->next_thread) {
+		uint32_t permille;
+
+		k_thread_stats_get(thread, &stats);
+		permille = (uint32_t)((stats.cycles * 1000) / total);
+
+		printk("%p %s\tprio %d\tcpu %u.%u%%\tswitches %u\t"
+		       "stack unused %u/%u\n", thread, thread_name(thread),
+		       thread->prio, permille / 10, permille % 10,
+		       stats.switches, k_thread_stack_unused_get(thread),
+		       stats.stack_size - sizeof(*thread));
+	}
+}
+#endif /* CONFIG_THREAD_STATS */
+
 /**
  *
  * @brief Common thread entry point function
@@ -295,6 +373,94 @@ k_tid_t k_thread_spawn(char *stack, unsigned stack_size,
 	return new_thread;
 }
 
+#ifdef CONFIG_THREAD_STACK_POOL
+
+#define POOL_STACK_SIZE \
+	ROUND_UP(CONFIG_THREAD_STACK_POOL_STACK_SIZE, STACK_ALIGN)
+
+K_MEM_MAP_DEFINE(_k_thread_stack_pool, POOL_STACK_SIZE,
+			 CONFIG_THREAD_STACK_POOL_STACKS, STACK_ALIGN);
+
+/* dead threads whose stack has not gone back to the pool yet */
+static sys_dlist_t dead_pool_threads =
+	SYS_DLIST_STATIC_INIT(&dead_pool_threads);
+
+static inline int has_pool_stack(struct k_thread *thread)
+{
+	struct k_mem_map *pool = &_k_thread_stack_pool;
+
+	return (char *)thread >= pool->buffer &&
+	       (char *)thread < pool->buffer +
+				pool->num_blocks * pool->block_size;
+}
+
+/*
+ * A thread cannot give its stack back itself, since it runs on it until it
+ * has switched out for the last time: the stacks of dead threads are
+ * reclaimed when the next thread is spawned from the pool instead.
+ *
+ * Must be called with interrupts locked.
+ */
+static void pool_stack_release(struct k_thread *thread)
+{
+	if (has_pool_stack(thread)) {
+		sys_dlist_append(&dead_pool_threads, &thread->k_q_node);
+	}
+}
+
+static void pool_stacks_reclaim(void)
+{
+	struct k_thread *thread;
+	unsigned int key = irq_lock();
+
+	while (!sys_dlist_is_empty(&dead_pool_threads)) {
+		thread = (struct k_thread *)sys_dlist_peek_head(
+							&dead_pool_threads);
+
+		/* the abort handler of the current thread may spawn a thread */
+		if (thread == _current) {
+			break;
+		}
+
+		sys_dlist_remove(&thread->k_q_node);
+
+		irq_unlock(key);
+		k_mem_map_free(&_k_thread_stack_pool, (void **)&thread);
+		key = irq_lock();
+	}
+
+	irq_unlock(key);
+}
+
+k_tid_t k_thread_spawn_dynamic(unsigned stack_size,
+			       void (*entry)(void *, void *, void *),
+			       void *p1, void *p2, void *p3,
+			       int32_t prio, uint32_t options, int32_t delay)
+{
+	void *stack;
+
+	__ASSERT(!_is_in_isr(), "");
+
+	if (stack_size > POOL_STACK_SIZE) {
+		return NULL;
+	}
+
+	pool_stacks_reclaim();
+
+	if (k_mem_map_alloc(&_k_thread_stack_pool, &stack, K_NO_WAIT) != 0) {
+		return NULL;
+	}
+
+	return k_thread_spawn(stack, POOL_STACK_SIZE, entry, p1, p2, p3,
+			      prio, options, delay);
+}
+
+#else
+
+#define pool_stack_release(thread) do { } while (0)
+
+#endif /* CONFIG_THREAD_STACK_POOL */
+
 int k_thread_cancel(k_tid_t tid)
 {
 	struct k_thread *thread = tid;
@@ -308,6 +474,7 @@ int k_thread_cancel(k_tid_t tid)
 
 	_abort_thread_timeout(thread);
 	_thread_exit(thread);
+	pool_stack_release(thread);
 
 	irq_unlock(key);
 
@@ -419,6 +586,15 @@ void _k_thread_single_abort(struct k_thread *thread)
 			_mark_thread_as_not_timing(thread);
 		}
 	}
+
+#ifdef CONFIG_THREAD_STACK_POOL
+	if (has_pool_stack(thread) && !(thread->flags & K_DEAD)) {
+		/* the stack gets reused: forget about the thread */
+		_thread_exit(thread);
+		pool_stack_release(thread);
+	}
+#endif
+
 	_mark_thread_as_dead(thread);
 }
 
@@ -23,6 +23,69 @@
 #include <nano_private.h>
 #include <wait_q.h>
 #include <errno.h>
+#include <string.h>
+#include <misc/util.h>
+#include <misc/kernel_trace.h>
+
+#ifdef CONFIG_WORKQUEUE_STATS
+static inline int stats_bucket(uint32_t cycles)
+{
+	int bucket = find_msb_set(cycles);
+
+	return min(bucket, CONFIG_WORKQUEUE_STATS_BUCKETS - 1);
+}
+
+static void work_q_stats_update(struct k_work_q *work_q, uint32_t wait,
+				uint32_t run)
+{
+	struct k_work_q_stats *stats = &work_q->stats;
+	int key = irq_lock();
+
+	stats->items++;
+	stats->wait_hist[stats_bucket(wait)]++;
+	stats->run_hist[stats_bucket(run)]++;
+	stats->max_wait = max(stats->max_wait, wait);
+	stats->max_run = max(stats->max_run, run);
+
+	irq_unlock(key);
+}
+
+void k_work_q_stats_reset(struct k_work_q *work_q)
+{
+	int key = irq_lock();
+
+	memset(&work_q->stats, 0, sizeof(work_q->stats));
+
+	irq_unlock(key);
+}
+#endif /* CONFIG_WORKQUEUE_STATS */
+
+static void work_q_process(struct k_work_q *work_q, struct k_work *work)
+{
+	k_work_handler_t handler = work->handler;
+
+#ifdef CONFIG_WORKQUEUE_STATS
+	uint32_t start = k_cycle_get_32();
+	uint32_t wait = start - work->_submit_cycles;
+#endif
+
+	/* Reset pending state so it can be resubmitted by handler */
+	if (!atomic_test_and_clear_bit(work->flags, K_WORK_STATE_PENDING)) {
+		return;
+	}
+
+	_SYS_K_TRACE(K_TRACE_WORK_START, work);
+
+	handler(work);
+
+	_SYS_K_TRACE(K_TRACE_WORK_END, work);
+
+#ifdef CONFIG_WORKQUEUE_STATS
+	work_q_stats_update(work_q, wait, k_cycle_get_32() - start);
+#else
+	ARG_UNUSED(work_q);
+#endif
+}
 
 static void work_q_main(void *work_q_ptr, void *p2, void *p3)
 {
@@ -33,33 +96,54 @@ static void work_q_main(void *work_q_ptr, void *p2, void *p3)
 
 	while (1) {
 		struct k_work *work;
-		k_work_handler_t handler;
+		int batch = 0;
 
 		work = k_fifo_get(&work_q->fifo, K_FOREVER);
 
-		handler = work->handler;
+		/*
+		 * Drain the queue without going back through the wait queue
+		 * as long as items are available: blocking in k_fifo_get()
+		 * already gives the CPU away when the queue is empty.
+		 */
+		do {
+			work_q_process(work_q, work);
+
+			/* Make sure we don't hog up the CPU if the FIFO never
+			 * (or very rarely) gets empty.
+			 */
+			if (++batch == CONFIG_WORKQUEUE_BATCH_SIZE) {
+				k_yield();
+				batch = 0;
+			}
+
+			work = k_fifo_get(&work_q->fifo, K_NO_WAIT);
+		} while (work);
+	}
+}
+
+void k_work_q_pool_start(struct k_work_q *work_q,
+			 const struct k_thread_config *config,
+			 int num_threads)
+{
+	__ASSERT(num_threads > 0, "workqueue needs at least one thread");
 
-		/* Reset pending state so it can be resubmitted by handler */
-		if (atomic_test_and_clear_bit(work->flags,
-					       K_WORK_STATE_PENDING)) {
-			handler(work);
-		}
+	k_fifo_init(&work_q->fifo);
 
-		/* Make sure we don't hog up the CPU if the FIFO never (or
-		 * very rarely) gets empty.
-		 */
-		k_yield();
+#ifdef CONFIG_WORKQUEUE_STATS
+	memset(&work_q->stats, 0, sizeof(work_q->stats));
+#endif
+
+	for (int i = 0; i < num_threads; i++) {
+		k_thread_spawn(config[i].stack, config[i].stack_size,
+			       work_q_main, work_q, 0, 0,
+			       config[i].prio, 0, 0);
 	}
 }
 
 void k_work_q_start(struct k_work_q *work_q,
 		    const struct k_thread_config *config)
 {
-	k_fifo_init(&work_q->fifo);
-
-	k_thread_spawn(config->stack, config->stack_size,
-		       work_q_main, work_q, 0, 0,
-		       config->prio, 0, 0);
+	k_work_q_pool_start(work_q, config, 1);
 }
 
 #ifdef CONFIG_SYS_CLOCK_EXISTS
@@ -149,13 +233,12 @@ int k_delayed_work_cancel(struct k_delayed_work *work)
 
 #include <init.h>
 
-static char __stack sys_work_q_stack[CONFIG_SYSTEM_WORKQUEUE_STACK_SIZE];
+static char __stack
+	sys_work_q_stack[CONFIG_SYSTEM_WORKQUEUE_THREADS]
+			[CONFIG_SYSTEM_WORKQUEUE_STACK_SIZE];
 
-static const struct k_thread_config sys_work_q_config = {
-	.stack = sys_work_q_stack,
-	.stack_size = sizeof(sys_work_q_stack),
-	.prio = CONFIG_SYSTEM_WORKQUEUE_PRIORITY,
-};
+static struct k_thread_config
+	sys_work_q_config[CONFIG_SYSTEM_WORKQUEUE_THREADS];
 
 struct k_work_q k_sys_work_q;
 
@@ -163,7 +246,14 @@ static int k_sys_work_q_init(struct device *dev)
 {
 	ARG_UNUSED(dev);
 
-	k_work_q_start(&k_sys_work_q, &sys_work_q_config);
+	for (int i = 0; i < CONFIG_SYSTEM_WORKQUEUE_THREADS; i++) {
+		sys_work_q_config[i].stack = sys_work_q_stack[i];
+		sys_work_q_config[i].stack_size = sizeof(sys_work_q_stack[i]);
+		sys_work_q_config[i].prio = CONFIG_SYSTEM_WORKQUEUE_PRIORITY;
+	}
+
+	k_work_q_pool_start(&k_sys_work_q, sys_work_q_config,
+			    CONFIG_SYSTEM_WORKQUEUE_THREADS);
 
 	return 0;
 }
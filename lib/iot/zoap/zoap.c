@@ -22,6 +22,7 @@
 #include <errno.h>
 
 #include <misc/byteorder.h>
+#include <misc/util.h>
 #include <net/ip_buf.h>
 
 #include "zoap.h"
@@ -159,8 +160,14 @@ static int coap_parse_options(struct zoap_packet *pkt, unsigned int offset)
 		.buflen = ip_buf_appdatalen(buf) - offset,
 		.buf = &appdata[offset] };
 
+	pkt->option_count = 0;
+	pkt->indexed = true;
+
 	while (true) {
-		int r = coap_parse_option(pkt, &context, NULL, NULL);
+		struct zoap_option_index *index;
+		uint8_t *value;
+		uint16_t len;
+		int r = coap_parse_option(pkt, &context, &value, &len);
 
 		if (r < 0) {
 			return -EINVAL;
@@ -169,6 +176,16 @@ static int coap_parse_options(struct zoap_packet *pkt, unsigned int offset)
 		if (r == 0) {
 			break;
 		}
+
+		if (pkt->option_count == CONFIG_ZOAP_OPTION_INDEX_SIZE) {
+			pkt->indexed = false;
+			continue;
+		}
+
+		index = &pkt->options[pkt->option_count++];
+		index->code = context.delta;
+		index->offset = value - appdata;
+		index->len = len;
 	}
 	return context.used;
 }
@@ -441,7 +458,7 @@ struct zoap_pending *zoap_pending_next_to_expire(
 	size_t i;
 
 	for (i = 0, p = pendings; i < len; i++, p++) {
-		if (p->timeout && (!found || found->timeout < p->timeout)) {
+		if (p->timeout && (!found || found->timeout > p->timeout)) {
 			found = p;
 		}
 	}
@@ -481,19 +498,12 @@ void zoap_pending_clear(struct zoap_pending *pending)
 	pending->timeout = 0;
 }
 
-static bool uri_path_eq(const struct zoap_packet *pkt,
+#define MAX_PATH_SEGMENTS 16
+
+static bool uri_path_eq(const struct zoap_option *options, int count,
 			const char * const *path)
 {
-	struct zoap_option options[16];
-	uint16_t count = 16;
-	int i, r;
-
-	r = zoap_find_options(pkt, ZOAP_OPTION_URI_PATH, options, count);
-	if (r < 0) {
-		return false;
-	}
-
-	count = r;
+	int i;
 
 	for (i = 0; i < count && path[i]; i++) {
 		size_t len;
@@ -529,32 +539,200 @@ static zoap_method_t method_from_code(const struct zoap_resource *resource,
 	}
 }
 
+static int call_method(struct zoap_resource *resource,
+		       struct zoap_packet *pkt,
+		       const uip_ipaddr_t *addr, uint16_t port)
+{
+	zoap_method_t method;
+
+	method = method_from_code(resource, zoap_header_get_code(pkt));
+	if (!method) {
+		return 0;
+	}
+
+	return method(resource, pkt, addr, port);
+}
+
 int zoap_handle_request(struct zoap_packet *pkt,
 			struct zoap_resource *resources,
 			const uip_ipaddr_t *addr, uint16_t port)
+{
+	struct zoap_option options[MAX_PATH_SEGMENTS];
+	struct zoap_resource *resource;
+	int count;
+
+	count = zoap_find_options(pkt, ZOAP_OPTION_URI_PATH, options,
+				  MAX_PATH_SEGMENTS);
+	if (count < 0) {
+		return -ENOENT;
+	}
+
+	for (resource = resources; resource && resource->path; resource++) {
+		if (!uri_path_eq(options, count, resource->path)) {
+			continue;
+		}
+
+		return call_method(resource, pkt, addr, port);
+	}
+
+	return -ENOENT;
+}
+
+static uint32_t segment_hash(const void *segment, size_t len)
+{
+	const uint8_t *p = segment;
+	uint32_t hash = 2166136261u;
+
+	/* FNV-1a */
+	while (len--) {
+		hash ^= *p++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/* First entry not ordered before (parent, hash) */
+static uint16_t index_lower_bound(const struct zoap_resource_index *index,
+				  uint16_t parent, uint32_t hash)
+{
+	uint16_t lo = 0, hi = index->used;
+
+	while (lo < hi) {
+		uint16_t mid = lo + (hi - lo) / 2;
+		const struct zoap_resource_index_entry *e = &index->entries[mid];
+
+		if (e->parent < parent ||
+		    (e->parent == parent && e->hash < hash)) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+/* Find the entry of a segment, or where it should be inserted */
+static bool index_find(const struct zoap_resource_index *index,
+		       uint16_t parent, const void *segment, uint16_t len,
+		       uint16_t *pos)
+{
+	uint32_t hash = segment_hash(segment, len);
+	uint16_t i;
+
+	for (i = index_lower_bound(index, parent, hash); i < index->used; i++) {
+		const struct zoap_resource_index_entry *e = &index->entries[i];
+
+		if (e->parent != parent || e->hash != hash) {
+			break;
+		}
+
+		if (e->len == len && !memcmp(e->segment, segment, len)) {
+			*pos = i;
+			return true;
+		}
+	}
+
+	*pos = i;
+	return false;
+}
+
+int zoap_resource_index_build(struct zoap_resource_index *index,
+			      struct zoap_resource_index_entry *entries,
+			      uint16_t size, struct zoap_resource *resources)
 {
 	struct zoap_resource *resource;
+	uint16_t nodes = 0;
+
+	index->entries = entries;
+	index->root = NULL;
+	index->size = size;
+	index->used = 0;
 
 	for (resource = resources; resource && resource->path; resource++) {
-		zoap_method_t method;
-		uint8_t code;
+		struct zoap_resource_index_entry *e = NULL;
+		uint16_t parent = 0;
+		int i;
+
+		for (i = 0; resource->path[i]; i++) {
+			const char *segment = resource->path[i];
+			uint16_t len = strlen(segment);
+			uint16_t pos;
+
+			if (!index_find(index, parent, segment, len, &pos)) {
+				if (index->used == index->size) {
+					return -ENOMEM;
+				}
+
+				memmove(&entries[pos + 1], &entries[pos],
+					(index->used - pos) * sizeof(*entries));
+				index->used++;
+
+				e = &entries[pos];
+				e->hash = segment_hash(segment, len);
+				e->parent = parent;
+				e->node = ++nodes;
+				e->len = len;
+				e->segment = segment;
+				e->resource = NULL;
+			}
+
+			e = &entries[pos];
+			parent = e->node;
+		}
+
+		if (!e) {
+			if (index->root) {
+				return -EEXIST;
+			}
 
-		/* FIXME: deal with hierarchical resources */
-		if (!uri_path_eq(pkt, resource->path)) {
+			index->root = resource;
 			continue;
 		}
 
-		code = zoap_header_get_code(pkt);
-		method = method_from_code(resource, code);
+		if (e->resource) {
+			return -EEXIST;
+		}
+
+		e->resource = resource;
+	}
+
+	return 0;
+}
+
+int zoap_handle_request_indexed(struct zoap_packet *pkt,
+				const struct zoap_resource_index *index,
+				const uip_ipaddr_t *addr, uint16_t port)
+{
+	struct zoap_option options[MAX_PATH_SEGMENTS];
+	struct zoap_resource *resource = index->root;
+	uint16_t parent = 0;
+	int count, i;
+
+	count = zoap_find_options(pkt, ZOAP_OPTION_URI_PATH, options,
+				  MAX_PATH_SEGMENTS);
+	if (count < 0) {
+		return -ENOENT;
+	}
 
-		if (!method) {
-			return 0;
+	for (i = 0; i < count; i++) {
+		uint16_t pos;
+
+		if (!index_find(index, parent, options[i].value,
+				options[i].len, &pos)) {
+			return -ENOENT;
 		}
 
-		return method(resource, pkt, addr, port);
+		parent = index->entries[pos].node;
+		resource = index->entries[pos].resource;
 	}
 
-	return -ENOENT;
+	if (!resource) {
+		return -ENOENT;
+	}
+
+	return call_method(resource, pkt, addr, port);
 }
 
 unsigned int zoap_option_value_to_int(const struct zoap_option *option)
@@ -565,13 +743,11 @@ unsigned int zoap_option_value_to_int(const struct zoap_option *option)
 	case 1:
 		return option->value[0];
 	case 2:
-		return (option->value[0] << 0) | (option->value[1] << 8);
+		return sys_get_be16(option->value);
 	case 3:
-		return (option->value[0] << 0) | (option->value[1] << 8) |
-			(option->value[2] << 16);
+		return (option->value[0] << 16) | sys_get_be16(&option->value[1]);
 	case 4:
-		return (option->value[0] << 0) | (option->value[1] << 8) |
-			(option->value[2] << 16) | (option->value[3] << 24);
+		return sys_get_be32(option->value);
 	default:
 		return 0;
 	}
@@ -608,6 +784,10 @@ struct zoap_reply *zoap_response_received(
 	for (i = 0, r = replies; i < len; i++, r++) {
 		int age;
 
+		if (!r->reply) {
+			continue;
+		}
+
 		if (r->tkl != tkl) {
 			continue;
 		}
@@ -678,6 +858,151 @@ int zoap_resource_notify(struct zoap_resource *resource)
 	return 0;
 }
 
+/*
+ * The part of a notification shared by all the observers: everything
+ * after the Observe option. Option deltas are relative to the previous
+ * option, so it can be copied as is after any Observe option.
+ */
+static int notification_tail(const struct zoap_packet *representation,
+			     const uint8_t **tail, uint16_t *len)
+{
+	struct net_buf *buf = representation->buf;
+	uint8_t *appdata = ip_buf_appdata(buf);
+	struct option_context context = { .delta = 0,
+					  .used = 0 };
+	int hdrlen, r;
+
+	hdrlen = coap_get_header_len(representation);
+	if (hdrlen < 0) {
+		return -EINVAL;
+	}
+
+	context.buflen = ip_buf_appdatalen(buf) - hdrlen;
+	context.buf = appdata + hdrlen;
+
+	r = coap_parse_option(representation, &context, NULL, NULL);
+	if (r <= 0 || context.delta != ZOAP_OPTION_OBSERVE) {
+		return -EINVAL;
+	}
+
+	*tail = appdata + hdrlen + context.used;
+	*len = ip_buf_appdatalen(buf) - (hdrlen + context.used);
+
+	return 0;
+}
+
+static int notify_observer(struct zoap_resource *resource,
+			   const struct zoap_notifier *notifier,
+			   struct zoap_observer *observer,
+			   uint8_t code, const uint8_t *tail, uint16_t len)
+{
+	struct zoap_packet pkt;
+	struct net_buf *buf;
+	int r;
+
+	buf = notifier->alloc(resource, observer);
+	if (!buf) {
+		return -ENOMEM;
+	}
+
+	r = zoap_packet_init(&pkt, buf);
+	if (r < 0) {
+		goto fail;
+	}
+
+	zoap_header_set_version(&pkt, 1);
+	zoap_header_set_type(&pkt, notifier->type);
+	zoap_header_set_code(&pkt, code);
+	zoap_header_set_id(&pkt, zoap_next_id());
+
+	r = zoap_header_set_token(&pkt, observer->token, observer->tkl);
+	if (r < 0) {
+		goto fail;
+	}
+
+	/* The sequence number is 24 bits wide */
+	r = zoap_add_option_int(&pkt, ZOAP_OPTION_OBSERVE,
+				resource->age & 0xFFFFFF);
+	if (r < 0) {
+		goto fail;
+	}
+
+	if (ip_buf_appdatalen(buf) + len > net_buf_tailroom(buf)) {
+		r = -ENOMEM;
+		goto fail;
+	}
+
+	memcpy((uint8_t *)ip_buf_appdata(buf) + ip_buf_appdatalen(buf),
+	       tail, len);
+	ip_buf_appdatalen(buf) += len;
+
+	return notifier->send(resource, observer, &pkt);
+
+fail:
+	net_buf_unref(buf);
+	return r;
+}
+
+int zoap_resource_flush(struct zoap_resource *resource,
+			const struct zoap_notifier *notifier,
+			const struct zoap_packet *representation)
+{
+	uint32_t now = sys_tick_get_32();
+	const uint8_t *tail;
+	sys_snode_t *node;
+	uint16_t len;
+	uint8_t code;
+	int r, pending = 0;
+
+	r = notification_tail(representation, &tail, &len);
+	if (r < 0) {
+		return r;
+	}
+
+	code = zoap_header_get_code(representation);
+
+	SYS_SLIST_FOR_EACH_NODE(&resource->observers, node) {
+		struct zoap_observer *o = (struct zoap_observer *) node;
+
+		if (!o->pending) {
+			continue;
+		}
+
+		if (now - o->last_notified < notifier->interval) {
+			pending++;
+			continue;
+		}
+
+		r = notify_observer(resource, notifier, o, code, tail, len);
+		if (r < 0) {
+			pending++;
+			continue;
+		}
+
+		o->pending = false;
+		o->last_notified = now;
+	}
+
+	return pending;
+}
+
+int zoap_resource_publish(struct zoap_resource *resource,
+			  const struct zoap_notifier *notifier,
+			  const struct zoap_packet *representation)
+{
+	sys_snode_t *node;
+
+	resource->age++;
+
+	SYS_SLIST_FOR_EACH_NODE(&resource->observers, node) {
+		struct zoap_observer *o = (struct zoap_observer *) node;
+
+		o->pending = true;
+	}
+
+	return zoap_resource_flush(resource, notifier, representation);
+}
+
 bool zoap_request_is_observe(const struct zoap_packet *request)
 {
 	return get_observe_option(request) == 0;
@@ -698,6 +1023,8 @@ void zoap_observer_init(struct zoap_observer *observer,
 	}
 
 	observer->tkl = tkl;
+	observer->pending = false;
+	observer->last_notified = sys_tick_get_32();
 
 	/* FIXME: new network stack */
 	uip_ipaddr_copy(&observer->addr, addr);
@@ -810,6 +1137,7 @@ int zoap_add_option(struct zoap_packet *pkt, uint16_t code,
 	}
 
 	ip_buf_appdatalen(buf) += r;
+	pkt->indexed = false;
 
 	return 0;
 }
@@ -822,15 +1150,15 @@ int zoap_add_option_int(struct zoap_packet *pkt, uint16_t code,
 	if (val == 0) {
 		data[0] = 0;
 		len = 0;
-	} else if (val < 0xFF) {
+	} else if (val <= 0xFF) {
 		data[0] = (uint8_t) val;
 		len = 1;
-	} else if (val < 0xFFFF) {
+	} else if (val <= 0xFFFF) {
 		sys_put_be16(val, data);
 		len = 2;
-	} else if (val < 0xFFFFFF) {
-		sys_put_be16(val, data);
-		data[2] = val >> 16;
+	} else if (val <= 0xFFFFFF) {
+		data[0] = val >> 16;
+		sys_put_be16(val, &data[1]);
 		len = 3;
 	} else {
 		sys_put_be32(val, data);
@@ -849,6 +1177,28 @@ int zoap_find_options(const struct zoap_packet *pkt, uint16_t code,
 	int hdrlen, count = 0;
 	uint16_t len;
 
+	if (pkt->indexed) {
+		uint8_t *appdata = ip_buf_appdata(buf);
+		int i;
+
+		/* Options are stored in numeric order */
+		for (i = 0; i < pkt->option_count && count < veclen; i++) {
+			if (pkt->options[i].code < code) {
+				continue;
+			}
+
+			if (pkt->options[i].code > code) {
+				break;
+			}
+
+			options[count].value = appdata + pkt->options[i].offset;
+			options[count].len = pkt->options[i].len;
+			count++;
+		}
+
+		return count;
+	}
+
 	hdrlen = coap_get_header_len(pkt);
 	if (hdrlen < 0) {
 		return -EINVAL;
@@ -880,6 +1230,344 @@ int zoap_find_options(const struct zoap_packet *pkt, uint16_t code,
 	return count;
 }
 
+#define BLOCK_NUM_MAX 0xFFFFF /* NUM is at most 20 bits */
+
+static bool is_request(const struct zoap_packet *pkt)
+{
+	uint8_t code = zoap_header_get_code(pkt);
+
+	return code != ZOAP_CODE_EMPTY && !(code & ~ZOAP_REQUEST_MASK);
+}
+
+/* Size of the payload of a received packet */
+static uint16_t received_payload_len(const struct zoap_packet *pkt)
+{
+	struct net_buf *buf = pkt->buf;
+
+	if (!pkt->start) {
+		return 0;
+	}
+
+	return ip_buf_appdatalen(buf) -
+		(pkt->start - (uint8_t *)ip_buf_appdata(buf));
+}
+
+static int add_block_option(struct zoap_packet *pkt, uint16_t code,
+			    size_t offset, enum zoap_block_size block_size,
+			    bool more)
+{
+	unsigned int num = offset / zoap_block_size_to_bytes(block_size);
+
+	if (num > BLOCK_NUM_MAX) {
+		return -EINVAL;
+	}
+
+	return zoap_add_option_int(pkt, code,
+				   (num << 4) | (more << 3) | block_size);
+}
+
+static int get_block_option(const struct zoap_packet *pkt, uint16_t code,
+			    unsigned int *num, bool *more,
+			    enum zoap_block_size *block_size)
+{
+	struct zoap_option option;
+	unsigned int val;
+	int r;
+
+	r = zoap_find_options(pkt, code, &option, 1);
+	if (r <= 0) {
+		return -ENOENT;
+	}
+
+	if (option.len > 3) {
+		return -EINVAL;
+	}
+
+	val = zoap_option_value_to_int(&option);
+
+	/* SZX 7 is reserved */
+	if ((val & 0x7) > ZOAP_BLOCK_1024) {
+		return -EINVAL;
+	}
+
+	*num = val >> 4;
+	*more = !!(val & 0x8);
+	*block_size = val & 0x7;
+
+	return 0;
+}
+
+int zoap_block_transfer_init(struct zoap_block_context *ctx,
+			     enum zoap_block_size block_size,
+			     size_t total_size)
+{
+	if (block_size > ZOAP_BLOCK_1024) {
+		return -EINVAL;
+	}
+
+	ctx->block_size = block_size;
+	ctx->total_size = total_size;
+	ctx->current = 0;
+	ctx->more = false;
+
+	return 0;
+}
+
+int zoap_add_block1_option(struct zoap_packet *pkt,
+			   struct zoap_block_context *ctx)
+{
+	bool more;
+
+	if (is_request(pkt)) {
+		more = ctx->current + zoap_block_size_to_bytes(ctx->block_size)
+			< ctx->total_size;
+	} else {
+		/* Acknowledge the block as the client described it */
+		more = ctx->more;
+	}
+
+	return add_block_option(pkt, ZOAP_OPTION_BLOCK1, ctx->current,
+				ctx->block_size, more);
+}
+
+int zoap_add_block2_option(struct zoap_packet *pkt,
+			   struct zoap_block_context *ctx)
+{
+	bool more = false;
+
+	if (!is_request(pkt)) {
+		more = ctx->current + zoap_block_size_to_bytes(ctx->block_size)
+			< ctx->total_size;
+	}
+
+	return add_block_option(pkt, ZOAP_OPTION_BLOCK2, ctx->current,
+				ctx->block_size, more);
+}
+
+int zoap_add_size1_option(struct zoap_packet *pkt,
+			  struct zoap_block_context *ctx)
+{
+	return zoap_add_option_int(pkt, ZOAP_OPTION_SIZE1, ctx->total_size);
+}
+
+int zoap_add_size2_option(struct zoap_packet *pkt,
+			  struct zoap_block_context *ctx)
+{
+	return zoap_add_option_int(pkt, ZOAP_OPTION_SIZE2, ctx->total_size);
+}
+
+int zoap_update_from_block(const struct zoap_packet *pkt,
+			   struct zoap_block_context *ctx)
+{
+	enum zoap_block_size block_size;
+	struct zoap_option option;
+	bool request = is_request(pkt);
+	bool found = false;
+	unsigned int num;
+	bool more;
+	int r;
+
+	r = zoap_find_options(pkt, request ? ZOAP_OPTION_SIZE1 :
+			      ZOAP_OPTION_SIZE2, &option, 1);
+	if (r > 0) {
+		ctx->total_size = zoap_option_value_to_int(&option);
+	}
+
+	r = get_block_option(pkt, ZOAP_OPTION_BLOCK1, &num, &more,
+			     &block_size);
+	if (r == -EINVAL) {
+		return r;
+	}
+
+	if (r == 0) {
+		found = true;
+
+		/*
+		 * In a request, this is the block being sent to us, taken
+		 * as is; in a response, the peer acknowledges our block and
+		 * may ask for smaller ones from now on.
+		 */
+		if (request) {
+			ctx->current = num * zoap_block_size_to_bytes(block_size);
+			ctx->block_size = block_size;
+		} else {
+			ctx->block_size = min(ctx->block_size, block_size);
+		}
+
+		ctx->more = more;
+	}
+
+	r = get_block_option(pkt, ZOAP_OPTION_BLOCK2, &num, &more,
+			     &block_size);
+	if (r == -EINVAL) {
+		return r;
+	}
+
+	if (r == 0) {
+		found = true;
+
+		/*
+		 * The offset is the one the peer meant, even if we end up
+		 * answering with smaller blocks.
+		 */
+		ctx->current = num * zoap_block_size_to_bytes(block_size);
+		ctx->block_size = min(ctx->block_size, block_size);
+
+		if (!request) {
+			ctx->more = more;
+		}
+	}
+
+	return found ? 0 : -ENOENT;
+}
+
+size_t zoap_next_block(struct zoap_block_context *ctx)
+{
+	if (!ctx->more) {
+		return 0;
+	}
+
+	ctx->current += zoap_block_size_to_bytes(ctx->block_size);
+
+	if (ctx->total_size && ctx->current >= ctx->total_size) {
+		return 0;
+	}
+
+	return ctx->current;
+}
+
+int zoap_block2_respond(struct zoap_resource *resource,
+			struct zoap_packet *response,
+			struct zoap_block_context *ctx,
+			zoap_block_read_t read)
+{
+	struct zoap_option option;
+	uint16_t size, len;
+	uint8_t *payload;
+	int count, r;
+
+	/*
+	 * Claim the M flag until we know this is the last block, and
+	 * patch it afterwards: the block only has to be produced once,
+	 * right into the response.
+	 */
+	r = add_block_option(response, ZOAP_OPTION_BLOCK2, ctx->current,
+			     ctx->block_size, true);
+	if (r < 0) {
+		return r;
+	}
+
+	if (ctx->current == 0 && ctx->total_size) {
+		r = zoap_add_size2_option(response, ctx);
+		if (r < 0) {
+			return r;
+		}
+	}
+
+	payload = zoap_packet_get_payload(response, &len);
+	if (!payload) {
+		return -ENOMEM;
+	}
+
+	size = zoap_block_size_to_bytes(ctx->block_size);
+	if (len < size) {
+		return -ENOMEM;
+	}
+
+	count = read(resource, ctx->current, payload, size);
+	if (count < 0) {
+		return count;
+	}
+
+	/*
+	 * A short block is the last one, and so is a full one reaching
+	 * the known size: no empty block should be asked for after it.
+	 */
+	if (count < size ||
+	    (ctx->total_size && ctx->current + count >= ctx->total_size)) {
+		r = zoap_find_options(response, ZOAP_OPTION_BLOCK2, &option, 1);
+		if (r <= 0) {
+			return -EINVAL;
+		}
+
+		option.value[option.len - 1] &= ~0x8;
+		ctx->more = false;
+	} else {
+		ctx->more = true;
+	}
+
+	return zoap_packet_set_used(response, count);
+}
+
+int zoap_block1_receive(struct zoap_resource *resource,
+			const struct zoap_packet *request,
+			struct zoap_block_context *ctx,
+			zoap_block_write_t write)
+{
+	struct zoap_block_context block = *ctx;
+	int r;
+
+	/* The context is only updated once the block is accepted */
+	r = zoap_update_from_block(request, &block);
+	if (r == -EINVAL) {
+		return r;
+	}
+
+	if (r == -ENOENT) {
+		/* Not block-wise: the whole representation at once */
+		block.current = 0;
+		block.more = false;
+	} else if (block.current != 0 && block.current != ctx->current &&
+		   !(ctx->more && block.current == ctx->current +
+		     zoap_block_size_to_bytes(ctx->block_size))) {
+		/* Blocks must follow the previous one, or repeat it */
+		return -EAGAIN;
+	}
+
+	*ctx = block;
+
+	return write(resource, ctx->current, request->start,
+		     received_payload_len(request), !ctx->more);
+}
+
+struct zoap_block_transfer *zoap_block_transfer_find(
+	struct zoap_block_transfer *transfers, size_t len,
+	const struct zoap_resource *resource,
+	const uip_ipaddr_t *addr, uint16_t port)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		struct zoap_block_transfer *t = &transfers[i];
+
+		if (t->resource == resource && t->port == port &&
+		    uip_ipaddr_cmp(&t->addr, addr)) {
+			return t;
+		}
+	}
+
+	return NULL;
+}
+
+struct zoap_block_transfer *zoap_block_transfer_next_unused(
+	struct zoap_block_transfer *transfers, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		if (!transfers[i].resource) {
+			return &transfers[i];
+		}
+	}
+
+	return NULL;
+}
+
+void zoap_block_transfer_clear(struct zoap_block_transfer *transfer)
+{
+	memset(transfer, 0, sizeof(*transfer));
+}
+
 uint8_t zoap_header_get_version(const struct zoap_packet *pkt)
 {
 	struct net_buf *buf = pkt->buf;
@@ -945,6 +1633,7 @@ uint8_t zoap_header_get_code(const struct zoap_packet *pkt)
 	case ZOAP_RESPONSE_CODE_VALID:
 	case ZOAP_RESPONSE_CODE_CHANGED:
 	case ZOAP_RESPONSE_CODE_CONTENT:
+	case ZOAP_RESPONSE_CODE_CONTINUE:
 	case ZOAP_RESPONSE_CODE_BAD_REQUEST:
 	case ZOAP_RESPONSE_CODE_UNAUTHORIZED:
 	case ZOAP_RESPONSE_CODE_BAD_OPTION:
@@ -952,6 +1641,7 @@ uint8_t zoap_header_get_code(const struct zoap_packet *pkt)
 	case ZOAP_RESPONSE_CODE_NOT_FOUND:
 	case ZOAP_RESPONSE_CODE_NOT_ALLOWED:
 	case ZOAP_RESPONSE_CODE_NOT_ACCEPTABLE:
+	case ZOAP_RESPONSE_CODE_INCOMPLETE:
 	case ZOAP_RESPONSE_CODE_PRECONDITION_FAILED:
 	case ZOAP_RESPONSE_CODE_REQUEST_TOO_LARGE:
 	case ZOAP_RESPONSE_CODE_INTERNAL_ERROR:
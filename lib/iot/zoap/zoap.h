@@ -30,6 +30,8 @@
 #include <contiki/ip/uip.h>
 
 #include <misc/slist.h>
+#include <misc/dlist.h>
+#include <misc/nano_work.h>
 
 /**
  * @brief Set of CoAP packet options we are aware of.
@@ -54,8 +56,12 @@ enum zoap_option_num {
 	ZOAP_OPTION_URI_QUERY = 15,
 	ZOAP_OPTION_ACCEPT = 17,
 	ZOAP_OPTION_LOCATION_QUERY = 20,
+	ZOAP_OPTION_BLOCK2 = 23,
+	ZOAP_OPTION_BLOCK1 = 27,
+	ZOAP_OPTION_SIZE2 = 28,
 	ZOAP_OPTION_PROXY_URI = 35,
-	ZOAP_OPTION_PROXY_SCHEME = 39
+	ZOAP_OPTION_PROXY_SCHEME = 39,
+	ZOAP_OPTION_SIZE1 = 60
 };
 
 /**
@@ -120,6 +126,7 @@ enum zoap_response_code {
 	ZOAP_RESPONSE_CODE_VALID = zoap_make_response_code(2, 3),
 	ZOAP_RESPONSE_CODE_CHANGED = zoap_make_response_code(2, 4),
 	ZOAP_RESPONSE_CODE_CONTENT = zoap_make_response_code(2, 5),
+	ZOAP_RESPONSE_CODE_CONTINUE = zoap_make_response_code(2, 31),
 	ZOAP_RESPONSE_CODE_BAD_REQUEST = zoap_make_response_code(4, 0),
 	ZOAP_RESPONSE_CODE_UNAUTHORIZED = zoap_make_response_code(4, 1),
 	ZOAP_RESPONSE_CODE_BAD_OPTION = zoap_make_response_code(4, 2),
@@ -127,6 +134,7 @@ enum zoap_response_code {
 	ZOAP_RESPONSE_CODE_NOT_FOUND = zoap_make_response_code(4, 4),
 	ZOAP_RESPONSE_CODE_NOT_ALLOWED = zoap_make_response_code(4, 5),
 	ZOAP_RESPONSE_CODE_NOT_ACCEPTABLE = zoap_make_response_code(4, 6),
+	ZOAP_RESPONSE_CODE_INCOMPLETE = zoap_make_response_code(4, 8),
 	ZOAP_RESPONSE_CODE_PRECONDITION_FAILED = zoap_make_response_code(4, 12),
 	ZOAP_RESPONSE_CODE_REQUEST_TOO_LARGE = zoap_make_response_code(4, 13),
 	ZOAP_RESPONSE_CODE_INTERNAL_ERROR = zoap_make_response_code(5, 0),
@@ -185,6 +193,17 @@ struct zoap_observer {
 	uint16_t port;
 	uint8_t token[8];
 	uint8_t tkl;
+	bool pending; /* A notification is owed to the observer */
+	uint32_t last_notified; /* In ticks */
+};
+
+/**
+ * Location of an option in a parsed CoAP packet.
+ */
+struct zoap_option_index {
+	uint16_t code;
+	uint16_t offset; /* Offset of the value in the packet */
+	uint16_t len;
 };
 
 /**
@@ -193,6 +212,14 @@ struct zoap_observer {
 struct zoap_packet {
 	struct net_buf *buf;
 	uint8_t *start; /* Start of the payload */
+	/*
+	 * Options found by zoap_packet_parse(), so that looking them up
+	 * doesn't parse the packet again. Only valid if 'indexed' is set,
+	 * packets with more options than fit are looked up by parsing.
+	 */
+	struct zoap_option_index options[CONFIG_ZOAP_OPTION_INDEX_SIZE];
+	uint8_t option_count;
+	bool indexed;
 };
 
 /**
@@ -352,12 +379,107 @@ int zoap_handle_request(struct zoap_packet *pkt,
 			struct zoap_resource *resources,
 			const uip_ipaddr_t *addr, uint16_t port);
 
+/**
+ * Entry of a resource index, one per distinct path segment.
+ */
+struct zoap_resource_index_entry {
+	uint32_t hash; /* Hash of the segment */
+	uint16_t parent; /* Node the segment leads from, 0 is the root */
+	uint16_t node; /* Node the segment leads to */
+	uint16_t len;
+	const char *segment;
+	struct zoap_resource *resource; /* Resource at 'node', if any */
+};
+
+/**
+ * Resources compiled into a trie of path segments by
+ * zoap_resource_index_build(). The entries are kept sorted by parent node
+ * and segment hash, so each segment of a request path is resolved with a
+ * binary search, whatever the number of resources.
+ */
+struct zoap_resource_index {
+	struct zoap_resource_index_entry *entries;
+	struct zoap_resource *root; /* Resource with an empty path, if any */
+	uint16_t size;
+	uint16_t used;
+};
+
+/**
+ * Compiles the NULL path terminated array of @a resources into @a index,
+ * using @a entries for storage. One entry is needed for each distinct path
+ * prefix, e.g. "a/b" and "a/c" need 3 entries. Resources may be nested,
+ * e.g. both "a" and "a/b" can be resources.
+ *
+ * @return 0 on success, -ENOMEM if @a size entries are not enough, -EEXIST
+ * if two resources have the same path.
+ */
+int zoap_resource_index_build(struct zoap_resource_index *index,
+			      struct zoap_resource_index_entry *entries,
+			      uint16_t size, struct zoap_resource *resources);
+
+/**
+ * When a request is received, call the appropriate method of the
+ * resource matching its path in @a index.
+ */
+int zoap_handle_request_indexed(struct zoap_packet *pkt,
+				const struct zoap_resource_index *index,
+				const uip_ipaddr_t *addr, uint16_t port);
+
 /**
  * Indicates that this resource was updated and that the @a notify callback
  * should be called for every registered observer.
  */
 int zoap_resource_notify(struct zoap_resource *resource);
 
+/**
+ * @brief How notifications are sent to the observers of a resource.
+ *
+ * Used by zoap_resource_publish() and zoap_resource_flush().
+ */
+struct zoap_notifier {
+	/*
+	 * Returns a buffer for a notification to @a observer, or NULL when
+	 * it cannot be sent now: the observer will get the value current
+	 * at the next flush.
+	 */
+	struct net_buf *(*alloc)(struct zoap_resource *resource,
+				 struct zoap_observer *observer);
+	/*
+	 * Sends the notification, which is then owned by the callback. On
+	 * error the buffer is released and the observer stays pending.
+	 */
+	int (*send)(struct zoap_resource *resource,
+		    struct zoap_observer *observer,
+		    struct zoap_packet *notification);
+	/* Minimum time between notifications to an observer, in ticks */
+	uint32_t interval;
+	/* ZOAP_TYPE_CON or ZOAP_TYPE_NON_CON */
+	uint8_t type;
+};
+
+/**
+ * Indicates that @a resource changed and is now represented by
+ * @a representation, whose first option must be an Observe option and
+ * which is serialized only once. Each observer gets a copy with its own
+ * message ID, token and Observe sequence number, unless it was notified
+ * less than the notifier's interval ago: it is then notified at a later
+ * zoap_resource_flush(), of the value current at that time only.
+ *
+ * Returns the number of observers still to be notified.
+ */
+int zoap_resource_publish(struct zoap_resource *resource,
+			  const struct zoap_notifier *notifier,
+			  const struct zoap_packet *representation);
+
+/**
+ * Notifies the observers of @a resource still owed a notification, and
+ * whose interval has elapsed, of @a representation. Returns the number
+ * of observers still to be notified.
+ */
+int zoap_resource_flush(struct zoap_resource *resource,
+			const struct zoap_notifier *notifier,
+			const struct zoap_packet *representation);
+
 /**
  * Returns if this request is enabling observing a resource.
  */
@@ -402,6 +524,174 @@ int zoap_add_option_int(struct zoap_packet *pkt, uint16_t code,
 int zoap_find_options(const struct zoap_packet *pkt, uint16_t code,
 		      struct zoap_option *options, uint16_t veclen);
 
+/**
+ * Block sizes, as encoded by the SZX field of the Block1 and Block2
+ * options (RFC 7959).
+ */
+enum zoap_block_size {
+	ZOAP_BLOCK_16,
+	ZOAP_BLOCK_32,
+	ZOAP_BLOCK_64,
+	ZOAP_BLOCK_128,
+	ZOAP_BLOCK_256,
+	ZOAP_BLOCK_512,
+	ZOAP_BLOCK_1024,
+};
+
+/**
+ * Returns the size in bytes of blocks of size @a block_size.
+ */
+static inline uint16_t zoap_block_size_to_bytes(
+	enum zoap_block_size block_size)
+{
+	return (1 << (block_size + 4));
+}
+
+/**
+ * @brief State of a block-wise transfer.
+ *
+ * One context is kept by each side for the duration of a transfer.
+ * 'current' is the offset of the block being exchanged, 'block_size'
+ * starts as the local preference and follows what the peer negotiated.
+ */
+struct zoap_block_context {
+	size_t total_size; /* Size of the representation, 0 if unknown */
+	size_t current;
+	enum zoap_block_size block_size;
+	bool more;
+};
+
+/**
+ * Type of the callback producing the block of a representation that
+ * starts at @a offset. It returns the number of bytes written to
+ * @a data, less than @a len only for the last block, or a negative
+ * error code.
+ */
+typedef int (*zoap_block_read_t)(struct zoap_resource *resource,
+				 size_t offset, uint8_t *data, uint16_t len);
+
+/**
+ * Type of the callback consuming the block of a representation that
+ * starts at @a offset, @a last is set for the final block.
+ */
+typedef int (*zoap_block_write_t)(struct zoap_resource *resource,
+				  size_t offset, const uint8_t *data,
+				  uint16_t len, bool last);
+
+/**
+ * Block-wise transfer in progress with a remote device, used by servers
+ * to keep a context per client.
+ */
+struct zoap_block_transfer {
+	struct zoap_block_context ctx;
+	struct zoap_resource *resource; /* NULL if unused */
+	uip_ipaddr_t addr;
+	uint16_t port;
+};
+
+/**
+ * Initializes the context of a block-wise transfer of a representation
+ * of @a total_size bytes (0 if unknown), using blocks of at most
+ * @a block_size.
+ */
+int zoap_block_transfer_init(struct zoap_block_context *ctx,
+			     enum zoap_block_size block_size,
+			     size_t total_size);
+
+/**
+ * Adds a Block1 option describing the current block of @a ctx: in a
+ * request, the block being sent, in a response, the block being
+ * acknowledged.
+ */
+int zoap_add_block1_option(struct zoap_packet *pkt,
+			   struct zoap_block_context *ctx);
+
+/**
+ * Adds a Block2 option describing the current block of @a ctx: in a
+ * request, the block being asked for, in a response, the block being
+ * sent.
+ */
+int zoap_add_block2_option(struct zoap_packet *pkt,
+			   struct zoap_block_context *ctx);
+
+/**
+ * Adds a Size1 option, announcing the total size of the representation
+ * sent in a request.
+ */
+int zoap_add_size1_option(struct zoap_packet *pkt,
+			  struct zoap_block_context *ctx);
+
+/**
+ * Adds a Size2 option, announcing the total size of the representation
+ * sent in a response.
+ */
+int zoap_add_size2_option(struct zoap_packet *pkt,
+			  struct zoap_block_context *ctx);
+
+/**
+ * Updates @a ctx from the Block1, Block2, Size1 and Size2 options of a
+ * received packet. Except for the blocks of a request, which are taken
+ * as sent, the block size never grows past the one @a ctx was
+ * initialized with, so the smaller of both preferences is used.
+ *
+ * Returns -ENOENT if the packet has no block option, -EINVAL if it is
+ * malformed.
+ */
+int zoap_update_from_block(const struct zoap_packet *pkt,
+			   struct zoap_block_context *ctx);
+
+/**
+ * Advances @a ctx to the next block, returns its offset, or 0 when the
+ * transfer is complete.
+ */
+size_t zoap_next_block(struct zoap_block_context *ctx);
+
+/**
+ * Builds the payload of a response carrying the current block of @a ctx
+ * of the representation of @a resource, asking @a read to produce it.
+ * @a ctx is usually updated from the request with
+ * zoap_update_from_block() first, so the response can re-use the
+ * request buffer. Options with codes up to Block2 must be added to
+ * @a response before, the payload is set when this returns.
+ */
+int zoap_block2_respond(struct zoap_resource *resource,
+			struct zoap_packet *response,
+			struct zoap_block_context *ctx,
+			zoap_block_read_t read);
+
+/**
+ * Passes the payload of a (possibly block-wise) request to @a write,
+ * checking that blocks arrive in sequence. Returns -EAGAIN if a block
+ * is missing, the request should then be answered with
+ * ZOAP_RESPONSE_CODE_INCOMPLETE. The response to a block of a
+ * transfer carries a Block1 option built with
+ * zoap_add_block1_option().
+ */
+int zoap_block1_receive(struct zoap_resource *resource,
+			const struct zoap_packet *request,
+			struct zoap_block_context *ctx,
+			zoap_block_write_t write);
+
+/**
+ * Returns the transfer of @a resource in progress with the remote
+ * device at @a addr and @a port, or NULL.
+ */
+struct zoap_block_transfer *zoap_block_transfer_find(
+	struct zoap_block_transfer *transfers, size_t len,
+	const struct zoap_resource *resource,
+	const uip_ipaddr_t *addr, uint16_t port);
+
+/**
+ * Returns the next available transfer context, or NULL.
+ */
+struct zoap_block_transfer *zoap_block_transfer_next_unused(
+	struct zoap_block_transfer *transfers, size_t len);
+
+/**
+ * Releases a transfer context.
+ */
+void zoap_block_transfer_clear(struct zoap_block_transfer *transfer);
+
 /**
  * Returns the version present in a CoAP packet.
  */
@@ -454,6 +744,114 @@ void zoap_header_set_code(struct zoap_packet *pkt, uint8_t code);
  */
 void zoap_header_set_id(struct zoap_packet *pkt, uint16_t id);
 
+#if defined(CONFIG_ZOAP_TRANSACTIONS)
+
+struct zoap_transaction;
+
+/**
+ * Type of the callback used by the transaction engine to (re)transmit
+ * the request of a transaction.
+ */
+typedef int (*zoap_transaction_send_t)(struct zoap_transaction *transaction);
+
+/**
+ * Type of the callback called when a transaction ends, with the response
+ * received, or NULL if the request timed out or was cancelled.
+ */
+typedef void (*zoap_transaction_done_t)(struct zoap_transaction *transaction,
+					const struct zoap_packet *response);
+
+/**
+ * @brief Request tracked by the transaction engine.
+ *
+ * The memory belongs to the application and must stay valid until the
+ * transaction is done.
+ */
+struct zoap_transaction {
+	struct zoap_packet request;
+	zoap_transaction_done_t done;
+	void *user_data;
+	sys_dnode_t node; /* Timer wheel slot or NSTART queue */
+	sys_snode_t id_node;
+	sys_snode_t token_node;
+	uint32_t expiry; /* In ticks */
+	uint16_t timeout; /* Current retransmission timeout, in ms */
+	uint16_t id;
+	uint8_t token[8];
+	uint8_t tkl;
+	uint8_t retries;
+	uint8_t state;
+};
+
+#define ZOAP_TRANSACTION_WHEEL_SIZE 64
+
+/**
+ * @brief CoAP transaction engine.
+ *
+ * Retransmits confirmable requests until they are acknowledged, and
+ * matches responses to the requests in O(1). At most 'nstart'
+ * confirmable requests are awaiting an acknowledgment at once (NSTART,
+ * RFC 7252 section 4.7), the others are queued.
+ */
+struct zoap_transactions {
+	struct nano_delayed_work work;
+	zoap_transaction_send_t send;
+	sys_slist_t ids[CONFIG_ZOAP_TRANSACTION_BUCKETS];
+	sys_slist_t tokens[CONFIG_ZOAP_TRANSACTION_BUCKETS];
+	sys_dlist_t wheel[ZOAP_TRANSACTION_WHEEL_SIZE];
+	sys_dlist_t queue;
+	uint32_t slot; /* Next wheel slot to expire */
+	uint16_t count;
+	uint16_t active;
+	uint16_t nstart;
+	bool ticking;
+};
+
+/**
+ * Initializes a transaction engine, @a send is used for all the
+ * (re)transmissions and @a nstart limits the number of confirmable
+ * requests awaiting an acknowledgment.
+ */
+void zoap_transactions_init(struct zoap_transactions *transactions,
+			    zoap_transaction_send_t send, uint16_t nstart);
+
+/**
+ * Starts tracking @a request, sending it now or once NSTART allows.
+ * Confirmable requests are retransmitted until acknowledged,
+ * @a done is called when the response arrives or the request times out.
+ */
+int zoap_transaction_start(struct zoap_transactions *transactions,
+			   struct zoap_transaction *transaction,
+			   const struct zoap_packet *request,
+			   zoap_transaction_done_t done, void *user_data);
+
+/**
+ * Matches a received packet against the outstanding transactions,
+ * by message ID for acknowledgments and resets, and by token for
+ * separate responses. Returns the transaction matched, or NULL.
+ */
+struct zoap_transaction *zoap_transaction_received(
+	struct zoap_transactions *transactions,
+	const struct zoap_packet *response);
+
+/**
+ * Stops tracking @a transaction, its done callback is called with no
+ * response.
+ */
+void zoap_transaction_cancel(struct zoap_transactions *transactions,
+			     struct zoap_transaction *transaction);
+
+#if defined(CONFIG_ZOAP_TRANSACTIONS_TEST)
+/**
+ * Advances the clock of the transaction engine by @a ms, expiring the
+ * retransmission timeouts as the timer would. Only for testing.
+ */
+void zoap_transactions_advance(struct zoap_transactions *transactions,
+			       uint32_t ms);
+#endif
+
+#endif /* CONFIG_ZOAP_TRANSACTIONS */
+
 static inline uint16_t zoap_next_id(void)
 {
 	static uint16_t message_id;
@@ -0,0 +1,518 @@
+/*
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Outstanding requests are kept in two hash tables, by message ID (to
+ * match acknowledgments and resets) and by token (to match separate
+ * responses), and in a timer wheel. Each wheel slot covers
+ * CONFIG_ZOAP_TRANSACTION_TICK milliseconds; a transaction expiring more
+ * than a wheel revolution ahead stays in its slot until the revolution
+ * it expires in.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include <nanokernel.h>
+#include <misc/util.h>
+
+#include "lib/random.h"
+
+#include "zoap.h"
+
+/* Transmission parameters, RFC 7252 section 4.8 */
+#define ACK_TIMEOUT 2000
+#define ACK_RANDOM_FACTOR_PERCENT 150
+#define MAX_RETRANSMIT 4
+#define MAX_TRANSMIT_WAIT 93000
+
+enum {
+	STATE_FREE,
+	STATE_QUEUED, /* Waiting for NSTART */
+	STATE_SENT, /* Confirmable, waiting for an acknowledgment */
+	STATE_WAITING, /* Waiting for a (separate) response */
+};
+
+#define BUCKETS CONFIG_ZOAP_TRANSACTION_BUCKETS
+#define WHEEL_SIZE ZOAP_TRANSACTION_WHEEL_SIZE
+
+static inline uint32_t ms_to_ticks(uint32_t ms)
+{
+	return max(1, ms * sys_clock_ticks_per_sec / MSEC_PER_SEC);
+}
+
+#define TICKS_PER_SLOT ms_to_ticks(CONFIG_ZOAP_TRANSACTION_TICK)
+
+#if defined(CONFIG_ZOAP_TRANSACTIONS_TEST)
+/* Only advanced by zoap_transactions_advance() */
+static uint32_t test_ticks;
+
+static inline uint32_t now_ticks(void)
+{
+	return test_ticks;
+}
+
+static inline void tick_submit(struct zoap_transactions *transactions)
+{
+}
+#else
+static inline uint32_t now_ticks(void)
+{
+	return sys_tick_get_32();
+}
+
+static inline void tick_submit(struct zoap_transactions *transactions)
+{
+	nano_delayed_work_submit(&transactions->work, TICKS_PER_SLOT);
+}
+#endif
+
+static uint16_t token_hash(const uint8_t *token, uint8_t tkl)
+{
+	uint32_t hash = 2166136261u;
+	uint8_t i;
+
+	for (i = 0; i < tkl; i++) {
+		hash = (hash ^ token[i]) * 16777619u;
+	}
+
+	return hash % BUCKETS;
+}
+
+static uint16_t initial_timeout(void)
+{
+	uint32_t spread = ACK_TIMEOUT * (ACK_RANDOM_FACTOR_PERCENT - 100) / 100;
+
+	return ACK_TIMEOUT + random_rand() % (spread + 1);
+}
+
+/* must be called with interrupts locked */
+static void wheel_add(struct zoap_transactions *transactions,
+		      struct zoap_transaction *transaction, uint32_t ticks)
+{
+	uint32_t now = now_ticks();
+	uint32_t slot;
+
+	transaction->expiry = now + ticks;
+
+	slot = transaction->expiry / TICKS_PER_SLOT;
+
+	/* Slots are expired once they are over, never the current one */
+	if ((int32_t)(slot - transactions->slot) < 0) {
+		slot = transactions->slot;
+	}
+
+	sys_dlist_append(&transactions->wheel[slot % WHEEL_SIZE],
+			 &transaction->node);
+}
+
+/* must be called with interrupts locked */
+static void track(struct zoap_transactions *transactions,
+		  struct zoap_transaction *transaction)
+{
+	sys_slist_append(&transactions->ids[transaction->id % BUCKETS],
+			 &transaction->id_node);
+	sys_slist_append(&transactions->tokens[token_hash(transaction->token,
+							  transaction->tkl)],
+			 &transaction->token_node);
+	transactions->count++;
+
+	if (!transactions->ticking) {
+		transactions->ticking = true;
+		transactions->slot = now_ticks() / TICKS_PER_SLOT;
+		tick_submit(transactions);
+	}
+}
+
+/* must be called with interrupts locked */
+static void untrack(struct zoap_transactions *transactions,
+		    struct zoap_transaction *transaction)
+{
+	sys_slist_find_and_remove(&transactions->ids[transaction->id % BUCKETS],
+				  &transaction->id_node);
+	sys_slist_find_and_remove(
+		&transactions->tokens[token_hash(transaction->token,
+						 transaction->tkl)],
+		&transaction->token_node);
+
+	if (transaction->state == STATE_SENT) {
+		transactions->active--;
+	}
+
+	/* Not linked while being expired */
+	if (transaction->node.next) {
+		sys_dlist_remove(&transaction->node);
+	}
+
+	transaction->state = STATE_FREE;
+	transactions->count--;
+}
+
+/*
+ * Moves the transaction to its next state, returns true if it has to
+ * be sent.
+ *
+ * must be called with interrupts locked
+ */
+static bool transmit(struct zoap_transactions *transactions,
+		     struct zoap_transaction *transaction)
+{
+	if (zoap_header_get_type(&transaction->request) != ZOAP_TYPE_CON) {
+		transaction->state = STATE_WAITING;
+		wheel_add(transactions, transaction,
+			  ms_to_ticks(MAX_TRANSMIT_WAIT));
+		return true;
+	}
+
+	if (transactions->active >= transactions->nstart) {
+		transaction->state = STATE_QUEUED;
+		sys_dlist_append(&transactions->queue, &transaction->node);
+		return false;
+	}
+
+	transactions->active++;
+	transaction->state = STATE_SENT;
+	transaction->timeout = initial_timeout();
+	wheel_add(transactions, transaction, ms_to_ticks(transaction->timeout));
+
+	return true;
+}
+
+/* Sends the queued transactions NSTART now allows */
+static void dequeue(struct zoap_transactions *transactions)
+{
+	while (true) {
+		struct zoap_transaction *transaction;
+		unsigned int key;
+
+		key = irq_lock();
+
+		if (transactions->active >= transactions->nstart ||
+		    sys_dlist_is_empty(&transactions->queue)) {
+			irq_unlock(key);
+			return;
+		}
+
+		transaction = CONTAINER_OF(sys_dlist_get(&transactions->queue),
+					   struct zoap_transaction, node);
+		transmit(transactions, transaction);
+
+		irq_unlock(key);
+
+		transactions->send(transaction);
+	}
+}
+
+static void finish(struct zoap_transactions *transactions,
+		   struct zoap_transaction *transaction,
+		   const struct zoap_packet *response)
+{
+	unsigned int key;
+
+	key = irq_lock();
+	untrack(transactions, transaction);
+	irq_unlock(key);
+
+	if (transaction->done) {
+		transaction->done(transaction, response);
+	}
+
+	dequeue(transactions);
+}
+
+static void expire(struct zoap_transactions *transactions,
+		   struct zoap_transaction *transaction)
+{
+	unsigned int key;
+
+	key = irq_lock();
+
+	if (transaction->state != STATE_SENT ||
+	    transaction->retries == MAX_RETRANSMIT) {
+		irq_unlock(key);
+		finish(transactions, transaction, NULL);
+		return;
+	}
+
+	transaction->retries++;
+	transaction->timeout *= 2;
+	wheel_add(transactions, transaction, ms_to_ticks(transaction->timeout));
+
+	irq_unlock(key);
+
+	transactions->send(transaction);
+}
+
+static void transactions_tick(struct nano_work *work)
+{
+	struct zoap_transactions *transactions =
+		CONTAINER_OF(work, struct zoap_transactions, work);
+	uint32_t now = now_ticks();
+	uint32_t current = now / TICKS_PER_SLOT;
+	sys_dlist_t expired;
+	sys_dnode_t *node;
+	unsigned int key;
+
+	sys_dlist_init(&expired);
+
+	key = irq_lock();
+
+	/* Nothing is left behind once the whole wheel has been visited */
+	if (current - transactions->slot > WHEEL_SIZE) {
+		transactions->slot = current - WHEEL_SIZE;
+	}
+
+	for (; transactions->slot != current; transactions->slot++) {
+		sys_dlist_t *slot;
+		sys_dnode_t *next;
+
+		slot = &transactions->wheel[transactions->slot % WHEEL_SIZE];
+
+		SYS_DLIST_FOR_EACH_NODE_SAFE(slot, node, next) {
+			struct zoap_transaction *transaction;
+
+			transaction = CONTAINER_OF(node,
+						   struct zoap_transaction,
+						   node);
+
+			/* Expiring on a later revolution of the wheel */
+			if ((int32_t)(transaction->expiry - now) > 0) {
+				continue;
+			}
+
+			sys_dlist_remove(node);
+			sys_dlist_append(&expired, node);
+		}
+	}
+
+	irq_unlock(key);
+
+	/*
+	 * Sending may yield, and the transactions still in the list be
+	 * answered meanwhile: they are removed from it then.
+	 */
+	while (true) {
+		key = irq_lock();
+		node = sys_dlist_get(&expired);
+		if (node) {
+			node->next = NULL;
+		}
+		irq_unlock(key);
+
+		if (!node) {
+			break;
+		}
+
+		expire(transactions,
+		       CONTAINER_OF(node, struct zoap_transaction, node));
+	}
+
+	key = irq_lock();
+
+	if (transactions->count) {
+		tick_submit(transactions);
+	} else {
+		transactions->ticking = false;
+	}
+
+	irq_unlock(key);
+}
+
+#if defined(CONFIG_ZOAP_TRANSACTIONS_TEST)
+void zoap_transactions_advance(struct zoap_transactions *transactions,
+			       uint32_t ms)
+{
+	uint32_t end = test_ticks + ms_to_ticks(ms);
+
+	/* One slot at a time, as the timer would */
+	while ((int32_t)(end - test_ticks) > 0) {
+		test_ticks += min(TICKS_PER_SLOT, end - test_ticks);
+
+		if (transactions->ticking) {
+			transactions_tick(&transactions->work.work);
+		}
+	}
+}
+#endif
+
+void zoap_transactions_init(struct zoap_transactions *transactions,
+			    zoap_transaction_send_t send, uint16_t nstart)
+{
+	int i;
+
+	memset(transactions, 0, sizeof(*transactions));
+
+	nano_delayed_work_init(&transactions->work, transactions_tick);
+	transactions->send = send;
+	transactions->nstart = nstart;
+
+	for (i = 0; i < BUCKETS; i++) {
+		sys_slist_init(&transactions->ids[i]);
+		sys_slist_init(&transactions->tokens[i]);
+	}
+
+	for (i = 0; i < WHEEL_SIZE; i++) {
+		sys_dlist_init(&transactions->wheel[i]);
+	}
+
+	sys_dlist_init(&transactions->queue);
+}
+
+int zoap_transaction_start(struct zoap_transactions *transactions,
+			   struct zoap_transaction *transaction,
+			   const struct zoap_packet *request,
+			   zoap_transaction_done_t done, void *user_data)
+{
+	const uint8_t *token;
+	unsigned int key;
+	bool send;
+
+	if (!transactions->nstart) {
+		return -EINVAL;
+	}
+
+	memset(transaction, 0, sizeof(*transaction));
+	memcpy(&transaction->request, request, sizeof(*request));
+	transaction->done = done;
+	transaction->user_data = user_data;
+	transaction->id = zoap_header_get_id(request);
+
+	token = zoap_header_get_token(request, &transaction->tkl);
+	if (transaction->tkl) {
+		memcpy(transaction->token, token, transaction->tkl);
+	}
+
+	key = irq_lock();
+	track(transactions, transaction);
+	send = transmit(transactions, transaction);
+	irq_unlock(key);
+
+	if (send) {
+		return transactions->send(transaction);
+	}
+
+	return 0;
+}
+
+/* must be called with interrupts locked */
+static struct zoap_transaction *find_by_id(
+	struct zoap_transactions *transactions, uint16_t id)
+{
+	sys_snode_t *node;
+
+	SYS_SLIST_FOR_EACH_NODE(&transactions->ids[id % BUCKETS], node) {
+		struct zoap_transaction *transaction;
+
+		transaction = CONTAINER_OF(node, struct zoap_transaction,
+					   id_node);
+		if (transaction->id == id) {
+			return transaction;
+		}
+	}
+
+	return NULL;
+}
+
+/* must be called with interrupts locked */
+static struct zoap_transaction *find_by_token(
+	struct zoap_transactions *transactions,
+	const uint8_t *token, uint8_t tkl)
+{
+	sys_snode_t *node;
+
+	SYS_SLIST_FOR_EACH_NODE(&transactions->tokens[token_hash(token, tkl)],
+				node) {
+		struct zoap_transaction *transaction;
+
+		transaction = CONTAINER_OF(node, struct zoap_transaction,
+					   token_node);
+		if (transaction->tkl == tkl &&
+		    !memcmp(transaction->token, token, tkl)) {
+			return transaction;
+		}
+	}
+
+	return NULL;
+}
+
+struct zoap_transaction *zoap_transaction_received(
+	struct zoap_transactions *transactions,
+	const struct zoap_packet *response)
+{
+	struct zoap_transaction *transaction;
+	uint8_t type = zoap_header_get_type(response);
+	uint8_t code = zoap_header_get_code(response);
+	const uint8_t *token;
+	unsigned int key;
+	uint8_t tkl;
+
+	key = irq_lock();
+
+	if (type == ZOAP_TYPE_ACK || type == ZOAP_TYPE_RESET) {
+		transaction = find_by_id(transactions,
+					 zoap_header_get_id(response));
+		if (!transaction || transaction->state == STATE_QUEUED) {
+			irq_unlock(key);
+			return NULL;
+		}
+
+		if (type == ZOAP_TYPE_ACK && code == ZOAP_CODE_EMPTY) {
+			/*
+			 * Stop retransmitting, the response will come
+			 * separately.
+			 */
+			if (transaction->state == STATE_SENT) {
+				transactions->active--;
+				transaction->state = STATE_WAITING;
+				sys_dlist_remove(&transaction->node);
+				wheel_add(transactions, transaction,
+					  ms_to_ticks(MAX_TRANSMIT_WAIT));
+			}
+
+			irq_unlock(key);
+
+			dequeue(transactions);
+
+			return transaction;
+		}
+	} else {
+		token = zoap_header_get_token(response, &tkl);
+
+		transaction = find_by_token(transactions, token, tkl);
+		if (!transaction || transaction->state == STATE_QUEUED) {
+			irq_unlock(key);
+			return NULL;
+		}
+	}
+
+	irq_unlock(key);
+
+	finish(transactions, transaction, response);
+
+	return transaction;
+}
+
+void zoap_transaction_cancel(struct zoap_transactions *transactions,
+			     struct zoap_transaction *transaction)
+{
+	if (transaction->state == STATE_FREE) {
+		return;
+	}
+
+	finish(transactions, transaction, NULL);
+}
@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file
+ * @brief Deferred system log
+ *
+ * Log messages are stored unformatted in a ring of fixed-size slots: the
+ * format string pointer, the arguments and a timestamp. Any context can put
+ * messages, without locking: a slot is reserved by advancing the head index
+ * with a compare-and-swap, and published by setting its format string last.
+ * A single consumer formats and outputs the messages in order, so logging
+ * does not wait for the console.
+ */
+
+/* get the log layout definitions, whatever the default level */
+#define SYS_LOG_LEVEL SYS_LOG_LEVEL_DEBUG
+#include <misc/sys_log.h>
+
+#include <nanokernel.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+
+#define NUM_MSGS CONFIG_SYS_LOG_DEFERRED_MSGS
+
+#if (NUM_MSGS & (NUM_MSGS - 1)) != 0
+#error "CONFIG_SYS_LOG_DEFERRED_MSGS must be a power of two"
+#endif
+
+struct log_msg {
+	/* format string, 0 while the slot is free or being written */
+	atomic_t fmt;
+	struct sys_log_domain *domain;
+	const char *func;
+	uint32_t timestamp;
+	int level;
+	int nargs;
+	uint32_t args[SYS_LOG_DEFERRED_MAX_ARGS];
+};
+
+static struct log_msg msgs[NUM_MSGS];
+
+/* free-running indexes: the ring holds (head - tail) messages */
+static atomic_t head;
+static atomic_t tail;
+
+static atomic_t dropped;
+static uint32_t dropped_reported;
+
+/* registered domains, linked through their next field */
+static atomic_t domains;
+
+static atomic_t processing;
+
+static void domain_register(struct sys_log_domain *domain)
+{
+	atomic_val_t first;
+
+	if (atomic_set(&domain->registered, 1)) {
+		return;
+	}
+
+	do {
+		first = atomic_get(&domains);
+		domain->next = (struct sys_log_domain *)first;
+	} while (!atomic_cas(&domains, first, (atomic_val_t)domain));
+}
+
+void _sys_log_put(struct sys_log_domain *domain, int level,
+		  const char *func, int nargs, const char *fmt, ...)
+{
+	struct log_msg *msg;
+	atomic_val_t index;
+	va_list ap;
+	int i;
+
+	if (unlikely(!atomic_get(&domain->registered))) {
+		domain_register(domain);
+	}
+
+	do {
+		index = atomic_get(&head);
+		if ((uint32_t)index - (uint32_t)atomic_get(&tail) >= NUM_MSGS) {
+			atomic_inc(&dropped);
+			return;
+		}
+	} while (!atomic_cas(&head, index,
+			     (atomic_val_t)((uint32_t)index + 1)));
+
+	msg = &msgs[(uint32_t)index & (NUM_MSGS - 1)];
+
+	msg->domain = domain;
+	msg->func = func;
+	msg->timestamp = sys_cycle_get_32();
+	msg->level = level;
+
+	/* the logging macros reject more at build time */
+	if (nargs > SYS_LOG_DEFERRED_MAX_ARGS) {
+		nargs = SYS_LOG_DEFERRED_MAX_ARGS;
+	}
+	msg->nargs = nargs;
+
+	va_start(ap, fmt);
+	for (i = 0; i < nargs; i++) {
+		msg->args[i] = va_arg(ap, uint32_t);
+	}
+	va_end(ap);
+
+	/* the consumer takes the message once its format string is set */
+	atomic_set(&msg->fmt, (atomic_val_t)fmt);
+}
+
+static void msg_output(struct log_msg *msg)
+{
+	const char *tag = "";
+	const char *color = "";
+	uint32_t *a = msg->args;
+
+	switch (msg->level) {
+	case SYS_LOG_LEVEL_ERROR:
+		tag = SYS_LOG_TAG_ERR;
+		color = SYS_LOG_COLOR_RED;
+		break;
+	case SYS_LOG_LEVEL_WARNING:
+		tag = SYS_LOG_TAG_WRN;
+		color = SYS_LOG_COLOR_YELLOW;
+		break;
+	case SYS_LOG_LEVEL_INFO:
+		tag = SYS_LOG_TAG_INF;
+		break;
+	default:
+		tag = SYS_LOG_TAG_DBG;
+		break;
+	}
+
+	/* [timestamp] [domain] [level] function: */
+	SYS_LOG_BACKEND_FN("[%u] [%s]%s %s: %s", msg->timestamp,
+			   msg->domain->name, tag, msg->func, color);
+
+	/* arguments the format does not use are ignored */
+	SYS_LOG_BACKEND_FN((const char *)msg->fmt, a[0], a[1], a[2], a[3],
+			   a[4], a[5], a[6], a[7]);
+
+	SYS_LOG_BACKEND_FN("%s%s", color[0] ? SYS_LOG_COLOR_OFF : "",
+			   msg->domain->newline ? "\n" : "");
+}
+
+int sys_log_process(void)
+{
+	struct log_msg *msg;
+	struct log_msg copy;
+	uint32_t lost;
+
+	/* there is a single consumer */
+	if (atomic_set(&processing, 1)) {
+		return 0;
+	}
+
+	lost = (uint32_t)atomic_get(&dropped) - dropped_reported;
+	if (lost) {
+		dropped_reported += lost;
+		SYS_LOG_BACKEND_FN("--- %u log messages dropped ---\n", lost);
+	}
+
+	msg = &msgs[(uint32_t)atomic_get(&tail) & (NUM_MSGS - 1)];
+
+	if (!atomic_get(&msg->fmt)) {
+		atomic_clear(&processing);
+		return 0;
+	}
+
+	/* free the slot before the slow part */
+	copy = *msg;
+	atomic_clear(&msg->fmt);
+	atomic_inc(&tail);
+
+	msg_output(&copy);
+
+	atomic_clear(&processing);
+
+	return 1;
+}
+
+int sys_log_level_set(const char *name, int level)
+{
+	struct sys_log_domain *domain;
+	int rc = -ENOENT;
+
+	/* several compile units can share a domain name */
+	for (domain = (struct sys_log_domain *)atomic_get(&domains);
+	     domain; domain = domain->next) {
+		if (strcmp(domain->name, name) == 0) {
+			domain->level = level;
+			rc = 0;
+		}
+	}
+
+	return rc;
+}
+
+uint32_t sys_log_dropped_get(void)
+{
+	return (uint32_t)atomic_get(&dropped);
+}
+
+#ifdef CONFIG_SYS_LOG_DEFERRED_THREAD
+
+static void sys_log_thread_main(void *p1, void *p2, void *p3)
+{
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	while (1) {
+		while (sys_log_process()) {
+			/* output everything logged so far */
+		}
+
+		k_sleep(CONFIG_SYS_LOG_DEFERRED_THREAD_PERIOD);
+	}
+}
+
+K_THREAD_DEFINE(_sys_log_thread, CONFIG_SYS_LOG_DEFERRED_THREAD_STACK_SIZE,
+		sys_log_thread_main, NULL, NULL, NULL,
+		NULL, K_LOWEST_APPLICATION_THREAD_PRIO, 0);
+
+#endif /* CONFIG_SYS_LOG_DEFERRED_THREAD */
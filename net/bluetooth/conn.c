@@ -25,6 +25,7 @@
 #include <atomic.h>
 #include <misc/byteorder.h>
 #include <misc/util.h>
+#include <misc/stack.h>
 #include <misc/nano_work.h>
 
 #include <bluetooth/log.h>
@@ -36,6 +37,7 @@
 
 #include "hci_core.h"
 #include "conn_internal.h"
+#include "conn_map.h"
 #include "l2cap_internal.h"
 #include "keys.h"
 #include "smp.h"
@@ -48,12 +50,22 @@
 
 /* Pool for outgoing ACL fragments */
 static struct nano_fifo frag_buf;
-static NET_BUF_POOL(frag_pool, 1, BT_L2CAP_BUF_SIZE(23), &frag_buf, NULL,
-		    BT_BUF_USER_DATA_MIN);
 
-/* Pool for dummy buffers to wake up the tx fibers */
-static struct nano_fifo dummy;
-static NET_BUF_POOL(dummy_pool, CONFIG_BLUETOOTH_MAX_CONN, 0, &dummy, NULL, 0);
+static void frag_destroy(struct net_buf *buf)
+{
+	nano_fifo_put(buf->free, buf);
+
+	/* A connection may be waiting for the fragment buffer */
+	bt_conn_notify_tx();
+}
+
+static NET_BUF_POOL(frag_pool, 1, BT_L2CAP_BUF_SIZE(23), &frag_buf,
+		    frag_destroy, BT_BUF_USER_DATA_MIN);
+
+/* Single fiber sending ACL data for all connections */
+static BT_STACK_NOINIT(conn_tx_fiber_stack, 256);
+static struct nano_sem tx_sem;
+static uint8_t tx_next;
 
 /* How long until we cancel HCI_LE_Create_Connection */
 #define CONN_TIMEOUT	(3 * sys_clock_ticks_per_sec)
@@ -63,8 +75,23 @@ const struct bt_conn_auth_cb *bt_auth;
 #endif /* CONFIG_BLUETOOTH_SMP || CONFIG_BLUETOOTH_BREDR */
 
 static struct bt_conn conns[CONFIG_BLUETOOTH_MAX_CONN];
+
+/* LE Create Connection timeouts. They are kept out of conns[] since the
+ * work item may still be queued when its connection object is reused.
+ */
+static struct conn_timeout {
+	struct nano_delayed_work work;
+
+	/* Set while the connection is in the CONNECT state */
+	bool armed;
+	uint32_t deadline;
+} conn_timeouts[CONFIG_BLUETOOTH_MAX_CONN];
 static struct bt_conn_cb *callback_list;
 
+/* Connections indexed by ACL handle and by peer address */
+static struct bt_conn_map handle_map;
+static struct bt_conn_map addr_map;
+
 #if defined(CONFIG_BLUETOOTH_BREDR)
 enum pairing_method {
 	LEGACY,			/* Legacy (pre-SSP) pairing */
@@ -153,9 +180,129 @@ static void le_conn_update(struct nano_work *work)
 	bt_conn_le_param_update(conn, param);
 }
 
+static inline uint8_t conn_index(struct bt_conn *conn)
+{
+	return conn - conns;
+}
+
+static void conn_timeout(struct nano_work *work)
+{
+	struct conn_timeout *timeout = CONTAINER_OF(work, struct conn_timeout,
+						    work);
+	struct bt_conn *conn = &conns[timeout - conn_timeouts];
+	int32_t ticks;
+
+	/* The timeout was stopped after its work item got queued */
+	if (!timeout->armed || conn->state != BT_CONN_CONNECT) {
+		return;
+	}
+
+	/* The work item was still queued for an earlier connection attempt
+	 * when this one started, so the timeout could not be submitted.
+	 */
+	ticks = timeout->deadline - sys_tick_get_32();
+	if (ticks > 0) {
+		nano_delayed_work_submit(&timeout->work, ticks);
+		return;
+	}
+
+	timeout->armed = false;
+
+	bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+}
+
+static void conn_timeout_start(struct bt_conn *conn)
+{
+	struct conn_timeout *timeout = &conn_timeouts[conn_index(conn)];
+
+	timeout->armed = true;
+	timeout->deadline = sys_tick_get_32() + CONN_TIMEOUT;
+	nano_delayed_work_submit(&timeout->work, CONN_TIMEOUT);
+}
+
+static void conn_timeout_stop(struct bt_conn *conn)
+{
+	struct conn_timeout *timeout = &conn_timeouts[conn_index(conn)];
+
+	timeout->armed = false;
+	nano_delayed_work_cancel(&timeout->work);
+}
+
+static inline const void *conn_dst(struct bt_conn *conn, size_t *len)
+{
+#if defined(CONFIG_BLUETOOTH_BREDR)
+	if (conn->type == BT_CONN_TYPE_BR) {
+		*len = sizeof(conn->br.dst);
+		return &conn->br.dst;
+	}
+#endif /* CONFIG_BLUETOOTH_BREDR */
+
+	*len = sizeof(conn->le.dst);
+	return &conn->le.dst;
+}
+
+static void conn_addr_map_update(struct bt_conn *conn)
+{
+	const void *dst;
+	unsigned int key;
+	size_t len;
+
+	dst = conn_dst(conn, &len);
+
+	key = irq_lock();
+	bt_conn_map_add(&addr_map, conn_index(conn),
+			bt_conn_map_hash(dst, len));
+	irq_unlock(key);
+}
+
+/*
+ * Look up a connection by peer address, optionally in the given state
+ * (state < 0 matches any state). Like the linear scan it replaces, this
+ * returns the match with the lowest index in conns[].
+ */
+static struct bt_conn *conn_lookup_addr(uint8_t type, const void *peer,
+					size_t len, int state)
+{
+	uint8_t i, found = BT_CONN_MAP_NONE;
+	unsigned int key;
+
+	key = irq_lock();
+
+	for (i = bt_conn_map_first(&addr_map, bt_conn_map_hash(peer, len));
+	     i != BT_CONN_MAP_NONE; i = bt_conn_map_next(&addr_map, i)) {
+		struct bt_conn *conn = &conns[i];
+		size_t dst_len;
+
+		if (!atomic_get(&conn->ref) || conn->type != type) {
+			continue;
+		}
+
+		if (state >= 0 && conn->state != state) {
+			continue;
+		}
+
+		if (memcmp(peer, conn_dst(conn, &dst_len), len)) {
+			continue;
+		}
+
+		if (i < found) {
+			found = i;
+		}
+	}
+
+	irq_unlock(key);
+
+	if (found == BT_CONN_MAP_NONE) {
+		return NULL;
+	}
+
+	return bt_conn_ref(&conns[found]);
+}
+
 static struct bt_conn *conn_new(void)
 {
 	struct bt_conn *conn = NULL;
+	unsigned int key;
 	int i;
 
 	for (i = 0; i < ARRAY_SIZE(conns); i++) {
@@ -169,6 +316,11 @@ static struct bt_conn *conn_new(void)
 		return NULL;
 	}
 
+	key = irq_lock();
+	bt_conn_map_remove(&handle_map, conn_index(conn));
+	bt_conn_map_remove(&addr_map, conn_index(conn));
+	irq_unlock(key);
+
 	memset(conn, 0, sizeof(*conn));
 
 	atomic_set(&conn->ref, 1);
@@ -231,23 +383,7 @@ struct bt_conn *bt_conn_create_br(const bt_addr_t *peer,
 
 struct bt_conn *bt_conn_lookup_addr_br(const bt_addr_t *peer)
 {
-	int i;
-
-	for (i = 0; i < ARRAY_SIZE(conns); i++) {
-		if (!atomic_get(&conns[i].ref)) {
-			continue;
-		}
-
-		if (conns[i].type != BT_CONN_TYPE_BR) {
-			continue;
-		}
-
-		if (!bt_addr_cmp(peer, &conns[i].br.dst)) {
-			return bt_conn_ref(&conns[i]);
-		}
-	}
-
-	return NULL;
+	return conn_lookup_addr(BT_CONN_TYPE_BR, peer, sizeof(*peer), -1);
 }
 
 struct bt_conn *bt_conn_add_br(const bt_addr_t *peer)
@@ -260,6 +396,7 @@ struct bt_conn *bt_conn_add_br(const bt_addr_t *peer)
 
 	bt_addr_copy(&conn->br.dst, peer);
 	conn->type = BT_CONN_TYPE_BR;
+	conn_addr_map_update(conn);
 
 	return conn;
 }
@@ -894,9 +1031,16 @@ int bt_conn_send(struct bt_conn *conn, struct net_buf *buf)
 	}
 
 	net_buf_put(&conn->tx_queue, buf);
+	bt_conn_notify_tx();
+
 	return 0;
 }
 
+void bt_conn_notify_tx(void)
+{
+	nano_sem_give(&tx_sem);
+}
+
 static bool send_frag(struct bt_conn *conn, struct net_buf *buf, uint8_t flags,
 		      bool always_consume)
 {
@@ -906,14 +1050,6 @@ static bool send_frag(struct bt_conn *conn, struct net_buf *buf, uint8_t flags,
 	BT_DBG("conn %p buf %p len %u flags 0x%02x", conn, buf, buf->len,
 	       flags);
 
-	/* Wait until the controller can accept ACL packets */
-	nano_fiber_sem_take(bt_conn_get_pkts(conn), TICKS_UNLIMITED);
-
-	/* Check for disconnection while waiting for pkts_sem */
-	if (conn->state != BT_CONN_CONNECTED) {
-		goto fail;
-	}
-
 	hdr = net_buf_push(buf, sizeof(*hdr));
 	hdr->handle = sys_cpu_to_le16(bt_acl_handle_pack(conn->handle, flags));
 	hdr->len = sys_cpu_to_le16(buf->len - sizeof(*hdr));
@@ -953,10 +1089,11 @@ static struct net_buf *create_frag(struct bt_conn *conn, struct net_buf *buf)
 	struct net_buf *frag;
 	uint16_t frag_len;
 
-	frag = bt_conn_create_pdu(&frag_buf, 0);
-
-	if (conn->state != BT_CONN_CONNECTED) {
-		net_buf_unref(frag);
+	/* Don't block, the fiber serves the other connections meanwhile */
+	frag = net_buf_get_timeout(&frag_buf, sizeof(struct bt_hci_acl_hdr) +
+				   CONFIG_BLUETOOTH_HCI_SEND_RESERVE,
+				   TICKS_NONE);
+	if (!frag) {
 		return NULL;
 	}
 
@@ -968,78 +1105,135 @@ static struct net_buf *create_frag(struct bt_conn *conn, struct net_buf *buf)
 	return frag;
 }
 
-static bool send_buf(struct bt_conn *conn, struct net_buf *buf)
+/*
+ * Send the next ACL packet, or fragment of it, queued for the connection.
+ * Returns false if there is nothing to send, or the controller has no free
+ * buffer for this link type, or the fragment buffer is in use, so that the
+ * caller can move on to the next connection instead of blocking.
+ */
+static bool conn_tx_one(struct bt_conn *conn)
 {
-	struct net_buf *frag;
+	struct net_buf *buf, *frag;
+	uint8_t flags;
 
-	BT_DBG("conn %p buf %p len %u", conn, buf, buf->len);
+	if (!conn->tx_buf) {
+		conn->tx_buf = net_buf_get_timeout(&conn->tx_queue, 0,
+						   TICKS_NONE);
+		if (!conn->tx_buf) {
+			return false;
+		}
 
-	/* Send directly if the packet fits the ACL MTU */
-	if (buf->len <= conn_mtu(conn)) {
-		return send_frag(conn, buf, BT_ACL_START_NO_FLUSH, false);
+		conn->tx_flags = BT_ACL_START_NO_FLUSH;
 	}
 
-	/* Create & enqueue first fragment */
-	frag = create_frag(conn, buf);
-	if (!frag) {
+	if (!nano_fiber_sem_take(bt_conn_get_pkts(conn), TICKS_NONE)) {
 		return false;
 	}
 
-	if (!send_frag(conn, frag, BT_ACL_START_NO_FLUSH, true)) {
-		return false;
-	}
+	buf = conn->tx_buf;
+	flags = conn->tx_flags;
+
+	BT_DBG("conn %p buf %p len %u", conn, buf, buf->len);
 
 	/*
-	 * Send the fragments. For the last one simply use the original
-	 * buffer (which works since we've used net_buf_pull on it.
+	 * Send the remainder directly if it fits the ACL MTU. This also
+	 * covers the last fragment, since we've used net_buf_pull on the
+	 * original buffer.
 	 */
-	while (buf->len > conn_mtu(conn)) {
-		frag = create_frag(conn, buf);
-		if (!frag) {
-			return false;
+	if (buf->len <= conn_mtu(conn)) {
+		conn->tx_buf = NULL;
+		if (!send_frag(conn, buf, flags, false)) {
+			net_buf_unref(buf);
 		}
 
-		if (!send_frag(conn, frag, BT_ACL_CONT, true)) {
-			return false;
-		}
+		return true;
 	}
 
-	return send_frag(conn, buf, BT_ACL_CONT, false);
-}
+	frag = create_frag(conn, buf);
+	if (!frag) {
+		/* Try again once the fragment buffer is freed */
+		nano_fiber_sem_give(bt_conn_get_pkts(conn));
+		return false;
+	}
 
-static void conn_tx_fiber(int arg1, int arg2)
-{
-	struct bt_conn *conn = (struct bt_conn *)arg1;
-	struct net_buf *buf;
+	if (!send_frag(conn, frag, flags, true)) {
+		goto drop;
+	}
 
-	BT_DBG("Started for handle %u", conn->handle);
+	conn->tx_flags = BT_ACL_CONT;
+	return true;
 
-	while (conn->state == BT_CONN_CONNECTED) {
-		/* Get next ACL packet for connection */
-		buf = net_buf_get_timeout(&conn->tx_queue, 0, TICKS_UNLIMITED);
-		if (conn->state != BT_CONN_CONNECTED) {
-			net_buf_unref(buf);
-			break;
-		}
+drop:
+	/* The rest of the packet can't be sent without the first part */
+	conn->tx_buf = NULL;
+	net_buf_unref(buf);
+	return true;
+}
 
-		if (!send_buf(conn, buf)) {
-			net_buf_unref(buf);
-		}
-	}
+/*
+ * Drop the data queued for a connection that is no longer connected. The
+ * TX fiber only serves connected connections, and it never blocks while
+ * serving one, so it is not using the connection meanwhile.
+ */
+static void conn_tx_cleanup(struct bt_conn *conn)
+{
+	struct net_buf *buf;
 
 	BT_DBG("handle %u disconnected - cleaning up", conn->handle);
 
 	/* Give back any allocated buffers */
+	if (conn->tx_buf) {
+		net_buf_unref(conn->tx_buf);
+		conn->tx_buf = NULL;
+	}
+
 	while ((buf = net_buf_get_timeout(&conn->tx_queue, 0, TICKS_NONE))) {
 		net_buf_unref(buf);
 	}
 
-	BT_ASSERT(!conn->pending_pkts);
+	/* Check stack usage (no-op if not enabled) */
+	stack_analyze("conn tx stack", conn_tx_fiber_stack,
+		      sizeof(conn_tx_fiber_stack));
+}
+
+/*
+ * Serve the connections round-robin, one ACL packet or fragment per
+ * connection at a time, so that a connection with a lot of queued data
+ * (or one whose link type has run out of controller buffers) does not
+ * hold back the others.
+ */
+static void conn_tx_fiber(int arg1, int arg2)
+{
+	ARG_UNUSED(arg1);
+	ARG_UNUSED(arg2);
 
-	bt_conn_reset_rx_state(conn);
+	while (1) {
+		bool progress = false;
+		int i;
 
-	BT_DBG("handle %u exiting", conn->handle);
-	bt_conn_unref(conn);
+		for (i = 0; i < ARRAY_SIZE(conns); i++) {
+			struct bt_conn *conn;
+
+			conn = &conns[(tx_next + i) % ARRAY_SIZE(conns)];
+
+			if (conn->state != BT_CONN_CONNECTED) {
+				continue;
+			}
+
+			if (conn_tx_one(conn)) {
+				progress = true;
+			}
+		}
+
+		tx_next = (tx_next + 1) % ARRAY_SIZE(conns);
+
+		/* Wait for new data or free controller or fragment
+		 * buffers.
+		 */
+		if (!progress) {
+			nano_fiber_sem_take(&tx_sem, TICKS_UNLIMITED);
+		}
+	}
 }
 
 struct bt_conn *bt_conn_add_le(const bt_addr_le_t *peer)
@@ -1051,6 +1245,7 @@ struct bt_conn *bt_conn_add_le(const bt_addr_le_t *peer)
 	}
 
 	bt_addr_le_copy(&conn->le.dst, peer);
+	conn_addr_map_update(conn);
 #if defined(CONFIG_BLUETOOTH_SMP)
 	conn->sec_level = BT_SECURITY_LOW;
 	conn->required_sec_level = BT_SECURITY_LOW;
@@ -1063,21 +1258,11 @@ struct bt_conn *bt_conn_add_le(const bt_addr_le_t *peer)
 	return conn;
 }
 
-static void timeout_fiber(int arg1, int arg2)
-{
-	struct bt_conn *conn = (struct bt_conn *)arg1;
-
-	ARG_UNUSED(arg2);
-
-	conn->timeout = NULL;
-
-	bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
-	bt_conn_unref(conn);
-}
 
 void bt_conn_set_state(struct bt_conn *conn, bt_conn_state_t state)
 {
 	bt_conn_state_t old_state;
+	unsigned int key;
 
 	BT_DBG("%s -> %s", state2str(conn->state), state2str(state));
 
@@ -1099,14 +1284,13 @@ void bt_conn_set_state(struct bt_conn *conn, bt_conn_state_t state)
 		bt_conn_ref(conn);
 		break;
 	case BT_CONN_CONNECT:
-		if (conn->timeout) {
-			fiber_delayed_start_cancel(conn->timeout);
-			conn->timeout = NULL;
-
-			/* Drop the reference taken by timeout fiber */
-			bt_conn_unref(conn);
+		if (conn->type == BT_CONN_TYPE_LE) {
+			conn_timeout_stop(conn);
 		}
 		break;
+	case BT_CONN_CONNECTED:
+		conn_tx_cleanup(conn);
+		break;
 	default:
 		break;
 	}
@@ -1115,23 +1299,27 @@ void bt_conn_set_state(struct bt_conn *conn, bt_conn_state_t state)
 	switch (conn->state) {
 	case BT_CONN_CONNECTED:
 		nano_fifo_init(&conn->tx_queue);
-		fiber_start(conn->stack, sizeof(conn->stack), conn_tx_fiber,
-			    (int)bt_conn_ref(conn), 0, 7, 0);
+		conn->tx_buf = NULL;
+
+		key = irq_lock();
+		bt_conn_map_add(&handle_map, conn_index(conn), conn->handle);
+		irq_unlock(key);
 
 		bt_l2cap_connected(conn);
 		notify_connected(conn);
 		break;
 	case BT_CONN_DISCONNECTED:
-		/* Notify disconnection and queue a dummy buffer to wake
-		 * up and stop the tx fiber for states where it was
-		 * running.
+		/* Notify disconnection for states where the connection
+		 * was established.
 		 */
 		if (old_state == BT_CONN_CONNECTED ||
 		    old_state == BT_CONN_DISCONNECT) {
 			bt_l2cap_disconnected(conn);
 			notify_disconnected(conn);
 
-			net_buf_put(&conn->tx_queue, net_buf_get(&dummy, 0));
+			key = irq_lock();
+			bt_conn_map_remove(&handle_map, conn_index(conn));
+			irq_unlock(key);
 		} else if (old_state == BT_CONN_CONNECT) {
 			/* conn->err will be set in this case */
 			notify_connected(conn);
@@ -1140,6 +1328,9 @@ void bt_conn_set_state(struct bt_conn *conn, bt_conn_state_t state)
 			notify_connected(conn);
 		}
 
+		/* Drop any partially received L2CAP packet */
+		bt_conn_reset_rx_state(conn);
+
 		/* Return any unacknowledged packets */
 		while (conn->pending_pkts) {
 			nano_fiber_sem_give(bt_conn_get_pkts(conn));
@@ -1168,11 +1359,7 @@ void bt_conn_set_state(struct bt_conn *conn, bt_conn_state_t state)
 		}
 
 		/* Add LE Create Connection timeout */
-		conn->timeout = fiber_delayed_start(conn->stack,
-						    sizeof(conn->stack),
-						    timeout_fiber,
-						    (int)bt_conn_ref(conn),
-						    0, 7, 0, CONN_TIMEOUT);
+		conn_timeout_start(conn);
 		break;
 	case BT_CONN_DISCONNECT:
 		break;
@@ -1185,9 +1372,14 @@ void bt_conn_set_state(struct bt_conn *conn, bt_conn_state_t state)
 
 struct bt_conn *bt_conn_lookup_handle(uint16_t handle)
 {
-	int i;
+	struct bt_conn *conn = NULL;
+	unsigned int key;
+	uint8_t i;
 
-	for (i = 0; i < ARRAY_SIZE(conns); i++) {
+	key = irq_lock();
+
+	for (i = bt_conn_map_first(&handle_map, handle);
+	     i != BT_CONN_MAP_NONE; i = bt_conn_map_next(&handle_map, i)) {
 		if (!atomic_get(&conns[i].ref)) {
 			continue;
 		}
@@ -1199,32 +1391,19 @@ struct bt_conn *bt_conn_lookup_handle(uint16_t handle)
 		}
 
 		if (conns[i].handle == handle) {
-			return bt_conn_ref(&conns[i]);
+			conn = &conns[i];
+			break;
 		}
 	}
 
-	return NULL;
+	irq_unlock(key);
+
+	return conn ? bt_conn_ref(conn) : NULL;
 }
 
 struct bt_conn *bt_conn_lookup_addr_le(const bt_addr_le_t *peer)
 {
-	int i;
-
-	for (i = 0; i < ARRAY_SIZE(conns); i++) {
-		if (!atomic_get(&conns[i].ref)) {
-			continue;
-		}
-
-		if (conns[i].type != BT_CONN_TYPE_LE) {
-			continue;
-		}
-
-		if (!bt_addr_le_cmp(peer, &conns[i].le.dst)) {
-			return bt_conn_ref(&conns[i]);
-		}
-	}
-
-	return NULL;
+	return conn_lookup_addr(BT_CONN_TYPE_LE, peer, sizeof(*peer), -1);
 }
 
 struct bt_conn *bt_conn_lookup_state_le(const bt_addr_le_t *peer,
@@ -1232,6 +1411,11 @@ struct bt_conn *bt_conn_lookup_state_le(const bt_addr_le_t *peer,
 {
 	int i;
 
+	if (peer) {
+		return conn_lookup_addr(BT_CONN_TYPE_LE, peer, sizeof(*peer),
+					state);
+	}
+
 	for (i = 0; i < ARRAY_SIZE(conns); i++) {
 		if (!atomic_get(&conns[i].ref)) {
 			continue;
@@ -1241,10 +1425,6 @@ struct bt_conn *bt_conn_lookup_state_le(const bt_addr_le_t *peer,
 			continue;
 		}
 
-		if (peer && bt_addr_le_cmp(peer, &conns[i].le.dst)) {
-			continue;
-		}
-
 		if (conns[i].state == state) {
 			return bt_conn_ref(&conns[i]);
 		}
@@ -1253,6 +1433,12 @@ struct bt_conn *bt_conn_lookup_state_le(const bt_addr_le_t *peer,
 	return NULL;
 }
 
+void bt_conn_set_dst_le(struct bt_conn *conn, const bt_addr_le_t *dst)
+{
+	bt_addr_le_copy(&conn->le.dst, dst);
+	conn_addr_map_update(conn);
+}
+
 struct bt_conn *bt_conn_ref(struct bt_conn *conn)
 {
 	atomic_inc(&conn->ref);
@@ -1329,13 +1515,7 @@ static int bt_hci_disconnect(struct bt_conn *conn, uint8_t reason)
 
 static int bt_hci_connect_le_cancel(struct bt_conn *conn)
 {
-	if (conn->timeout) {
-		fiber_delayed_start_cancel(conn->timeout);
-		conn->timeout = NULL;
-
-		/* Drop the reference took by timeout fiber */
-		bt_conn_unref(conn);
-	}
+	conn_timeout_stop(conn);
 
 	return bt_hci_cmd_send(BT_HCI_OP_LE_CREATE_CONN_CANCEL, NULL);
 }
@@ -1698,10 +1878,20 @@ static void background_scan_init(void)
 
 int bt_conn_init(void)
 {
-	int err;
+	int err, i;
 
 	net_buf_pool_init(frag_pool);
-	net_buf_pool_init(dummy_pool);
+
+	for (i = 0; i < ARRAY_SIZE(conn_timeouts); i++) {
+		nano_delayed_work_init(&conn_timeouts[i].work, conn_timeout);
+	}
+
+	bt_conn_map_init(&handle_map);
+	bt_conn_map_init(&addr_map);
+
+	nano_sem_init(&tx_sem);
+	fiber_start(conn_tx_fiber_stack, sizeof(conn_tx_fiber_stack),
+		    conn_tx_fiber, 0, 0, 7, 0);
 
 	bt_att_init();
 
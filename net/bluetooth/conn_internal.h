@@ -96,6 +96,10 @@ struct bt_conn {
 	/* Queue for outgoing ACL data */
 	struct nano_fifo	tx_queue;
 
+	/* ACL packet being fragmented and flags for its next fragment */
+	struct net_buf		*tx_buf;
+	uint8_t			tx_flags;
+
 	/* L2CAP channels */
 	void			*channels;
 
@@ -106,21 +110,12 @@ struct bt_conn {
 
 	bt_conn_state_t		state;
 
-	/* Handle allowing to cancel timeout fiber */
-	nano_thread_id_t timeout;
-
 	union {
 		struct bt_conn_le	le;
 #if defined(CONFIG_BLUETOOTH_BREDR)
 		struct bt_conn_br	br;
 #endif
 	};
-
-	/* Stack for TX fiber and timeout fiber.
-	 * Since these fibers don't overlap, one stack can be used by
-	 * both of them.
-	 */
-	BT_STACK(stack, 256);
 };
 
 /* Process incoming data for a connection */
@@ -129,6 +124,9 @@ void bt_conn_recv(struct bt_conn *conn, struct net_buf *buf, uint8_t flags);
 /* Send data over a connection */
 int bt_conn_send(struct bt_conn *conn, struct net_buf *buf);
 
+/* Wake up the ACL TX fiber, e.g. when the controller has freed buffers */
+void bt_conn_notify_tx(void);
+
 /* Add a new LE connection */
 struct bt_conn *bt_conn_add_le(const bt_addr_le_t *peer);
 
@@ -154,6 +152,9 @@ struct bt_conn *bt_conn_lookup_handle(uint16_t handle);
 struct bt_conn *bt_conn_lookup_state_le(const bt_addr_le_t *peer,
 					const bt_conn_state_t state);
 
+/* Update the peer address of an LE connection, e.g. once resolved */
+void bt_conn_set_dst_le(struct bt_conn *conn, const bt_addr_le_t *dst);
+
 /* Set connection object in certain state and perform action related to state */
 void bt_conn_set_state(struct bt_conn *conn, bt_conn_state_t state);
 
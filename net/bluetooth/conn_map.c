@@ -0,0 +1,73 @@
+/* conn_map.c - Bluetooth connection lookup tables */
+
+/*
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "conn_map.h"
+
+void bt_conn_map_init(struct bt_conn_map *map)
+{
+	memset(map->head, BT_CONN_MAP_NONE, sizeof(map->head));
+	memset(map->next, BT_CONN_MAP_NONE, sizeof(map->next));
+	memset(map->bucket, BT_CONN_MAP_NONE, sizeof(map->bucket));
+}
+
+void bt_conn_map_remove(struct bt_conn_map *map, uint8_t index)
+{
+	uint8_t *link;
+
+	if (map->bucket[index] == BT_CONN_MAP_NONE) {
+		return;
+	}
+
+	for (link = &map->head[map->bucket[index]];
+	     *link != BT_CONN_MAP_NONE; link = &map->next[*link]) {
+		if (*link == index) {
+			*link = map->next[index];
+			break;
+		}
+	}
+
+	map->next[index] = BT_CONN_MAP_NONE;
+	map->bucket[index] = BT_CONN_MAP_NONE;
+}
+
+void bt_conn_map_add(struct bt_conn_map *map, uint8_t index, uint32_t hash)
+{
+	uint8_t bucket = hash & (BT_CONN_MAP_BUCKETS - 1);
+
+	bt_conn_map_remove(map, index);
+
+	map->next[index] = map->head[bucket];
+	map->head[bucket] = index;
+	map->bucket[index] = bucket;
+}
+
+uint32_t bt_conn_map_hash(const void *addr, size_t len)
+{
+	const uint8_t *p = addr;
+	uint32_t hash = 2166136261u;
+
+	/* FNV-1a */
+	while (len--) {
+		hash ^= *p++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
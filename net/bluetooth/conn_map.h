@@ -0,0 +1,78 @@
+/** @file
+ *  @brief Connection lookup tables.
+ */
+
+/*
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * A connection map is a chained hash table of indexes into the connection
+ * array, keyed by a 32-bit hash (the ACL handle, or a hash of the peer
+ * address). Each connection is in at most one bucket of a given map.
+ *
+ * Connections sharing a bucket are not necessarily a match: walk the chain
+ * with bt_conn_map_first()/bt_conn_map_next() and compare the actual key.
+ * The map only stores indexes, so callers provide the locking.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Power of two, at least twice the number of connections */
+#if CONFIG_BLUETOOTH_MAX_CONN <= 2
+#define BT_CONN_MAP_BUCKETS	4
+#elif CONFIG_BLUETOOTH_MAX_CONN <= 8
+#define BT_CONN_MAP_BUCKETS	16
+#elif CONFIG_BLUETOOTH_MAX_CONN <= 16
+#define BT_CONN_MAP_BUCKETS	32
+#else
+#define BT_CONN_MAP_BUCKETS	128
+#endif
+
+/* End of chain, or connection not in the map */
+#define BT_CONN_MAP_NONE	0xff
+
+struct bt_conn_map {
+	uint8_t	head[BT_CONN_MAP_BUCKETS];
+	uint8_t	next[CONFIG_BLUETOOTH_MAX_CONN];
+	uint8_t	bucket[CONFIG_BLUETOOTH_MAX_CONN];
+};
+
+/* Initialize an empty map */
+void bt_conn_map_init(struct bt_conn_map *map);
+
+/* Add connection index to the map, moving it if it was already there */
+void bt_conn_map_add(struct bt_conn_map *map, uint8_t index, uint32_t hash);
+
+/* Remove connection index from the map, if present */
+void bt_conn_map_remove(struct bt_conn_map *map, uint8_t index);
+
+/* First connection index in the bucket for the hash */
+static inline uint8_t bt_conn_map_first(const struct bt_conn_map *map,
+					uint32_t hash)
+{
+	return map->head[hash & (BT_CONN_MAP_BUCKETS - 1)];
+}
+
+/* Next connection index in the same bucket */
+static inline uint8_t bt_conn_map_next(const struct bt_conn_map *map,
+				       uint8_t index)
+{
+	return map->next[index];
+}
+
+/* Hash a peer address */
+uint32_t bt_conn_map_hash(const void *addr, size_t len);
@@ -553,6 +553,8 @@ static void hci_num_completed_packets(struct net_buf *buf)
 			nano_fiber_sem_give(bt_conn_get_pkts(conn));
 		}
 
+		bt_conn_notify_tx();
+
 		bt_conn_unref(conn);
 	}
 }
@@ -609,7 +611,6 @@ static void hci_disconn_complete(struct net_buf *buf)
 	stack_analyze("rx stack", rx_fiber_stack, sizeof(rx_fiber_stack));
 	stack_analyze("cmd tx stack", cmd_tx_fiber_stack,
 		      sizeof(cmd_tx_fiber_stack));
-	stack_analyze("conn tx stack", conn->stack, sizeof(conn->stack));
 
 	bt_conn_set_state(conn, BT_CONN_DISCONNECTED);
 	conn->handle = 0;
@@ -740,7 +741,7 @@ static void le_conn_complete(struct net_buf *buf)
 	}
 
 	conn->handle   = handle;
-	bt_addr_le_copy(&conn->le.dst, id_addr);
+	bt_conn_set_dst_le(conn, id_addr);
 	conn->le.interval = sys_le16_to_cpu(evt->interval);
 	conn->le.latency = sys_le16_to_cpu(evt->latency);
 	conn->le.timeout = sys_le16_to_cpu(evt->supv_timeout);
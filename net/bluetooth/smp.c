@@ -2982,7 +2982,7 @@ static uint8_t smp_ident_addr_info(struct bt_smp *smp, struct net_buf *buf)
 			 */
 			if (!bt_addr_le_is_identity(&conn->le.dst)) {
 				bt_addr_le_copy(&keys->addr, &req->addr);
-				bt_addr_le_copy(&conn->le.dst, &req->addr);
+				bt_conn_set_dst_le(conn, &req->addr);
 
 				bt_conn_identity_resolved(conn);
 			}
@@ -113,6 +113,12 @@ struct neighbor_queue {
   struct ctimer transmit_timer;
   uint8_t transmissions;
   uint8_t collisions, deferrals;
+  /* The RDC layer is sending a burst from this queue */
+  uint8_t sending;
+  /* A retransmission of the head of the queue is scheduled */
+  uint8_t rexmit_pending;
+  /* Counts the packets that left the queue */
+  uint8_t completed;
   LIST_STRUCT(queued_packet_list);
 };
 
@@ -138,6 +144,87 @@ MEMB(metadata_memb, struct qbuf_metadata, MAX_QUEUED_PACKETS);
 static void packet_sent(struct net_buf *buf, void *ptr, int status, int num_transmissions);
 static void transmit_packet_list(struct net_buf *buf, void *ptr);
 
+#if NET_MAC_CONF_STATS
+/* The number of neighbors statistics are kept for */
+#ifdef CSMA_CONF_STATS_NEIGHBORS
+#define CSMA_STATS_NEIGHBORS CSMA_CONF_STATS_NEIGHBORS
+#elif defined(NBR_TABLE_CONF_MAX_NEIGHBORS)
+#define CSMA_STATS_NEIGHBORS NBR_TABLE_CONF_MAX_NEIGHBORS
+#else
+#define CSMA_STATS_NEIGHBORS 8
+#endif /* CSMA_CONF_STATS_NEIGHBORS */
+
+static csma_neighbor_stats_t neighbor_stats[CSMA_STATS_NEIGHBORS];
+
+/*---------------------------------------------------------------------------*/
+static unsigned int
+stats_hash(const linkaddr_t *addr)
+{
+  unsigned int i, hash = 0;
+
+  for(i = 0; i < LINKADDR_SIZE; i++) {
+    hash = hash * 31 + addr->u8[i];
+  }
+  return hash % CSMA_STATS_NEIGHBORS;
+}
+/*---------------------------------------------------------------------------*/
+/* Open addressing with linear probing. Entries are never removed; when
+   the table is full, the neighbor takes over its home slot. */
+static csma_neighbor_stats_t *
+stats_lookup(const linkaddr_t *addr, int create)
+{
+  unsigned int home = stats_hash(addr);
+  unsigned int i, slot;
+
+  for(i = 0; i < CSMA_STATS_NEIGHBORS; i++) {
+    slot = (home + i) % CSMA_STATS_NEIGHBORS;
+    if(!neighbor_stats[slot].used) {
+      break;
+    }
+    if(linkaddr_cmp(&neighbor_stats[slot].addr, addr)) {
+      return &neighbor_stats[slot];
+    }
+  }
+
+  if(!create) {
+    return NULL;
+  }
+
+  if(i == CSMA_STATS_NEIGHBORS) {
+    slot = home;
+  }
+  memset(&neighbor_stats[slot], 0, sizeof(neighbor_stats[slot]));
+  linkaddr_copy(&neighbor_stats[slot].addr, addr);
+  neighbor_stats[slot].used = 1;
+  return &neighbor_stats[slot];
+}
+/*---------------------------------------------------------------------------*/
+const csma_neighbor_stats_t *
+csma_neighbor_stats(const linkaddr_t *addr)
+{
+  return stats_lookup(addr, 0);
+}
+/*---------------------------------------------------------------------------*/
+const csma_neighbor_stats_t *
+csma_neighbor_stats_get(int index)
+{
+  int i;
+
+  for(i = 0; i < CSMA_STATS_NEIGHBORS; i++) {
+    if(neighbor_stats[i].used && index-- == 0) {
+      return &neighbor_stats[i];
+    }
+  }
+  return NULL;
+}
+#define CSMA_STAT(addr, code) do {                              \
+    csma_neighbor_stats_t *s = stats_lookup(addr, 1);           \
+    code;                                                       \
+  } while(0)
+#else /* NET_MAC_CONF_STATS */
+#define CSMA_STAT(addr, code)
+#endif /* NET_MAC_CONF_STATS */
+
 /*---------------------------------------------------------------------------*/
 static struct neighbor_queue *
 neighbor_queue_from_addr(struct net_buf *buf, const linkaddr_t *addr)
@@ -179,6 +266,8 @@ free_packet(struct net_buf *buf, struct neighbor_queue *n, struct rdc_buf_list *
     queuebuf_free(p->buf);
     memb_free(&metadata_memb, p->ptr);
     memb_free(&packet_memb, p);
+    n->completed++;
+    CSMA_STAT(&n->addr, s->queued--);
     PRINTF("csma: free_queued_packet, queue length %d, free packets %d\n",
            list_length(n->queued_packet_list), memb_numfree(&packet_memb));
     if(list_head(n->queued_packet_list) != NULL) {
@@ -186,8 +275,12 @@ free_packet(struct net_buf *buf, struct neighbor_queue *n, struct rdc_buf_list *
       n->transmissions = 0;
       n->collisions = 0;
       n->deferrals = 0;
-      transmit_packet_list(buf, n);
-    } else {
+      /* Within a burst, transmit_packet_list() goes on with the next
+         packet once the RDC layer returns. */
+      if(!n->sending) {
+        transmit_packet_list(buf, n);
+      }
+    } else if(!n->sending) {
       /* This was the last packet in the queue, we free the neighbor */
       list_remove(uip_neighbor_list(buf), n);
       memb_free(&neighbor_memb, n);
@@ -195,19 +288,41 @@ free_packet(struct net_buf *buf, struct neighbor_queue *n, struct rdc_buf_list *
   }
 }
 /*---------------------------------------------------------------------------*/
+/* Sends the queued packets of a neighbor back to back, without a
+   backoff in between. The RDC layer may send the whole list in one
+   go or stop after any packet; we hand it the rest of the list until
+   the queue is empty, a packet waits for its retransmission or the
+   RDC layer did not get any packet out of the queue. */
 static void
 transmit_packet_list(struct net_buf *buf, void *ptr)
 {
   struct neighbor_queue *n = ptr;
-  if(n) {
-    struct rdc_buf_list *q = list_head(n->queued_packet_list);
-    if(q != NULL) {
-      PRINTF("csma: preparing number %d %p, queue len %d\n", n->transmissions, q,
-          list_length(n->queued_packet_list));
-      /* Send packets in the neighbor's list */
-      NETSTACK_RDC.send_list(buf, packet_sent, n, q);
+  struct rdc_buf_list *q;
+  uint8_t completed;
+
+  if(n == NULL) {
+    return;
+  }
+
+  n->rexmit_pending = 0;
+  n->sending = 1;
+  while((q = list_head(n->queued_packet_list)) != NULL) {
+    PRINTF("csma: preparing number %d %p, queue len %d\n", n->transmissions, q,
+        list_length(n->queued_packet_list));
+    completed = n->completed;
+    /* Send packets in the neighbor's list */
+    NETSTACK_RDC.send_list(buf, packet_sent, n, q);
+    if(n->rexmit_pending || n->completed == completed) {
+      break;
     }
   }
+  n->sending = 0;
+
+  if(list_head(n->queued_packet_list) == NULL) {
+    /* All packets sent, we free the neighbor */
+    list_remove(uip_neighbor_list(buf), n);
+    memb_free(&neighbor_memb, n);
+  }
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -229,12 +344,17 @@ packet_sent(struct net_buf *buf, void *ptr, int status, int num_transmissions)
   }
   switch(status) {
   case MAC_TX_OK:
+    n->transmissions += num_transmissions;
+    CSMA_STAT(&n->addr, s->sent++);
+    break;
   case MAC_TX_NOACK:
     n->transmissions += num_transmissions;
+    CSMA_STAT(&n->addr, s->noacks++);
     break;
   case MAC_TX_COLLISION:
     n->collisions += num_transmissions;
     n->transmissions += num_transmissions;
+    CSMA_STAT(&n->addr, s->collisions++);
     break;
   case MAC_TX_DEFERRED:
     n->deferrals += num_transmissions;
@@ -300,12 +420,14 @@ packet_sent(struct net_buf *buf, void *ptr, int status, int num_transmissions)
           PRINTF("csma: retransmitting with time %lu %p\n", time, q);
           ctimer_set(buf, &n->transmit_timer, time,
                      transmit_packet_list, n);
+          n->rexmit_pending = 1;
           /* This is needed to correctly attribute energy that we spent
              transmitting this packet. */
           queuebuf_update_attr_from_packetbuf(buf, q->buf);
         } else {
           PRINTF("csma: drop with status %d after %d transmissions, %d collisions\n",
                  status, n->transmissions, n->collisions);
+          CSMA_STAT(&n->addr, s->dropped++);
           free_packet(buf, n, q);
           mac_call_sent_callback(buf, sent, cptr, status, num_tx);
         }
@@ -314,6 +436,7 @@ packet_sent(struct net_buf *buf, void *ptr, int status, int num_transmissions)
           PRINTF("csma: rexmit ok %d\n", n->transmissions);
         } else {
           PRINTF("csma: rexmit failed %d: %d\n", n->transmissions, status);
+          CSMA_STAT(&n->addr, s->dropped++);
         }
         free_packet(buf, n, q);
         mac_call_sent_callback(buf, sent, cptr, status, num_tx);
@@ -364,6 +487,9 @@ send_packet(struct net_buf *buf, mac_callback_t sent, bool last_fragment, void *
       n->transmissions = 0;
       n->collisions = 0;
       n->deferrals = 0;
+      n->sending = 0;
+      n->rexmit_pending = 0;
+      n->completed = 0;
       /* Init packet list for this neighbor */
       LIST_STRUCT_INIT(n, queued_packet_list);
       /* Add neighbor to the list */
@@ -399,11 +525,18 @@ send_packet(struct net_buf *buf, mac_callback_t sent, bool last_fragment, void *
               list_add(n->queued_packet_list, q);
             }
 
+            CSMA_STAT(addr, {
+                s->queued++;
+                if(s->queued > s->max_queued) {
+                  s->max_queued = s->queued;
+                }
+              });
+
             PRINTF("csma: send_packet, queue length %d, free packets %d\n",
                    list_length(n->queued_packet_list), memb_numfree(&packet_memb));
             /* if received packet is last fragment/only one packet start sending
              * packets in list, do not start any timer.*/
-            if (last_fragment) {
+            if (last_fragment && !n->sending && !n->rexmit_pending) {
                transmit_packet_list(buf, n);
             }
             return 1;
@@ -415,7 +548,7 @@ send_packet(struct net_buf *buf, mac_callback_t sent, bool last_fragment, void *
         PRINTF("csma: could not allocate queuebuf, dropping packet\n");
       }
       /* The packet allocation failed. Remove and free neighbor entry if empty. */
-      if(list_length(n->queued_packet_list) == 0) {
+      if(list_length(n->queued_packet_list) == 0 && !n->sending) {
         list_remove(uip_neighbor_list(buf), n);
         memb_free(&neighbor_memb, n);
       }
@@ -426,6 +559,7 @@ send_packet(struct net_buf *buf, mac_callback_t sent, bool last_fragment, void *
   } else {
     PRINTF("csma: could not allocate neighbor, dropping packet\n");
   }
+  CSMA_STAT(addr, s->dropped++);
   mac_call_sent_callback(buf, sent, ptr, MAC_TX_ERR, 1);
   return 0;
 }
@@ -465,6 +599,9 @@ init(void)
   memb_init(&packet_memb);
   memb_init(&metadata_memb);
   memb_init(&neighbor_memb);
+#if NET_MAC_CONF_STATS
+  memset(neighbor_stats, 0, sizeof(neighbor_stats));
+#endif
 }
 /*---------------------------------------------------------------------------*/
 const struct mac_driver csma_driver = {
@@ -42,10 +42,33 @@
 #define CSMA_H_
 
 #include "contiki/mac/mac.h"
+#include "contiki/linkaddr.h"
 #include "dev/radio.h"
 
 extern const struct mac_driver csma_driver;
 
+#if NET_MAC_CONF_STATS
+/* Transmit statistics of a neighbor */
+typedef struct csma_neighbor_stats {
+  linkaddr_t addr;
+  uint8_t used;
+  uint8_t queued;      /* packets queued right now */
+  uint8_t max_queued;  /* highest queue depth seen */
+  uint32_t sent;       /* packets acknowledged or sent as broadcast */
+  uint32_t dropped;    /* packets dropped before or after transmission */
+  uint16_t collisions;
+  uint16_t noacks;
+} csma_neighbor_stats_t;
+
+/* Returns the statistics of the neighbor with the given address, or
+   NULL if nothing has been sent to it. */
+const csma_neighbor_stats_t *csma_neighbor_stats(const linkaddr_t *addr);
+
+/* Returns the statistics of the index'th known neighbor, or NULL when
+   index is past the last one. */
+const csma_neighbor_stats_t *csma_neighbor_stats_get(int index);
+#endif /* NET_MAC_CONF_STATS */
+
 const struct mac_driver *csma_init(const struct mac_driver *r);
 
 #endif /* CSMA_H_ */
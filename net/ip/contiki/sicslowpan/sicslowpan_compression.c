@@ -1036,6 +1036,9 @@ static int uncompress(struct net_buf *buf)
      uip_len(buf) += (uip_uncomp_hdr_len(mbuf) - uip_packetbuf_hdr_len(mbuf));
      ip_buf_len(buf) += (uip_uncomp_hdr_len(mbuf) - uip_packetbuf_hdr_len(mbuf));
 #endif
+
+  uip_compressed_hdr_len(buf) = uip_packetbuf_hdr_len(mbuf);
+  uip_uncompressed_hdr_len(buf) = uip_uncomp_hdr_len(mbuf);
 #endif
 
   l2_buf_unref(mbuf);
@@ -152,219 +152,269 @@ static int last_rssi;
 /** Datagram tag to be put in the fragments I send. */
 static uint16_t my_tag;
 
-/* This needs to be defined in NBR / Nodes depending on available RAM   */
-/*   and expected reassembly requirements                               */
-#ifdef SICSLOWPAN_CONF_FRAGMENT_BUFFERS
-#define SICSLOWPAN_FRAGMENT_BUFFERS SICSLOWPAN_CONF_FRAGMENT_BUFFERS
-#else
-#define SICSLOWPAN_FRAGMENT_BUFFERS 16
-#endif
-
 /* REASS_CONTEXTS corresponds to the number of simultaneous             */
-/* reassemblys that can be made.                                        */
+/* reassemblys that can be made. Each one holds an IP buffer from the    */
+/* RX pool while in progress.                                           */
 #ifdef SICSLOWPAN_CONF_REASS_CONTEXTS
 #define SICSLOWPAN_REASS_CONTEXTS SICSLOWPAN_CONF_REASS_CONTEXTS
 #else
-#define SICSLOWPAN_REASS_CONTEXTS 2
-#endif
-
-/* The size of each fragment (IP payload) for the 6lowpan fragmentation */
-#ifdef SICSLOWPAN_CONF_FRAGMENT_SIZE
-#define SICSLOWPAN_FRAGMENT_SIZE SICSLOWPAN_CONF_FRAGMENT_SIZE
-#else
-#define SICSLOWPAN_FRAGMENT_SIZE 110
+#define SICSLOWPAN_REASS_CONTEXTS 4
 #endif
 
 /* Assuming that the worst growth for uncompression is 38 bytes */
-#define SICSLOWPAN_FIRST_FRAGMENT_SIZE (SICSLOWPAN_FRAGMENT_SIZE + 38)
+#define SICSLOWPAN_MAX_HDR_GROWTH 38
 
-/* all information needed for reassembly */
+/* Fragment offsets are in units of 8 octets */
+#define SICSLOWPAN_FRAG_BLOCKS ((UIP_BUFSIZE + 7) / 8)
+
+/*
+ * All information needed for reassembly. Fragments are copied once,
+ * straight to their place in the IP buffer of the context, and the
+ * blocks they cover are tracked in a bitmap so that holes, duplicates
+ * and out-of-order arrival are handled.
+ *
+ * The first fragment holds the compressed headers, so the offset at
+ * which the subsequent fragments start (in uncompressed packet terms)
+ * is not known until uncompression. The packet may be complete when the
+ * first fragment has been received and the subsequent ones cover all
+ * the blocks from the lowest offset received to the end of the packet,
+ * provided that this lowest offset is within the header growth of the
+ * end of the first fragment. It is only delivered if, once uncompressed,
+ * the first fragment ends exactly at that offset.
+ */
 struct sicslowpan_frag_info {
+  /** IP buffer the fragments are reassembled in, NULL if unused */
+  struct net_buf *buf;
   /** When reassembling, the source address of the fragments being merged */
   linkaddr_t sender;
-  /** The destination address of the fragments being merged */
-  linkaddr_t receiver;
   /** When reassembling, the tag in the fragments being merged. */
   uint16_t tag;
   /** Total length of the fragmented packet */
   uint16_t len;
-  /** Current length of reassembled fragments */
-  uint16_t reassembled_len;
-  /** Last fragment */
-  uint8_t last_fragment;
+  /** Stored length of the first fragment, zero until it is received */
+  uint16_t first_len;
+  /** Lowest block covered by a subsequent fragment */
+  uint8_t min_block;
+  /** Number of blocks covered by subsequent fragments */
+  uint8_t blocks;
+  /** Blocks covered by subsequent fragments */
+  uint8_t map[(SICSLOWPAN_FRAG_BLOCKS + 7) / 8];
   /** Reassembly %process %timer. */
   struct timer reass_timer;
 };
 
 static struct sicslowpan_frag_info frag_info[SICSLOWPAN_REASS_CONTEXTS];
 
-struct sicslowpan_frag_buf {
-  /* the index of the frag_info */
-  uint8_t index;
-  /* Fragment offset */
-  uint8_t offset;
-  /* Length of this fragment (if zero this buffer is not allocated) */
-  uint8_t len;
-  uint8_t data[SICSLOWPAN_FRAGMENT_SIZE];
-};
-
-static struct sicslowpan_frag_buf frag_buf[SICSLOWPAN_FRAGMENT_BUFFERS];
-
 /*---------------------------------------------------------------------------*/
-static int
-clear_fragments(uint8_t frag_info_index)
+static void
+clear_fragments(struct sicslowpan_frag_info *info)
 {
-  int i, clear_count;
-  clear_count = 0;
-  frag_info[frag_info_index].len = 0;
-  for(i = 0; i < SICSLOWPAN_FRAGMENT_BUFFERS; i++) {
-    if(frag_buf[i].len > 0 && frag_buf[i].index == frag_info_index) {
-      /* deallocate the buffer */
-      frag_buf[i].len = 0;
-      clear_count++;
-    }
+  if(info->buf) {
+    ip_buf_unref(info->buf);
   }
-  return clear_count;
+  memset(info, 0, sizeof(*info));
 }
 /*---------------------------------------------------------------------------*/
-static int
-store_fragment(struct net_buf *mbuf, uint8_t index, uint8_t offset)
+/* find the reassembly context of a fragment, or start a new one */
+static struct sicslowpan_frag_info *
+get_context(struct net_buf *mbuf, uint16_t tag, uint16_t frag_size)
 {
+  struct sicslowpan_frag_info *found = NULL;
   int i;
-  for(i = 0; i < SICSLOWPAN_FRAGMENT_BUFFERS; i++) {
-    if(frag_buf[i].len == 0) {
-      /* copy over the data from packetbuf into the fragment buffer
-       * and store offset and len */
-      frag_buf[i].offset = offset; /* frag offset */
-      frag_buf[i].len = packetbuf_datalen(mbuf) - uip_packetbuf_hdr_len(mbuf);
-      frag_buf[i].index = index;
-      memcpy(frag_buf[i].data, uip_packetbuf_ptr(mbuf) + uip_packetbuf_hdr_len(mbuf),
-             packetbuf_datalen(mbuf) - uip_packetbuf_hdr_len(mbuf));
-
-      PRINTF("Fragment payload length: %d\n", frag_buf[i].len);
-      /* return the length of the stored fragment */
-      return frag_buf[i].len;
+
+  for(i = 0; i < SICSLOWPAN_REASS_CONTEXTS; i++) {
+    if(frag_info[i].buf && frag_info[i].tag == tag &&
+       linkaddr_cmp(&frag_info[i].sender,
+                    packetbuf_addr(mbuf, PACKETBUF_ADDR_SENDER))) {
+      /* Tag and Sender match - this must be the correct info to store in */
+      if(frag_info[i].len != frag_size) {
+        PRINTF("*** Fragment size mismatch - tag: %d\n", tag);
+        return NULL;
+      }
+      return &frag_info[i];
     }
   }
-  /* failed */
-  return -1;
+
+  for(i = 0; i < SICSLOWPAN_REASS_CONTEXTS; i++) {
+    /* clear all fragment info with expired timer to free all IP buffers */
+    if(frag_info[i].buf && timer_expired(&frag_info[i].reass_timer)) {
+      PRINTF("*** Reassembly timed out - tag: %d\n", frag_info[i].tag);
+      clear_fragments(&frag_info[i]);
+    }
+
+    /* We remember the first free fragment info but must continue
+       the loop to free any other expired IP buffers. */
+    if(!found && !frag_info[i].buf) {
+      found = &frag_info[i];
+    }
+  }
+
+  if(!found) {
+    PRINTF("*** Failed to store new fragment session - tag: %d\n", tag);
+    return NULL;
+  }
+
+  found->buf = ip_buf_get_reserve_rx(0);
+  if(!found->buf) {
+    PRINTF("*** No IP buffer for fragment session - tag: %d\n", tag);
+    return NULL;
+  }
+
+  found->len = frag_size;
+  found->tag = tag;
+  found->min_block = SICSLOWPAN_FRAG_BLOCKS;
+  linkaddr_copy(&found->sender, packetbuf_addr(mbuf, PACKETBUF_ADDR_SENDER));
+  linkaddr_copy(&ip_buf_ll_dest(found->buf),
+                packetbuf_addr(mbuf, PACKETBUF_ADDR_RECEIVER));
+  linkaddr_copy(&ip_buf_ll_src(found->buf),
+                packetbuf_addr(mbuf, PACKETBUF_ADDR_SENDER));
+
+  timer_set(&found->reass_timer, SICSLOWPAN_REASS_MAXAGE * CLOCK_SECOND / 16);
+
+  return found;
 }
 /*---------------------------------------------------------------------------*/
-/* add a new fragment to the buffer */
-static int8_t
-add_fragment(struct net_buf *mbuf, uint16_t tag, uint16_t frag_size, uint8_t offset)
+/* headers do not shrink when uncompressed, so a subsequent fragment
+ * starting before the end of the first one overlaps it
+ */
+static int
+check_first_overlap(struct sicslowpan_frag_info *info)
 {
-  int i;
-  int len;
-  int8_t found = -1;
-
-  if(offset == 0) {
-    /* This is a first fragment - check if we can add this */
-    for(i = 0; i < SICSLOWPAN_REASS_CONTEXTS; i++) {
-      /* clear all fragment info with expired timer to free all fragment buffers */
-      if(frag_info[i].len > 0 && timer_expired(&frag_info[i].reass_timer)) {
-       clear_fragments(i);
-      }
+  if(info->first_len && info->blocks &&
+     (uint16_t)(info->min_block << 3) < info->first_len) {
+    PRINTF("Fragment overlapping the first one - tag: %d\n", info->tag);
+    return -1;
+  }
 
-      /* We use len as indication on used or not used */
-      if(found < 0 && frag_info[i].len == 0) {
-        /* We remember the first free fragment info but must continue
-           the loop to free any other expired fragment buffers. */
-        found = i;
-      }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* copy the fragment payload in place, returns 0 on success */
+static int
+store_fragment(struct sicslowpan_frag_info *info, struct net_buf *mbuf,
+               uint8_t offset, int first)
+{
+  uint8_t *data = uip_packetbuf_ptr(mbuf) + uip_packetbuf_hdr_len(mbuf);
+  uint16_t len = packetbuf_datalen(mbuf) - uip_packetbuf_hdr_len(mbuf);
+  uint8_t block, last_block, covered;
+
+  if(first) {
+    if(info->first_len) {
+      PRINTF("Duplicate first fragment - tag: %d\n", info->tag);
+      return 0;
+    }
+
+    /* Strip the dispatch byte of uncompressed IPv6 while copying */
+    if(data[0] == SICSLOWPAN_DISPATCH_IPV6) {
+      data++;
+      len--;
+      uip_uncompressed(info->buf) = 1;
+    } else {
+      uip_uncompressed(info->buf) = 0;
     }
 
-    if(found < 0) {
-      PRINTF("*** Failed to store new fragment session - tag: %d\n", tag);
+    if(!len || len > info->len) {
       return -1;
     }
 
-    /* Found a free fragment info to store data in */
-    frag_info[found].len = frag_size;
-    frag_info[found].tag = tag;
-    linkaddr_copy(&frag_info[found].sender,
-                  packetbuf_addr(mbuf, PACKETBUF_ADDR_SENDER));
-    linkaddr_copy(&frag_info[found].receiver,
-                  packetbuf_addr(mbuf, PACKETBUF_ADDR_RECEIVER));
-
-    timer_set(&frag_info[found].reass_timer, SICSLOWPAN_REASS_MAXAGE * CLOCK_SECOND / 16);
-    i = found;
-    goto store;
+    memcpy(uip_buf(info->buf), data, len);
+    info->first_len = len;
+
+    PRINTF("Fragment payload length: %d\n", len);
+    return check_first_overlap(info);
   }
 
-  /* This is a N-fragment - should find the info */
-  for(i = 0; i < SICSLOWPAN_REASS_CONTEXTS; i++) {
-    if(frag_info[i].tag == tag && frag_info[i].len > 0 &&
-       linkaddr_cmp(&frag_info[i].sender, packetbuf_addr(mbuf, PACKETBUF_ADDR_SENDER))) {
-      /* Tag and Sender match - this must be the correct info to store in */
-      found = i;
-      break;
-    }
+  if(!len) {
+    return -1;
   }
 
-  if(found < 0) {
-    /* no entry found for storing the new fragment */
-    PRINTF("*** Failed to store N-fragment - could not find session - tag: %d offset: %d\n", tag, offset);
+  /* The blocks past the datagram end would make it look complete */
+  if((uint16_t)(offset << 3) + len > info->len) {
+    PRINTF("Fragment past the datagram end - tag: %d offset: %d\n",
+           info->tag, offset);
     return -1;
   }
 
-store:
-  /* i is the index of the reassembly context */
-  len = store_fragment(mbuf, i, offset);
-  if(len > 0) {
-    frag_info[i].reassembled_len += len;
-    if((offset << 3)+ len >= frag_size) {
-      frag_info[i].last_fragment = 1;
-    } else {
-      frag_info[i].last_fragment = 0;
+  block = offset;
+  last_block = offset + (len - 1) / 8;
+
+  if(last_block >= SICSLOWPAN_FRAG_BLOCKS) {
+    return -1;
+  }
+
+  /* Every block already received: a duplicate. Some of them: an
+   * overlap, which discards the datagram (RFC 4944, section 5.3).
+   */
+  covered = 0;
+  for(; block <= last_block; block++) {
+    if(info->map[block / 8] & BIT(block % 8)) {
+      covered++;
     }
-    return i;
-  } else {
-    /* should we also clear all fragments since we failed to store this fragment? */
-    PRINTF("*** Failed to store fragment - packet reassembly will fail tag:%d l\n", frag_info[i].tag);
+  }
+
+  if(covered == last_block - offset + 1) {
+    PRINTF("Duplicate fragment - tag: %d offset: %d\n", info->tag, offset);
+    return 0;
+  }
+
+  if(covered) {
+    PRINTF("Overlapping fragment - tag: %d offset: %d\n", info->tag, offset);
     return -1;
   }
-}
 
+  memcpy(uip_buf(info->buf) + (uint16_t)(offset << 3), data, len);
+
+  for(block = offset; block <= last_block; block++) {
+    info->map[block / 8] |= BIT(block % 8);
+    info->blocks++;
+  }
+
+  if(offset < info->min_block) {
+    info->min_block = offset;
+  }
+
+  PRINTF("Fragment payload length: %d\n", len);
+  return check_first_overlap(info);
+}
 /*---------------------------------------------------------------------------*/
-/* Copy all the fragments that are associated with a specific context into uip */
-static struct net_buf *copy_frags2uip(int context)
+static int
+is_complete(struct sicslowpan_frag_info *info)
 {
-  int i, total_len = 0;
-  struct net_buf *buf;
+  uint8_t total_blocks = (info->len + 7) / 8;
+  uint16_t first_end = info->min_block << 3;
 
-  buf = ip_buf_get_reserve_rx(0);
-  if(!buf) {
-    return NULL;
+  if(!info->first_len || !info->blocks) {
+    return 0;
   }
 
-  /* Copy from the fragment context info buffer first */
-  linkaddr_copy(&ip_buf_ll_dest(buf), &frag_info[context].receiver);
-  linkaddr_copy(&ip_buf_ll_src(buf), &frag_info[context].sender);
-
-  for(i = 0; i < SICSLOWPAN_FRAGMENT_BUFFERS; i++) {
-    if(i == 0) {
-       uip_first_frag_len(buf) = frag_buf[i].len;
-       if(frag_buf[i].data[0] == SICSLOWPAN_DISPATCH_IPV6) {
-         memmove(frag_buf[i].data, frag_buf[i].data + 1, frag_buf[i].len - 1);
-         frag_buf[i].len -= 1;
-         uip_uncompressed(buf) = 1;
-        } else {
-         uip_uncompressed(buf) = 0;
-        }
-    }
-    /* And also copy all matching fragments */
-    if(frag_buf[i].len > 0 && frag_buf[i].index == context) {
-      memcpy(uip_buf(buf) + (uint16_t)(frag_buf[i].offset << 3),
-            (uint8_t *)frag_buf[i].data, frag_buf[i].len);
-      total_len += frag_buf[i].len;
+  /* A hole right after the first fragment. Where a compressed first
+   * fragment ends is checked again once it is uncompressed.
+   */
+  if(uip_uncompressed(info->buf)) {
+    if(first_end != info->first_len) {
+      return 0;
     }
+  } else if(first_end > info->first_len + SICSLOWPAN_MAX_HDR_GROWTH) {
+    return 0;
   }
-  net_buf_add(buf, total_len);
-  uip_len(buf) = total_len;
 
-  /* deallocate all the fragments for this context */
-  clear_fragments(context);
+  return info->blocks >= total_blocks - info->min_block;
+}
+/*---------------------------------------------------------------------------*/
+/* hand over the reassembled IP buffer and free the context */
+static struct net_buf *
+take_frags(struct sicslowpan_frag_info *info)
+{
+  struct net_buf *buf = info->buf;
+
+  uip_first_frag_len(buf) = info->first_len;
+  uip_compressed_hdr_len(buf) = 0;
+  uip_uncompressed_hdr_len(buf) = 0;
+  net_buf_add(buf, info->first_len + info->len - (info->min_block << 3));
+  uip_len(buf) = info->len;
+
+  info->buf = NULL;
+  clear_fragments(info);
 
   return buf;
 }
@@ -621,14 +671,15 @@ static int reassemble(struct net_buf *mbuf)
 {
   /* size of the IP packet (read from fragment) */
   uint16_t frag_size = 0;
-  int8_t frag_context = 0;
+  struct sicslowpan_frag_info *info;
   /* offset of the fragment in the IP packet */
   uint8_t frag_offset = 0;
-  uint8_t is_fragment = 0;
   /* tag of the fragment */
   uint16_t frag_tag = 0;
-  uint8_t first_fragment = 0, last_fragment = 0;
-  struct net_buf *buf = NULL; 
+  uint8_t first_fragment = 0;
+  /* where the first fragment ends once uncompressed */
+  uint16_t first_end;
+  struct net_buf *buf = NULL;
 
   /* init */
   uip_uncomp_hdr_len(mbuf) = 0;
@@ -654,22 +705,8 @@ static int reassemble(struct net_buf *mbuf)
 
       PRINTF("size %d, tag %d, offset %d\n", frag_size, frag_tag, frag_offset);
 
-      if (frag_size > IP_BUF_MAX_DATA) {
-        PRINTF("Too big packet %d bytes (max %d), fragment discarded\n",
-	       frag_size, IP_BUF_MAX_DATA);
-	goto fail;
-      }
-
       uip_packetbuf_hdr_len(mbuf) += SICSLOWPAN_FRAG1_HDR_LEN;
       first_fragment = 1;
-      is_fragment = 1;
-
-      /* Add the fragment to the fragmentation context (this will also copy the payload)*/
-      frag_context = add_fragment(mbuf, frag_tag, frag_size, frag_offset);
-      if(frag_context == -1) {
-        goto fail;
-      }
-
       break;
 
     case SICSLOWPAN_DISPATCH_FRAGN:
@@ -685,20 +722,6 @@ static int reassemble(struct net_buf *mbuf)
       PRINTF("reassemble: size %d, tag %d, offset %d\n", frag_size, frag_tag, frag_offset);
 
       uip_packetbuf_hdr_len(mbuf) += SICSLOWPAN_FRAGN_HDR_LEN;
-
-      /* If this is the last fragment, we may shave off any extrenous
-         bytes at the end. We must be liberal in what we accept. */
-      /* Add the fragment to the fragmentation context  (this will also copy the payload) */
-      frag_context = add_fragment(mbuf, frag_tag, frag_size, frag_offset);
-      if(frag_context == -1) {
-        goto fail;
-      }
-
-      if(frag_info[frag_context].reassembled_len >= frag_size
-         || frag_info[frag_context].last_fragment) {
-        last_fragment = 1;
-      }
-      is_fragment = 1;
       break;
 
     default:
@@ -712,14 +735,13 @@ static int reassemble(struct net_buf *mbuf)
       goto out;
   }
 
-  /*
-   * copy "payload" from the packetbuf buffer to the sicslowpan_buf
-   * if this is a first fragment or not fragmented packet,
-   * we have already copied the compressed headers, uncomp_hdr_len
-   * and packetbuf_hdr_len are non 0, frag_offset is.
-   * If this is a subsequent fragment, this is the contrary.
-   */
-  if(packetbuf_datalen(mbuf) < uip_packetbuf_hdr_len(mbuf)) {
+  if (frag_size > IP_BUF_MAX_DATA) {
+    PRINTF("Too big packet %d bytes (max %d), fragment discarded\n",
+           frag_size, IP_BUF_MAX_DATA);
+    goto fail;
+  }
+
+  if(packetbuf_datalen(mbuf) <= uip_packetbuf_hdr_len(mbuf)) {
     PRINTF("reassemble: packet dropped due to header > total packet\n");
     goto fail;
   }
@@ -738,33 +760,41 @@ static int reassemble(struct net_buf *mbuf)
     }
   }
 
-  if(frag_size > 0) {
-    /* Add the size of the header only for the first fragment. */
-    if(first_fragment != 0) {
-      frag_info[frag_context].reassembled_len = uip_uncomp_hdr_len(mbuf) + uip_packetbuf_payload_len(mbuf);
-    }
+  /* Add the fragment to its reassembly context (this will also copy
+   * the payload to the IP buffer)
+   */
+  info = get_context(mbuf, frag_tag, frag_size);
+  if(!info) {
+    goto fail;
+  }
 
-    /* For the last fragment, we are OK if there is extrenous bytes at
-       the end of the packet. */
-    if(last_fragment != 0) {
-      frag_info[frag_context].reassembled_len = frag_size;
-      /* copy to uip(net_buf) */
-      buf = copy_frags2uip(frag_context);
-      if(!buf)
-        goto fail;
-    }
+  if(store_fragment(info, mbuf, frag_offset, first_fragment) < 0) {
+    PRINTF("*** Failed to store fragment - packet reassembly will fail tag:%d\n", frag_tag);
+    clear_fragments(info);
+    goto fail;
   }
 
   /*
-   * If we have a full IP packet in sicslowpan_buf, deliver it to
+   * If we have a full IP packet in the IP buffer, deliver it to
    * the IP stack
    */
-  if(!is_fragment || last_fragment) {
-    /* packet is in uip already - just set length */
-    if(is_fragment != 0 && last_fragment != 0) {
-      uip_len(buf) = frag_size;
-    } else {
-      uip_len(buf) = uip_packetbuf_payload_len(mbuf) + uip_uncomp_hdr_len(mbuf);
+  if(is_complete(info)) {
+    first_end = info->min_block << 3;
+    buf = take_frags(info);
+
+    /* Only known for sure once the headers are uncompressed */
+    if(!uip_uncompressed(buf)) {
+      if(!NETSTACK_COMPRESS.uncompress(buf)) {
+        goto fail;
+      }
+      uip_uncompressed(buf) = 1;
+
+      if(uip_first_frag_len(buf) + uip_uncompressed_hdr_len(buf) -
+         uip_compressed_hdr_len(buf) != first_end) {
+        PRINTF("reassemble: first fragment does not end at %d, packet dropped\n",
+               first_end);
+        goto fail;
+      }
     }
 
     PRINTF("reassemble: IP packet ready (length %d)\n", uip_len(buf));
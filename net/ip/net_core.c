@@ -231,6 +231,10 @@ int net_send(struct net_buf *buf)
 #include "mac/handler-802154.h"
 #endif
 
+#if NET_MAC_CONF_STATS && defined(CONFIG_NETWORKING_WITH_15_4_MAC_CSMA)
+#include "mac/csma.h"
+#endif
+
 static void stats(void)
 {
 	static clock_time_t last_print;
@@ -243,6 +247,24 @@ static void stats(void)
 			MAC_STAT(bytes_received),
 			MAC_STAT(bytes_sent));
 #endif
+
+#if NET_MAC_CONF_STATS && defined(CONFIG_NETWORKING_WITH_15_4_MAC_CSMA)
+		{
+			const csma_neighbor_stats_t *nbr;
+			int i;
+
+			for (i = 0; (nbr = csma_neighbor_stats_get(i)); i++) {
+				NET_DBG("CSMA %02x%02x queued %d\tmax\t%d\t"
+					"sent\t%d\tdrop\t%d\tcoll\t%d\t"
+					"noack\t%d\n",
+					nbr->addr.u8[LINKADDR_SIZE - 2],
+					nbr->addr.u8[LINKADDR_SIZE - 1],
+					nbr->queued, nbr->max_queued,
+					nbr->sent, nbr->dropped,
+					nbr->collisions, nbr->noacks);
+			}
+		}
+#endif
 		NET_DBG("IP recv        %d\tsent\t%d\tdrop\t%d\tforwarded\t%d\n",
 			STAT(ip.recv),
 			STAT(ip.sent),
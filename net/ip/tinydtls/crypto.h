@@ -58,6 +58,7 @@
 /** Length of DTLS master_secret */
 #define DTLS_MASTER_SECRET_LENGTH 48
 #define DTLS_RANDOM_LENGTH 32
+#define DTLS_SESSION_ID_LENGTH_MAX 32
 
 typedef enum { AES128=0 
 } dtls_crypto_alg;
@@ -127,6 +128,9 @@ typedef struct {
   dtls_compression_t compression;		/**< compression method */
   dtls_cipher_t cipher;		/**< cipher type */
   unsigned int do_client_auth:1;
+  unsigned int resumed:1;	/**< abbreviated handshake of a cached session */
+  uint8 session_id_length;	/**< length of session_id, 0 if none */
+  uint8 session_id[DTLS_SESSION_ID_LENGTH_MAX]; /**< the session id */
   union {
 #ifdef DTLS_ECC
     dtls_handshake_parameters_ecdsa_t ecdsa;
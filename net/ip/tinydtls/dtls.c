@@ -43,6 +43,9 @@
 #include "alert.h"
 #include "session.h"
 #include "prng.h"
+#ifdef DTLS_SESSION_CACHE
+#include "session_cache.h"
+#endif /* DTLS_SESSION_CACHE */
 
 #ifdef WITH_SHA256
 #  include "sha2/sha2.h"
@@ -77,7 +80,7 @@ static NET_BUF_POOL(tx_buffer, 1, IP_BUF_MAX_DATA - UIP_IPUDPH_LEN,
 #define DTLS_HS_LENGTH sizeof(dtls_handshake_header_t)
 #define DTLS_CH_LENGTH sizeof(dtls_client_hello_t) /* no variable length fields! */
 #define DTLS_COOKIE_LENGTH_MAX 32
-#define DTLS_CH_LENGTH_MAX sizeof(dtls_client_hello_t) + DTLS_COOKIE_LENGTH_MAX + 12 + 26
+#define DTLS_CH_LENGTH_MAX sizeof(dtls_client_hello_t) + DTLS_SESSION_ID_LENGTH_MAX + DTLS_COOKIE_LENGTH_MAX + 12 + 26
 #define DTLS_HV_LENGTH sizeof(dtls_hello_verify_t)
 #define DTLS_SH_LENGTH (2 + DTLS_RANDOM_LENGTH + 1 + 2 + 1)
 #define DTLS_CE_LENGTH (3 + 3 + 27 + DTLS_EC_KEY_SIZE + DTLS_EC_KEY_SIZE)
@@ -168,6 +171,9 @@ dtls_init() {
   crypto_init();
   netq_init();
   peer_init();
+#ifdef DTLS_SESSION_CACHE
+  dtls_cache_init();
+#endif /* DTLS_SESSION_CACHE */
   net_buf_pool_init(tx_buffer);
 }
 
@@ -212,22 +218,45 @@ dtls_send(dtls_context_t *ctx, dtls_peer_t *peer, unsigned char type,
  */
 static void dtls_stop_retransmission(dtls_context_t *context, dtls_peer_t *peer);
 
+/* Peers are kept in ctx->peers and, to find the peer of a received
+ * datagram without walking that list, in hash buckets by session. */
+#define PEER_BUCKET(Session) \
+  (dtls_session_hash(Session) & (DTLS_PEER_HASH_SIZE - 1))
+
 dtls_peer_t *
 dtls_get_peer(const dtls_context_t *ctx, const session_t *session) {
-  dtls_peer_t *p = NULL;
+  dtls_peer_t *p;
 
-  for (p = list_head(ctx->peers); p; p = list_item_next(p))
+  for (p = ctx->peer_hash[PEER_BUCKET(session)]; p; p = p->hnext)
     if (dtls_session_equals(&p->session, session))
       return p;
 
-  return p;
+  return NULL;
 }
 
 static void
 dtls_add_peer(dtls_context_t *ctx, dtls_peer_t *peer) {
+  dtls_peer_t **bucket = &ctx->peer_hash[PEER_BUCKET(&peer->session)];
+
+  peer->hnext = *bucket;
+  *bucket = peer;
   list_add(ctx->peers, peer);
 }
 
+static void
+dtls_remove_peer(dtls_context_t *ctx, dtls_peer_t *peer) {
+  dtls_peer_t **p = &ctx->peer_hash[PEER_BUCKET(&peer->session)];
+
+  for (; *p; p = &(*p)->hnext) {
+    if (*p == peer) {
+      *p = peer->hnext;
+      break;
+    }
+  }
+  peer->hnext = NULL;
+  list_remove(ctx->peers, peer);
+}
+
 int
 dtls_write(struct dtls_context_t *ctx, 
 	   session_t *dst, uint8 *buf, size_t len) {
@@ -588,6 +617,36 @@ static char *dtls_handshake_type_to_name(int type)
   }
 }
 
+/**
+ * Expands \p master_secret and the random values of \p handshake into
+ * the key block of \p security. The master secret is kept in
+ * \p handshake for the Finished messages.
+ */
+static void
+expand_key_block(dtls_handshake_parameters_t *handshake,
+		 dtls_security_parameters_t *security,
+		 dtls_peer_type role,
+		 const uint8 *master_secret) {
+  /* create key_block from master_secret
+   * key_block = PRF(master_secret,
+                    "key expansion" + tmp.random.server + tmp.random.client) */
+
+  dtls_prf(master_secret,
+	   DTLS_MASTER_SECRET_LENGTH,
+	   PRF_LABEL(key), PRF_LABEL_SIZE(key),
+	   handshake->tmp.random.server, DTLS_RANDOM_LENGTH,
+	   handshake->tmp.random.client, DTLS_RANDOM_LENGTH,
+	   security->key_block,
+	   dtls_kb_size(security, role));
+
+  memcpy(handshake->tmp.master_secret, master_secret, DTLS_MASTER_SECRET_LENGTH);
+  dtls_debug_keyblock(security);
+
+  security->cipher = handshake->cipher;
+  security->compression = handshake->compression;
+  security->rseq = 0;
+}
+
 /**
  * Calculate the pre master secret and after that calculate the master-secret.
  */
@@ -671,28 +730,54 @@ calculate_key_block(dtls_context_t *ctx,
 
   dtls_debug_dump("master_secret", master_secret, DTLS_MASTER_SECRET_LENGTH);
 
-  /* create key_block from master_secret
-   * key_block = PRF(master_secret,
-                    "key expansion" + tmp.random.server + tmp.random.client) */
+  expand_key_block(handshake, security, role, master_secret);
 
-  dtls_prf(master_secret,
-	   DTLS_MASTER_SECRET_LENGTH,
-	   PRF_LABEL(key), PRF_LABEL_SIZE(key),
-	   handshake->tmp.random.server, DTLS_RANDOM_LENGTH,
-	   handshake->tmp.random.client, DTLS_RANDOM_LENGTH,
-	   security->key_block,
-	   dtls_kb_size(security, role));
+  return 0;
+}
 
-  memcpy(handshake->tmp.master_secret, master_secret, DTLS_MASTER_SECRET_LENGTH);
-  dtls_debug_keyblock(security);
+#ifdef DTLS_SESSION_CACHE
+/**
+ * Calculates the key block for an abbreviated handshake from the
+ * master secret of the \p cached session that \p peer resumes.
+ */
+static int
+calculate_resumed_key_block(dtls_peer_t *peer,
+			    const dtls_cache_entry_t *cached) {
+  dtls_handshake_parameters_t *handshake = peer->handshake_params;
+  dtls_security_parameters_t *security = dtls_security_params_next(peer);
 
-  security->cipher = handshake->cipher;
-  security->compression = handshake->compression;
-  security->rseq = 0;
+  if (!security) {
+    return dtls_alert_fatal_create(DTLS_ALERT_INTERNAL_ERROR);
+  }
+
+  handshake->cipher = cached->cipher;
+  handshake->compression = TLS_COMPRESSION_NULL;
+
+  dtls_debug_dump("client_random", handshake->tmp.random.client, DTLS_RANDOM_LENGTH);
+  dtls_debug_dump("server_random", handshake->tmp.random.server, DTLS_RANDOM_LENGTH);
+
+  expand_key_block(handshake, security, peer->role, cached->master_secret);
 
   return 0;
 }
 
+/**
+ * Stores the session that \p peer has just established with a full
+ * handshake, if the server has assigned it a session id.
+ */
+static void
+dtls_cache_session(dtls_peer_t *peer) {
+  dtls_handshake_parameters_t *handshake = peer->handshake_params;
+
+  if (handshake->resumed || !handshake->session_id_length)
+    return;
+
+  dtls_cache_add(&peer->session, peer->role,
+		 handshake->session_id, handshake->session_id_length,
+		 handshake->cipher, handshake->tmp.master_secret);
+}
+#endif /* DTLS_SESSION_CACHE */
+
 /* TODO: add a generic method which iterates over a list and searches for a specific key */
 static int verify_ext_eliptic_curves(uint8 *data, size_t data_length) {
   int i, curve_name;
@@ -885,6 +970,8 @@ error:
  * parameters with the new data for the given \p peer. When the ClientHello
  * handshake message in \p data does not contain a cipher suite or
  * compression method, it is copied from the the current security parameters.
+ * When the client offers the id of a cached session whose cipher suite is
+ * still acceptable, the session is marked for resumption.
  *
  * \param ctx   The current DTLS context.
  * \param peer  The remote peer whose security parameters are about to change.
@@ -900,6 +987,9 @@ dtls_update_parameters(dtls_context_t *ctx,
   int ok;
   dtls_handshake_parameters_t *config = peer->handshake_params;
   dtls_security_parameters_t *security = dtls_security_params(peer);
+#ifdef DTLS_SESSION_CACHE
+  dtls_cache_entry_t *cached = NULL;
+#endif /* DTLS_SESSION_CACHE */
 
   assert(config);
   assert(data_length > DTLS_HS_LENGTH + DTLS_CH_LENGTH);
@@ -913,8 +1003,17 @@ dtls_update_parameters(dtls_context_t *ctx,
   data += DTLS_RANDOM_LENGTH;
   data_length -= DTLS_RANDOM_LENGTH;
 
+  /* store the session id the client wants to resume, if any */
+  i = dtls_uint8_to_int(data);
+  if (i > DTLS_SESSION_ID_LENGTH_MAX || data_length < i + sizeof(uint8))
+    goto error;
+
+  config->session_id_length = i;
+  memcpy(config->session_id, data + sizeof(uint8), i);
+  data += i + sizeof(uint8);
+  data_length -= i + sizeof(uint8);
+
   /* Caution: SKIP_VAR_FIELD may jump to error: */
-  SKIP_VAR_FIELD(data, data_length, uint8);	/* skip session id */
   SKIP_VAR_FIELD(data, data_length, uint8);	/* skip cookie */
 
   i = dtls_uint16_to_int(data);
@@ -934,6 +1033,22 @@ dtls_update_parameters(dtls_context_t *ctx,
   data += sizeof(uint16);
   data_length -= sizeof(uint16) + i;
 
+#ifdef DTLS_SESSION_CACHE
+  /* Sessions are only resumed in an initial handshake, and only if
+   * the client still offers the cipher suite of the session. */
+  if (peer->state != DTLS_STATE_CONNECTED)
+    cached = dtls_cache_find_id(config->session_id, config->session_id_length);
+
+  if (cached && known_cipher(ctx, cached->cipher, 0)) {
+    for (j = 0; j < i; j += sizeof(uint16)) {
+      if (dtls_uint16_to_int(data + j) == cached->cipher) {
+	config->resumed = 1;
+	break;
+      }
+    }
+  }
+#endif /* DTLS_SESSION_CACHE */
+
   ok = 0;
   while (i && !ok) {
     config->cipher = dtls_uint16_to_int(data);
@@ -945,6 +1060,11 @@ dtls_update_parameters(dtls_context_t *ctx,
   /* skip remaining ciphers */
   data += i;
 
+#ifdef DTLS_SESSION_CACHE
+  if (config->resumed)
+    config->cipher = cached->cipher;
+#endif /* DTLS_SESSION_CACHE */
+
   if (!ok) {
     /* reset config cipher to a well-defined value */
     config->cipher = TLS_NULL_WITH_NULL_NULL;
@@ -1454,14 +1574,13 @@ dtls_send_multi(dtls_context_t *ctx, dtls_peer_t *peer,
   if ((type == DTLS_CT_HANDSHAKE && buf_array[0][0] != DTLS_HT_HELLO_VERIFY_REQUEST) ||
       type == DTLS_CT_CHANGE_CIPHER_SPEC) {
     /* copy handshake messages other than HelloVerify into retransmit buffer */
-    netq_t *n = netq_node_new(overall_len);
+    netq_t *n = netq_node_new(peer, overall_len);
     if (n) {
       dtls_tick_t now;
       dtls_ticks(&now);
       n->t = now + 2 * CLOCK_SECOND;
       n->retransmit_cnt = 0;
       n->timeout = 2 * CLOCK_SECOND;
-      n->peer = peer;
       n->epoch = (security) ? security->epoch : 0;
       n->type = type;
       n->length = 0;
@@ -1470,7 +1589,7 @@ dtls_send_multi(dtls_context_t *ctx, dtls_peer_t *peer,
         n->length += buf_len_array[i];
       }
 
-      if (!netq_insert_node(ctx->sendqueue, n)) {
+      if (!netq_heap_insert(&ctx->sendqueue, n)) {
 	dtls_warn("cannot add packet to retransmit buffer\n");
 	netq_node_free(n);
 #ifdef WITH_CONTIKI
@@ -1531,7 +1650,7 @@ static void dtls_destroy_peer(dtls_context_t *ctx, dtls_peer_t *peer, int unlink
   if (peer->state != DTLS_STATE_CLOSED && peer->state != DTLS_STATE_CLOSING)
     dtls_close(ctx, &peer->session);
   if (unlink) {
-    list_remove(ctx->peers, peer);
+    dtls_remove_peer(ctx, peer);
     dtls_dsrv_log_addr(DTLS_LOG_DEBUG, "removed peer", &peer->session);
   }
   dtls_free_peer(peer);
@@ -1754,7 +1873,7 @@ dtls_send_server_hello(dtls_context_t *ctx, dtls_peer_t *peer)
   /* Ensure that the largest message to create fits in our source
    * buffer. (The size of the destination buffer is checked by the
    * encoding function, so we do not need to guess.) */
-  uint8 buf[DTLS_SH_LENGTH + 2 + 5 + 5 + 8 + 6];
+  uint8 buf[DTLS_SH_LENGTH + DTLS_SESSION_ID_LENGTH_MAX + 2 + 5 + 5 + 8 + 6];
   uint8 *p;
   int ecdsa;
   uint8 extension_size;
@@ -1781,7 +1900,10 @@ dtls_send_server_hello(dtls_context_t *ctx, dtls_peer_t *peer)
   memcpy(p, handshake->tmp.random.server, DTLS_RANDOM_LENGTH);
   p += DTLS_RANDOM_LENGTH;
 
-  *p++ = 0;			/* no session id */
+  /* session id, empty if the session cannot be resumed */
+  *p++ = handshake->session_id_length;
+  memcpy(p, handshake->session_id, handshake->session_id_length);
+  p += handshake->session_id_length;
 
   if (handshake->cipher != TLS_NULL_WITH_NULL_NULL) {
     /* selected cipher suite */
@@ -2175,6 +2297,52 @@ dtls_send_ccs(dtls_context_t *ctx, dtls_peer_t *peer) {
   return dtls_send(ctx, peer, DTLS_CT_CHANGE_CIPHER_SPEC, buf, 1);
 }
 
+static int
+dtls_send_finished(dtls_context_t *ctx, dtls_peer_t *peer,
+		   const unsigned char *label, size_t labellen);
+
+#ifdef DTLS_SESSION_CACHE
+/**
+ * Sends the server's flight of an abbreviated handshake: the ServerHello
+ * echoing the session id of the client, followed by ChangeCipherSpec and
+ * Finished with the keys derived from the cached master secret.
+ */
+static int
+dtls_send_server_hello_resumed(dtls_context_t *ctx, dtls_peer_t *peer)
+{
+  dtls_handshake_parameters_t *handshake = peer->handshake_params;
+  dtls_cache_entry_t *cached;
+  int res;
+
+  cached = dtls_cache_find_id(handshake->session_id,
+			      handshake->session_id_length);
+  if (!cached) {
+    return dtls_alert_fatal_create(DTLS_ALERT_INTERNAL_ERROR);
+  }
+
+  res = dtls_send_server_hello(ctx, peer);
+  if (res < 0) {
+    dtls_debug("dtls_server_hello: cannot prepare ServerHello record\n");
+    return res;
+  }
+
+  res = calculate_resumed_key_block(peer, cached);
+  if (res < 0) {
+    return res;
+  }
+
+  res = dtls_send_ccs(ctx, peer);
+  if (res < 0) {
+    dtls_debug("cannot send CCS message\n");
+    return res;
+  }
+
+  dtls_security_params_switch(peer);
+
+  return dtls_send_finished(ctx, peer, PRF_LABEL(server), PRF_LABEL_SIZE(server));
+}
+#endif /* DTLS_SESSION_CACHE */
+
     
 static int
 dtls_send_client_key_exchange(dtls_context_t *ctx, dtls_peer_t *peer)
@@ -2362,9 +2530,11 @@ dtls_send_client_hello(dtls_context_t *ctx, dtls_peer_t *peer,
   memcpy(p, handshake->tmp.random.client, DTLS_RANDOM_LENGTH);
   p += DTLS_RANDOM_LENGTH;
 
-  /* session id (length 0) */
-  dtls_int_to_uint8(p, 0);
+  /* session id, set if we try to resume a cached session */
+  dtls_int_to_uint8(p, handshake->session_id_length);
   p += sizeof(uint8);
+  memcpy(p, handshake->session_id, handshake->session_id_length);
+  p += handshake->session_id_length;
 
   /* cookie */
   dtls_int_to_uint8(p, cookie_length);
@@ -2478,6 +2648,8 @@ check_server_hello(dtls_context_t *ctx,
 		      uint8 *data, size_t data_length)
 {
   dtls_handshake_parameters_t *handshake = peer->handshake_params;
+  int err;
+  size_t i;
 
   /* This function is called when we expect a ServerHello (i.e. we
    * have sent a ClientHello).  We might instead receive a HelloVerify
@@ -2514,7 +2686,18 @@ check_server_hello(dtls_context_t *ctx,
   data += DTLS_RANDOM_LENGTH;
   data_length -= DTLS_RANDOM_LENGTH;
 
-  SKIP_VAR_FIELD(data, data_length, uint8); /* skip session id */
+  /* The server echoes the session id we offered if it agrees to
+   * resume the session, otherwise it may assign a new one. */
+  i = dtls_uint8_to_int(data);
+  if (i > DTLS_SESSION_ID_LENGTH_MAX || data_length < i + sizeof(uint8))
+    goto error;
+
+  handshake->resumed = handshake->session_id_length && i == handshake->session_id_length
+    && equals(data + sizeof(uint8), handshake->session_id, i);
+  handshake->session_id_length = i;
+  memcpy(handshake->session_id, data + sizeof(uint8), i);
+  data += i + sizeof(uint8);
+  data_length -= i + sizeof(uint8);
     
   /* Check cipher suite. As we offer all we have, it is sufficient
    * to check if the cipher suite selected by the server is in our
@@ -2536,7 +2719,23 @@ check_server_hello(dtls_context_t *ctx,
   data += sizeof(uint8);
   data_length -= sizeof(uint8);
 
-  return dtls_check_tls_extension(peer, data, data_length, 0);
+  err = dtls_check_tls_extension(peer, data, data_length, 0);
+  if (err < 0 || !handshake->resumed)
+    return err;
+
+#ifdef DTLS_SESSION_CACHE
+  {
+    dtls_cache_entry_t *cached = dtls_cache_find_peer(&peer->session);
+
+    if (cached && cached->cipher == handshake->cipher) {
+      dtls_debug("resuming cached session\n");
+      return calculate_resumed_key_block(peer, cached);
+    }
+  }
+#endif /* DTLS_SESSION_CACHE */
+
+  /* the server resumes a session we do not know (anymore) */
+  return dtls_alert_fatal_create(DTLS_ALERT_ILLEGAL_PARAMETER);
 
 error:
   return dtls_alert_fatal_create(DTLS_ALERT_DECODE_ERROR);
@@ -3055,7 +3254,10 @@ handle_handshake_msg(dtls_context_t *ctx, dtls_peer_t *peer, session_t *session,
       dtls_warn("error in check_server_hello err: %i\n", err);
       return err;
     }
-    if (is_tls_ecdhe_ecdsa_with_aes_128_ccm_8(peer->handshake_params->cipher))
+    if (peer->handshake_params->resumed)
+      /* abbreviated handshake, expect ChangeCipherSpec and Finished */
+      peer->state = DTLS_STATE_WAIT_CHANGECIPHERSPEC;
+    else if (is_tls_ecdhe_ecdsa_with_aes_128_ccm_8(peer->handshake_params->cipher))
       peer->state = DTLS_STATE_WAIT_SERVERCERTIFICATE;
     else
       peer->state = DTLS_STATE_WAIT_SERVERHELLODONE;
@@ -3155,8 +3357,9 @@ handle_handshake_msg(dtls_context_t *ctx, dtls_peer_t *peer, session_t *session,
       dtls_warn("error in check_finished err: %i\n", err);
       return err;
     }
-    if (role == DTLS_SERVER) {
-      /* send ServerFinished */
+    /* The server sends its Finished last in a full handshake, the
+     * client in an abbreviated one. */
+    if ((role == DTLS_SERVER) != peer->handshake_params->resumed) {
       update_hs_hash(peer, data, data_length);
 
       /* send change cipher spec message and switch to new configuration */
@@ -3168,12 +3371,18 @@ handle_handshake_msg(dtls_context_t *ctx, dtls_peer_t *peer, session_t *session,
 
       dtls_security_params_switch(peer);
 
-      err = dtls_send_finished(ctx, peer, PRF_LABEL(server), PRF_LABEL_SIZE(server));
+      if (role == DTLS_SERVER)
+	err = dtls_send_finished(ctx, peer, PRF_LABEL(server), PRF_LABEL_SIZE(server));
+      else
+	err = dtls_send_finished(ctx, peer, PRF_LABEL(client), PRF_LABEL_SIZE(client));
       if (err < 0) {
-        dtls_warn("sending server Finished failed\n");
+        dtls_warn("sending Finished failed\n");
         return err;
       }
     }
+#ifdef DTLS_SESSION_CACHE
+    dtls_cache_session(peer);
+#endif /* DTLS_SESSION_CACHE */
     dtls_handshake_free(peer->handshake_params);
     peer->handshake_params = NULL;
     dtls_debug("Handshake complete\n");
@@ -3304,6 +3513,26 @@ handle_handshake_msg(dtls_context_t *ctx, dtls_peer_t *peer, session_t *session,
     /* update finish MAC */
     update_hs_hash(peer, data, data_length);
 
+#ifdef DTLS_SESSION_CACHE
+    if (peer->handshake_params->resumed) {
+      dtls_debug("resuming cached session\n");
+      err = dtls_send_server_hello_resumed(ctx, peer);
+      if (err < 0) {
+	return err;
+      }
+
+      /* the client answers with ChangeCipherSpec and Finished */
+      peer->state = DTLS_STATE_WAIT_CHANGECIPHERSPEC;
+      break;
+    }
+
+    /* assign a new session id so that the client can resume later */
+    peer->handshake_params->session_id_length = DTLS_SESSION_ID_LENGTH_MAX;
+    dtls_prng(peer->handshake_params->session_id, DTLS_SESSION_ID_LENGTH_MAX);
+#else /* DTLS_SESSION_CACHE */
+    peer->handshake_params->session_id_length = 0;
+#endif /* DTLS_SESSION_CACHE */
+
     err = dtls_send_server_hello_msgs(ctx, peer);
     if (err < 0) {
       return err;
@@ -3418,13 +3647,12 @@ handle_handshake(dtls_context_t *ctx, dtls_peer_t *peer, session_t *session,
       node = netq_next(node);
     }
 
-    n = netq_node_new(data_length);
+    n = netq_node_new(peer, data_length);
     if (!n) {
       dtls_warn("no space in reoder buffer\n");
       return 0;
     }
 
-    n->peer = peer;
     n->length = data_length;
     memcpy(n->data, data, data_length);
 
@@ -3453,6 +3681,7 @@ handle_handshake(dtls_context_t *ctx, dtls_peer_t *peer, session_t *session,
           netq_remove(peer->handshake_params->reorder_queue, node);
           next = 1;
           res = handle_handshake_msg(ctx, peer, session, role, peer->state, node->data, node->length);
+          netq_node_free(node);
           if (res < 0) {
             return res;
           }
@@ -3490,8 +3719,9 @@ handle_ccs(dtls_context_t *ctx, dtls_peer_t *peer,
   if (data_length < 1 || data[0] != 1)
     return dtls_alert_fatal_create(DTLS_ALERT_DECODE_ERROR);
 
-  /* Just change the cipher when we are on the same epoch */
-  if (peer->role == DTLS_SERVER) {
+  /* Just change the cipher when we are on the same epoch. In an
+   * abbreviated handshake the keys are already known. */
+  if (peer->role == DTLS_SERVER && !handshake->resumed) {
     err = calculate_key_block(ctx, handshake, peer,
 			      &peer->session, peer->role);
     if (err < 0) {
@@ -3532,7 +3762,13 @@ handle_alert(dtls_context_t *ctx, dtls_peer_t *peer,
   if (data[0] == DTLS_ALERT_LEVEL_FATAL || data[1] == DTLS_ALERT_CLOSE_NOTIFY) {
     dtls_alert("%d invalidate peer\n", data[1]);
     
-    list_remove(ctx->peers, peer);
+    dtls_remove_peer(ctx, peer);
+
+#ifdef DTLS_SESSION_CACHE
+    /* a session terminated by an error must not be resumed */
+    if (data[1] != DTLS_ALERT_CLOSE_NOTIFY)
+      dtls_cache_remove(&peer->session);
+#endif /* DTLS_SESSION_CACHE */
 
 #ifdef WITH_CONTIKI
 #ifndef NDEBUG
@@ -3583,6 +3819,10 @@ static int dtls_alert_send_from_err(dtls_context_t *ctx, dtls_peer_t *peer,
       peer = dtls_get_peer(ctx, session);
     }
     if (peer) {
+#ifdef DTLS_SESSION_CACHE
+      if (level == DTLS_ALERT_LEVEL_FATAL)
+	dtls_cache_remove(&peer->session);
+#endif /* DTLS_SESSION_CACHE */
       peer->state = DTLS_STATE_CLOSING;
       return dtls_send_alert(ctx, peer, level, desc);
     }
@@ -3591,6 +3831,9 @@ static int dtls_alert_send_from_err(dtls_context_t *ctx, dtls_peer_t *peer,
       peer = dtls_get_peer(ctx, session);
     }
     if (peer) {
+#ifdef DTLS_SESSION_CACHE
+      dtls_cache_remove(&peer->session);
+#endif /* DTLS_SESSION_CACHE */
       peer->state = DTLS_STATE_CLOSING;
       return dtls_send_alert(ctx, peer, DTLS_ALERT_LEVEL_FATAL, DTLS_ALERT_INTERNAL_ERROR);
     }
@@ -3701,10 +3944,13 @@ dtls_handle_message(dtls_context_t *ctx,
 
 	/* The new security parameters must be used for all messages
 	 * that are sent after the ChangeCipherSpec message. This
-	 * means that the client's Finished message uses epoch + 1
-	 * while the server is still in the old epoch.
+	 * means that the Finished message of the peer uses epoch + 1
+	 * when we have not sent our own ChangeCipherSpec yet, i.e. for
+	 * the server in a full handshake and for the client in an
+	 * abbreviated handshake.
 	 */
-	if (role == DTLS_SERVER && state == DTLS_STATE_WAIT_FINISHED) {
+	if (state == DTLS_STATE_WAIT_FINISHED && peer->security_params[1] &&
+	    peer->security_params[1]->epoch == expected_epoch + 1) {
 	  expected_epoch++;
 	}
 
@@ -3784,8 +4030,6 @@ dtls_new_context(void *app_data) {
 
   memset(c, 0, sizeof(dtls_context_t));
   c->app = app_data;
-  
-  LIST_STRUCT_INIT(c, sendqueue);
 
 #ifdef WITH_CONTIKI
   LIST_STRUCT_INIT(c, peers);
@@ -3820,7 +4064,7 @@ dtls_free_context(dtls_context_t *ctx) {
     return;
   }
 
-  for (p = list_head(ctx->peers); p; p = list_item_next(p))
+  while ((p = list_head(ctx->peers)))
     dtls_destroy_peer(ctx, p, 1);
 
   free_context(ctx);
@@ -3853,6 +4097,21 @@ dtls_connect_peer(dtls_context_t *ctx, dtls_peer_t *peer) {
   peer->handshake_params->hs_state.mseq_r = 0;
   peer->handshake_params->hs_state.mseq_s = 0;
   LIST_STRUCT_INIT(peer->handshake_params, reorder_queue);
+
+#ifdef DTLS_SESSION_CACHE
+  {
+    /* offer to resume the last session with this server */
+    dtls_cache_entry_t *cached = dtls_cache_find_peer(&peer->session);
+
+    if (cached) {
+      dtls_debug("offering cached session\n");
+      peer->handshake_params->session_id_length = cached->id_length;
+      memcpy(peer->handshake_params->session_id, cached->id,
+	     cached->id_length);
+    }
+  }
+#endif /* DTLS_SESSION_CACHE */
+
   res = dtls_send_client_hello(ctx, peer, NULL, 0);
   if (res < 0)
     dtls_warn("cannot send ClientHello\n");
@@ -3915,7 +4174,10 @@ dtls_retransmit(dtls_context_t *context, netq_t *node) {
       dtls_ticks(&now);
       node->retransmit_cnt++;
       node->t = now + (node->timeout << node->retransmit_cnt);
-      netq_insert_node(context->sendqueue, node);
+      if (!netq_heap_insert(&context->sendqueue, node)) {
+	netq_node_free(node);
+	return;
+      }
       
       if (node->type == DTLS_CT_HANDSHAKE) {
 	dtls_handshake_header_t *hs_header = DTLS_HANDSHAKE_HEADER(data);
@@ -3958,30 +4220,19 @@ dtls_retransmit(dtls_context_t *context, netq_t *node) {
 
 static void
 dtls_stop_retransmission(dtls_context_t *context, dtls_peer_t *peer) {
-  netq_t *node;
-  node = list_head(context->sendqueue); 
-
-  while (node) {
-    if (dtls_session_equals(&node->peer->session, &peer->session)) {
-      netq_t *tmp = node;
-      node = list_item_next(node);
-      list_remove(context->sendqueue, tmp);
-      netq_node_free(tmp);
-    } else
-      node = list_item_next(node);    
-  }
+  netq_heap_delete_peer(&context->sendqueue, peer);
 }
 
 void
 dtls_check_retransmit(dtls_context_t *context, clock_time_t *next) {
   dtls_tick_t now;
-  netq_t *node = netq_head(context->sendqueue);
+  netq_t *node = netq_heap_head(&context->sendqueue);
 
   dtls_ticks(&now);
   while (node && node->t <= now) {
-    netq_pop_first(context->sendqueue);
+    netq_heap_pop(&context->sendqueue);
     dtls_retransmit(context, node);
-    node = netq_head(context->sendqueue);
+    node = netq_heap_head(&context->sendqueue);
   }
 
   if (next && node)
@@ -4006,12 +4257,12 @@ PROCESS_THREAD(dtls_retransmit_process, ev, data, buf, user_data)
     if (ev == PROCESS_EVENT_TIMER) {
       if (etimer_expired(&the_dtls_context.retransmit_timer)) {
 	
-	node = list_head(the_dtls_context.sendqueue);
+	node = netq_heap_head(&the_dtls_context.sendqueue);
 	
 	now = clock_time();
 	if (node && node->t <= now) {
-	  dtls_retransmit(&the_dtls_context, list_pop(the_dtls_context.sendqueue));
-	  node = list_head(the_dtls_context.sendqueue);
+	  dtls_retransmit(&the_dtls_context, netq_heap_pop(&the_dtls_context.sendqueue));
+	  node = netq_heap_head(&the_dtls_context.sendqueue);
 	}
 
 	/* need to set timer to some value even if no nextpdu is available */
@@ -44,6 +44,7 @@
 
 #include "global.h"
 #include "dtls_time.h"
+#include "netq.h"
 
 #ifndef DTLSv12
 #define DTLS_VERSION 0xfeff	/* DTLS v1.1 */
@@ -214,18 +215,24 @@ typedef struct {
 #endif /* DTLS_ECC */
 } dtls_handler_t;
 
+#ifndef DTLS_PEER_HASH_SIZE
+/** Number of buckets to look up peers by session, a power of two. */
+#define DTLS_PEER_HASH_SIZE 8
+#endif
+
 /** Holds global information of the DTLS engine. */
 typedef struct dtls_context_t {
   unsigned char cookie_secret[DTLS_COOKIE_SECRET_LENGTH];
   clock_time_t cookie_secret_age; /**< the time the secret has been generated */
 
   LIST_STRUCT(peers);
+  dtls_peer_t *peer_hash[DTLS_PEER_HASH_SIZE]; /**< peers by session hash */
 
 #ifdef WITH_CONTIKI
   struct etimer retransmit_timer; /**< fires when the next packet must be sent */
 #endif /* WITH_CONTIKI */
 
-  LIST_STRUCT(sendqueue);	/**< the packets to send */
+  netq_heap_t sendqueue;	/**< the packets to retransmit */
 
   void *app;			/**< application-specific data */
 
@@ -25,8 +25,13 @@
 #include <stdlib.h>
 
 static inline netq_t *
-netq_malloc_node(size_t size) {
-  return (netq_t *)malloc(sizeof(netq_t) + size);
+netq_malloc_node(dtls_peer_t *peer, size_t size) {
+  netq_t *node = (netq_t *)malloc(sizeof(netq_t) + size);
+
+  if (node)
+    memset(node, 0, sizeof(netq_t));
+
+  return node;
 }
 
 static inline void
@@ -41,13 +46,90 @@ netq_free_node(netq_t *node) {
 
 MEMB(netq_storage, netq_t, NETQ_MAXCNT);
 
+/* The datagrams of all nodes share this area, each node reserves only
+ * the length of its datagram. Blocks never move, so data pointers stay
+ * valid while a buffered record is being processed. */
+static unsigned char netq_data[NETQ_STORAGE_SIZE];
+
+#define NETQ_NODE(i) (&((netq_t *)netq_storage.mem)[i])
+
+static inline int
+netq_data_used(int i) {
+  return netq_storage.count[i] && NETQ_NODE(i)->size;
+}
+
+/* Returns non-zero if [start, start + size) overlaps no used block. */
+static int
+netq_data_free(size_t start, size_t size) {
+  int i;
+
+  for (i = 0; i < netq_storage.num; i++) {
+    size_t offset;
+
+    if (!netq_data_used(i))
+      continue;
+
+    offset = NETQ_NODE(i)->data - netq_data;
+    if (start < offset + NETQ_NODE(i)->size && offset < start + size)
+      return 0;
+  }
+
+  return 1;
+}
+
+static unsigned char *
+netq_data_alloc(dtls_peer_t *peer, size_t size) {
+  size_t used = 0, start;
+  int i;
+
+  for (i = 0; i < netq_storage.num; i++) {
+    if (netq_data_used(i) && NETQ_NODE(i)->peer == peer)
+      used += NETQ_NODE(i)->size;
+  }
+
+  if (used + size > NETQ_PEER_STORAGE_SIZE) {
+    dtls_warn("netq: peer uses %u bytes already\n", (unsigned int)used);
+    return NULL;
+  }
+
+  /* First fit: a free block starts at the beginning of the area or
+   * right behind a used block. */
+  for (i = -1; i < netq_storage.num; i++) {
+    if (i < 0)
+      start = 0;
+    else if (netq_data_used(i))
+      start = NETQ_NODE(i)->data - netq_data + NETQ_NODE(i)->size;
+    else
+      continue;
+
+    if (start + size <= NETQ_STORAGE_SIZE && netq_data_free(start, size))
+      return netq_data + start;
+  }
+
+  return NULL;
+}
+
 static inline netq_t *
-netq_malloc_node(size_t size) {
-  return (netq_t *)memb_alloc(&netq_storage);
+netq_malloc_node(dtls_peer_t *peer, size_t size) {
+  netq_t *node = (netq_t *)memb_alloc(&netq_storage);
+
+  if (!node)
+    return NULL;
+
+  memset(node, 0, sizeof(netq_t));
+  node->data = netq_data_alloc(peer, size);
+  if (!node->data) {
+    memb_free(&netq_storage, node);
+    return NULL;
+  }
+  node->size = size;
+
+  return node;
 }
 
 static inline void
 netq_free_node(netq_t *node) {
+  node->size = 0;
   memb_free(&netq_storage, node);
 }
 
@@ -108,9 +190,9 @@ netq_t *netq_pop_first(list_t queue) {
 }
 
 netq_t *
-netq_node_new(size_t size) {
+netq_node_new(dtls_peer_t *peer, size_t size) {
   netq_t *node;
-  node = netq_malloc_node(size);
+  node = netq_malloc_node(peer, size);
 
 #ifndef NDEBUG
   if (!node)
@@ -118,7 +200,7 @@ netq_node_new(size_t size) {
 #endif
 
   if (node)
-    memset(node, 0, sizeof(netq_t));
+    node->peer = peer;
 
   return node;  
 }
@@ -138,3 +220,98 @@ netq_delete_all(list_t queue) {
   }
 }
 
+
+static inline void
+netq_heap_swap(netq_heap_t *heap, unsigned int i, unsigned int j) {
+  netq_t *tmp = heap->node[i];
+
+  heap->node[i] = heap->node[j];
+  heap->node[j] = tmp;
+  heap->node[i]->index = i;
+  heap->node[j]->index = j;
+}
+
+static void
+netq_heap_up(netq_heap_t *heap, unsigned int i) {
+  while (i > 0 && heap->node[(i - 1) / 2]->t > heap->node[i]->t) {
+    netq_heap_swap(heap, i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+}
+
+static void
+netq_heap_down(netq_heap_t *heap, unsigned int i) {
+  for (;;) {
+    unsigned int min = i, child = 2 * i + 1;
+
+    if (child < heap->count && heap->node[child]->t < heap->node[min]->t)
+      min = child;
+    if (child + 1 < heap->count &&
+	heap->node[child + 1]->t < heap->node[min]->t)
+      min = child + 1;
+    if (min == i)
+      return;
+
+    netq_heap_swap(heap, i, min);
+    i = min;
+  }
+}
+
+int
+netq_heap_insert(netq_heap_t *heap, netq_t *node) {
+  assert(heap);
+  assert(node);
+
+  if (heap->count >= NETQ_MAXCNT)
+    return 0;
+
+  node->index = heap->count;
+  heap->node[heap->count++] = node;
+  netq_heap_up(heap, node->index);
+
+  return 1;
+}
+
+netq_t *
+netq_heap_pop(netq_heap_t *heap) {
+  netq_t *node = netq_heap_head(heap);
+
+  if (node)
+    netq_heap_remove(heap, node);
+
+  return node;
+}
+
+void
+netq_heap_remove(netq_heap_t *heap, netq_t *node) {
+  unsigned int i = node->index;
+
+  assert(i < heap->count && heap->node[i] == node);
+
+  heap->node[i] = heap->node[--heap->count];
+  heap->node[i]->index = i;
+  if (i < heap->count) {
+    netq_heap_up(heap, i);
+    netq_heap_down(heap, heap->node[i]->index);
+  }
+}
+
+void
+netq_heap_delete_peer(netq_heap_t *heap, dtls_peer_t *peer) {
+  unsigned int i, count = 0;
+
+  /* keep the other nodes in place, then restore the heap order */
+  for (i = 0; i < heap->count; i++) {
+    if (dtls_session_equals(&heap->node[i]->peer->session, &peer->session)) {
+      netq_free_node(heap->node[i]);
+    } else {
+      heap->node[count] = heap->node[i];
+      heap->node[count]->index = count;
+      count++;
+    }
+  }
+  heap->count = count;
+
+  for (i = count / 2; i-- > 0; )
+    netq_heap_down(heap, i);
+}
@@ -11,8 +11,9 @@
 
 #include "tinydtls.h"
 #include "global.h"
-#include "dtls.h"
+#include "peer.h"
 #include "dtls_time.h"
+#include "t_list.h"
 
 /**
  * \defgroup netq Network Packet Queue
@@ -30,10 +31,15 @@
 #endif
 #endif
 
-/** 
- * Datagrams in the netq_t structure have a fixed maximum size of
- * DTLS_MAX_BUF to simplify memory management on constrained nodes. */ 
-typedef unsigned char netq_packet_t[DTLS_MAX_BUF];
+#ifndef NETQ_STORAGE_SIZE
+/** Number of bytes available for the datagrams of all netq elements. */
+#define NETQ_STORAGE_SIZE (NETQ_MAXCNT * DTLS_MAX_BUF)
+#endif
+
+#ifndef NETQ_PEER_STORAGE_SIZE
+/** Number of bytes of NETQ_STORAGE_SIZE a single peer may use. */
+#define NETQ_PEER_STORAGE_SIZE NETQ_STORAGE_SIZE
+#endif
 
 typedef struct netq_t {
   struct netq_t *next;
@@ -45,15 +51,29 @@ typedef struct netq_t {
   uint16_t epoch;
   uint8_t type;
   unsigned char retransmit_cnt;	/**< retransmission counter, will be removed when zero */
+  unsigned short index;		/**< position in a netq_heap_t */
 
   size_t length;		/**< actual length of data */
 #ifndef WITH_CONTIKI
   unsigned char data[];		/**< the datagram to send */
 #else
-  netq_packet_t data;		/**< the datagram to send */
+  size_t size;			/**< bytes reserved for data */
+  unsigned char *data;		/**< the datagram to send, taken from
+				 * a storage area of NETQ_STORAGE_SIZE
+				 * bytes shared by all nodes */
 #endif
 } netq_t;
 
+/**
+ * A queue of netq elements ordered by their time-stamp t, kept as a
+ * binary min-heap so that insertion and removal of the earliest element
+ * take O(log n) time.
+ */
+typedef struct netq_heap_t {
+  netq_t *node[NETQ_MAXCNT];
+  unsigned int count;
+} netq_heap_t;
+
 #ifndef WITH_CONTIKI
 static inline void netq_init()
 { }
@@ -79,8 +99,15 @@ void netq_node_free(netq_t *node);
 /** Removes all items from given queue and frees the allocated storage */
 void netq_delete_all(list_t queue);
 
-/** Creates a new node suitable for adding to a netq_t queue. */
-netq_t *netq_node_new(size_t size);
+/**
+ * Creates a new node for @p peer with storage for a datagram of
+ * @p size bytes, suitable for adding to a netq_t queue. This function
+ * returns NULL when no node is left, when the datagram does not fit
+ * in the remaining storage, or when @p peer would use more than
+ * NETQ_PEER_STORAGE_SIZE bytes. The storage limits apply to the
+ * Contiki build, otherwise nodes are allocated with malloc().
+ */
+netq_t *netq_node_new(dtls_peer_t *peer, size_t size);
 
 /**
  * Returns a pointer to the first item in given queue or NULL if
@@ -98,6 +125,32 @@ void netq_remove(list_t queue, netq_t *p);
  */
 netq_t *netq_pop_first(list_t queue);
 
+/**
+ * Adds @p node to @p heap. This function returns @c 0 if @p heap is
+ * full, or non-zero if @p node has been added.
+ */
+int netq_heap_insert(netq_heap_t *heap, netq_t *node);
+
+/** Returns the element of @p heap with the earliest time-stamp, or NULL. */
+static inline netq_t *netq_heap_head(netq_heap_t *heap) {
+  return heap->count ? heap->node[0] : NULL;
+}
+
+/**
+ * Removes the element with the earliest time-stamp from @p heap and
+ * returns it, or returns NULL if @p heap is empty.
+ */
+netq_t *netq_heap_pop(netq_heap_t *heap);
+
+/** Removes @p node from @p heap. */
+void netq_heap_remove(netq_heap_t *heap, netq_t *node);
+
+/**
+ * Removes all elements that are to be sent to the session of @p peer
+ * from @p heap and frees them.
+ */
+void netq_heap_delete_peer(netq_heap_t *heap, dtls_peer_t *peer);
+
 /**@}*/
 
 #endif /* _DTLS_NETQ_H_ */
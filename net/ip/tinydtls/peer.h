@@ -47,6 +47,7 @@ typedef enum { DTLS_CLIENT=0, DTLS_SERVER } dtls_peer_type;
  * for each peer. */
 typedef struct dtls_peer_t {
   struct dtls_peer_t *next;
+  struct dtls_peer_t *hnext; /**< next peer in the same lookup bucket */
 
   session_t session;	     /**< peer address and local interface */
 
@@ -69,6 +69,57 @@ _dtls_address_equals_impl(const session_t *a,
 }
 #endif /* WITH_CONTIKI */
 
+/* FNV-1a, folded over the bytes that identify a session */
+#define FNV_OFFSET_BASIS 2166136261U
+#define FNV_PRIME 16777619U
+
+static inline unsigned int
+_dtls_hash_update(unsigned int h, const void *data, size_t len) {
+  const unsigned char *p = data;
+
+  while (len--) {
+    h ^= *p++;
+    h *= FNV_PRIME;
+  }
+  return h;
+}
+
+#ifdef WITH_CONTIKI
+static inline unsigned int
+_dtls_session_hash_impl(const session_t *sess) {
+  unsigned int h = FNV_OFFSET_BASIS;
+
+  h = _dtls_hash_update(h, &sess->addr.ipaddr, sizeof(sess->addr.ipaddr));
+  h = _dtls_hash_update(h, &sess->addr.port, sizeof(sess->addr.port));
+  return h ^ sess->ifindex;
+}
+
+#else /* WITH_CONTIKI */
+
+static inline unsigned int
+_dtls_session_hash_impl(const session_t *sess) {
+  unsigned int h = FNV_OFFSET_BASIS;
+
+ switch (sess->addr.sa.sa_family) {
+ case AF_INET:
+   h = _dtls_hash_update(h, &sess->addr.sin.sin_addr,
+			 sizeof(struct in_addr));
+   h = _dtls_hash_update(h, &sess->addr.sin.sin_port,
+			 sizeof(sess->addr.sin.sin_port));
+   break;
+ case AF_INET6:
+   h = _dtls_hash_update(h, &sess->addr.sin6.sin6_addr,
+			 sizeof(struct in6_addr));
+   h = _dtls_hash_update(h, &sess->addr.sin6.sin6_port,
+			 sizeof(sess->addr.sin6.sin6_port));
+   break;
+ default:
+   ;
+ }
+ return h ^ sess->ifindex;
+}
+#endif /* WITH_CONTIKI */
+
 void
 dtls_session_init(session_t *sess) {
   assert(sess);
@@ -81,3 +132,9 @@ dtls_session_equals(const session_t *a, const session_t *b) {
   assert(a); assert(b);
   return _dtls_address_equals_impl(a, b);
 }
+
+unsigned int
+dtls_session_hash(const session_t *sess) {
+  assert(sess);
+  return _dtls_session_hash_impl(sess);
+}
@@ -75,4 +75,11 @@ void dtls_session_init(session_t *sess);
  */
 int dtls_session_equals(const session_t *a, const session_t *b);
 
+/**
+ * Computes a hash over the address, port and interface of @p sess.
+ * Sessions that are equal according to dtls_session_equals() have
+ * the same hash.
+ */
+unsigned int dtls_session_hash(const session_t *sess);
+
 #endif /* _DTLS_SESSION_H_ */
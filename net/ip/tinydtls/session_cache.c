@@ -0,0 +1,128 @@
+/* session_cache.c -- Cache of resumable DTLS sessions
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * This file is part of the library tinyDTLS. Please see the file
+ * LICENSE for terms of use.
+ */
+
+#include <string.h>
+
+#include "session_cache.h"
+#include "debug.h"
+
+static dtls_cache_entry_t session_cache[DTLS_SESSION_CACHE_MAX];
+
+static inline void
+dtls_cache_clear(dtls_cache_entry_t *entry) {
+  /* do not leave the master secret behind */
+  memset(entry, 0, sizeof(*entry));
+}
+
+static int
+dtls_cache_expired(dtls_cache_entry_t *entry, dtls_tick_t now) {
+  if (now - entry->timestamp <
+      (dtls_tick_t)DTLS_SESSION_CACHE_LIFETIME * DTLS_TICKS_PER_SECOND)
+    return 0;
+
+  dtls_debug("session cache: session expired\n");
+  dtls_cache_clear(entry);
+  return 1;
+}
+
+void
+dtls_cache_init(void) {
+  memset(session_cache, 0, sizeof(session_cache));
+}
+
+dtls_cache_entry_t *
+dtls_cache_add(const session_t *session, dtls_peer_type role,
+	       const uint8 *id, size_t id_length,
+	       dtls_cipher_t cipher, const uint8 *master_secret) {
+  dtls_cache_entry_t *entry = NULL, *unused = NULL, *oldest = NULL;
+  dtls_cache_entry_t *e;
+  dtls_tick_t now;
+
+  if (id_length == 0 || id_length > DTLS_SESSION_ID_LENGTH_MAX)
+    return NULL;
+
+  dtls_ticks(&now);
+
+  /* Take the slot of the previous session with this peer, else a free
+   * one, else the oldest one. */
+  for (e = session_cache; e < session_cache + DTLS_SESSION_CACHE_MAX; e++) {
+    if (!e->id_length) {
+      if (!unused)
+	unused = e;
+    } else if (e->role == role && dtls_session_equals(&e->session, session)) {
+      entry = e;
+      break;
+    } else if (!oldest || now - e->timestamp > now - oldest->timestamp) {
+      oldest = e;
+    }
+  }
+
+  if (!entry)
+    entry = unused ? unused : oldest;
+
+  dtls_cache_clear(entry);
+
+  memcpy(&entry->session, session, sizeof(session_t));
+  entry->timestamp = now;
+  entry->role = role;
+  entry->cipher = cipher;
+  entry->id_length = id_length;
+  memcpy(entry->id, id, id_length);
+  memcpy(entry->master_secret, master_secret, DTLS_MASTER_SECRET_LENGTH);
+
+  dtls_dsrv_log_addr(DTLS_LOG_DEBUG, "session cache: added", session);
+
+  return entry;
+}
+
+dtls_cache_entry_t *
+dtls_cache_find_id(const uint8 *id, size_t id_length) {
+  dtls_cache_entry_t *e;
+  dtls_tick_t now;
+
+  if (id_length == 0)
+    return NULL;
+
+  dtls_ticks(&now);
+
+  for (e = session_cache; e < session_cache + DTLS_SESSION_CACHE_MAX; e++) {
+    if (e->role == DTLS_SERVER && e->id_length == id_length &&
+	memcmp(e->id, id, id_length) == 0)
+      return dtls_cache_expired(e, now) ? NULL : e;
+  }
+
+  return NULL;
+}
+
+dtls_cache_entry_t *
+dtls_cache_find_peer(const session_t *session) {
+  dtls_cache_entry_t *e;
+  dtls_tick_t now;
+
+  dtls_ticks(&now);
+
+  for (e = session_cache; e < session_cache + DTLS_SESSION_CACHE_MAX; e++) {
+    if (e->role == DTLS_CLIENT && e->id_length &&
+	dtls_session_equals(&e->session, session))
+      return dtls_cache_expired(e, now) ? NULL : e;
+  }
+
+  return NULL;
+}
+
+void
+dtls_cache_remove(const session_t *session) {
+  dtls_cache_entry_t *e;
+
+  for (e = session_cache; e < session_cache + DTLS_SESSION_CACHE_MAX; e++) {
+    if (e->id_length && dtls_session_equals(&e->session, session)) {
+      dtls_dsrv_log_addr(DTLS_LOG_DEBUG, "session cache: removed", session);
+      dtls_cache_clear(e);
+    }
+  }
+}
@@ -0,0 +1,97 @@
+/* session_cache.h -- Cache of resumable DTLS sessions
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * This file is part of the library tinyDTLS. Please see the file
+ * LICENSE for terms of use.
+ */
+
+#ifndef _DTLS_SESSION_CACHE_H_
+#define _DTLS_SESSION_CACHE_H_
+
+#include "tinydtls.h"
+#include "global.h"
+#include "session.h"
+#include "peer.h"
+#include "crypto.h"
+#include "dtls_time.h"
+
+/**
+ * \defgroup session_cache Session Cache
+ * The session cache keeps the master secret of established sessions
+ * so that a peer can resume its session with an abbreviated handshake
+ * (RFC 5246, section 7.3) instead of running the key exchange again.
+ * A server looks its sessions up by the session id that the client
+ * offers in its ClientHello, a client by the address of the server it
+ * connects to.
+ * @{
+ */
+
+#ifndef DTLS_SESSION_CACHE_MAX
+/** The maximum number of cached sessions. */
+#define DTLS_SESSION_CACHE_MAX 4
+#endif
+
+#ifndef DTLS_SESSION_CACHE_LIFETIME
+/** Seconds after its full handshake after which a session cannot
+ *  be resumed anymore. */
+#define DTLS_SESSION_CACHE_LIFETIME 3600
+#endif
+
+typedef struct dtls_cache_entry_t {
+  session_t session;		/**< address of the remote peer */
+  dtls_tick_t timestamp;	/**< time of the full handshake */
+  dtls_peer_type role;		/**< our role in the cached session */
+  dtls_cipher_t cipher;		/**< cipher suite of the session */
+  uint8 id_length;		/**< length of id, 0 for a free entry */
+  uint8 id[DTLS_SESSION_ID_LENGTH_MAX]; /**< the session id */
+  uint8 master_secret[DTLS_MASTER_SECRET_LENGTH];
+} dtls_cache_entry_t;
+
+/** Empties the session cache. */
+void dtls_cache_init(void);
+
+/**
+ * Stores a session that has been established with a full handshake.
+ * An older session of the same role with the same peer is replaced.
+ * When the cache is full, the oldest session is evicted.
+ *
+ * @param session       The address of the remote peer.
+ * @param role          Our role in the session.
+ * @param id            The session id assigned by the server.
+ * @param id_length     The length of @p id.
+ * @param cipher        The cipher suite negotiated for the session.
+ * @param master_secret The master secret of the session.
+ * @return The new cache entry, or NULL if @p id is invalid.
+ */
+dtls_cache_entry_t *dtls_cache_add(const session_t *session,
+				   dtls_peer_type role,
+				   const uint8 *id, size_t id_length,
+				   dtls_cipher_t cipher,
+				   const uint8 *master_secret);
+
+/**
+ * Looks up the server side session with the given @p id.
+ *
+ * @return The cache entry or NULL if there is no such session or it
+ * has expired.
+ */
+dtls_cache_entry_t *dtls_cache_find_id(const uint8 *id, size_t id_length);
+
+/**
+ * Looks up the client side session with the server at @p session.
+ *
+ * @return The cache entry or NULL if there is no such session or it
+ * has expired.
+ */
+dtls_cache_entry_t *dtls_cache_find_peer(const session_t *session);
+
+/**
+ * Removes all sessions with the peer at @p session from the cache,
+ * e.g. because the connection was terminated by a fatal alert.
+ */
+void dtls_cache_remove(const session_t *session);
+
+/** @} */
+
+#endif /* _DTLS_SESSION_CACHE_H_ */
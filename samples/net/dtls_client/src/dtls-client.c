@@ -61,6 +61,7 @@ struct data {
 	bool fail;
 	bool connected;
 	int expecting;
+	int received;
 	int ipsum_len;
 	struct net_context *ctx;
 };
@@ -123,6 +124,12 @@ static inline void reverse(unsigned char *buf, int len)
 #define WAIT_TIME 5
 #define WAIT_TICKS (WAIT_TIME * sys_clock_ticks_per_sec)
 
+/* How many messages to exchange before closing the connection and
+ * connecting again. With CONFIG_TINYDTLS_SESSION_CACHE the reconnect
+ * resumes the session with an abbreviated handshake.
+ */
+#define MESSAGES_PER_CONNECTION 10
+
 static inline void send_message(const char *name,
 				dtls_context_t *ctx,
 				session_t *session)
@@ -175,6 +182,28 @@ static inline bool wait_reply(const char *name,
 	return false;
 }
 
+static void reconnect(dtls_context_t *dtls, session_t *session)
+{
+	struct data *user_data = (struct data *)dtls_get_app_data(dtls);
+
+	PRINT("Closing the connection and connecting again\n");
+
+	user_data->received = 0;
+
+	dtls_close(dtls, session);
+
+	/* The peer is removed when the server confirms the close_notify */
+	while (dtls_get_peer(dtls, session)) {
+		if (!wait_reply(__func__, dtls, session)) {
+			PRINT("ERROR: Connection was not closed.\n");
+			user_data->fail = true;
+			return;
+		}
+	}
+
+	dtls_connect(dtls, session);
+}
+
 #ifdef CONFIG_NETWORKING_WITH_IPV6
 static const struct in6_addr in6addr_peer = PEER_IPADDR;
 #else
@@ -244,6 +273,8 @@ static int read_from_peer(struct dtls_context_t *ctx,
 	if (memcmp(lorem_ipsum + pos, data, user_data->expecting)) {
 		PRINT("%s: received data mismatch.\n", __func__);
 		user_data->fail = true;
+	} else {
+		user_data->received++;
 	}
 
 	return 0;
@@ -370,6 +401,12 @@ static int handle_event(struct dtls_context_t *ctx, session_t *session,
 
 	if (level > 0) {
 		/* alert code, quit */
+		if (code == DTLS_ALERT_CLOSE_NOTIFY) {
+			struct data *user_data =
+				(struct data *)dtls_get_app_data(ctx);
+
+			user_data->connected = false;
+		}
 	} else if (level == 0) {
 		/* internal event */
 		if (code == DTLS_EVENT_CONNECTED) {
@@ -451,6 +488,11 @@ void startup(void)
 	dtls_connect(dtls, &session);
 
 	while (!user_data.fail) {
+		if (user_data.connected &&
+		    user_data.received == MESSAGES_PER_CONNECTION) {
+			reconnect(dtls, &session);
+			continue;
+		}
 		if (user_data.connected) {
 			send_message(__func__, dtls, &session);
 		}
@@ -32,9 +32,11 @@
 
 #define STACKSIZE 2000
 
-#define NUM_PENDINGS 3
 #define NUM_REPLIES 3
 
+/* Confirmable requests awaiting an acknowledgment at once */
+#define NSTART 1
+
 #define ALL_NODES_LOCAL_COAP_MCAST \
 	{ { { 0xff, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xfd } } }
 
@@ -42,12 +44,21 @@ char fiberStack[STACKSIZE];
 
 static struct net_context *send_context, *receive_context;
 
-struct zoap_pending pendings[NUM_PENDINGS];
 struct zoap_reply replies[NUM_REPLIES];
-struct nano_delayed_work retransmit_work;
+
+/* Retransmissions are handled by the transaction engine */
+static struct zoap_transactions transactions;
+static struct zoap_transaction observe_transaction, large_transaction;
 
 static const char * const test_path[] = { "test", NULL };
 
+static const char * const large_path[] = { "large", NULL };
+
+static const uint8_t large_token[] = { 0x6c, 0x61 };
+
+/* The "large" resource is fetched block-wise, one request per block */
+static struct zoap_block_context large_ctx;
+
 static void msg_dump(const char *s, uint8_t *data, unsigned len)
 {
 	unsigned i;
@@ -70,10 +81,81 @@ static int resource_reply_cb(const struct zoap_packet *response,
 	return 0;
 }
 
+/*
+ * Sending a buffer gives it away, so each (re)transmission sends a copy
+ * of the request.
+ */
+static int send_request(struct zoap_transaction *transaction)
+{
+	struct net_buf *request = transaction->request.buf;
+	struct net_buf *buf;
+	int r;
+
+	buf = ip_buf_get_tx(send_context);
+	if (!buf) {
+		return -ENOMEM;
+	}
+
+	memcpy(ip_buf_appdata(buf), ip_buf_appdata(request),
+	       ip_buf_appdatalen(request));
+	ip_buf_appdatalen(buf) = ip_buf_appdatalen(request);
+
+	r = net_send(buf);
+	if (r < 0) {
+		ip_buf_unref(buf);
+	}
+
+	return r;
+}
+
+static void request_done(struct zoap_transaction *transaction,
+			 const struct zoap_packet *response)
+{
+	if (!response) {
+		printf("Request timed out\n");
+	}
+
+	ip_buf_unref(transaction->request.buf);
+}
+
+static int send_large_request(void);
+
+static int large_reply_cb(const struct zoap_packet *response,
+			  struct zoap_reply *reply,
+			  const uip_ipaddr_t *addr,
+			  uint16_t port)
+{
+	struct net_buf *buf = response->buf;
+	uint16_t len = 0;
+	int r;
+
+	if (response->start) {
+		len = ip_buf_appdatalen(buf) -
+			(response->start - (uint8_t *)ip_buf_appdata(buf));
+	}
+
+	r = zoap_update_from_block(response, &large_ctx);
+	if (r < 0) {
+		printf("large: not block-wise (%d), %u bytes\n", r, len);
+		zoap_reply_clear(reply);
+		return 0;
+	}
+
+	printf("large: %u bytes at %zu\n", len, large_ctx.current);
+
+	zoap_reply_clear(reply);
+
+	if (!zoap_next_block(&large_ctx)) {
+		printf("large: done\n");
+		return 0;
+	}
+
+	return send_large_request();
+}
+
 static void udp_receive(void)
 {
 	struct zoap_packet response;
-	struct zoap_pending *pending;
 	struct zoap_reply *reply;
 	struct net_buf *buf;
 	int r;
@@ -94,11 +176,8 @@ static void udp_receive(void)
 
 		conn = uip_conn(buf);
 
-		pending = zoap_pending_received(&response, pendings,
-						NUM_PENDINGS);
-		if (pending) {
-			/* If necessary cancel retransmissions */
-		}
+		/* Stops the retransmissions of the request answered */
+		zoap_transaction_received(&transactions, &response);
 
 		reply = zoap_response_received(&response,
 					       &conn->ripaddr,
@@ -111,34 +190,65 @@ static void udp_receive(void)
 	}
 }
 
-static void retransmit_request(struct nano_work *work)
+static int send_large_request(void)
 {
-	struct zoap_pending *pending;
-	struct zoap_packet *request;
+	struct zoap_packet request;
+	struct zoap_reply *reply;
+	const char * const *p;
 	struct net_buf *buf;
-	int r, timeout;
+	int r;
 
-	pending = zoap_pending_next_to_expire(pendings, NUM_PENDINGS);
-	if (!pending) {
-		return;
+	buf = ip_buf_get_tx(send_context);
+	if (!buf) {
+		return -ENOMEM;
 	}
 
-	request = &pending->request;
-	buf = request->buf;
+	r = zoap_packet_init(&request, buf);
+	if (r < 0) {
+		goto fail;
+	}
 
-	r = net_send(buf);
+	/* FIXME: Could be that zoap_packet_init() sets some defaults */
+	zoap_header_set_version(&request, 1);
+	zoap_header_set_type(&request, ZOAP_TYPE_CON);
+	zoap_header_set_code(&request, ZOAP_METHOD_GET);
+	zoap_header_set_id(&request, zoap_next_id());
+	zoap_header_set_token(&request, large_token, sizeof(large_token));
+
+	for (p = large_path; p && *p; p++) {
+		r = zoap_add_option(&request, ZOAP_OPTION_URI_PATH,
+				     *p, strlen(*p));
+		if (r < 0) {
+			goto fail;
+		}
+	}
+
+	r = zoap_add_block2_option(&request, &large_ctx);
 	if (r < 0) {
-		return;
+		goto fail;
 	}
 
-	if (!zoap_pending_cycle(pending)) {
-		net_buf_unref(buf);
-		zoap_pending_clear(pending);
-		return;
+	reply = zoap_reply_next_unused(replies, NUM_REPLIES);
+	if (!reply) {
+		r = -ENOMEM;
+		goto fail;
 	}
 
-	timeout = pending->timeout * (sys_clock_ticks_per_sec / MSEC_PER_SEC);
-	nano_delayed_work_submit(&retransmit_work, timeout);
+	zoap_reply_init(reply, &request);
+	reply->reply = large_reply_cb;
+
+	r = zoap_transaction_start(&transactions, &large_transaction,
+				   &request, request_done, NULL);
+	if (r < 0) {
+		printk("Error sending the packet (%d).\n", r);
+	}
+
+	/* The buffer is released when the transaction is done */
+	return 0;
+
+fail:
+	net_buf_unref(buf);
+	return r;
 }
 
 void main(void)
@@ -149,11 +259,10 @@ void main(void)
 	static struct net_addr any_addr = { .in6_addr = IN6ADDR_ANY_INIT,
 					   .family = AF_INET6 };
 	struct zoap_packet request;
-	struct zoap_pending *pending;
 	struct zoap_reply *reply;
 	const char * const *p;
 	struct net_buf *buf;
-	int r, timeout;
+	int r;
 	uint8_t observe = 0;
 
 	net_init();
@@ -170,7 +279,7 @@ void main(void)
 	task_fiber_start(&fiberStack[0], STACKSIZE,
 			(nano_fiber_entry_t) udp_receive, 0, 0, 7, 0);
 
-	nano_delayed_work_init(&retransmit_work, retransmit_request);
+	zoap_transactions_init(&transactions, send_request, NSTART);
 
 	buf = ip_buf_get_tx(send_context);
 	if (!buf) {
@@ -206,19 +315,6 @@ void main(void)
 		}
 	}
 
-	pending = zoap_pending_next_unused(pendings, NUM_PENDINGS);
-	if (!pending) {
-		printk("Unable to find a free pending to track "
-		       "retransmissions.\n");
-		return;
-	}
-
-	r = zoap_pending_init(pending, &request);
-	if (r < 0) {
-		printk("Unable to initialize a pending retransmission.\n");
-		return;
-	}
-
 	reply = zoap_reply_next_unused(replies, NUM_REPLIES);
 	if (!reply) {
 		printk("No resources for waiting for replies.\n");
@@ -228,13 +324,21 @@ void main(void)
 	zoap_reply_init(reply, &request);
 	reply->reply = resource_reply_cb;
 
-	r = net_send(buf);
+	r = zoap_transaction_start(&transactions, &observe_transaction,
+				   &request, request_done, NULL);
 	if (r < 0) {
 		printk("Error sending the packet (%d).\n", r);
 	}
 
-	zoap_pending_cycle(pending);
-	timeout = pending->timeout * (sys_clock_ticks_per_sec / MSEC_PER_SEC);
+	/*
+	 * Sent once the first request is acknowledged, NSTART allows one
+	 * at a time. Ask for small blocks, the server may pick even
+	 * smaller ones.
+	 */
+	zoap_block_transfer_init(&large_ctx, ZOAP_BLOCK_32, 0);
 
-	nano_delayed_work_submit(&retransmit_work, timeout);
+	r = send_large_request();
+	if (r < 0) {
+		printk("Unable to fetch the large resource (%d).\n", r);
+	}
 }
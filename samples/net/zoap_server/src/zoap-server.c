@@ -310,12 +310,180 @@ static int query_get(struct zoap_resource *resource,
 	return net_reply(context, buf);
 }
 
+/* Size of the generated representation of the "large" resource */
+#define LARGE_SIZE 2048
+
+#define NUM_TRANSFERS 2
+
+static struct zoap_block_transfer transfers[NUM_TRANSFERS];
+
+/*
+ * The "large" representation is produced one block at a time, so it is
+ * never held in memory as a whole.
+ */
+static int large_read(struct zoap_resource *resource, size_t offset,
+		      uint8_t *data, uint16_t len)
+{
+	uint16_t i;
+
+	if (offset >= LARGE_SIZE) {
+		return 0;
+	}
+
+	len = min(len, LARGE_SIZE - offset);
+
+	for (i = 0; i < len; i++) {
+		data[i] = 'a' + (offset + i) % 26;
+	}
+
+	return len;
+}
+
+static int large_get(struct zoap_resource *resource,
+		     struct zoap_packet *request,
+		     const uip_ipaddr_t *addr,
+		     uint16_t port)
+{
+	struct zoap_block_context ctx;
+	struct net_buf *buf;
+	struct zoap_packet response;
+	const uint8_t *token;
+	uint8_t tk[8], tkl;
+	uint16_t id;
+	int r;
+
+	id = zoap_header_get_id(request);
+	token = zoap_header_get_token(request, &tkl);
+	memcpy(tk, token, tkl);
+
+	/* No transfer state is needed: the request names the block */
+	zoap_block_transfer_init(&ctx, ZOAP_BLOCK_64, LARGE_SIZE);
+
+	r = zoap_update_from_block(request, &ctx);
+	if (r == -EINVAL) {
+		return r;
+	}
+
+	/* Re-using the request buffer for the response */
+	buf = request->buf;
+
+	r = zoap_packet_init(&response, buf);
+	if (r < 0) {
+		return -EINVAL;
+	}
+
+	/* FIXME: Could be that zoap_packet_init() sets some defaults */
+	zoap_header_set_version(&response, 1);
+	zoap_header_set_type(&response, ZOAP_TYPE_ACK);
+	zoap_header_set_code(&response, ZOAP_RESPONSE_CODE_CONTENT);
+	zoap_header_set_id(&response, id);
+	zoap_header_set_token(&response, tk, tkl);
+
+	r = zoap_block2_respond(resource, &response, &ctx, large_read);
+	if (r < 0) {
+		return -EINVAL;
+	}
+
+	NET_INFO("large: block at %zu of %u\n", ctx.current, LARGE_SIZE);
+
+	return net_reply(context, buf);
+}
+
+static int large_update_write(struct zoap_resource *resource, size_t offset,
+			      const uint8_t *data, uint16_t len, bool last)
+{
+	NET_INFO("large-update: %u bytes at %zu%s\n", len, offset,
+		 last ? " (last)" : "");
+
+	return 0;
+}
+
+static int large_update_put(struct zoap_resource *resource,
+			    struct zoap_packet *request,
+			    const uip_ipaddr_t *addr,
+			    uint16_t port)
+{
+	struct zoap_block_transfer *transfer;
+	struct zoap_block_context ctx;
+	struct net_buf *buf;
+	struct zoap_packet response;
+	const uint8_t *token;
+	uint8_t code, tk[8], tkl;
+	uint16_t id;
+	int r;
+
+	id = zoap_header_get_id(request);
+	token = zoap_header_get_token(request, &tkl);
+	memcpy(tk, token, tkl);
+
+	transfer = zoap_block_transfer_find(transfers, NUM_TRANSFERS,
+					    resource, addr, port);
+	if (!transfer) {
+		transfer = zoap_block_transfer_next_unused(transfers,
+							   NUM_TRANSFERS);
+		if (!transfer) {
+			return -ENOMEM;
+		}
+
+		zoap_block_transfer_init(&transfer->ctx, ZOAP_BLOCK_64, 0);
+		transfer->resource = resource;
+		uip_ipaddr_copy(&transfer->addr, addr);
+		transfer->port = port;
+	}
+
+	r = zoap_block1_receive(resource, request, &transfer->ctx,
+				large_update_write);
+	if (r == -EAGAIN) {
+		code = ZOAP_RESPONSE_CODE_INCOMPLETE;
+	} else if (r < 0) {
+		code = ZOAP_RESPONSE_CODE_BAD_REQUEST;
+	} else if (transfer->ctx.more) {
+		code = ZOAP_RESPONSE_CODE_CONTINUE;
+	} else {
+		code = ZOAP_RESPONSE_CODE_CHANGED;
+	}
+
+	/* The request buffer is re-used, keep what the ACK echoes */
+	ctx = transfer->ctx;
+	if (code != ZOAP_RESPONSE_CODE_CONTINUE) {
+		zoap_block_transfer_clear(transfer);
+	}
+
+	buf = request->buf;
+
+	r = zoap_packet_init(&response, buf);
+	if (r < 0) {
+		return -EINVAL;
+	}
+
+	/* FIXME: Could be that zoap_packet_init() sets some defaults */
+	zoap_header_set_version(&response, 1);
+	zoap_header_set_type(&response, ZOAP_TYPE_ACK);
+	zoap_header_set_code(&response, code);
+	zoap_header_set_id(&response, id);
+	zoap_header_set_token(&response, tk, tkl);
+
+	if (code == ZOAP_RESPONSE_CODE_CONTINUE ||
+	    code == ZOAP_RESPONSE_CODE_CHANGED) {
+		r = zoap_add_block1_option(&response, &ctx);
+		if (r < 0) {
+			return -EINVAL;
+		}
+	}
+
+	return net_reply(context, buf);
+}
+
 static const char * const test_path[] = { "test", NULL };
 
 static const char * const segments_path[] = { "seg1", "seg2", "seg3", NULL };
 
 static const char * const query_path[] = { "query", NULL };
 
+static const char * const large_path[] = { "large", NULL };
+
+static const char * const large_update_path[] = { "large-update", NULL };
+
 static struct zoap_resource resources[] = {
 	{ .get = piggyback_get,
 	  .post = test_post,
@@ -328,9 +496,19 @@ static struct zoap_resource resources[] = {
 	{ .get = query_get,
 	  .path = query_path,
 	},
+	{ .get = large_get,
+	  .path = large_path,
+	},
+	{ .put = large_update_put,
+	  .path = large_update_path,
+	},
 	{ },
 };
 
+/* One entry per distinct path prefix */
+static struct zoap_resource_index_entry index_entries[8];
+static struct zoap_resource_index resource_index;
+
 static void udp_receive(void)
 {
 	struct net_buf *buf;
@@ -353,8 +531,9 @@ static void udp_receive(void)
 
 		conn = uip_conn(buf);
 
-		r = zoap_handle_request(&request, resources, &conn->ripaddr,
-					sys_be16_to_cpu(conn->rport));
+		r = zoap_handle_request_indexed(&request, &resource_index,
+						&conn->ripaddr,
+						sys_be16_to_cpu(conn->rport));
 		if (r < 0) {
 			printf("No handler for such request (%d)\n", r);
 			continue;
@@ -372,6 +551,12 @@ void main(void)
 
 	net_init();
 
+	if (zoap_resource_index_build(&resource_index, index_entries,
+				      ARRAY_SIZE(index_entries), resources)) {
+		printf("Unable to build the resource index\n");
+		return;
+	}
+
 #if defined(CONFIG_NET_TESTING)
 	net_testing_setup();
 #endif
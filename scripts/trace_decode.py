@@ -0,0 +1,321 @@
+#!/usr/bin/env python
+#
+# Copyright (c) 2016 Wind River Systems, Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+"""Decode kernel trace records (CONFIG_KERNEL_TRACING).
+
+The input is either a console log containing the lines printed by the trace
+dump thread (CONFIG_KERNEL_TRACING_DUMP), or a raw binary dump of
+struct k_trace_record entries, e.g. copied out of RAM with a debugger.
+
+The decoder prints a summary (per-thread CPU usage, lock contention and ISR
+durations) and can write a timeline in the Chrome trace event format, which
+can be loaded in chrome://tracing or Perfetto.
+"""
+
+from __future__ import print_function
+
+import argparse
+import json
+import re
+import struct
+import sys
+
+K_TRACE_CONTEXT_SWITCH = 0x01
+K_TRACE_ISR_ENTER = 0x02
+K_TRACE_ISR_EXIT = 0x03
+K_TRACE_IDLE_ENTER = 0x04
+K_TRACE_SEM_GIVE = 0x10
+K_TRACE_SEM_TAKE = 0x11
+K_TRACE_SEM_TAKE_BLOCK = 0x12
+K_TRACE_MUTEX_LOCK = 0x20
+K_TRACE_MUTEX_LOCK_BLOCK = 0x21
+K_TRACE_MUTEX_UNLOCK = 0x22
+K_TRACE_FIFO_PUT = 0x30
+K_TRACE_FIFO_GET = 0x31
+K_TRACE_FIFO_GET_BLOCK = 0x32
+K_TRACE_WORK_START = 0x40
+K_TRACE_WORK_END = 0x41
+K_TRACE_USER = 0x80
+
+EVENT_NAMES = {
+    K_TRACE_CONTEXT_SWITCH: "switch",
+    K_TRACE_ISR_ENTER: "isr_enter",
+    K_TRACE_ISR_EXIT: "isr_exit",
+    K_TRACE_IDLE_ENTER: "idle",
+    K_TRACE_SEM_GIVE: "sem_give",
+    K_TRACE_SEM_TAKE: "sem_take",
+    K_TRACE_SEM_TAKE_BLOCK: "sem_take_block",
+    K_TRACE_MUTEX_LOCK: "mutex_lock",
+    K_TRACE_MUTEX_LOCK_BLOCK: "mutex_lock_block",
+    K_TRACE_MUTEX_UNLOCK: "mutex_unlock",
+    K_TRACE_FIFO_PUT: "fifo_put",
+    K_TRACE_FIFO_GET: "fifo_get",
+    K_TRACE_FIFO_GET_BLOCK: "fifo_get_block",
+    K_TRACE_WORK_START: "work_start",
+    K_TRACE_WORK_END: "work_end",
+}
+
+# timestamp, event_id, in_isr, thread, data
+RECORD = struct.Struct("<IHHII")
+
+line_re = re.compile(r"KTRACE ([0-9a-fA-F]{8}) ([0-9a-fA-F]{4}) "
+                     r"([0-9a-fA-F]{4}) ([0-9a-fA-F]{8}) ([0-9a-fA-F]{8})")
+hz_re = re.compile(r"KTRACE-HZ (\d+)")
+dropped_re = re.compile(r"KTRACE-DROPPED (\d+)")
+
+
+class Record(object):
+    def __init__(self, timestamp, event_id, in_isr, thread, data):
+        self.timestamp = timestamp
+        self.event_id = event_id
+        self.in_isr = in_isr
+        self.thread = thread
+        self.data = data
+
+
+def read_text(f):
+    records = []
+    hz = None
+    dropped = 0
+
+    for line in f:
+        m = line_re.search(line)
+        if m:
+            records.append(Record(*[int(x, 16) for x in m.groups()]))
+            continue
+        m = hz_re.search(line)
+        if m:
+            hz = int(m.group(1))
+            continue
+        m = dropped_re.search(line)
+        if m:
+            dropped = int(m.group(1))
+
+    return records, hz, dropped
+
+
+def read_binary(data):
+    records = []
+    for off in range(0, len(data) - RECORD.size + 1, RECORD.size):
+        records.append(Record(*RECORD.unpack_from(data, off)))
+    return records
+
+
+def unwrap(records):
+    """Turn the 32-bit cycle counter into a monotonic 64-bit count."""
+    base = 0
+    last = None
+    stamps = []
+    for r in records:
+        if last is not None and r.timestamp < last:
+            base += 1 << 32
+        last = r.timestamp
+        stamps.append(base + r.timestamp)
+    return stamps
+
+
+def thread_name(addr, names):
+    return names.get(addr, "0x%08x" % addr)
+
+
+class Analysis(object):
+    def __init__(self, records, hz, names):
+        self.hz = hz
+        self.names = names
+        self.events = []
+        self.cpu = {}
+        self.isr = {}
+        self.contention = {}
+        self.total = 0
+
+        if not records:
+            return
+
+        stamps = unwrap(records)
+        t0 = stamps[0]
+        self.total = stamps[-1] - t0
+
+        running = records[0].thread
+        run_start = t0
+        isr_stack = []
+        blocked = {}
+
+        for r, ts in zip(records, stamps):
+            ev = r.event_id
+
+            if ev == K_TRACE_CONTEXT_SWITCH:
+                self._slice(running, run_start, ts, t0)
+                running = r.data
+                run_start = ts
+                # a thread blocked on a mutex runs again once it owns it
+                if running in blocked:
+                    obj, start = blocked.pop(running)
+                    self._contended(obj, ts - start)
+            elif ev == K_TRACE_ISR_ENTER:
+                isr_stack.append((r.data, ts))
+            elif ev == K_TRACE_ISR_EXIT:
+                if isr_stack:
+                    key, start = isr_stack.pop()
+                    self._isr(key, start, ts, t0)
+            elif ev == K_TRACE_MUTEX_LOCK_BLOCK:
+                blocked[r.thread] = (r.data, ts)
+            elif ev == K_TRACE_MUTEX_LOCK:
+                if r.thread in blocked:
+                    obj, start = blocked.pop(r.thread)
+                    self._contended(obj, ts - start)
+            elif ev == K_TRACE_WORK_START:
+                self._instant(r, ts, t0, "B")
+                continue
+            elif ev == K_TRACE_WORK_END:
+                self._instant(r, ts, t0, "E")
+                continue
+
+            if ev != K_TRACE_CONTEXT_SWITCH:
+                self._instant(r, ts, t0, "i")
+
+        self._slice(running, run_start, stamps[-1], t0)
+
+    def us(self, cycles):
+        return cycles * 1000000.0 / self.hz
+
+    def _slice(self, thread, start, end, t0):
+        self.cpu[thread] = self.cpu.get(thread, 0) + (end - start)
+        if end > start:
+            self.events.append({
+                "name": thread_name(thread, self.names),
+                "cat": "thread", "ph": "X", "pid": 0, "tid": thread,
+                "ts": self.us(start - t0), "dur": self.us(end - start),
+            })
+
+    def _isr(self, key, start, end, t0):
+        stats = self.isr.setdefault(key, [0, 0, 0])
+        stats[0] += 1
+        stats[1] += end - start
+        stats[2] = max(stats[2], end - start)
+        self.events.append({
+            "name": "isr 0x%x" % key, "cat": "isr", "ph": "X",
+            "pid": 0, "tid": "isr", "ts": self.us(start - t0),
+            "dur": self.us(end - start),
+        })
+
+    def _contended(self, obj, cycles):
+        stats = self.contention.setdefault(obj, [0, 0, 0])
+        stats[0] += 1
+        stats[1] += cycles
+        stats[2] = max(stats[2], cycles)
+
+    def _instant(self, r, ts, t0, ph):
+        name = EVENT_NAMES.get(r.event_id, "user 0x%x" % r.event_id)
+        ev = {
+            "name": name, "cat": "kernel", "ph": ph, "pid": 0,
+            "tid": "isr" if r.in_isr else r.thread,
+            "ts": self.us(ts - t0), "args": {"data": "0x%08x" % r.data},
+        }
+        if ph == "i":
+            ev["s"] = "t"
+        self.events.append(ev)
+
+    def timeline(self):
+        meta = []
+        for tid in set(e["tid"] for e in self.events):
+            name = "ISR" if tid == "isr" else thread_name(tid, self.names)
+            meta.append({"name": "thread_name", "ph": "M", "pid": 0,
+                         "tid": tid, "args": {"name": name}})
+        # Chrome wants numeric tids: map the ISR track to 0
+        for e in meta + self.events:
+            if e["tid"] == "isr":
+                e["tid"] = 0
+        return {"traceEvents": meta + self.events,
+                "displayTimeUnit": "ns"}
+
+    def summary(self, out, dropped):
+        total = float(self.total) or 1.0
+
+        print("Trace: %.1f us, %d cycles/s" % (self.us(self.total), self.hz),
+              file=out)
+        if dropped:
+            print("WARNING: %d records dropped, results are partial" %
+                  dropped, file=out)
+
+        print("\nThread CPU usage:", file=out)
+        for thread, cycles in sorted(self.cpu.items(),
+                                     key=lambda x: -x[1]):
+            print("  %-20s %6.2f%% %12.1f us" %
+                  (thread_name(thread, self.names), 100 * cycles / total,
+                   self.us(cycles)), file=out)
+
+        print("\nLock contention (mutex):", file=out)
+        if not self.contention:
+            print("  none", file=out)
+        for obj, (n, tot, worst) in sorted(self.contention.items(),
+                                           key=lambda x: -x[1][1]):
+            print("  0x%08x %6d waits, avg %10.1f us, max %10.1f us" %
+                  (obj, n, self.us(tot) / n, self.us(worst)), file=out)
+
+        print("\nISR durations:", file=out)
+        if not self.isr:
+            print("  none", file=out)
+        for key, (n, tot, worst) in sorted(self.isr.items()):
+            print("  0x%08x %6d calls, avg %10.1f us, max %10.1f us" %
+                  (key, n, self.us(tot) / n, self.us(worst)), file=out)
+
+
+def parse_names(args):
+    names = {}
+    for spec in args or []:
+        addr, _, name = spec.partition("=")
+        names[int(addr, 16)] = name
+    return names
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", help="console log or binary record dump")
+    parser.add_argument("-b", "--binary", action="store_true",
+                        help="input is a raw binary dump of records")
+    parser.add_argument("--hz", type=int,
+                        help="cycle counter frequency (default: taken "
+                        "from the KTRACE-HZ line)")
+    parser.add_argument("-o", "--output",
+                        help="write a Chrome/Perfetto JSON timeline")
+    parser.add_argument("-n", "--name", action="append", metavar="ADDR=NAME",
+                        help="name a thread, e.g. 0x00102340=main")
+    args = parser.parse_args()
+
+    dropped = 0
+    hz = None
+    if args.binary:
+        with open(args.input, "rb") as f:
+            records = read_binary(f.read())
+    else:
+        with open(args.input, "r") as f:
+            records, hz, dropped = read_text(f)
+
+    hz = args.hz or hz
+    if not hz:
+        sys.exit("cycle counter frequency unknown, use --hz")
+
+    analysis = Analysis(records, hz, parse_names(args.name))
+    analysis.summary(sys.stdout, dropped)
+
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(analysis.timeline(), f)
+
+
+if __name__ == "__main__":
+    main()
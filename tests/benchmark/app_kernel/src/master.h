@@ -49,6 +49,7 @@
 #define NR_OF_NOP_RUNS 10000
 #define NR_OF_FIFO_RUNS 500
 #define NR_OF_SEMA_RUNS 500
+#define SEMA_BURST 25
 #define NR_OF_MUTEX_RUNS 1000
 #define NR_OF_POOL_RUNS 1000
 #define NR_OF_MAP_RUNS 1000
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2016 Wind River Systems, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * @file
+ * @brief Periodic taskset scheduled with and without deadlines
+ *
+ * Three periodic tasks of the same priority each run a job every period,
+ * which must complete before the next release. The taskset uses 70% of the
+ * CPU. It runs twice: first without deadlines, where a task that becomes
+ * ready waits for the running one to complete its job, then with a deadline
+ * set for each job, where the job with the earliest deadline runs first.
+ *
+ * The tasks are released together, the one with the longest period first,
+ * so that without deadlines the task with the shortest period misses its
+ * deadline. With deadlines, no job may complete late.
+ */
+
+#include <zephyr.h>
+#include <tc_util.h>
+#include <misc/util.h>
+
+#define STACKSIZE 1024
+
+/* the main thread only runs when the tasks leave the CPU idle */
+#define MAIN_PRIO K_PRIO_PREEMPT(10)
+#define TASK_PRIO K_PRIO_PREEMPT(5)
+
+/* length of each run (in milliseconds) */
+#define RUN_DURATION 2000
+
+struct task {
+	/* release period and relative deadline (in milliseconds) */
+	uint32_t period;
+	/* execution time of a job (in milliseconds) */
+	uint32_t wcet;
+	uint32_t jobs;
+	uint32_t misses;
+	/* largest response time of a job (in milliseconds) */
+	uint32_t max_response;
+};
+
+/* in release order */
+static struct task tasks[] = {
+	{ .period = 100, .wcet = 20 },
+	{ .period = 60, .wcet = 15 },
+	{ .period = 40, .wcet = 10 },
+};
+
+#define NUM_TASKS ARRAY_SIZE(tasks)
+
+static char __stack stacks[NUM_TASKS][STACKSIZE];
+
+static K_SEM_DEFINE(task_done, 0, NUM_TASKS);
+
+static uint32_t start;
+static volatile int running;
+static int use_deadlines;
+
+/*
+ * Consume CPU time. k_busy_wait() waits for wall clock time, so wait in 1 ms
+ * steps: a preempted job only gets the rest of the current step for free.
+ */
+static void job_run(uint32_t wcet)
+{
+	while (wcet--) {
+		k_busy_wait(USEC_PER_MSEC);
+	}
+}
+
+static void task_main(void *p1, void *p2, void *p3)
+{
+	struct task *task = p1;
+	uint32_t release = start;
+	uint32_t deadline;
+	uint32_t now;
+
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	while (running) {
+		now = k_uptime_get_32();
+		if ((int32_t)(release - now) > 0) {
+			k_sleep(release - now);
+		}
+
+		if (use_deadlines) {
+			deadline = release + task->period;
+			now = k_uptime_get_32();
+			k_thread_deadline_set(k_current_get(),
+					      (int32_t)(deadline - now) > 0 ?
+					      deadline - now : 0);
+		}
+
+		job_run(task->wcet);
+
+		now = k_uptime_get_32();
+
+		if (use_deadlines) {
+			k_thread_deadline_set(k_current_get(), K_FOREVER);
+		}
+
+		task->jobs++;
+		if (now - release > task->period) {
+			task->misses++;
+		}
+		if (now - release > task->max_response) {
+			task->max_response = now - release;
+		}
+
+		release += task->period;
+	}
+
+	k_sem_give(&task_done);
+}
+
+static int taskset_run(int deadlines)
+{
+	struct k_thread_deadline_stats stats;
+	k_tid_t tids[NUM_TASKS];
+	uint32_t misses = 0;
+	int i;
+
+	use_deadlines = deadlines;
+	running = 1;
+
+	/* leave the tasks time to get ready for the first release */
+	start = k_uptime_get_32() + 20;
+
+	for (i = 0; i < NUM_TASKS; i++) {
+		tasks[i].jobs = 0;
+		tasks[i].misses = 0;
+		tasks[i].max_response = 0;
+
+		tids[i] = k_thread_spawn(stacks[i], STACKSIZE, task_main,
+					 &tasks[i], NULL, NULL,
+					 TASK_PRIO, 0, K_NO_WAIT);
+	}
+
+	k_sleep(RUN_DURATION);
+	running = 0;
+
+	for (i = 0; i < NUM_TASKS; i++) {
+		k_sem_take(&task_done, K_FOREVER);
+	}
+
+	TC_PRINT("%s deadlines:\n", deadlines ? "With" : "Without");
+
+	for (i = 0; i < NUM_TASKS; i++) {
+		TC_PRINT("  period %3u ms, job %2u ms: %3u jobs, %3u late, "
+			 "max response %3u ms\n",
+			 tasks[i].period, tasks[i].wcet, tasks[i].jobs,
+			 tasks[i].misses, tasks[i].max_response);
+
+		/* the kernel times deadlines with the cycle counter */
+		if (deadlines) {
+			k_thread_deadline_stats_get(tids[i], &stats);
+			TC_PRINT("  kernel: %3u jobs, %3u late, "
+				 "max lateness %u cycles\n",
+				 stats.jobs, stats.misses, stats.max_lateness);
+			if (stats.jobs != tasks[i].jobs) {
+				TC_ERROR("kernel counted %u jobs, not %u\n",
+					 stats.jobs, tasks[i].jobs);
+				return -1;
+			}
+		}
+
+		misses += tasks[i].misses;
+	}
+
+	return misses;
+}
+
+void main(void)
+{
+	int rv = TC_PASS;
+
+	TC_START("Periodic taskset");
+
+	k_thread_priority_set(k_current_get(), MAIN_PRIO);
+
+	if (taskset_run(0) == 0) {
+		TC_PRINT("No job was late without deadlines\n");
+	}
+
+	if (taskset_run(1) != 0) {
+		TC_ERROR("Jobs were late with deadlines\n");
+		rv = TC_FAIL;
+	}
+
+	TC_END_RESULT(rv);
+	TC_END_REPORT(rv);
+}
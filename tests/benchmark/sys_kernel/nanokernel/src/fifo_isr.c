@@ -0,0 +1,168 @@
+/* fifo_isr.c */
+
+/*
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "syskernel.h"
+
+#include <irq_offload.h>
+
+#define FIFO_ISR_BURST 16
+
+struct item {
+	void *reserved;		/* used by the fifo */
+	int seq;
+};
+
+K_FIFO_DEFINE(isr_fifo);
+
+static struct item items[FIFO_ISR_BURST];
+
+static int isr_seq;
+
+
+/**
+ *
+ * @brief ISR putting a burst of items in the fifo
+ *
+ * @param arg   Number of items to put.
+ *
+ * @return N/A
+ */
+static void fifo_isr_put(void *arg)
+{
+	int n = (int)arg;
+	int b;
+
+	for (b = 0; b < n; b++) {
+		items[b].seq = isr_seq++;
+		k_fifo_put(&isr_fifo, &items[b]);
+	}
+}
+
+
+/**
+ *
+ * @brief Fifo test fiber, waiting for the items put by the ISR
+ *
+ * @param par1   Address of the counter.
+ * @param par2   Number of test loops.
+ * @param par3   Ignored parameter.
+ *
+ * @return N/A
+ */
+static void fifo_isr_fiber1(void *par1, void *par2, void *par3)
+{
+	int *pcounter = par1;
+	int loops = (int)par2;
+	struct item *item;
+	int i;
+
+	ARG_UNUSED(par3);
+
+	for (i = 0; i < loops; i++) {
+		item = k_fifo_get(&isr_fifo, K_FOREVER);
+		if (item->seq == i) {
+			(*pcounter)++;
+		}
+	}
+}
+
+
+/**
+ *
+ * @brief Bursts of items put by an ISR while nobody waits, then drained
+ *
+ * @return number of items received in order
+ */
+static int fifo_isr_burst(void)
+{
+	struct item *item;
+	int i = 0, n, b;
+
+	isr_seq = 0;
+
+	while (i < NUMBER_OF_LOOPS) {
+		n = NUMBER_OF_LOOPS - i;
+		if (n > FIFO_ISR_BURST) {
+			n = FIFO_ISR_BURST;
+		}
+		irq_offload(fifo_isr_put, (void *)n);
+		for (b = 0; b < n; b++) {
+			item = k_fifo_get(&isr_fifo, K_NO_WAIT);
+			if (!item || item->seq != i) {
+				return i;
+			}
+			i++;
+		}
+	}
+
+	return i;
+}
+
+
+/**
+ *
+ * @brief The main test entry
+ *
+ * @return 1 if success and 0 on failure
+ */
+int fifo_isr_test(void)
+{
+	uint32_t t;
+	int i;
+	int j;
+	int return_value = 0;
+
+	fprintf(output_file, sz_test_case_fmt,
+			"FIFO from ISR #1");
+	fprintf(output_file, sz_description,
+			"\n\tk_fifo_put from ISR, nobody waiting"
+			"\n\tk_fifo_get(K_NO_WAIT)");
+	printf(sz_test_start_fmt);
+
+	t = BENCH_START();
+
+	i = fifo_isr_burst();
+
+	t = TIME_STAMP_DELTA_GET(t);
+
+	return_value += check_result(i, t);
+
+	fprintf(output_file, sz_test_case_fmt,
+			"FIFO from ISR #2");
+	fprintf(output_file, sz_description,
+			"\n\tk_fifo_put from ISR, to a waiting thread"
+			"\n\tk_fifo_get(K_FOREVER)");
+	printf(sz_test_start_fmt);
+
+	i = 0;
+	isr_seq = 0;
+
+	t = BENCH_START();
+
+	k_thread_spawn(fiber_stack1, STACK_SIZE, fifo_isr_fiber1, &i,
+		       (void *)NUMBER_OF_LOOPS, NULL, K_PRIO_COOP(3), 0, 0);
+	for (j = 0; j < NUMBER_OF_LOOPS; j++) {
+		irq_offload(fifo_isr_put, (void *)1);
+	}
+
+	t = TIME_STAMP_DELTA_GET(t);
+
+	return_value += check_result(i, t);
+
+	return return_value;
+}
@@ -0,0 +1,279 @@
+/* msgq.c */
+
+/*
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "syskernel.h"
+
+#include <string.h>
+
+#define MSGQ_DEPTH 32
+
+struct record {
+	uint32_t seq;
+	uint32_t value[3];
+};
+
+K_MSGQ_DEFINE(msgq, sizeof(struct record), MSGQ_DEPTH, 4);
+
+static struct record batch[MSGQ_DEPTH];
+
+
+/**
+ *
+ * @brief Fill a record with dummy telemetry data
+ *
+ * @param rec   Record to fill.
+ * @param seq   Sequence number of the record.
+ *
+ * @return N/A
+ */
+static inline void record_fill(struct record *rec, uint32_t seq)
+{
+	rec->seq = seq;
+	rec->value[0] = seq;
+	rec->value[1] = ~seq;
+	rec->value[2] = 0;
+}
+
+
+/**
+ *
+ * @brief Message queue test fiber
+ *
+ * @param par1   Address of the counter.
+ * @param par2   Number of test loops.
+ * @param par3   Ignored parameter.
+ *
+ * @return N/A
+ */
+static void msgq_fiber1(void *par1, void *par2, void *par3)
+{
+	int *pcounter = par1;
+	int loops = (int)par2;
+	struct record rec;
+	int i;
+
+	ARG_UNUSED(par3);
+
+	for (i = 0; i < loops; i++) {
+		k_msgq_get(&msgq, &rec, K_FOREVER);
+		if (rec.seq == i) {
+			(*pcounter)++;
+		}
+	}
+}
+
+
+/**
+ *
+ * @brief Single messages, the queue alternately filled and drained
+ *
+ * @return number of messages moved in order
+ */
+static int msgq_single(void)
+{
+	struct record rec;
+	int i = 0, n, b;
+
+	while (i < NUMBER_OF_LOOPS) {
+		n = NUMBER_OF_LOOPS - i;
+		if (n > MSGQ_DEPTH) {
+			n = MSGQ_DEPTH;
+		}
+		for (b = 0; b < n; b++) {
+			record_fill(&rec, i + b);
+			k_msgq_put(&msgq, &rec, K_NO_WAIT);
+		}
+		for (b = 0; b < n; b++) {
+			if (k_msgq_get(&msgq, &rec, K_NO_WAIT) != 0 ||
+			    rec.seq != i) {
+				return i;
+			}
+			i++;
+		}
+	}
+
+	return i;
+}
+
+
+/**
+ *
+ * @brief Bulk transfers, the queue alternately filled and drained
+ *
+ * @return number of messages moved in order
+ */
+static int msgq_bulk(void)
+{
+	int i = 0, n, b;
+
+	while (i < NUMBER_OF_LOOPS) {
+		n = NUMBER_OF_LOOPS - i;
+		if (n > MSGQ_DEPTH) {
+			n = MSGQ_DEPTH;
+		}
+		for (b = 0; b < n; b++) {
+			record_fill(&batch[b], i + b);
+		}
+		if (k_msgq_put_n(&msgq, batch, n) != n) {
+			return i;
+		}
+		memset(batch, 0, sizeof(batch));
+		if (k_msgq_get_n(&msgq, batch, MSGQ_DEPTH) != n) {
+			return i;
+		}
+		for (b = 0; b < n; b++) {
+			if (batch[b].seq != i) {
+				return i;
+			}
+			i++;
+		}
+	}
+
+	return i;
+}
+
+
+/**
+ *
+ * @brief Messages built and read in place, the queue alternately filled
+ * and drained
+ *
+ * @return number of messages moved in order
+ */
+static int msgq_in_place(void)
+{
+	struct record *rec;
+	int i = 0, n, b;
+
+	while (i < NUMBER_OF_LOOPS) {
+		n = NUMBER_OF_LOOPS - i;
+		if (n > MSGQ_DEPTH) {
+			n = MSGQ_DEPTH;
+		}
+		for (b = 0; b < n; b++) {
+			rec = k_msgq_claim(&msgq);
+			if (!rec) {
+				return i;
+			}
+			record_fill(rec, i + b);
+			k_msgq_commit(&msgq);
+		}
+		for (b = 0; b < n; b++) {
+			rec = k_msgq_peek(&msgq);
+			if (!rec || rec->seq != i) {
+				return i;
+			}
+			k_msgq_release(&msgq);
+			i++;
+		}
+	}
+
+	return i;
+}
+
+
+/**
+ *
+ * @brief The main test entry
+ *
+ * @return 1 if success and 0 on failure
+ */
+int msgq_test(void)
+{
+	uint32_t t;
+	int i = 0;
+	int return_value = 0;
+	struct record rec;
+
+	fprintf(output_file, sz_test_case_fmt,
+			"Message queue #1");
+	fprintf(output_file, sz_description,
+			"\n\tk_msgq_put(K_NO_WAIT)"
+			"\n\tk_msgq_get(K_NO_WAIT)");
+	printf(sz_test_start_fmt);
+
+	k_msgq_purge(&msgq);
+
+	t = BENCH_START();
+
+	i = msgq_single();
+
+	t = TIME_STAMP_DELTA_GET(t);
+
+	return_value += check_result(i, t);
+
+	fprintf(output_file, sz_test_case_fmt,
+			"Message queue #2");
+	fprintf(output_file, sz_description,
+			"\n\tk_msgq_put_n"
+			"\n\tk_msgq_get_n");
+	printf(sz_test_start_fmt);
+
+	k_msgq_purge(&msgq);
+
+	t = BENCH_START();
+
+	i = msgq_bulk();
+
+	t = TIME_STAMP_DELTA_GET(t);
+
+	return_value += check_result(i, t);
+
+	fprintf(output_file, sz_test_case_fmt,
+			"Message queue #3");
+	fprintf(output_file, sz_description,
+			"\n\tk_msgq_claim"
+			"\n\tk_msgq_commit"
+			"\n\tk_msgq_peek"
+			"\n\tk_msgq_release");
+	printf(sz_test_start_fmt);
+
+	k_msgq_purge(&msgq);
+
+	t = BENCH_START();
+
+	i = msgq_in_place();
+
+	t = TIME_STAMP_DELTA_GET(t);
+
+	return_value += check_result(i, t);
+
+	fprintf(output_file, sz_test_case_fmt,
+			"Message queue #4");
+	fprintf(output_file, sz_description,
+			"\n\tk_msgq_get(K_FOREVER)"
+			"\n\tk_msgq_put(K_FOREVER)");
+	printf(sz_test_start_fmt);
+
+	k_msgq_purge(&msgq);
+	i = 0;
+
+	t = BENCH_START();
+
+	k_thread_spawn(fiber_stack1, STACK_SIZE, msgq_fiber1, &i,
+		       (void *)NUMBER_OF_LOOPS, NULL, K_PRIO_COOP(3), 0, 0);
+	for (rec.seq = 0; rec.seq < NUMBER_OF_LOOPS; rec.seq++) {
+		k_msgq_put(&msgq, &rec, K_FOREVER);
+	}
+
+	t = TIME_STAMP_DELTA_GET(t);
+
+	return_value += check_result(i, t);
+
+	return return_value;
+}
@@ -0,0 +1,115 @@
+/* mutex.c */
+
+/*
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "syskernel.h"
+
+K_MUTEX_DEFINE(mutex);
+
+
+/**
+ *
+ * @brief Lock and unlock a mutex nobody else wants
+ *
+ * @return number of successful lock/unlock cycles
+ */
+static int mutex_uncontended(void)
+{
+	int i;
+
+	for (i = 0; i < NUMBER_OF_LOOPS; i++) {
+		if (k_mutex_lock(&mutex, K_FOREVER) != 0) {
+			break;
+		}
+		k_mutex_unlock(&mutex);
+	}
+
+	return i;
+}
+
+
+/**
+ *
+ * @brief Lock a mutex again while owning it, then unlock it twice
+ *
+ * @return number of successful lock/unlock cycles
+ */
+static int mutex_recursive(void)
+{
+	int i;
+
+	if (k_mutex_lock(&mutex, K_FOREVER) != 0) {
+		return 0;
+	}
+
+	for (i = 0; i < NUMBER_OF_LOOPS; i++) {
+		if (k_mutex_lock(&mutex, K_NO_WAIT) != 0) {
+			break;
+		}
+		k_mutex_unlock(&mutex);
+	}
+
+	k_mutex_unlock(&mutex);
+
+	return i;
+}
+
+
+/**
+ *
+ * @brief The main test entry
+ *
+ * @return 1 if success and 0 on failure
+ */
+int mutex_test(void)
+{
+	uint32_t t;
+	int i;
+	int return_value = 0;
+
+	fprintf(output_file, sz_test_case_fmt,
+			"Mutex #1");
+	fprintf(output_file, sz_description,
+			"\n\tk_mutex_lock(K_FOREVER)"
+			"\n\tk_mutex_unlock");
+	printf(sz_test_start_fmt);
+
+	t = BENCH_START();
+
+	i = mutex_uncontended();
+
+	t = TIME_STAMP_DELTA_GET(t);
+
+	return_value += check_result(i, t);
+
+	fprintf(output_file, sz_test_case_fmt,
+			"Mutex #2");
+	fprintf(output_file, sz_description,
+			"\n\tk_mutex_lock(K_NO_WAIT), mutex already owned"
+			"\n\tk_mutex_unlock");
+	printf(sz_test_start_fmt);
+
+	t = BENCH_START();
+
+	i = mutex_recursive();
+
+	t = TIME_STAMP_DELTA_GET(t);
+
+	return_value += check_result(i, t);
+
+	return return_value;
+}
@@ -0,0 +1,164 @@
+/* rwlock.c */
+
+/*
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "syskernel.h"
+
+K_RWLOCK_DEFINE(rwlock);
+K_SEM_DEFINE(rwlock_sync, 0, 1);
+
+
+/**
+ *
+ * @brief Writer fiber, contending with the reading main thread
+ *
+ * @param par1   Address of the counter.
+ * @param par2   Number of test loops.
+ * @param par3   Ignored parameter.
+ *
+ * @return N/A
+ */
+static void rwlock_fiber1(void *par1, void *par2, void *par3)
+{
+	int *pcounter = par1;
+	int loops = (int)par2;
+	int i;
+
+	ARG_UNUSED(par3);
+
+	for (i = 0; i < loops; i++) {
+		k_sem_take(&rwlock_sync, K_FOREVER);
+		k_rwlock_write_lock(&rwlock, K_FOREVER);
+		(*pcounter)++;
+		k_rwlock_write_unlock(&rwlock);
+	}
+}
+
+
+/**
+ *
+ * @brief Take and release the lock for reading, without contention
+ *
+ * @return number of successful lock/unlock cycles
+ */
+static int rwlock_read(void)
+{
+	int i;
+
+	for (i = 0; i < NUMBER_OF_LOOPS; i++) {
+		if (k_rwlock_read_lock(&rwlock, K_NO_WAIT) != 0) {
+			break;
+		}
+		k_rwlock_read_unlock(&rwlock);
+	}
+
+	return i;
+}
+
+
+/**
+ *
+ * @brief Take and release the lock for writing, without contention
+ *
+ * @return number of successful lock/unlock cycles
+ */
+static int rwlock_write(void)
+{
+	int i;
+
+	for (i = 0; i < NUMBER_OF_LOOPS; i++) {
+		if (k_rwlock_write_lock(&rwlock, K_NO_WAIT) != 0) {
+			break;
+		}
+		k_rwlock_write_unlock(&rwlock);
+	}
+
+	return i;
+}
+
+
+/**
+ *
+ * @brief The main test entry
+ *
+ * @return 1 if success and 0 on failure
+ */
+int rwlock_test(void)
+{
+	uint32_t t;
+	int i;
+	int j;
+	int return_value = 0;
+
+	fprintf(output_file, sz_test_case_fmt,
+			"Reader-writer lock #1");
+	fprintf(output_file, sz_description,
+			"\n\tk_rwlock_read_lock(K_NO_WAIT)"
+			"\n\tk_rwlock_read_unlock");
+	printf(sz_test_start_fmt);
+
+	t = BENCH_START();
+
+	i = rwlock_read();
+
+	t = TIME_STAMP_DELTA_GET(t);
+
+	return_value += check_result(i, t);
+
+	fprintf(output_file, sz_test_case_fmt,
+			"Reader-writer lock #2");
+	fprintf(output_file, sz_description,
+			"\n\tk_rwlock_write_lock(K_NO_WAIT)"
+			"\n\tk_rwlock_write_unlock");
+	printf(sz_test_start_fmt);
+
+	t = BENCH_START();
+
+	i = rwlock_write();
+
+	t = TIME_STAMP_DELTA_GET(t);
+
+	return_value += check_result(i, t);
+
+	fprintf(output_file, sz_test_case_fmt,
+			"Reader-writer lock #3");
+	fprintf(output_file, sz_description,
+			"\n\tk_rwlock_read_lock(K_FOREVER)"
+			"\n\tk_rwlock_read_unlock, handing over to a writer"
+			"\n\tk_rwlock_write_lock(K_FOREVER)"
+			"\n\tk_rwlock_write_unlock");
+	printf(sz_test_start_fmt);
+
+	i = 0;
+
+	t = BENCH_START();
+
+	k_thread_spawn(fiber_stack1, STACK_SIZE, rwlock_fiber1, &i,
+		       (void *)NUMBER_OF_LOOPS, NULL, K_PRIO_COOP(3), 0, 0);
+	for (j = 0; j < NUMBER_OF_LOOPS; j++) {
+		k_rwlock_read_lock(&rwlock, K_FOREVER);
+		/* the writer wakes up and blocks on the lock */
+		k_sem_give(&rwlock_sync);
+		k_rwlock_read_unlock(&rwlock);
+	}
+
+	t = TIME_STAMP_DELTA_GET(t);
+
+	return_value += check_result(i, t);
+
+	return return_value;
+}
@@ -188,10 +188,20 @@ void main(void)
 		test_result += lifo_test();
 		test_result += fifo_test();
 		test_result += stack_test();
+#ifdef CONFIG_KERNEL_V2
+		test_result += msgq_test();
+		test_result += mutex_test();
+		test_result += rwlock_test();
+		test_result += fifo_isr_test();
+#endif
 
 		if (test_result) {
-			/* sema, lifo, fifo, stack account for twelve tests in total */
-			if (test_result == 12) {
+			/*
+			 * sema, lifo, fifo, stack account for twelve tests in
+			 * total, msgq for four more, mutex for two, rwlock
+			 * for three and fifo from ISR for two
+			 */
+			if (test_result == NUMBER_OF_TESTS) {
 				fprintf(output_file, sz_module_result_fmt, sz_success);
 			} else {
 				fprintf(output_file, sz_module_result_fmt, sz_partial);
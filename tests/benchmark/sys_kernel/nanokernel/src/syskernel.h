@@ -27,6 +27,12 @@
 #define STACK_SIZE 2048
 #define NUMBER_OF_LOOPS 5000
 
+#ifdef CONFIG_KERNEL_V2
+#define NUMBER_OF_TESTS 23
+#else
+#define NUMBER_OF_TESTS 12
+#endif
+
 extern char fiber_stack1[STACK_SIZE];
 extern char fiber_stack2[STACK_SIZE];
 
@@ -57,6 +63,10 @@ int sema_test(void);
 int lifo_test(void);
 int fifo_test(void);
 int stack_test(void);
+int msgq_test(void);
+int mutex_test(void);
+int rwlock_test(void);
+int fifo_isr_test(void);
 void begin_test(void);
 
 static inline uint32_t BENCH_START(void)
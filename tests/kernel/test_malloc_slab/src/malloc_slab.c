@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2016 Wind River Systems, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * @file
+ * @brief Test k_malloc() and k_free() with slab caches
+ *
+ * There are caches of 8, 16, 32 and 64 byte blocks, of two blocks each, and
+ * a heap pool with a single 1024 byte block.
+ *
+ * Scenario #1:
+ * Small requests are served from the smallest cache they fit in.
+ *
+ * Scenario #2:
+ * Requests for an empty cache, and requests larger than the caches, are
+ * served from the heap pool.
+ *
+ * Scenario #3:
+ * k_free() gives cache blocks back to their cache, and pool blocks back to
+ * the pool.
+ */
+
+#include <zephyr.h>
+#include <tc_util.h>
+#include <misc/util.h>
+
+#define NUM_CACHES 4
+#define CACHE_BLOCKS CONFIG_HEAP_SLAB_BLOCKS
+
+/* a request only the whole heap pool block can serve */
+#define POOL_ONLY_SIZE 600
+
+static int used_get(int cache)
+{
+	struct k_malloc_slab_stats stats;
+
+	if (k_malloc_slab_stats_get(cache, &stats) != 0) {
+		return -1;
+	}
+
+	return stats.num_used;
+}
+
+/**
+ *
+ * @brief Check the number of blocks used in each cache
+ *
+ * @return TC_PASS if they are the ones expected, TC_FAIL otherwise
+ */
+static int used_check(const int *expected)
+{
+	int i;
+
+	for (i = 0; i < NUM_CACHES; i++) {
+		if (used_get(i) != expected[i]) {
+			TC_ERROR("%d blocks used in cache %d, not %d\n",
+				 used_get(i), i, expected[i]);
+			return TC_FAIL;
+		}
+	}
+
+	return TC_PASS;
+}
+
+static int test_sizes(void)
+{
+	static const struct {
+		uint32_t size;
+		int cache;
+	} requests[] = {
+		{ 1, 0 }, { 8, 0 }, { 9, 1 }, { 16, 1 },
+		{ 17, 2 }, { 32, 2 }, { 33, 3 }, { 64, 3 },
+	};
+	int used[NUM_CACHES] = { 0 };
+	void *ptrs[ARRAY_SIZE(requests)];
+	int i;
+
+	TC_PRINT("Serving small requests from the caches\n");
+
+	for (i = 0; i < ARRAY_SIZE(requests); i++) {
+		ptrs[i] = k_malloc(requests[i].size);
+		if (!ptrs[i]) {
+			TC_ERROR("no block for %u bytes\n", requests[i].size);
+			return TC_FAIL;
+		}
+
+		used[requests[i].cache]++;
+		if (used_check(used) != TC_PASS) {
+			TC_ERROR("%u bytes not served by cache %d\n",
+				 requests[i].size, requests[i].cache);
+			return TC_FAIL;
+		}
+	}
+
+	for (i = 0; i < ARRAY_SIZE(requests); i++) {
+		k_free(ptrs[i]);
+
+		used[requests[i].cache]--;
+		if (used_check(used) != TC_PASS) {
+			TC_ERROR("block not given back to cache %d\n",
+				 requests[i].cache);
+			return TC_FAIL;
+		}
+	}
+
+	return TC_PASS;
+}
+
+static int test_fallback_free(void)
+{
+	static const int full[NUM_CACHES] = { 0, CACHE_BLOCKS, 0, 0 };
+	static const int none[NUM_CACHES] = { 0 };
+	struct k_malloc_slab_stats stats;
+	void *cache_ptrs[CACHE_BLOCKS];
+	void *pool_ptr, *large_ptr;
+	uint32_t fallbacks;
+	int i;
+
+	TC_PRINT("Falling back to the pool and freeing to the right owner\n");
+
+	k_malloc_slab_stats_get(1, &stats);
+	fallbacks = stats.num_fallbacks;
+
+	for (i = 0; i < CACHE_BLOCKS; i++) {
+		cache_ptrs[i] = k_malloc(16);
+		if (!cache_ptrs[i]) {
+			TC_ERROR("no block in the 16 byte cache\n");
+			return TC_FAIL;
+		}
+	}
+
+	/* the cache is empty */
+	pool_ptr = k_malloc(16);
+	k_malloc_slab_stats_get(1, &stats);
+	if (!pool_ptr || stats.num_fallbacks != fallbacks + 1 ||
+	    used_check(full) != TC_PASS) {
+		TC_ERROR("request for an empty cache not served by the pool\n");
+		return TC_FAIL;
+	}
+
+	/* larger than the caches */
+	large_ptr = k_malloc(100);
+	if (!large_ptr || used_check(full) != TC_PASS) {
+		TC_ERROR("large request not served by the pool\n");
+		return TC_FAIL;
+	}
+
+	/* the pool is in use, its whole block cannot be allocated */
+	if (k_malloc(POOL_ONLY_SIZE) != NULL) {
+		TC_ERROR("pool block allocated twice\n");
+		return TC_FAIL;
+	}
+
+	/* the pool blocks do not go to the caches */
+	k_free(pool_ptr);
+	k_free(large_ptr);
+	if (used_check(full) != TC_PASS) {
+		return TC_FAIL;
+	}
+
+	for (i = 0; i < CACHE_BLOCKS; i++) {
+		k_free(cache_ptrs[i]);
+	}
+	if (used_check(none) != TC_PASS) {
+		return TC_FAIL;
+	}
+
+	/* the cache blocks do not go to the pool, which has all its memory */
+	large_ptr = k_malloc(POOL_ONLY_SIZE);
+	if (!large_ptr || used_check(none) != TC_PASS) {
+		TC_ERROR("pool blocks not given back to the pool\n");
+		return TC_FAIL;
+	}
+
+	k_free(large_ptr);
+
+	return TC_PASS;
+}
+
+void main(void)
+{
+	int rv = TC_PASS;
+
+	TC_START("Test k_malloc() slab caches");
+
+	if (test_sizes() != TC_PASS ||
+	    test_fallback_free() != TC_PASS) {
+		rv = TC_FAIL;
+	}
+
+	TC_END_RESULT(rv);
+	TC_END_REPORT(rv);
+}
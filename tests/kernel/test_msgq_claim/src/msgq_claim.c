@@ -0,0 +1,428 @@
+/*
+ * Copyright (c) 2016 Wind River Systems, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * @file
+ * @brief Test in-place message queue operations
+ *
+ * The main thread runs at a low priority and spawns helper threads of
+ * higher priority, which run right away until they block on the message
+ * queue, which holds two messages.
+ *
+ * Scenario #1:
+ * A claimed message is read before the messages added after it, once it
+ * is committed.
+ *
+ * Scenario #2:
+ * A thread waiting to read gets the claimed message when it is committed.
+ *
+ * Scenario #3:
+ * A thread waiting to write while a message is claimed waits for room
+ * instead of failing, and its message is read after the claimed one.
+ *
+ * Scenario #4:
+ * The oldest message is read in place, and releasing it lets a thread
+ * waiting to write add its message.
+ *
+ * Scenario #5:
+ * A thread polling the message queue is not woken up by a message put
+ * behind a claimed one, only when the claimed message is committed.
+ */
+
+#include <zephyr.h>
+#include <tc_util.h>
+
+#define STACKSIZE 512
+
+#define MAIN_PRIO   K_PRIO_PREEMPT(10)
+#define HELPER_PRIO K_PRIO_PREEMPT(5)
+
+#define MAX_MSGS 2
+
+K_MSGQ_DEFINE(msgq, sizeof(uint32_t), MAX_MSGS, 4);
+
+static K_SEM_DEFINE(helper_done, 0, 2);
+
+static char __stack reader_stack[STACKSIZE];
+static char __stack writer_stack[STACKSIZE];
+
+static uint32_t reader_data;
+static int reader_result;
+static int writer_result;
+static int poller_result;
+
+/**
+ *
+ * @brief Wait for a message, then report it
+ *
+ * @return N/A
+ */
+static void reader(void *p1, void *p2, void *p3)
+{
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	reader_result = k_msgq_get(&msgq, &reader_data, K_FOREVER);
+	k_sem_give(&helper_done);
+}
+
+/**
+ *
+ * @brief Wait for room to add a message, then report
+ *
+ * @return N/A
+ */
+static void writer(void *p1, void *p2, void *p3)
+{
+	uint32_t data = (uint32_t)p1;
+
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	writer_result = k_msgq_put(&msgq, &data, K_FOREVER);
+	k_sem_give(&helper_done);
+}
+
+/**
+ *
+ * @brief Poll for a message, then report
+ *
+ * @return N/A
+ */
+static void poller(void *p1, void *p2, void *p3)
+{
+	struct k_poll_event event;
+
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	k_poll_event_init(&event, K_POLL_TYPE_MSGQ_DATA_AVAILABLE,
+			  K_POLL_MODE_NOTIFY_ONLY, &msgq);
+	poller_result = k_poll(&event, 1, K_FOREVER);
+	k_sem_give(&helper_done);
+}
+
+static void reader_spawn(void)
+{
+	reader_result = 1;
+	k_thread_spawn(reader_stack, STACKSIZE, reader, NULL, NULL, NULL,
+		       HELPER_PRIO, 0, K_NO_WAIT);
+}
+
+static void writer_spawn(uint32_t data)
+{
+	writer_result = 1;
+	k_thread_spawn(writer_stack, STACKSIZE, writer, (void *)data, NULL,
+		       NULL, HELPER_PRIO, 0, K_NO_WAIT);
+}
+
+static int helper_wait(void)
+{
+	if (k_sem_take(&helper_done, 1000) != 0) {
+		TC_ERROR("helper thread did not finish\n");
+		return TC_FAIL;
+	}
+
+	return TC_PASS;
+}
+
+/**
+ *
+ * @brief Get the next message and check it
+ *
+ * @return TC_PASS if it is the one expected, TC_FAIL otherwise
+ */
+static int get_check(uint32_t expected)
+{
+	uint32_t data;
+
+	if (k_msgq_get(&msgq, &data, K_NO_WAIT) != 0) {
+		TC_ERROR("no message, expected %u\n", expected);
+		return TC_FAIL;
+	}
+
+	if (data != expected) {
+		TC_ERROR("got message %u, expected %u\n", data, expected);
+		return TC_FAIL;
+	}
+
+	return TC_PASS;
+}
+
+static int empty_check(void)
+{
+	if (k_msgq_num_used_get(&msgq) != 0) {
+		TC_ERROR("%d messages left\n", k_msgq_num_used_get(&msgq));
+		return TC_FAIL;
+	}
+
+	return TC_PASS;
+}
+
+static int test_claim_order(void)
+{
+	uint32_t data = 2;
+	uint32_t *slot;
+
+	TC_PRINT("Reading a claimed message first\n");
+
+	slot = k_msgq_claim(&msgq);
+	if (!slot) {
+		TC_ERROR("could not claim a message\n");
+		return TC_FAIL;
+	}
+
+	if (k_msgq_claim(&msgq) != NULL) {
+		TC_ERROR("claimed two messages\n");
+		return TC_FAIL;
+	}
+
+	if (k_msgq_put(&msgq, &data, K_NO_WAIT) != 0) {
+		TC_ERROR("could not put a message after the claim\n");
+		return TC_FAIL;
+	}
+
+	if (k_msgq_get(&msgq, &data, K_NO_WAIT) != -ENOMSG ||
+	    k_msgq_peek(&msgq) != NULL) {
+		TC_ERROR("message read ahead of the claimed one\n");
+		return TC_FAIL;
+	}
+
+	*slot = 1;
+
+	if (k_msgq_commit(&msgq) != 0 || k_msgq_commit(&msgq) != -EINVAL) {
+		TC_ERROR("could not commit the claimed message once\n");
+		return TC_FAIL;
+	}
+
+	if (get_check(1) != TC_PASS || get_check(2) != TC_PASS) {
+		return TC_FAIL;
+	}
+
+	return empty_check();
+}
+
+static int test_commit_reader(void)
+{
+	uint32_t *slot;
+
+	TC_PRINT("Committing a message to a waiting reader\n");
+
+	slot = k_msgq_claim(&msgq);
+	if (!slot) {
+		TC_ERROR("could not claim a message\n");
+		return TC_FAIL;
+	}
+
+	/* the reader waits for the claimed message */
+	reader_spawn();
+
+	*slot = 3;
+	k_msgq_commit(&msgq);
+
+	if (helper_wait() != TC_PASS) {
+		return TC_FAIL;
+	}
+
+	if (reader_result != 0 || reader_data != 3) {
+		TC_ERROR("reader got %u (%d), expected 3\n",
+			 reader_data, reader_result);
+		return TC_FAIL;
+	}
+
+	return empty_check();
+}
+
+static int test_claim_writer(void)
+{
+	uint32_t data = 5;
+	uint32_t *slot;
+
+	TC_PRINT("Waiting to write while a message is claimed\n");
+
+	slot = k_msgq_claim(&msgq);
+	if (!slot || k_msgq_put(&msgq, &data, K_NO_WAIT) != 0) {
+		TC_ERROR("could not fill the message queue\n");
+		return TC_FAIL;
+	}
+
+	/* both wait, the reader for the claimed message, the writer for room */
+	reader_spawn();
+	writer_spawn(6);
+
+	if (writer_result != 1) {
+		TC_ERROR("writer did not wait for room: %d\n", writer_result);
+		return TC_FAIL;
+	}
+
+	*slot = 4;
+	k_msgq_commit(&msgq);
+
+	if (helper_wait() != TC_PASS || helper_wait() != TC_PASS) {
+		return TC_FAIL;
+	}
+
+	if (reader_result != 0 || reader_data != 4) {
+		TC_ERROR("reader got %u (%d), expected 4\n",
+			 reader_data, reader_result);
+		return TC_FAIL;
+	}
+
+	if (writer_result != 0) {
+		TC_ERROR("writer failed: %d\n", writer_result);
+		return TC_FAIL;
+	}
+
+	if (get_check(5) != TC_PASS || get_check(6) != TC_PASS) {
+		return TC_FAIL;
+	}
+
+	return empty_check();
+}
+
+static int test_peek_release(void)
+{
+	uint32_t data[MAX_MSGS] = { 7, 8 };
+	uint32_t *msg;
+
+	TC_PRINT("Reading messages in place\n");
+
+	if (k_msgq_put_n(&msgq, data, MAX_MSGS) != MAX_MSGS) {
+		TC_ERROR("could not fill the message queue\n");
+		return TC_FAIL;
+	}
+
+	/* the writer waits for room */
+	writer_spawn(9);
+
+	msg = k_msgq_peek(&msgq);
+	if (!msg || *msg != 7 || k_msgq_peek(&msgq) != msg) {
+		TC_ERROR("could not peek at the oldest message\n");
+		return TC_FAIL;
+	}
+
+	k_msgq_release(&msgq);
+
+	if (helper_wait() != TC_PASS) {
+		return TC_FAIL;
+	}
+
+	if (writer_result != 0) {
+		TC_ERROR("writer failed: %d\n", writer_result);
+		return TC_FAIL;
+	}
+
+	msg = k_msgq_peek(&msgq);
+	if (!msg || *msg != 8) {
+		TC_ERROR("released message still in the queue\n");
+		return TC_FAIL;
+	}
+	k_msgq_release(&msgq);
+
+	msg = k_msgq_peek(&msgq);
+	if (!msg || *msg != 9) {
+		TC_ERROR("writer's message not in the queue\n");
+		return TC_FAIL;
+	}
+	k_msgq_release(&msgq);
+
+	if (k_msgq_peek(&msgq) != NULL) {
+		TC_ERROR("peeked at an empty message queue\n");
+		return TC_FAIL;
+	}
+
+	/* nothing to release */
+	k_msgq_release(&msgq);
+
+	return empty_check();
+}
+
+static int test_claim_poll(void)
+{
+	struct k_poll_event event;
+	uint32_t data = 11;
+	uint32_t *slot;
+
+	TC_PRINT("Polling while a message is claimed\n");
+
+	slot = k_msgq_claim(&msgq);
+	if (!slot) {
+		TC_ERROR("could not claim a message\n");
+		return TC_FAIL;
+	}
+
+	k_poll_event_init(&event, K_POLL_TYPE_MSGQ_DATA_AVAILABLE,
+			  K_POLL_MODE_NOTIFY_ONLY, &msgq);
+	if (k_poll(&event, 1, K_NO_WAIT) != -EAGAIN) {
+		TC_ERROR("claimed message seen by a poller\n");
+		return TC_FAIL;
+	}
+
+	/* the poller waits, it shares the stack of the reader */
+	poller_result = 1;
+	k_thread_spawn(reader_stack, STACKSIZE, poller, NULL, NULL, NULL,
+		       HELPER_PRIO, 0, K_NO_WAIT);
+
+	if (k_msgq_put(&msgq, &data, K_NO_WAIT) != 0) {
+		TC_ERROR("could not put a message after the claim\n");
+		return TC_FAIL;
+	}
+
+	if (poller_result != 1) {
+		TC_ERROR("poller woken up by a message behind the claim\n");
+		return TC_FAIL;
+	}
+
+	*slot = 10;
+	k_msgq_commit(&msgq);
+
+	if (helper_wait() != TC_PASS) {
+		return TC_FAIL;
+	}
+
+	if (poller_result != 0) {
+		TC_ERROR("poller failed: %d\n", poller_result);
+		return TC_FAIL;
+	}
+
+	if (get_check(10) != TC_PASS || get_check(11) != TC_PASS) {
+		return TC_FAIL;
+	}
+
+	return empty_check();
+}
+
+void main(void)
+{
+	int rv = TC_PASS;
+
+	TC_START("Test in-place message queue operations");
+
+	k_thread_priority_set(k_current_get(), MAIN_PRIO);
+
+	if (test_claim_order() != TC_PASS ||
+	    test_commit_reader() != TC_PASS ||
+	    test_claim_writer() != TC_PASS ||
+	    test_peek_release() != TC_PASS ||
+	    test_claim_poll() != TC_PASS) {
+		rv = TC_FAIL;
+	}
+
+	TC_END_RESULT(rv);
+	TC_END_REPORT(rv);
+}
@@ -0,0 +1,401 @@
+/*
+ * Copyright (c) 2016 Wind River Systems, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * @file
+ * @brief Test polling for multiple kernel objects
+ *
+ * The main thread runs at a low priority and spawns a polling thread of
+ * higher priority, which runs right away until it waits in k_poll() for a
+ * semaphore, a fifo, a message queue and a pipe.
+ *
+ * Scenario #1:
+ * Objects already available when k_poll() is called are reported right
+ * away, without waiting, even with K_FOREVER.
+ *
+ * Scenario #2:
+ * Nothing becomes available: k_poll() times out.
+ *
+ * Scenario #3:
+ * Each type of object wakes up the polling thread when it becomes
+ * available. Only its event is reported, and the events on the other
+ * objects are no longer registered once k_poll() returns.
+ *
+ * Scenario #4:
+ * A second thread polling an object already polled gets -EADDRINUSE, and
+ * the first one is still woken up.
+ */
+
+#include <zephyr.h>
+#include <tc_util.h>
+
+#define STACKSIZE 512
+
+#define MAIN_PRIO   K_PRIO_PREEMPT(10)
+#define HELPER_PRIO K_PRIO_PREEMPT(5)
+
+#define TIMEOUT 50
+
+#define NUM_OBJS 4
+
+struct fifo_item {
+	void *reserved;
+	uint32_t data;
+};
+
+static K_SEM_DEFINE(sem, 0, 1);
+static K_FIFO_DEFINE(fifo);
+K_MSGQ_DEFINE(msgq, sizeof(uint32_t), 2, 4);
+K_PIPE_DEFINE(pipe, 16, 4);
+
+static K_SEM_DEFINE(helper_done, 0, 1);
+
+static char __stack poller_stack[STACKSIZE];
+
+static struct fifo_item item;
+
+static struct k_poll_event poller_events[NUM_OBJS];
+static int poller_result;
+
+static const struct {
+	const char *name;
+	uint32_t type;
+	uint32_t state;
+	void *obj;
+} objs[NUM_OBJS] = {
+	{ "semaphore", K_POLL_TYPE_SEM_AVAILABLE,
+	  K_POLL_STATE_SEM_AVAILABLE, &sem },
+	{ "fifo", K_POLL_TYPE_FIFO_DATA_AVAILABLE,
+	  K_POLL_STATE_FIFO_DATA_AVAILABLE, &fifo },
+	{ "message queue", K_POLL_TYPE_MSGQ_DATA_AVAILABLE,
+	  K_POLL_STATE_MSGQ_DATA_AVAILABLE, &msgq },
+	{ "pipe", K_POLL_TYPE_PIPE_DATA_AVAILABLE,
+	  K_POLL_STATE_PIPE_DATA_AVAILABLE, &pipe },
+};
+
+static void events_init(struct k_poll_event *events)
+{
+	int i;
+
+	for (i = 0; i < NUM_OBJS; i++) {
+		k_poll_event_init(&events[i], objs[i].type,
+				  K_POLL_MODE_NOTIFY_ONLY, objs[i].obj);
+	}
+}
+
+/**
+ *
+ * @brief Poll all the objects, then report
+ *
+ * @return N/A
+ */
+static void poller(void *p1, void *p2, void *p3)
+{
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	poller_result = k_poll(poller_events, NUM_OBJS, K_FOREVER);
+	k_sem_give(&helper_done);
+}
+
+static void poller_spawn(void)
+{
+	events_init(poller_events);
+	poller_result = 1;
+	k_thread_spawn(poller_stack, STACKSIZE, poller, NULL, NULL, NULL,
+		       HELPER_PRIO, 0, K_NO_WAIT);
+}
+
+static int helper_wait(void)
+{
+	if (k_sem_take(&helper_done, 1000) != 0) {
+		TC_ERROR("polling thread did not finish\n");
+		return TC_FAIL;
+	}
+
+	return TC_PASS;
+}
+
+static void obj_give(int i)
+{
+	uint32_t data = i;
+	size_t bytes;
+
+	switch (objs[i].type) {
+	case K_POLL_TYPE_SEM_AVAILABLE:
+		k_sem_give(&sem);
+		break;
+	case K_POLL_TYPE_FIFO_DATA_AVAILABLE:
+		k_fifo_put(&fifo, &item);
+		break;
+	case K_POLL_TYPE_MSGQ_DATA_AVAILABLE:
+		k_msgq_put(&msgq, &data, K_NO_WAIT);
+		break;
+	case K_POLL_TYPE_PIPE_DATA_AVAILABLE:
+		k_pipe_put(&pipe, &data, sizeof(data), &bytes, sizeof(data),
+			   K_NO_WAIT);
+		break;
+	}
+}
+
+/**
+ *
+ * @brief Take what was given to an object
+ *
+ * @return TC_PASS if it was available, TC_FAIL otherwise
+ */
+static int obj_take(int i)
+{
+	uint32_t data;
+	size_t bytes;
+	int rc = -1;
+
+	switch (objs[i].type) {
+	case K_POLL_TYPE_SEM_AVAILABLE:
+		rc = k_sem_take(&sem, K_NO_WAIT);
+		break;
+	case K_POLL_TYPE_FIFO_DATA_AVAILABLE:
+		rc = k_fifo_get(&fifo, K_NO_WAIT) == &item ? 0 : -1;
+		break;
+	case K_POLL_TYPE_MSGQ_DATA_AVAILABLE:
+		rc = k_msgq_get(&msgq, &data, K_NO_WAIT);
+		break;
+	case K_POLL_TYPE_PIPE_DATA_AVAILABLE:
+		rc = k_pipe_get(&pipe, &data, sizeof(data), &bytes,
+				sizeof(data), K_NO_WAIT);
+		break;
+	}
+
+	if (rc != 0) {
+		TC_ERROR("%s not available\n", objs[i].name);
+		return TC_FAIL;
+	}
+
+	return TC_PASS;
+}
+
+/**
+ *
+ * @brief Check the state of each event
+ *
+ * @param ready Index of the only object available, -1 for all of them,
+ *              NUM_OBJS for none
+ *
+ * @return TC_PASS if the states are the ones expected, TC_FAIL otherwise
+ */
+static int states_check(struct k_poll_event *events, int ready)
+{
+	uint32_t expected;
+	int i;
+
+	for (i = 0; i < NUM_OBJS; i++) {
+		if (ready < 0 || ready == i) {
+			expected = objs[i].state;
+		} else {
+			expected = K_POLL_STATE_NOT_READY;
+		}
+
+		if (events[i].state != expected) {
+			TC_ERROR("%s state %u, expected %u\n", objs[i].name,
+				 events[i].state, expected);
+			return TC_FAIL;
+		}
+	}
+
+	return TC_PASS;
+}
+
+/**
+ *
+ * @brief Check that nothing is available, nor polled by another thread
+ *
+ * @return TC_PASS if k_poll() times out, TC_FAIL otherwise
+ */
+static int timeout_check(void)
+{
+	struct k_poll_event events[NUM_OBJS];
+	int rc;
+
+	events_init(events);
+
+	rc = k_poll(events, NUM_OBJS, TIMEOUT);
+	if (rc != -EAGAIN) {
+		TC_ERROR("k_poll() returned %d, expected -EAGAIN\n", rc);
+		return TC_FAIL;
+	}
+
+	return states_check(events, NUM_OBJS);
+}
+
+static int test_poll_ready(void)
+{
+	struct k_poll_event events[NUM_OBJS];
+	int i;
+
+	TC_PRINT("Polling objects already available\n");
+
+	for (i = 0; i < NUM_OBJS; i++) {
+		obj_give(i);
+	}
+
+	events_init(events);
+
+	if (k_poll(events, NUM_OBJS, K_NO_WAIT) != 0 ||
+	    states_check(events, -1) != TC_PASS) {
+		TC_ERROR("available objects not reported\n");
+		return TC_FAIL;
+	}
+
+	/* does not wait, so registers nothing */
+	if (k_poll(events, NUM_OBJS, K_FOREVER) != 0 ||
+	    states_check(events, -1) != TC_PASS) {
+		TC_ERROR("available objects not reported\n");
+		return TC_FAIL;
+	}
+
+	for (i = 0; i < NUM_OBJS; i++) {
+		if (obj_take(i) != TC_PASS) {
+			return TC_FAIL;
+		}
+	}
+
+	return TC_PASS;
+}
+
+static int test_poll_timeout(void)
+{
+	struct k_poll_event events[NUM_OBJS];
+
+	TC_PRINT("Polling objects that do not become available\n");
+
+	events_init(events);
+
+	if (k_poll(events, NUM_OBJS, K_NO_WAIT) != -EAGAIN ||
+	    states_check(events, NUM_OBJS) != TC_PASS) {
+		TC_ERROR("unavailable objects reported\n");
+		return TC_FAIL;
+	}
+
+	/* twice, so that registrations left behind would be in use */
+	if (timeout_check() != TC_PASS || timeout_check() != TC_PASS) {
+		return TC_FAIL;
+	}
+
+	return TC_PASS;
+}
+
+static int test_poll_wake_up(void)
+{
+	int i;
+
+	for (i = 0; i < NUM_OBJS; i++) {
+		TC_PRINT("Waking up a polling thread with a %s\n",
+			 objs[i].name);
+
+		/* the poller waits for all the objects */
+		poller_spawn();
+
+		if (poller_result != 1) {
+			TC_ERROR("poller did not wait: %d\n", poller_result);
+			return TC_FAIL;
+		}
+
+		obj_give(i);
+
+		if (helper_wait() != TC_PASS) {
+			return TC_FAIL;
+		}
+
+		if (poller_result != 0) {
+			TC_ERROR("poller failed: %d\n", poller_result);
+			return TC_FAIL;
+		}
+
+		if (states_check(poller_events, i) != TC_PASS ||
+		    obj_take(i) != TC_PASS) {
+			return TC_FAIL;
+		}
+
+		/* none of the poller's events is registered anymore */
+		if (timeout_check() != TC_PASS) {
+			return TC_FAIL;
+		}
+	}
+
+	return TC_PASS;
+}
+
+static int test_poll_in_use(void)
+{
+	struct k_poll_event event;
+	int rc;
+
+	TC_PRINT("Polling an object polled by another thread\n");
+
+	poller_spawn();
+
+	k_poll_event_init(&event, K_POLL_TYPE_SEM_AVAILABLE,
+			  K_POLL_MODE_NOTIFY_ONLY, &sem);
+
+	rc = k_poll(&event, 1, TIMEOUT);
+	if (rc != -EADDRINUSE || event.state != K_POLL_STATE_EADDRINUSE) {
+		TC_ERROR("k_poll() returned %d, state %u\n", rc, event.state);
+		return TC_FAIL;
+	}
+
+	if (poller_result != 1) {
+		TC_ERROR("poller did not wait: %d\n", poller_result);
+		return TC_FAIL;
+	}
+
+	obj_give(0);
+
+	if (helper_wait() != TC_PASS) {
+		return TC_FAIL;
+	}
+
+	if (poller_result != 0) {
+		TC_ERROR("poller failed: %d\n", poller_result);
+		return TC_FAIL;
+	}
+
+	if (states_check(poller_events, 0) != TC_PASS ||
+	    obj_take(0) != TC_PASS) {
+		return TC_FAIL;
+	}
+
+	return timeout_check();
+}
+
+void main(void)
+{
+	int rv = TC_PASS;
+
+	TC_START("Test polling for multiple kernel objects");
+
+	k_thread_priority_set(k_current_get(), MAIN_PRIO);
+
+	if (test_poll_ready() != TC_PASS ||
+	    test_poll_timeout() != TC_PASS ||
+	    test_poll_wake_up() != TC_PASS ||
+	    test_poll_in_use() != TC_PASS) {
+		rv = TC_FAIL;
+	}
+
+	TC_END_RESULT(rv);
+	TC_END_REPORT(rv);
+}
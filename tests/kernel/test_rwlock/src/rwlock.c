@@ -0,0 +1,316 @@
+/*
+ * Copyright (c) 2016 Wind River Systems, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * @file
+ * @brief Test unified kernel reader-writer lock APIs
+ *
+ * The main thread runs at a low priority and spawns helper threads of
+ * higher priority, which run right away until they block on the lock.
+ *
+ * Scenario #1:
+ * The lock is taken and released without contention.
+ *
+ * Scenario #2:
+ * Several readers hold the lock at the same time.
+ *
+ * Scenario #3:
+ * A waiting writer keeps new readers out, and gets the lock from the last
+ * reader.
+ *
+ * Scenario #4:
+ * The writer holding the lock inherits the priority of a waiting reader.
+ *
+ * Scenario #5:
+ * A writer times out, and readers that waited behind it get the lock.
+ */
+
+#include <zephyr.h>
+#include <tc_util.h>
+
+#define STACKSIZE 512
+
+#define MAIN_PRIO   K_PRIO_PREEMPT(10)
+#define HELPER_PRIO K_PRIO_PREEMPT(5)
+
+static char __stack stack1[STACKSIZE];
+static char __stack stack2[STACKSIZE];
+
+K_RWLOCK_DEFINE(rwlock);
+
+static K_SEM_DEFINE(helper_done, 0, 2);
+
+static int helper_result[2];
+
+/**
+ *
+ * @brief Take the lock for reading, then release it
+ *
+ * @param p1 Where to store the result of k_rwlock_read_lock().
+ * @param p2 Timeout.
+ * @param p3 Unused.
+ *
+ * @return N/A
+ */
+static void reader(void *p1, void *p2, void *p3)
+{
+	int *result = p1;
+
+	ARG_UNUSED(p3);
+
+	*result = k_rwlock_read_lock(&rwlock, (int32_t)p2);
+	if (*result == 0) {
+		k_rwlock_read_unlock(&rwlock);
+	}
+
+	k_sem_give(&helper_done);
+}
+
+/**
+ *
+ * @brief Take the lock for writing, then release it
+ *
+ * @param p1 Where to store the result of k_rwlock_write_lock().
+ * @param p2 Timeout.
+ * @param p3 Unused.
+ *
+ * @return N/A
+ */
+static void writer(void *p1, void *p2, void *p3)
+{
+	int *result = p1;
+
+	ARG_UNUSED(p3);
+
+	*result = k_rwlock_write_lock(&rwlock, (int32_t)p2);
+	if (*result == 0) {
+		k_rwlock_write_unlock(&rwlock);
+	}
+
+	k_sem_give(&helper_done);
+}
+
+static void spawn(char *stack, void (*entry)(void *, void *, void *),
+		  int *result, int32_t timeout)
+{
+	*result = 1;
+	k_thread_spawn(stack, STACKSIZE, entry, result, (void *)timeout, NULL,
+		       HELPER_PRIO, 0, 0);
+}
+
+static int helpers_wait(int n)
+{
+	while (n--) {
+		if (k_sem_take(&helper_done, 1000) != 0) {
+			TC_ERROR("helper thread did not finish\n");
+			return TC_FAIL;
+		}
+	}
+
+	return TC_PASS;
+}
+
+static int test_uncontended(void)
+{
+	TC_PRINT("Taking and releasing the lock without contention\n");
+
+	if (k_rwlock_read_lock(&rwlock, K_NO_WAIT) != 0 ||
+	    k_rwlock_read_lock(&rwlock, K_NO_WAIT) != 0) {
+		TC_ERROR("could not take the lock for reading\n");
+		return TC_FAIL;
+	}
+
+	if (k_rwlock_write_lock(&rwlock, K_NO_WAIT) != -EBUSY) {
+		TC_ERROR("took the lock for writing while read\n");
+		return TC_FAIL;
+	}
+
+	k_rwlock_read_unlock(&rwlock);
+	k_rwlock_read_unlock(&rwlock);
+
+	if (k_rwlock_write_lock(&rwlock, K_NO_WAIT) != 0) {
+		TC_ERROR("could not take the lock for writing\n");
+		return TC_FAIL;
+	}
+
+	if (k_rwlock_read_lock(&rwlock, K_NO_WAIT) != -EBUSY) {
+		TC_ERROR("took the lock for reading while written\n");
+		return TC_FAIL;
+	}
+
+	k_rwlock_write_unlock(&rwlock);
+
+	return TC_PASS;
+}
+
+static int test_concurrent_readers(void)
+{
+	TC_PRINT("Concurrent readers\n");
+
+	k_rwlock_read_lock(&rwlock, K_FOREVER);
+
+	spawn(stack1, reader, &helper_result[0], K_NO_WAIT);
+	spawn(stack2, reader, &helper_result[1], K_NO_WAIT);
+
+	k_rwlock_read_unlock(&rwlock);
+
+	if (helpers_wait(2) != TC_PASS) {
+		return TC_FAIL;
+	}
+
+	if (helper_result[0] != 0 || helper_result[1] != 0) {
+		TC_ERROR("readers got %d and %d\n",
+			 helper_result[0], helper_result[1]);
+		return TC_FAIL;
+	}
+
+	return TC_PASS;
+}
+
+static int test_writer_preference(void)
+{
+	TC_PRINT("Writer preference\n");
+
+	k_rwlock_read_lock(&rwlock, K_FOREVER);
+
+	spawn(stack1, writer, &helper_result[0], K_FOREVER);
+
+	if (helper_result[0] != 1) {
+		TC_ERROR("writer did not wait for the reader\n");
+		return TC_FAIL;
+	}
+
+	if (k_rwlock_read_lock(&rwlock, K_NO_WAIT) != -EBUSY) {
+		TC_ERROR("new reader overtook the waiting writer\n");
+		return TC_FAIL;
+	}
+
+	/* the writer gets the lock and preempts us */
+	k_rwlock_read_unlock(&rwlock);
+
+	if (helper_result[0] != 0) {
+		TC_ERROR("writer got %d\n", helper_result[0]);
+		return TC_FAIL;
+	}
+
+	return helpers_wait(1);
+}
+
+static int test_priority_inheritance(void)
+{
+	int prio;
+
+	TC_PRINT("Priority inheritance\n");
+
+	k_rwlock_write_lock(&rwlock, K_FOREVER);
+
+	spawn(stack1, reader, &helper_result[0], K_FOREVER);
+
+	prio = k_thread_priority_get(k_current_get());
+	if (prio != HELPER_PRIO) {
+		TC_ERROR("writer runs at %d, not %d\n", prio, HELPER_PRIO);
+		return TC_FAIL;
+	}
+
+	/* the reader gets the lock and preempts us */
+	k_rwlock_write_unlock(&rwlock);
+
+	prio = k_thread_priority_get(k_current_get());
+	if (prio != MAIN_PRIO) {
+		TC_ERROR("writer still runs at %d, not %d\n", prio, MAIN_PRIO);
+		return TC_FAIL;
+	}
+
+	if (helper_result[0] != 0) {
+		TC_ERROR("reader got %d\n", helper_result[0]);
+		return TC_FAIL;
+	}
+
+	return helpers_wait(1);
+}
+
+static int test_timeout(void)
+{
+	int prio;
+
+	TC_PRINT("Timeouts\n");
+
+	k_rwlock_read_lock(&rwlock, K_FOREVER);
+
+	/* the reader waits behind the writer, which gives up */
+	spawn(stack1, writer, &helper_result[0], 50);
+	spawn(stack2, reader, &helper_result[1], K_FOREVER);
+
+	if (helpers_wait(2) != TC_PASS) {
+		return TC_FAIL;
+	}
+
+	if (helper_result[0] != -EAGAIN || helper_result[1] != 0) {
+		TC_ERROR("writer got %d, reader got %d\n",
+			 helper_result[0], helper_result[1]);
+		return TC_FAIL;
+	}
+
+	k_rwlock_read_unlock(&rwlock);
+
+	/* a writer that gives up no longer boosts the lock holder */
+	k_rwlock_write_lock(&rwlock, K_FOREVER);
+
+	spawn(stack1, writer, &helper_result[0], 50);
+
+	if (helpers_wait(1) != TC_PASS) {
+		return TC_FAIL;
+	}
+
+	prio = k_thread_priority_get(k_current_get());
+
+	k_rwlock_write_unlock(&rwlock);
+
+	if (helper_result[0] != -EAGAIN || prio != MAIN_PRIO) {
+		TC_ERROR("writer got %d, holder runs at %d\n",
+			 helper_result[0], prio);
+		return TC_FAIL;
+	}
+
+	/* the lock is free again */
+	if (k_rwlock_write_lock(&rwlock, K_NO_WAIT) != 0) {
+		TC_ERROR("could not take the lock for writing\n");
+		return TC_FAIL;
+	}
+	k_rwlock_write_unlock(&rwlock);
+
+	return TC_PASS;
+}
+
+void main(void)
+{
+	int rv = TC_PASS;
+
+	TC_START("Test Reader-Writer Lock APIs");
+
+	k_thread_priority_set(k_current_get(), MAIN_PRIO);
+
+	if (test_uncontended() != TC_PASS ||
+	    test_concurrent_readers() != TC_PASS ||
+	    test_writer_preference() != TC_PASS ||
+	    test_priority_inheritance() != TC_PASS ||
+	    test_timeout() != TC_PASS) {
+		rv = TC_FAIL;
+	}
+
+	TC_END_RESULT(rv);
+	TC_END_REPORT(rv);
+}
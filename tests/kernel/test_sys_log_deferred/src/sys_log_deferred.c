@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * @file
+ * @brief Test deferred system logging
+ *
+ * The messages are output by the test itself, with sys_log_process(), and
+ * the console output is captured to check them.
+ *
+ * Scenario #1:
+ * The domain can only be found once it has logged a message, and messages
+ * are output in the order they were logged, with all their arguments.
+ *
+ * Scenario #2:
+ * Messages logged while the buffer is full are dropped and counted, and
+ * the number of dropped messages is output before the next message.
+ *
+ * Scenario #3:
+ * Messages above the level set at runtime are not stored.
+ */
+
+#define SYS_LOG_DOMAIN "test"
+#define SYS_LOG_LEVEL SYS_LOG_LEVEL_DEBUG
+#include <misc/sys_log.h>
+
+#include <zephyr.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <tc_util.h>
+
+#define NUM_MSGS CONFIG_SYS_LOG_DEFERRED_MSGS
+
+#define BUF_SZ 256
+
+static int pos;
+static char ram_console[BUF_SZ];
+
+extern int (*_char_out)(int);
+static int (*_old_char_out)(int);
+
+static int ram_console_out(int character)
+{
+	if (pos < BUF_SZ - 1) {
+		ram_console[pos++] = (char)character;
+	}
+
+	return _old_char_out(character);
+}
+
+/**
+ *
+ * @brief Output the next message and check it
+ *
+ * The timestamp that starts each message is skipped.
+ *
+ * @param dropped Line expected before the message, or NULL.
+ * @param expected Message expected, after the timestamp.
+ *
+ * @return TC_PASS if the message is the one expected, TC_FAIL otherwise
+ */
+static int process_check(const char *dropped, const char *expected)
+{
+	char *msg = ram_console;
+	int processed;
+
+	pos = 0;
+	_char_out = ram_console_out;
+	processed = sys_log_process();
+	_char_out = _old_char_out;
+	ram_console[pos] = '\0';
+
+	if (!processed) {
+		TC_ERROR("no message to output, expected: %s", expected);
+		return TC_FAIL;
+	}
+
+	if (dropped) {
+		if (strncmp(msg, dropped, strlen(dropped)) != 0) {
+			TC_ERROR("missing drop count, got: %s", msg);
+			return TC_FAIL;
+		}
+		msg += strlen(dropped);
+	}
+
+	/* [timestamp] */
+	if (msg[0] != '[' || !strchr(msg, ']') ||
+	    strcmp(strchr(msg, ']') + 2, expected) != 0) {
+		TC_ERROR("expected: %s", expected);
+		TC_ERROR("got: %s", msg);
+		return TC_FAIL;
+	}
+
+	return TC_PASS;
+}
+
+static int test_order(void)
+{
+	TC_PRINT("Outputting messages in order\n");
+
+	if (sys_log_level_set(SYS_LOG_DOMAIN, SYS_LOG_LEVEL_DEBUG) !=
+	    -ENOENT) {
+		TC_ERROR("domain found before it logged anything\n");
+		return TC_FAIL;
+	}
+
+	SYS_LOG_ERR("first %d", 1);
+	SYS_LOG_WRN("second %s", "string");
+	SYS_LOG_DBG("%d %d %d %d %d %d %d %d", 1, 2, 3, 4, 5, 6, 7, 8);
+
+	if (process_check(NULL, "[test] test_order: first 1\n") ||
+	    process_check(NULL, "[test] test_order: second string\n") ||
+	    process_check(NULL, "[test] test_order: 1 2 3 4 5 6 7 8\n")) {
+		return TC_FAIL;
+	}
+
+	if (sys_log_process() != 0) {
+		TC_ERROR("more messages output than logged\n");
+		return TC_FAIL;
+	}
+
+	return TC_PASS;
+}
+
+static int test_drop(void)
+{
+	uint32_t dropped = sys_log_dropped_get();
+	char line[64];
+	int i;
+
+	TC_PRINT("Dropping messages while the buffer is full\n");
+
+	for (i = 0; i < NUM_MSGS + 2; i++) {
+		SYS_LOG_INF("message %d", i);
+	}
+
+	if (sys_log_dropped_get() - dropped != 2) {
+		TC_ERROR("%u messages dropped, not 2\n",
+			 sys_log_dropped_get() - dropped);
+		return TC_FAIL;
+	}
+
+	/* the messages kept are the first ones */
+	for (i = 0; i < NUM_MSGS; i++) {
+		snprintf(line, sizeof(line), "[test] test_drop: message %d\n",
+			 i);
+		if (process_check(i ? NULL : "--- 2 log messages dropped ---\n",
+				  line)) {
+			return TC_FAIL;
+		}
+	}
+
+	if (sys_log_process() != 0) {
+		TC_ERROR("dropped message output\n");
+		return TC_FAIL;
+	}
+
+	return TC_PASS;
+}
+
+static int test_level(void)
+{
+	int rv = TC_PASS;
+
+	TC_PRINT("Changing the log level at runtime\n");
+
+	if (sys_log_level_set("unknown", SYS_LOG_LEVEL_OFF) != -ENOENT) {
+		TC_ERROR("unknown domain found\n");
+		return TC_FAIL;
+	}
+
+	if (sys_log_level_set(SYS_LOG_DOMAIN, SYS_LOG_LEVEL_WARNING) != 0) {
+		TC_ERROR("could not set the domain level\n");
+		return TC_FAIL;
+	}
+
+	SYS_LOG_DBG("not stored");
+	SYS_LOG_INF("not stored");
+	SYS_LOG_WRN("stored");
+
+	if (process_check(NULL, "[test] test_level: stored\n") != TC_PASS ||
+	    sys_log_process() != 0) {
+		rv = TC_FAIL;
+	}
+
+	sys_log_level_set(SYS_LOG_DOMAIN, SYS_LOG_LEVEL_OFF);
+
+	SYS_LOG_ERR("not stored");
+
+	if (sys_log_process() != 0) {
+		TC_ERROR("message output from a silenced domain\n");
+		rv = TC_FAIL;
+	}
+
+	sys_log_level_set(SYS_LOG_DOMAIN, SYS_LOG_LEVEL_DEBUG);
+
+	return rv;
+}
+
+void main(void)
+{
+	int rv = TC_PASS;
+
+	TC_START("Test deferred system log");
+
+	_old_char_out = _char_out;
+
+	if (test_order() != TC_PASS ||
+	    test_drop() != TC_PASS ||
+	    test_level() != TC_PASS) {
+		rv = TC_FAIL;
+	}
+
+	TC_END_RESULT(rv);
+	TC_END_REPORT(rv);
+}
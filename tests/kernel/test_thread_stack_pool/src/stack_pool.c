@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2016 Wind River Systems, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * @file
+ * @brief Test threads spawned on stacks from the thread stack pool
+ *
+ * The main thread runs at a low priority and spawns helper threads of
+ * higher priority, which run right away until they block on a semaphore.
+ *
+ * Scenario #1:
+ * Threads are spawned until the pool has no stack left.
+ *
+ * Scenario #2:
+ * The threads exit, and their stacks are used for new threads.
+ *
+ * Scenario #3:
+ * A thread is aborted and a delayed thread is canceled before it starts,
+ * and their stacks are used for new threads.
+ */
+
+#include <zephyr.h>
+#include <tc_util.h>
+
+#define NUM_STACKS CONFIG_THREAD_STACK_POOL_STACKS
+
+#define MAIN_PRIO   K_PRIO_PREEMPT(10)
+#define HELPER_PRIO K_PRIO_PREEMPT(5)
+
+static K_SEM_DEFINE(helper_go, 0, NUM_STACKS);
+static K_SEM_DEFINE(helper_done, 0, NUM_STACKS);
+
+static k_tid_t helpers[NUM_STACKS];
+
+/**
+ *
+ * @brief Wait to be allowed to exit, then exit
+ *
+ * @return N/A
+ */
+static void helper(void *p1, void *p2, void *p3)
+{
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	k_sem_take(&helper_go, K_FOREVER);
+	k_sem_give(&helper_done);
+}
+
+static k_tid_t spawn(int32_t delay)
+{
+	return k_thread_spawn_dynamic(CONFIG_THREAD_STACK_POOL_STACK_SIZE,
+				      helper, NULL, NULL, NULL,
+				      HELPER_PRIO, 0, delay);
+}
+
+static int spawn_all(void)
+{
+	int i;
+
+	for (i = 0; i < NUM_STACKS; i++) {
+		helpers[i] = spawn(K_NO_WAIT);
+		if (!helpers[i]) {
+			TC_ERROR("no stack for thread %d\n", i);
+			return TC_FAIL;
+		}
+	}
+
+	if (spawn(K_NO_WAIT) != NULL) {
+		TC_ERROR("got more stacks than the pool has\n");
+		return TC_FAIL;
+	}
+
+	return TC_PASS;
+}
+
+static int release_all(void)
+{
+	int i;
+
+	for (i = 0; i < NUM_STACKS; i++) {
+		k_sem_give(&helper_go);
+	}
+
+	for (i = 0; i < NUM_STACKS; i++) {
+		if (k_sem_take(&helper_done, 1000) != 0) {
+			TC_ERROR("helper thread did not finish\n");
+			return TC_FAIL;
+		}
+	}
+
+	return TC_PASS;
+}
+
+static int test_pool_empty(void)
+{
+	TC_PRINT("Spawning threads until the pool is empty\n");
+
+	if (k_thread_spawn_dynamic(CONFIG_THREAD_STACK_POOL_STACK_SIZE + 64,
+				   helper, NULL, NULL, NULL,
+				   HELPER_PRIO, 0, K_NO_WAIT) != NULL) {
+		TC_ERROR("got a stack larger than the pool stacks\n");
+		return TC_FAIL;
+	}
+
+	return spawn_all();
+}
+
+static int test_exit(void)
+{
+	TC_PRINT("Reusing the stacks of exited threads\n");
+
+	if (release_all() != TC_PASS) {
+		return TC_FAIL;
+	}
+
+	if (spawn_all() != TC_PASS) {
+		return TC_FAIL;
+	}
+
+	return release_all();
+}
+
+static int test_abort_cancel(void)
+{
+	k_tid_t tid;
+
+	TC_PRINT("Reusing the stacks of aborted and canceled threads\n");
+
+	if (spawn_all() != TC_PASS) {
+		return TC_FAIL;
+	}
+
+	/* helpers[0] waits for helper_go */
+	k_thread_abort(helpers[0]);
+
+	/* another helper exits */
+	k_sem_give(&helper_go);
+	if (k_sem_take(&helper_done, 1000) != 0) {
+		TC_ERROR("helper thread did not finish\n");
+		return TC_FAIL;
+	}
+
+	tid = spawn(1000);
+	if (!tid || k_thread_cancel(tid) != 0) {
+		TC_ERROR("could not spawn and cancel a delayed thread\n");
+		return TC_FAIL;
+	}
+
+	/* two stacks are back in the pool */
+	helpers[0] = spawn(K_NO_WAIT);
+	helpers[1] = spawn(K_NO_WAIT);
+	if (!helpers[0] || !helpers[1]) {
+		TC_ERROR("stacks did not go back to the pool\n");
+		return TC_FAIL;
+	}
+
+	return release_all();
+}
+
+void main(void)
+{
+	int rv = TC_PASS;
+
+	TC_START("Test Thread Stack Pool");
+
+	k_thread_priority_set(k_current_get(), MAIN_PRIO);
+
+	if (test_pool_empty() != TC_PASS ||
+	    test_exit() != TC_PASS ||
+	    test_abort_cancel() != TC_PASS) {
+		rv = TC_FAIL;
+	}
+
+	TC_END_RESULT(rv);
+	TC_END_REPORT(rv);
+}
@@ -0,0 +1,427 @@
+/*
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <misc/printk.h>
+
+#include <nanokernel.h>
+
+#include <net/ip_buf.h>
+#include <net/l2_buf.h>
+#include <net/net_core.h>
+#include <net/net_socket.h>
+
+#include <tc_util.h>
+
+#include "contiki/packetbuf.h"
+#include "contiki/sicslowpan/sicslowpan_fragmentation.h"
+
+#define MY_PORT 4242
+#define PEER_PORT 4243
+
+#define IPV6_HDR_LEN 40
+#define UDP_HDR_LEN 8
+#define DATA_LEN 72
+#define PKT_LEN (IPV6_HDR_LEN + UDP_HDR_LEN + DATA_LEN)
+
+/* IPHC with the traffic class and flow label elided, the next header
+ * inline, a hop limit of 255 and both addresses inline
+ */
+#define IPHC_HDR_LEN 35
+
+#define DISPATCH_IPV6 0x41
+
+#define WAIT_TICKS (sys_clock_ticks_per_sec / 10)
+
+static const struct in6_addr in6addr_my = { { { 0x20, 0x01, 0x0d, 0xb8,
+						0, 0, 0, 0, 0, 0, 0, 0,
+						0, 0, 0, 0x1 } } };
+static const struct in6_addr in6addr_peer = { { { 0x20, 0x01, 0x0d, 0xb8,
+						  0, 0, 0, 0, 0, 0, 0, 0,
+						  0, 0, 0, 0x2 } } };
+
+static const linkaddr_t sender = { { 0x02, 0, 0, 0, 0, 0, 0, 0x02 } };
+static const linkaddr_t receiver = { { 0x02, 0, 0, 0, 0, 0, 0, 0x01 } };
+
+static struct net_context *ctx;
+static struct net_addr any_addr;
+static struct net_addr my_addr;
+
+/* The uncompressed datagram, with room for a fragment past its end,
+ * and its IPHC header
+ */
+static uint8_t pkt[PKT_LEN + 8];
+static uint8_t iphc_hdr[IPHC_HDR_LEN];
+
+static uint16_t tag;
+
+static void build_packet(void)
+{
+	int i;
+
+	/* IPv6 header */
+	pkt[0] = 0x60;
+	pkt[4] = (UDP_HDR_LEN + DATA_LEN) >> 8;
+	pkt[5] = (UDP_HDR_LEN + DATA_LEN) & 0xff;
+	pkt[6] = IPPROTO_UDP;
+	pkt[7] = 255;
+	memcpy(&pkt[8], &in6addr_peer, 16);
+	memcpy(&pkt[24], &in6addr_my, 16);
+
+	/* UDP header, a zero checksum is accepted */
+	pkt[40] = PEER_PORT >> 8;
+	pkt[41] = PEER_PORT & 0xff;
+	pkt[42] = MY_PORT >> 8;
+	pkt[43] = MY_PORT & 0xff;
+	pkt[44] = (UDP_HDR_LEN + DATA_LEN) >> 8;
+	pkt[45] = (UDP_HDR_LEN + DATA_LEN) & 0xff;
+
+	for (i = 0; i < DATA_LEN; i++) {
+		pkt[IPV6_HDR_LEN + UDP_HDR_LEN + i] = i;
+	}
+
+	iphc_hdr[0] = 0x7b;
+	iphc_hdr[1] = 0x00;
+	iphc_hdr[2] = IPPROTO_UDP;
+	memcpy(&iphc_hdr[3], &in6addr_peer, 16);
+	memcpy(&iphc_hdr[19], &in6addr_my, 16);
+}
+
+static void input(const uint8_t *frame, uint16_t len)
+{
+	struct net_buf *mbuf;
+
+	mbuf = l2_buf_get_reserve(0);
+	if (!mbuf) {
+		TC_PRINT("Could not get L2 buffer\n");
+		return;
+	}
+
+	packetbuf_copyfrom(mbuf, frame, len);
+	packetbuf_set_addr(mbuf, PACKETBUF_ADDR_SENDER, &sender);
+	packetbuf_set_addr(mbuf, PACKETBUF_ADDR_RECEIVER, &receiver);
+
+	/* Like the 802.15.4 RX fiber, free the frame if it was refused */
+	if (!sicslowpan_fragmentation.reassemble(mbuf)) {
+		l2_buf_unref(mbuf);
+	}
+}
+
+/* First fragment, up to len bytes of the uncompressed datagram */
+static void frag1(uint16_t len, bool compressed)
+{
+	uint8_t frame[SICSLOWPAN_FRAG1_HDR_LEN + 1 + PKT_LEN];
+	uint16_t hdr_len = SICSLOWPAN_FRAG1_HDR_LEN;
+
+	frame[0] = SICSLOWPAN_DISPATCH_FRAG1 | (PKT_LEN >> 8);
+	frame[1] = PKT_LEN & 0xff;
+	frame[2] = tag >> 8;
+	frame[3] = tag & 0xff;
+
+	if (compressed) {
+		memcpy(&frame[hdr_len], iphc_hdr, IPHC_HDR_LEN);
+		memcpy(&frame[hdr_len + IPHC_HDR_LEN], &pkt[IPV6_HDR_LEN],
+		       len - IPV6_HDR_LEN);
+		len += IPHC_HDR_LEN - IPV6_HDR_LEN;
+	} else {
+		frame[hdr_len++] = DISPATCH_IPV6;
+		memcpy(&frame[hdr_len], pkt, len);
+	}
+
+	input(frame, hdr_len + len);
+}
+
+/* Subsequent fragment, len bytes from block offset */
+static void fragn(uint8_t offset, uint16_t len)
+{
+	uint8_t frame[SICSLOWPAN_FRAGN_HDR_LEN + PKT_LEN];
+
+	frame[0] = SICSLOWPAN_DISPATCH_FRAGN | (PKT_LEN >> 8);
+	frame[1] = PKT_LEN & 0xff;
+	frame[2] = tag >> 8;
+	frame[3] = tag & 0xff;
+	frame[4] = offset;
+
+	memcpy(&frame[SICSLOWPAN_FRAGN_HDR_LEN], &pkt[offset << 3], len);
+
+	input(frame, SICSLOWPAN_FRAGN_HDR_LEN + len);
+}
+
+static int recv_check(void)
+{
+	struct net_buf *buf;
+	int result = TC_PASS;
+
+	buf = net_receive(ctx, WAIT_TICKS);
+	if (!buf) {
+		TC_PRINT("Datagram not delivered\n");
+		return TC_FAIL;
+	}
+
+	if (ip_buf_appdatalen(buf) != DATA_LEN ||
+	    memcmp(ip_buf_appdata(buf), &pkt[IPV6_HDR_LEN + UDP_HDR_LEN],
+		   DATA_LEN)) {
+		TC_PRINT("Wrong data delivered (%d bytes)\n",
+			 ip_buf_appdatalen(buf));
+		result = TC_FAIL;
+	}
+
+	ip_buf_unref(buf);
+
+	return result;
+}
+
+static int recv_none(void)
+{
+	struct net_buf *buf;
+
+	buf = net_receive(ctx, WAIT_TICKS);
+	if (buf) {
+		TC_PRINT("Datagram delivered\n");
+		ip_buf_unref(buf);
+		return TC_FAIL;
+	}
+
+	return TC_PASS;
+}
+
+static int test_in_order(void)
+{
+	int result;
+
+	tag++;
+
+	frag1(56, false);
+	fragn(7, 32);
+	fragn(11, 32);
+
+	result = recv_check();
+
+	TC_END_RESULT(result);
+
+	return result;
+}
+
+static int test_out_of_order(void)
+{
+	int result;
+
+	tag++;
+
+	fragn(11, 32);
+	frag1(56, false);
+	fragn(7, 32);
+
+	result = recv_check();
+
+	TC_END_RESULT(result);
+
+	return result;
+}
+
+static int test_duplicate(void)
+{
+	int result = TC_FAIL;
+
+	tag++;
+
+	frag1(56, false);
+	fragn(7, 32);
+	fragn(7, 32);
+	frag1(56, false);
+
+	if (recv_none() != TC_PASS) {
+		goto done;
+	}
+
+	fragn(11, 32);
+
+	/* Delivered once */
+	if (recv_check() != TC_PASS || recv_none() != TC_PASS) {
+		goto done;
+	}
+
+	result = TC_PASS;
+
+done:
+	TC_END_RESULT(result);
+
+	return result;
+}
+
+static int test_overlapping(void)
+{
+	int result = TC_FAIL;
+
+	/* Overlapping a subsequent fragment discards the datagram */
+	tag++;
+
+	frag1(56, false);
+	fragn(7, 32);
+	fragn(9, 32);
+
+	if (recv_none() != TC_PASS) {
+		goto done;
+	}
+
+	/* And so does overlapping the first fragment */
+	tag++;
+
+	fragn(6, 40);
+	fragn(11, 32);
+	frag1(56, false);
+
+	if (recv_none() != TC_PASS) {
+		goto done;
+	}
+
+	result = TC_PASS;
+
+done:
+	TC_END_RESULT(result);
+
+	return result;
+}
+
+static int test_past_end(void)
+{
+	int result;
+
+	tag++;
+
+	frag1(56, false);
+	fragn(7, 32);
+	/* Bytes 88 to 128 of a 120 byte datagram */
+	fragn(11, 40);
+
+	result = recv_none();
+
+	TC_END_RESULT(result);
+
+	return result;
+}
+
+static int test_missing_middle(void)
+{
+	int result = TC_FAIL;
+
+	/* Reassembly waits for the missing fragment */
+	tag++;
+
+	frag1(56, false);
+	fragn(11, 32);
+
+	if (recv_none() != TC_PASS) {
+		goto done;
+	}
+
+	fragn(7, 32);
+
+	if (recv_check() != TC_PASS) {
+		goto done;
+	}
+
+	/* The end of a compressed first fragment is only known once
+	 * uncompressed, here it ends 8 bytes short of the next fragment
+	 */
+	tag++;
+
+	frag1(48, true);
+	fragn(7, 32);
+	fragn(11, 32);
+
+	if (recv_none() != TC_PASS) {
+		goto done;
+	}
+
+	result = TC_PASS;
+
+done:
+	TC_END_RESULT(result);
+
+	return result;
+}
+
+static int test_compressed(void)
+{
+	int result;
+
+	tag++;
+
+	fragn(7, 32);
+	frag1(56, true);
+	fragn(11, 32);
+
+	result = recv_check();
+
+	TC_END_RESULT(result);
+
+	return result;
+}
+
+static const struct {
+	const char *name;
+	int (*func)(void);
+} tests[] = {
+	{ "In order fragments", test_in_order, },
+	{ "Out of order fragments", test_out_of_order, },
+	{ "Duplicate fragments", test_duplicate, },
+	{ "Overlapping fragments", test_overlapping, },
+	{ "Fragments past the end", test_past_end, },
+	{ "Missing middle fragment", test_missing_middle, },
+	{ "Compressed first fragment", test_compressed, },
+};
+
+int main(int argc, char *argv[])
+{
+	int count, pass, result;
+
+	TC_START("Test 6LoWPAN fragment reassembly");
+
+	net_init();
+
+	build_packet();
+
+	any_addr.family = AF_INET6;
+	my_addr.in6_addr = in6addr_my;
+	my_addr.family = AF_INET6;
+
+	ctx = net_context_get(IPPROTO_UDP, &any_addr, 0, &my_addr, MY_PORT);
+	if (!ctx) {
+		TC_PRINT("Cannot get network context\n");
+		TC_END_REPORT(TC_FAIL);
+		return 0;
+	}
+
+	for (count = 0, pass = 0; count < ARRAY_SIZE(tests); count++) {
+		TC_PRINT("%s\n", tests[count].name);
+
+		if (tests[count].func() == TC_PASS) {
+			pass++;
+		}
+	}
+
+	TC_PRINT("%d / %d tests passed\n", pass, count);
+
+	result = pass == count ? TC_PASS : TC_FAIL;
+
+	TC_END_REPORT(result);
+
+	return 0;
+}
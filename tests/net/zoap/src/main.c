@@ -641,7 +641,7 @@ static int test_observer_server(void)
 	}
 
 	rsp_buf = net_buf_get(&zoap_fifo, 0);
-	if (!buf) {
+	if (!rsp_buf) {
 		TC_PRINT("Could not get buffer from pool\n");
 		goto done;
 	}
@@ -772,7 +772,7 @@ static int test_observer_client(void)
 	}
 
 	rsp_buf = net_buf_get(&zoap_fifo, 0);
-	if (!buf) {
+	if (!rsp_buf) {
 		TC_PRINT("Could not get buffer from pool\n");
 		goto done;
 	}
@@ -807,6 +807,1017 @@ static int test_observer_client(void)
 
 done:
 	net_buf_unref(buf);
+	if (rsp_buf) {
+		net_buf_unref(rsp_buf);
+	}
+
+	TC_END_RESULT(result);
+
+	return result;
+}
+
+static struct zoap_resource *index_called;
+
+static int index_resource_get(struct zoap_resource *resource,
+			      struct zoap_packet *request,
+			      const uip_ipaddr_t *addr,
+			      uint16_t port)
+{
+	index_called = resource;
+
+	return 0;
+}
+
+static const char * const index_path_s[] = { "s", NULL };
+static const char * const index_path_s_1[] = { "s", "1", NULL };
+static const char * const index_path_s_2_x[] = { "s", "2", "x", NULL };
+static const char * const index_path_a[] = { "a", NULL };
+static struct zoap_resource index_resources[] = {
+	{ .get = index_resource_get, .path = index_path_s_1 },
+	{ .get = index_resource_get, .path = index_path_s },
+	{ .get = index_resource_get, .path = index_path_s_2_x },
+	{ .get = index_resource_get, .path = index_path_a },
+	{ },
+};
+
+static int index_dispatch(struct zoap_resource_index *index,
+			  struct net_buf *buf,
+			  const uint8_t *pdu, size_t len,
+			  struct zoap_resource **called)
+{
+	struct zoap_packet req;
+	int r;
+
+	ip_buf_appdata(buf) = net_buf_tail(buf);
+	memcpy(ip_buf_appdata(buf), pdu, len);
+	ip_buf_appdatalen(buf) = len;
+
+	r = zoap_packet_parse(&req, buf);
+	if (r) {
+		return r;
+	}
+
+	index_called = NULL;
+
+	r = zoap_handle_request_indexed(&req, index, &dummy_addr, MY_PORT);
+
+	*called = index_called;
+
+	return r;
+}
+
+static int test_resource_index(void)
+{
+	/* GET, Uri-Path options */
+	uint8_t s_1_pdu[] = { 0x40, 0x01, 0x12, 0x34,
+			      0xb1, 's', 0x01, '1' };
+	uint8_t s_pdu[] = { 0x40, 0x01, 0x12, 0x34,
+			    0xb1, 's' };
+	uint8_t s_2_pdu[] = { 0x40, 0x01, 0x12, 0x34,
+			      0xb1, 's', 0x01, '2' };
+	uint8_t s_2_x_pdu[] = { 0x40, 0x01, 0x12, 0x34,
+				0xb1, 's', 0x01, '2', 0x01, 'x' };
+	uint8_t b_pdu[] = { 0x40, 0x01, 0x12, 0x34,
+			    0xb1, 'b' };
+	struct zoap_resource_index_entry entries[6];
+	struct zoap_resource_index index;
+	struct zoap_resource *called;
+	struct net_buf *buf;
+	int result = TC_FAIL;
+	int r;
+
+	buf = net_buf_get(&zoap_fifo, 0);
+	if (!buf) {
+		TC_PRINT("Could not get buffer from pool\n");
+		goto done;
+	}
+
+	/* "s", "s/1", "s/2", "s/2/x" and "a" */
+	r = zoap_resource_index_build(&index, entries, 4, index_resources);
+	if (r != -ENOMEM) {
+		TC_PRINT("Index should not fit in 4 entries\n");
+		goto done;
+	}
+
+	r = zoap_resource_index_build(&index, entries, ARRAY_SIZE(entries),
+				      index_resources);
+	if (r) {
+		TC_PRINT("Could not build resource index\n");
+		goto done;
+	}
+
+	r = index_dispatch(&index, buf, s_1_pdu, sizeof(s_1_pdu), &called);
+	if (r || called != &index_resources[0]) {
+		TC_PRINT("Wrong resource for s/1\n");
+		goto done;
+	}
+
+	r = index_dispatch(&index, buf, s_pdu, sizeof(s_pdu), &called);
+	if (r || called != &index_resources[1]) {
+		TC_PRINT("Wrong resource for s\n");
+		goto done;
+	}
+
+	r = index_dispatch(&index, buf, s_2_x_pdu, sizeof(s_2_x_pdu),
+			   &called);
+	if (r || called != &index_resources[2]) {
+		TC_PRINT("Wrong resource for s/2/x\n");
+		goto done;
+	}
+
+	/* Intermediate node without a resource */
+	r = index_dispatch(&index, buf, s_2_pdu, sizeof(s_2_pdu), &called);
+	if (r != -ENOENT || called) {
+		TC_PRINT("There should be no resource for s/2\n");
+		goto done;
+	}
+
+	r = index_dispatch(&index, buf, b_pdu, sizeof(b_pdu), &called);
+	if (r != -ENOENT || called) {
+		TC_PRINT("There should be no resource for b\n");
+		goto done;
+	}
+
+	/* The same resource twice */
+	index_resources[3].path = index_path_s_1;
+	r = zoap_resource_index_build(&index, entries, ARRAY_SIZE(entries),
+				      index_resources);
+	index_resources[3].path = index_path_a;
+	if (r != -EEXIST) {
+		TC_PRINT("Duplicate resource path not detected\n");
+		goto done;
+	}
+
+	result = TC_PASS;
+
+done:
+	if (buf) {
+		net_buf_unref(buf);
+	}
+
+	TC_END_RESULT(result);
+
+	return result;
+}
+
+#define BLOCK_DATA_SIZE 100
+
+static uint8_t block_data[BLOCK_DATA_SIZE];
+static uint8_t block_received[BLOCK_DATA_SIZE];
+static size_t block_data_len;
+static bool block_last;
+
+static int block_read(struct zoap_resource *resource, size_t offset,
+		      uint8_t *data, uint16_t len)
+{
+	if (offset >= block_data_len) {
+		return 0;
+	}
+
+	len = min(len, block_data_len - offset);
+	memcpy(data, &block_data[offset], len);
+
+	return len;
+}
+
+static int block_write(struct zoap_resource *resource, size_t offset,
+		       const uint8_t *data, uint16_t len, bool last)
+{
+	if (offset + len > sizeof(block_received)) {
+		return -ENOMEM;
+	}
+
+	memcpy(&block_received[offset], data, len);
+	block_last = last;
+
+	return 0;
+}
+
+static int block_packet_init(struct zoap_packet *pkt, struct net_buf *buf,
+			     uint8_t type, uint8_t code)
+{
+	int r;
+
+	ip_buf_appdata(buf) = net_buf_tail(buf);
+	ip_buf_appdatalen(buf) = 0;
+
+	r = zoap_packet_init(pkt, buf);
+	if (r) {
+		return r;
+	}
+
+	zoap_header_set_version(pkt, 1);
+	zoap_header_set_type(pkt, type);
+	zoap_header_set_code(pkt, code);
+	zoap_header_set_id(pkt, 0x1234);
+
+	return 0;
+}
+
+static int test_option_int(void)
+{
+	struct zoap_packet pkt;
+	struct zoap_option options[2];
+	struct net_buf *buf;
+	int result = TC_FAIL;
+	int r;
+
+	buf = net_buf_get(&zoap_fifo, 0);
+	if (!buf) {
+		TC_PRINT("Could not get buffer from pool\n");
+		goto done;
+	}
+
+	r = block_packet_init(&pkt, buf, ZOAP_TYPE_CON, ZOAP_METHOD_GET);
+	if (r) {
+		TC_PRINT("Could not initialize packet\n");
+		goto done;
+	}
+
+	r = zoap_add_option_int(&pkt, ZOAP_OPTION_SIZE2, 0xff);
+	r |= zoap_add_option_int(&pkt, ZOAP_OPTION_SIZE2, 0x12345);
+	if (r) {
+		TC_PRINT("Could not add integer options\n");
+		goto done;
+	}
+
+	r = zoap_find_options(&pkt, ZOAP_OPTION_SIZE2, options, 2);
+	if (r != 2) {
+		TC_PRINT("Integer options not found\n");
+		goto done;
+	}
+
+	/* Network byte order, shortest encoding */
+	if (options[0].len != 1 || options[1].len != 3 ||
+	    options[1].value[0] != 0x01 || options[1].value[2] != 0x45) {
+		TC_PRINT("Integer options wrongly encoded\n");
+		goto done;
+	}
+
+	if (zoap_option_value_to_int(&options[0]) != 0xff ||
+	    zoap_option_value_to_int(&options[1]) != 0x12345) {
+		TC_PRINT("Integer options wrongly decoded\n");
+		goto done;
+	}
+
+	result = TC_PASS;
+
+done:
+	if (buf) {
+		net_buf_unref(buf);
+	}
+
+	TC_END_RESULT(result);
+
+	return result;
+}
+
+static int block2_transfer(size_t total, int expected_blocks)
+{
+	struct zoap_block_context client, server;
+	struct zoap_packet req, rsp;
+	struct net_buf *req_buf, *rsp_buf = NULL;
+	int result = TC_FAIL;
+	int blocks = 0;
+	uint16_t len;
+	size_t i;
+	int r;
+
+	for (i = 0; i < sizeof(block_data); i++) {
+		block_data[i] = i;
+	}
+	memset(block_received, 0, sizeof(block_received));
+	block_data_len = total;
+
+	req_buf = net_buf_get(&zoap_fifo, 0);
+	rsp_buf = net_buf_get(&zoap_fifo, 0);
+	if (!req_buf || !rsp_buf) {
+		TC_PRINT("Could not get buffer from pool\n");
+		goto done;
+	}
+
+	/* The client asks for 64-byte blocks, the server only does 32 */
+	zoap_block_transfer_init(&client, ZOAP_BLOCK_64, 0);
+
+	do {
+		r = block_packet_init(&req, req_buf, ZOAP_TYPE_CON,
+				      ZOAP_METHOD_GET);
+		r |= zoap_add_block2_option(&req, &client);
+		if (r) {
+			TC_PRINT("Could not build request\n");
+			goto done;
+		}
+
+		/* Server */
+		r = zoap_packet_parse(&req, req_buf);
+		if (r) {
+			TC_PRINT("Could not parse request\n");
+			goto done;
+		}
+
+		zoap_block_transfer_init(&server, ZOAP_BLOCK_32, total);
+
+		r = zoap_update_from_block(&req, &server);
+		if (r) {
+			TC_PRINT("No block option in request\n");
+			goto done;
+		}
+
+		r = block_packet_init(&rsp, rsp_buf, ZOAP_TYPE_ACK,
+				      ZOAP_RESPONSE_CODE_CONTENT);
+		r |= zoap_block2_respond(NULL, &rsp, &server, block_read);
+		if (r) {
+			TC_PRINT("Could not build response\n");
+			goto done;
+		}
+
+		/* Client */
+		r = zoap_packet_parse(&rsp, rsp_buf);
+		if (r) {
+			TC_PRINT("Could not parse response\n");
+			goto done;
+		}
+
+		r = zoap_update_from_block(&rsp, &client);
+		if (r) {
+			TC_PRINT("No block option in response\n");
+			goto done;
+		}
+
+		len = ip_buf_appdatalen(rsp_buf) -
+			(rsp.start - (uint8_t *)ip_buf_appdata(rsp_buf));
+		if (client.current + len > sizeof(block_received)) {
+			TC_PRINT("Block out of bounds\n");
+			goto done;
+		}
+
+		memcpy(&block_received[client.current], rsp.start, len);
+		blocks++;
+	} while (zoap_next_block(&client));
+
+	if (blocks != expected_blocks || client.block_size != ZOAP_BLOCK_32 ||
+	    client.total_size != total) {
+		TC_PRINT("Unexpected negotiation (%d blocks)\n", blocks);
+		goto done;
+	}
+
+	/* The last block tells there are no more, even if full */
+	if (client.more) {
+		TC_PRINT("More blocks announced after the last one\n");
+		goto done;
+	}
+
+	if (memcmp(block_data, block_received, total)) {
+		TC_PRINT("Representation received differs\n");
+		goto done;
+	}
+
+	result = TC_PASS;
+
+done:
+	if (req_buf) {
+		net_buf_unref(req_buf);
+	}
+
+	if (rsp_buf) {
+		net_buf_unref(rsp_buf);
+	}
+
+	return result;
+}
+
+static int test_block2_transfer(void)
+{
+	int result;
+
+	/* The last block is a short one, then a full one */
+	result = block2_transfer(BLOCK_DATA_SIZE, 4);
+	if (result == TC_PASS) {
+		result = block2_transfer(96, 3);
+	}
+
+	TC_END_RESULT(result);
+
+	return result;
+}
+
+static int test_block1_transfer(void)
+{
+	/* Blocks #0, #2 then #1, out of sequence once */
+	static const uint16_t offsets[] = { 0, 64, 32 };
+	struct zoap_block_context client, server;
+	struct zoap_packet req, rsp;
+	struct net_buf *req_buf, *rsp_buf = NULL;
+	int result = TC_FAIL;
+	uint8_t *payload, code = ZOAP_CODE_EMPTY;
+	uint16_t len;
+	size_t i;
+	int r;
+
+	for (i = 0; i < sizeof(block_data); i++) {
+		block_data[i] = 0xff - i;
+	}
+	memset(block_received, 0, sizeof(block_received));
+	block_last = false;
+
+	req_buf = net_buf_get(&zoap_fifo, 0);
+	rsp_buf = net_buf_get(&zoap_fifo, 0);
+	if (!req_buf || !rsp_buf) {
+		TC_PRINT("Could not get buffer from pool\n");
+		goto done;
+	}
+
+	zoap_block_transfer_init(&client, ZOAP_BLOCK_32, sizeof(block_data));
+	zoap_block_transfer_init(&server, ZOAP_BLOCK_64, 0);
+
+	do {
+		r = block_packet_init(&req, req_buf, ZOAP_TYPE_CON,
+				      ZOAP_METHOD_PUT);
+		r |= zoap_add_block1_option(&req, &client);
+		r |= zoap_add_size1_option(&req, &client);
+		if (r) {
+			TC_PRINT("Could not build request\n");
+			goto done;
+		}
+
+		payload = zoap_packet_get_payload(&req, &len);
+		len = min(zoap_block_size_to_bytes(client.block_size),
+			  sizeof(block_data) - client.current);
+		memcpy(payload, &block_data[client.current], len);
+		zoap_packet_set_used(&req, len);
+
+		/* Server */
+		r = zoap_packet_parse(&req, req_buf);
+		if (r) {
+			TC_PRINT("Could not parse request\n");
+			goto done;
+		}
+
+		r = zoap_block1_receive(NULL, &req, &server, block_write);
+		if (r) {
+			TC_PRINT("Block not accepted (%d)\n", r);
+			goto done;
+		}
+
+		code = server.more ? ZOAP_RESPONSE_CODE_CONTINUE :
+			ZOAP_RESPONSE_CODE_CHANGED;
+
+		r = block_packet_init(&rsp, rsp_buf, ZOAP_TYPE_ACK, code);
+		r |= zoap_add_block1_option(&rsp, &server);
+		if (r) {
+			TC_PRINT("Could not build response\n");
+			goto done;
+		}
+
+		/* Client */
+		r = zoap_packet_parse(&rsp, rsp_buf);
+		r |= zoap_update_from_block(&rsp, &client);
+		if (r) {
+			TC_PRINT("Could not parse response\n");
+			goto done;
+		}
+	} while (zoap_next_block(&client));
+
+	if (code != ZOAP_RESPONSE_CODE_CHANGED || !block_last ||
+	    server.total_size != sizeof(block_data)) {
+		TC_PRINT("Transfer did not complete\n");
+		goto done;
+	}
+
+	if (memcmp(block_data, block_received, sizeof(block_data))) {
+		TC_PRINT("Representation received differs\n");
+		goto done;
+	}
+
+	/* A block out of sequence is rejected, the next one still expected */
+	zoap_block_transfer_init(&client, ZOAP_BLOCK_32, 128);
+	zoap_block_transfer_init(&server, ZOAP_BLOCK_64, 0);
+
+	for (i = 0; i < ARRAY_SIZE(offsets); i++) {
+		client.current = offsets[i];
+
+		r = block_packet_init(&req, req_buf, ZOAP_TYPE_CON,
+				      ZOAP_METHOD_PUT);
+		r |= zoap_add_block1_option(&req, &client);
+		r |= zoap_packet_parse(&req, req_buf);
+		if (r) {
+			TC_PRINT("Could not build request\n");
+			goto done;
+		}
+
+		r = zoap_block1_receive(NULL, &req, &server, block_write);
+		if (i == 1 ? r != -EAGAIN : r != 0) {
+			TC_PRINT("Block at %u wrongly handled (%d)\n",
+				 offsets[i], r);
+			goto done;
+		}
+	}
+
+	result = TC_PASS;
+
+done:
+	if (req_buf) {
+		net_buf_unref(req_buf);
+	}
+
+	if (rsp_buf) {
+		net_buf_unref(rsp_buf);
+	}
+
+	TC_END_RESULT(result);
+
+	return result;
+}
+
+/* RFC 7252 defaults, as used by the transaction engine */
+#define ACK_TIMEOUT 2000
+#define ACK_TIMEOUT_MAX 3000
+#define MAX_RETRANSMIT 4
+#define MAX_TRANSMIT_WAIT 93000
+
+#define TICK CONFIG_ZOAP_TRANSACTION_TICK
+
+static int transactions_sent;
+static int transactions_done;
+static const struct zoap_packet *transaction_response;
+
+/* Time in ms, as advanced by the test, and when each request was sent */
+static uint32_t transaction_clock;
+static uint32_t transaction_sent_at[1 + MAX_RETRANSMIT];
+static uint16_t transaction_timeout[1 + MAX_RETRANSMIT];
+static uint32_t transaction_done_at;
+
+static int transaction_send(struct zoap_transaction *transaction)
+{
+	if (transactions_sent < ARRAY_SIZE(transaction_sent_at)) {
+		transaction_sent_at[transactions_sent] = transaction_clock;
+		transaction_timeout[transactions_sent] = transaction->timeout;
+	}
+
+	transactions_sent++;
+
+	return 0;
+}
+
+static void transaction_done(struct zoap_transaction *transaction,
+			     const struct zoap_packet *response)
+{
+	transactions_done++;
+	transaction_response = response;
+	transaction_done_at = transaction_clock;
+}
+
+/* Advances time until ms have passed or the transaction is done */
+static void transactions_advance(struct zoap_transactions *transactions,
+				 uint32_t ms)
+{
+	uint32_t end = transaction_clock + ms;
+
+	while (!transactions_done && transaction_clock < end) {
+		transaction_clock += TICK;
+		zoap_transactions_advance(transactions, TICK);
+	}
+}
+
+/* Whether it expired within a tick of the timeout */
+static bool expired_in_time(uint32_t from, uint32_t to, uint32_t timeout)
+{
+	return to - from >= timeout && to - from <= timeout + TICK;
+}
+
+static int transaction_packet(struct zoap_packet *pkt, struct net_buf *buf,
+			      uint8_t type, uint8_t code, uint16_t id,
+			      const char *token)
+{
+	int r;
+
+	ip_buf_appdata(buf) = net_buf_tail(buf);
+	ip_buf_appdatalen(buf) = 0;
+
+	r = zoap_packet_init(pkt, buf);
+	if (r) {
+		return r;
+	}
+
+	zoap_header_set_version(pkt, 1);
+	zoap_header_set_type(pkt, type);
+	zoap_header_set_code(pkt, code);
+	zoap_header_set_id(pkt, id);
+
+	return zoap_header_set_token(pkt, (const uint8_t *)token,
+				     strlen(token));
+}
+
+static int test_transactions(void)
+{
+	/* The engine's timer may still run after the test returns */
+	static struct zoap_transactions transactions;
+	struct zoap_transaction t1, t2;
+	struct zoap_packet req1, req2, resp;
+	struct net_buf *buf1, *buf2 = NULL, *resp_buf = NULL;
+	struct zoap_transaction *matched;
+	int result = TC_FAIL;
+	int r;
+
+	/* Free until started, so that they can always be cancelled */
+	memset(&t1, 0, sizeof(t1));
+	memset(&t2, 0, sizeof(t2));
+
+	buf1 = net_buf_get(&zoap_fifo, 0);
+	buf2 = net_buf_get(&zoap_fifo, 0);
+	resp_buf = net_buf_get(&zoap_incoming_fifo, 0);
+	if (!buf1 || !buf2 || !resp_buf) {
+		TC_PRINT("Could not get buffer from pool\n");
+		goto done;
+	}
+
+	transactions_sent = 0;
+	transactions_done = 0;
+
+	zoap_transactions_init(&transactions, transaction_send, 1);
+
+	r = transaction_packet(&req1, buf1, ZOAP_TYPE_CON, ZOAP_METHOD_GET,
+			       0x100, "a");
+	r |= transaction_packet(&req2, buf2, ZOAP_TYPE_CON, ZOAP_METHOD_GET,
+				0x101, "b");
+	if (r) {
+		TC_PRINT("Could not build requests\n");
+		goto done;
+	}
+
+	r = zoap_transaction_start(&transactions, &t1, &req1,
+				   transaction_done, NULL);
+	r |= zoap_transaction_start(&transactions, &t2, &req2,
+				    transaction_done, NULL);
+	if (r || transactions_sent != 1) {
+		TC_PRINT("NSTART not respected (%d sent)\n",
+			 transactions_sent);
+		goto done;
+	}
+
+	/* An empty ACK lets the next request go, the first still waits */
+	transaction_packet(&resp, resp_buf, ZOAP_TYPE_ACK, ZOAP_CODE_EMPTY,
+			   0x100, "");
+	matched = zoap_transaction_received(&transactions, &resp);
+	if (matched != &t1 || transactions_done || transactions_sent != 2) {
+		TC_PRINT("Empty ACK not handled\n");
+		goto done;
+	}
+
+	/* Piggybacked response, matched by message ID */
+	transaction_packet(&resp, resp_buf, ZOAP_TYPE_ACK,
+			   ZOAP_RESPONSE_CODE_CONTENT, 0x101, "b");
+	matched = zoap_transaction_received(&transactions, &resp);
+	if (matched != &t2 || transactions_done != 1 ||
+	    transaction_response != &resp) {
+		TC_PRINT("Piggybacked response not matched\n");
+		goto done;
+	}
+
+	/* Separate response, matched by token */
+	transaction_packet(&resp, resp_buf, ZOAP_TYPE_CON,
+			   ZOAP_RESPONSE_CODE_CONTENT, 0x2000, "a");
+	matched = zoap_transaction_received(&transactions, &resp);
+	if (matched != &t1 || transactions_done != 2) {
+		TC_PRINT("Separate response not matched\n");
+		goto done;
+	}
+
+	/* Duplicates are not matched anymore */
+	matched = zoap_transaction_received(&transactions, &resp);
+	if (matched || transactions.count) {
+		TC_PRINT("Transactions still tracked\n");
+		goto done;
+	}
+
+	result = TC_PASS;
+
+done:
+	/* The engine outlives the transactions, on the stack */
+	zoap_transaction_cancel(&transactions, &t1);
+	zoap_transaction_cancel(&transactions, &t2);
+
+	if (buf1) {
+		net_buf_unref(buf1);
+	}
+
+	if (buf2) {
+		net_buf_unref(buf2);
+	}
+
+	if (resp_buf) {
+		net_buf_unref(resp_buf);
+	}
+
+	TC_END_RESULT(result);
+
+	return result;
+}
+
+static int test_transaction_timeouts(void)
+{
+	static struct zoap_transactions transactions;
+	struct zoap_transaction t;
+	struct zoap_packet req;
+	struct net_buf *buf;
+	int result = TC_FAIL;
+	int i, r;
+
+	memset(&t, 0, sizeof(t));
+
+	buf = net_buf_get(&zoap_fifo, 0);
+	if (!buf) {
+		TC_PRINT("Could not get buffer from pool\n");
+		goto done;
+	}
+
+	/* A confirmable request that is never acknowledged */
+	transactions_sent = 0;
+	transactions_done = 0;
+	transaction_clock = 0;
+
+	zoap_transactions_init(&transactions, transaction_send, 1);
+
+	r = transaction_packet(&req, buf, ZOAP_TYPE_CON, ZOAP_METHOD_GET,
+			       0x200, "c");
+	if (r) {
+		TC_PRINT("Could not build request\n");
+		goto done;
+	}
+
+	r = zoap_transaction_start(&transactions, &t, &req,
+				   transaction_done, NULL);
+	if (r) {
+		TC_PRINT("Could not start transaction\n");
+		goto done;
+	}
+
+	transactions_advance(&transactions, MAX_TRANSMIT_WAIT + TICK);
+
+	if (transactions_sent != 1 + MAX_RETRANSMIT) {
+		TC_PRINT("Sent %d times, expected %d\n", transactions_sent,
+			 1 + MAX_RETRANSMIT);
+		goto done;
+	}
+
+	if (transaction_timeout[0] < ACK_TIMEOUT ||
+	    transaction_timeout[0] > ACK_TIMEOUT_MAX) {
+		TC_PRINT("Initial timeout %u ms out of range\n",
+			 transaction_timeout[0]);
+		goto done;
+	}
+
+	for (i = 1; i <= MAX_RETRANSMIT; i++) {
+		if (transaction_timeout[i] != 2 * transaction_timeout[i - 1]) {
+			TC_PRINT("Timeout %u ms not doubled to %u ms\n",
+				 transaction_timeout[i - 1],
+				 transaction_timeout[i]);
+			goto done;
+		}
+
+		if (!expired_in_time(transaction_sent_at[i - 1],
+				     transaction_sent_at[i],
+				     transaction_timeout[i - 1])) {
+			TC_PRINT("Retransmission %d after %u ms, "
+				 "expected %u ms\n", i,
+				 transaction_sent_at[i] -
+				 transaction_sent_at[i - 1],
+				 transaction_timeout[i - 1]);
+			goto done;
+		}
+	}
+
+	if (transactions_done != 1 || transaction_response ||
+	    !expired_in_time(transaction_sent_at[MAX_RETRANSMIT],
+			     transaction_done_at,
+			     transaction_timeout[MAX_RETRANSMIT])) {
+		TC_PRINT("Not timed out after the last retransmission\n");
+		goto done;
+	}
+
+	/* A non-confirmable request, whose response never comes */
+	transactions_sent = 0;
+	transactions_done = 0;
+	transaction_clock = 0;
+
+	r = transaction_packet(&req, buf, ZOAP_TYPE_NON_CON, ZOAP_METHOD_GET,
+			       0x201, "d");
+	if (r) {
+		TC_PRINT("Could not build request\n");
+		goto done;
+	}
+
+	r = zoap_transaction_start(&transactions, &t, &req,
+				   transaction_done, NULL);
+	if (r) {
+		TC_PRINT("Could not start transaction\n");
+		goto done;
+	}
+
+	transactions_advance(&transactions, MAX_TRANSMIT_WAIT - TICK);
+
+	if (transactions_sent != 1 || transactions_done) {
+		TC_PRINT("Non-confirmable request sent %d times, "
+			 "done %d times before MAX_TRANSMIT_WAIT\n",
+			 transactions_sent, transactions_done);
+		goto done;
+	}
+
+	transactions_advance(&transactions, 2 * TICK);
+
+	if (transactions_sent != 1 || transactions_done != 1 ||
+	    transaction_response ||
+	    !expired_in_time(0, transaction_done_at, MAX_TRANSMIT_WAIT)) {
+		TC_PRINT("Non-confirmable request not done after "
+			 "MAX_TRANSMIT_WAIT\n");
+		goto done;
+	}
+
+	result = TC_PASS;
+
+done:
+	zoap_transaction_cancel(&transactions, &t);
+
+	if (buf) {
+		net_buf_unref(buf);
+	}
+
+	TC_END_RESULT(result);
+
+	return result;
+}
+
+static int publish_sent;
+static bool publish_blocked;
+static struct zoap_observer *publish_observer;
+
+static struct net_buf *publish_alloc(struct zoap_resource *resource,
+				     struct zoap_observer *observer)
+{
+	struct net_buf *buf;
+
+	if (publish_blocked && observer == publish_observer) {
+		return NULL;
+	}
+
+	buf = net_buf_get(&zoap_fifo, 0);
+	if (!buf) {
+		return NULL;
+	}
+
+	ip_buf_appdata(buf) = net_buf_tail(buf);
+	ip_buf_appdatalen(buf) = 0;
+
+	return buf;
+}
+
+static int publish_send(struct zoap_resource *resource,
+			struct zoap_observer *observer,
+			struct zoap_packet *notification)
+{
+	struct net_buf *buf = notification->buf;
+	struct zoap_packet pkt;
+	struct zoap_option option;
+	const uint8_t *token;
+	uint8_t tkl;
+	int r;
+
+	r = zoap_packet_parse(&pkt, buf);
+	if (r) {
+		goto done;
+	}
+
+	r = -EINVAL;
+
+	token = zoap_header_get_token(&pkt, &tkl);
+	if (tkl != observer->tkl || memcmp(token, observer->token, tkl)) {
+		goto done;
+	}
+
+	if (zoap_find_options(&pkt, ZOAP_OPTION_OBSERVE, &option, 1) != 1 ||
+	    zoap_option_value_to_int(&option) != resource->age) {
+		goto done;
+	}
+
+	/* The shared part follows, with its options and payload */
+	if (zoap_find_options(&pkt, ZOAP_OPTION_CONTENT_FORMAT,
+			      &option, 1) != 1 ||
+	    !pkt.start || memcmp(pkt.start, "22.5", 4)) {
+		goto done;
+	}
+
+	publish_sent++;
+	r = 0;
+
+done:
+	net_buf_unref(buf);
+	return r;
+}
+
+static int test_observer_publish(void)
+{
+	uint8_t observe_pdu_1[] = { 0x42, 0x01, 0x12, 0x34, 'o', '1', 0x60 };
+	uint8_t observe_pdu_2[] = { 0x42, 0x01, 0x12, 0x35, 'o', '2', 0x60 };
+	struct zoap_resource resource = { };
+	struct zoap_observer obs[2];
+	struct zoap_notifier notifier = {
+		.alloc = publish_alloc,
+		.send = publish_send,
+		.type = ZOAP_TYPE_NON_CON,
+	};
+	struct zoap_packet pkt, representation;
+	struct net_buf *buf;
+	uint8_t *payload;
+	uint16_t len;
+	int result = TC_FAIL;
+	int r;
+
+	buf = net_buf_get(&zoap_incoming_fifo, 0);
+	if (!buf) {
+		TC_PRINT("Could not get buffer from pool\n");
+		goto done;
+	}
+
+	sys_slist_init(&resource.observers);
+
+	/* Two observers register */
+	ip_buf_appdata(buf) = net_buf_tail(buf);
+	memcpy(ip_buf_appdata(buf), observe_pdu_1, sizeof(observe_pdu_1));
+	ip_buf_appdatalen(buf) = sizeof(observe_pdu_1);
+	r = zoap_packet_parse(&pkt, buf);
+	zoap_observer_init(&obs[0], &pkt, &dummy_addr, MY_PORT);
+	zoap_register_observer(&resource, &obs[0]);
+
+	memcpy(ip_buf_appdata(buf), observe_pdu_2, sizeof(observe_pdu_2));
+	ip_buf_appdatalen(buf) = sizeof(observe_pdu_2);
+	r |= zoap_packet_parse(&pkt, buf);
+	zoap_observer_init(&obs[1], &pkt, &dummy_addr, MY_PORT + 1);
+	zoap_register_observer(&resource, &obs[1]);
+	if (r) {
+		TC_PRINT("Could not parse observe requests\n");
+		goto done;
+	}
+
+	/* The representation, serialized once for all the observers */
+	ip_buf_appdatalen(buf) = 0;
+	r = zoap_packet_init(&representation, buf);
+	zoap_header_set_version(&representation, 1);
+	zoap_header_set_code(&representation, ZOAP_RESPONSE_CODE_CONTENT);
+	r |= zoap_add_option_int(&representation, ZOAP_OPTION_OBSERVE, 0);
+	r |= zoap_add_option_int(&representation,
+				 ZOAP_OPTION_CONTENT_FORMAT, 0);
+	payload = zoap_packet_get_payload(&representation, &len);
+	if (r || !payload) {
+		TC_PRINT("Could not build representation\n");
+		goto done;
+	}
+	memcpy(payload, "22.5", 4);
+	zoap_packet_set_used(&representation, 4);
+
+	publish_sent = 0;
+	publish_blocked = false;
+
+	r = zoap_resource_publish(&resource, &notifier, &representation);
+	if (r != 0 || publish_sent != 2) {
+		TC_PRINT("Observers not notified (%d sent)\n", publish_sent);
+		goto done;
+	}
+
+	/* Too soon: both updates are coalesced into one notification */
+	notifier.interval = sys_clock_ticks_per_sec * 60;
+
+	r = zoap_resource_publish(&resource, &notifier, &representation);
+	r = zoap_resource_publish(&resource, &notifier, &representation);
+	if (r != 2 || publish_sent != 2) {
+		TC_PRINT("Notifications not rate limited\n");
+		goto done;
+	}
+
+	/* One observer can't take notifications for now */
+	notifier.interval = 0;
+	publish_blocked = true;
+	publish_observer = &obs[1];
+
+	r = zoap_resource_flush(&resource, &notifier, &representation);
+	if (r != 1 || publish_sent != 3) {
+		TC_PRINT("Back-pressure not handled\n");
+		goto done;
+	}
+
+	publish_blocked = false;
+
+	r = zoap_resource_flush(&resource, &notifier, &representation);
+	if (r != 0 || publish_sent != 4) {
+		TC_PRINT("Pending observer not notified\n");
+		goto done;
+	}
+
+	result = TC_PASS;
+
+done:
+	if (buf) {
+		net_buf_unref(buf);
+	}
 
 	TC_END_RESULT(result);
 
@@ -825,6 +1836,13 @@ static const struct {
 	{ "Test retransmission", test_retransmit_second_round, },
 	{ "Test observer server", test_observer_server, },
 	{ "Test observer server", test_observer_client, },
+	{ "Test resource index", test_resource_index, },
+	{ "Test integer options", test_option_int, },
+	{ "Test block-wise GET", test_block2_transfer, },
+	{ "Test block-wise PUT", test_block1_transfer, },
+	{ "Test transactions", test_transactions, },
+	{ "Test transaction timeouts", test_transaction_timeouts, },
+	{ "Test observer publish", test_observer_publish, },
 };
 
 int main(int argc, char *argv[])
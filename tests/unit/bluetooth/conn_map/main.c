@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <ztest.h>
+
+#define CONFIG_BLUETOOTH_MAX_CONN 8
+
+#include <net/bluetooth/conn_map.c>
+
+static struct bt_conn_map map;
+
+/* Handle of each connection index, as the caller would keep it */
+static uint16_t handles[CONFIG_BLUETOOTH_MAX_CONN];
+
+static uint8_t lookup(uint16_t handle)
+{
+	uint8_t i;
+
+	for (i = bt_conn_map_first(&map, handle); i != BT_CONN_MAP_NONE;
+	     i = bt_conn_map_next(&map, i)) {
+		if (handles[i] == handle) {
+			return i;
+		}
+	}
+
+	return BT_CONN_MAP_NONE;
+}
+
+static void add(uint8_t index, uint16_t handle)
+{
+	handles[index] = handle;
+	bt_conn_map_add(&map, index, handle);
+}
+
+static void test_empty(void)
+{
+	bt_conn_map_init(&map);
+
+	assert_equal(lookup(0x0000), BT_CONN_MAP_NONE, "Found in empty map");
+	assert_equal(lookup(0x0eff), BT_CONN_MAP_NONE, "Found in empty map");
+
+	/* Removing an index not in the map is a no-op */
+	bt_conn_map_remove(&map, 3);
+	assert_equal(lookup(0x0000), BT_CONN_MAP_NONE, "Found in empty map");
+}
+
+static void test_add_lookup(void)
+{
+	uint8_t i;
+
+	bt_conn_map_init(&map);
+
+	for (i = 0; i < CONFIG_BLUETOOTH_MAX_CONN; i++) {
+		add(i, 0x0040 + i);
+	}
+
+	for (i = 0; i < CONFIG_BLUETOOTH_MAX_CONN; i++) {
+		assert_equal(lookup(0x0040 + i), i, "Wrong index");
+		/* Sequential handles don't share buckets */
+		assert_equal(bt_conn_map_next(&map, i), BT_CONN_MAP_NONE,
+			     "Unexpected collision");
+	}
+
+	assert_equal(lookup(0x0040 + CONFIG_BLUETOOTH_MAX_CONN),
+		     BT_CONN_MAP_NONE, "Found unknown handle");
+}
+
+static void test_collisions(void)
+{
+	bt_conn_map_init(&map);
+
+	/* All three handles land in the same bucket */
+	add(1, 0x0001);
+	add(4, 0x0001 + BT_CONN_MAP_BUCKETS);
+	add(6, 0x0001 + 2 * BT_CONN_MAP_BUCKETS);
+
+	assert_equal(lookup(0x0001), 1, "Wrong index");
+	assert_equal(lookup(0x0001 + BT_CONN_MAP_BUCKETS), 4, "Wrong index");
+	assert_equal(lookup(0x0001 + 2 * BT_CONN_MAP_BUCKETS), 6,
+		     "Wrong index");
+
+	/* Remove from the middle of the chain */
+	bt_conn_map_remove(&map, 4);
+
+	assert_equal(lookup(0x0001), 1, "Lost head after remove");
+	assert_equal(lookup(0x0001 + BT_CONN_MAP_BUCKETS), BT_CONN_MAP_NONE,
+		     "Found removed handle");
+	assert_equal(lookup(0x0001 + 2 * BT_CONN_MAP_BUCKETS), 6,
+		     "Lost tail after remove");
+
+	/* Remove the head of the chain */
+	bt_conn_map_remove(&map, 6);
+	assert_equal(lookup(0x0001), 1, "Lost entry after remove");
+	assert_equal(bt_conn_map_first(&map, 0x0001), 1, "Wrong chain head");
+	assert_equal(bt_conn_map_next(&map, 1), BT_CONN_MAP_NONE,
+		     "Wrong chain tail");
+}
+
+static void test_move(void)
+{
+	bt_conn_map_init(&map);
+
+	add(2, 0x0002);
+	add(3, 0x0003);
+
+	/* Re-adding an index moves it to its new bucket */
+	add(2, 0x0005);
+
+	assert_equal(lookup(0x0002), BT_CONN_MAP_NONE, "Found stale handle");
+	assert_equal(lookup(0x0005), 2, "Wrong index");
+	assert_equal(lookup(0x0003), 3, "Wrong index");
+	assert_equal(bt_conn_map_first(&map, 0x0002), BT_CONN_MAP_NONE,
+		     "Stale entry left in old bucket");
+}
+
+static void test_hash(void)
+{
+	const uint8_t a[] = { 0x01, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66 };
+	const uint8_t b[] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66 };
+	const uint8_t c[] = { 0x01, 0x11, 0x22, 0x33, 0x44, 0x55, 0x67 };
+
+	assert_equal(bt_conn_map_hash(a, sizeof(a)),
+		     bt_conn_map_hash(a, sizeof(a)), "Hash not stable");
+	assert_true(bt_conn_map_hash(a, sizeof(a)) !=
+		    bt_conn_map_hash(b, sizeof(b)), "Address type not hashed");
+	assert_true(bt_conn_map_hash(a, sizeof(a)) !=
+		    bt_conn_map_hash(c, sizeof(c)), "Address not hashed");
+}
+
+void test_main(void)
+{
+	ztest_test_suite(bt_conn_map_test,
+		ztest_unit_test(test_empty),
+		ztest_unit_test(test_add_lookup),
+		ztest_unit_test(test_collisions),
+		ztest_unit_test(test_move),
+		ztest_unit_test(test_hash)
+	);
+
+	ztest_run_test_suite(bt_conn_map_test);
+}